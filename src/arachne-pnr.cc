@@ -16,28 +16,44 @@
 #include "netlist.hh"
 #include "chipdb.hh"
 #include "blif.hh"
-#include "pack.hh"
-#include "io.hh"
 #include "place.hh"
 #include "route.hh"
 #include "configuration.hh"
 #include "pcf.hh"
 #include "casting.hh"
-#include "global.hh"
 #include "carry.hh"
-#include "constant.hh"
 #include "designstate.hh"
+#include "checkpoint.hh"
+#include "eco.hh"
+#include "cache.hh"
+#include "arachne.hh"
+#include "stats.hh"
+#include "server.hh"
+#include "textwriter.hh"
 #include "util.hh"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cstring>
 #include <cstdlib>
+#include <thread>
+
+#include <sys/stat.h>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define HAVE_FORK
+#include <map>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 const char *program_name;
 
 class null_streambuf : public std::streambuf
@@ -97,8 +113,37 @@ usage()
     << "    --route-only\n"
     << "        Input must include placement.\n"
     << "\n"
+    << "    --checkpoint <file>\n"
+    << "        Write a binary checkpoint of the design and its packing,\n"
+    << "        placement and routing state to <file>.\n"
+    << "    --checkpoint-after <stage>\n"
+    << "        Stage to write the checkpoint after: pack (everything\n"
+    << "        before placement), place or route.\n"
+    << "        Default: place\n"
+    << "    --resume <file>\n"
+    << "        Continue from the checkpoint in <file> instead of reading\n"
+    << "        an input file, skipping the stages it covers.  Run with\n"
+    << "        the same seed and options, the result is as if arachne-pnr\n"
+    << "        had not stopped.\n"
+    << "\n"
+    << "    --eco <file>\n"
+    << "        Incremental place and route against the placed or routed\n"
+    << "        checkpoint in <file> of an earlier version of the design.\n"
+    << "        Instances that are unchanged keep their cells, the rest are\n"
+    << "        placed around them, and nets start from their previous\n"
+    << "        routes.\n"
+    << "\n"
+    << "    --cache-dir <dir>\n"
+    << "        Keep checkpoints after pack, place and route in <dir>, named\n"
+    << "        by a hash of the input, constraints, chipdb, version and\n"
+    << "        the options each stage depends on, and resume from the\n"
+    << "        last stage an earlier run had the same inputs for.\n"
+    << "\n"
     << "    -p <pcf-file>, --pcf-file <pcf-file>\n"
     << "        Read physical constraints from <pcf-file>.\n"
+    << "        Besides set_io, set_region <pattern> <xmin> <ymin> <xmax>\n"
+    << "        <ymax> keeps the gates driving nets whose names match the\n"
+    << "        glob <pattern> in that box of tiles.\n"
     << "\n"
     << "    -P <package>, --package <package>\n"
     << "        Target package <package>.\n"
@@ -111,47 +156,468 @@ usage()
     << "        Maximum number of routing passes.\n"
     << "        Default: 200\n"
     << "\n"
+    << "    --place-threads <int>\n"
+    << "        Anneal the logic cells on <int> threads, each in its own\n"
+    << "        band of columns.  The result depends on the seed and <int>\n"
+    << "        only, and differs from the default serial placer.\n"
+    << "\n"
+    << "    --place-congestion <weight>\n"
+    << "        Add <weight> times an estimate of routing congestion,\n"
+    << "        from the net bounding boxes, to the wire length the\n"
+    << "        placer minimizes.  Try 1 for designs that take many\n"
+    << "        routing passes.  Default: 0\n"
+    << "\n"
+    << "    --place-timing <weight>\n"
+    << "        Add <weight> times the length of each net, scaled by how\n"
+    << "        close it is to the critical path, to the wire length the\n"
+    << "        placer minimizes.  Delays are estimated from the placement\n"
+    << "        once per temperature.  Try 1.  Default: 0\n"
+    << "\n"
+    << "    --place-schedule <schedule>\n"
+    << "        Annealing schedule: default, or adaptive, which scales the\n"
+    << "        moves per temperature with the design size and cools by the\n"
+    << "        acceptance rate.  Adaptive is faster on small designs.\n"
+    << "        Default: default\n"
+    << "\n"
+    << "    --place-time-budget <time>\n"
+    << "        Cool fast enough to finish placement in about <time>\n"
+    << "        (e.g. 30s, 500ms or 2m), and stop when it runs out.\n"
+    << "\n"
+    << "    --place-analytic\n"
+    << "        Start placement from a quadratic wire length solution and\n"
+    << "        only refine it locally.  Faster on large designs, but\n"
+    << "        results differ from the default placer.\n"
+    << "\n"
+    << "    --place-multilevel\n"
+    << "        Start placement from an annealing of tile-sized clusters of\n"
+    << "        connected gates and only refine it locally.  Faster on large\n"
+    << "        designs, but results differ from the default placer.\n"
+    << "\n"
+    << "    --place-chain-moves\n"
+    << "        Also slide carry chains along their columns, swap them, and\n"
+    << "        move them into gaps between other chains.  Results differ\n"
+    << "        from the default placer.\n"
+    << "\n"
+    << "    --route-astar\n"
+    << "        Direct the router search towards the targets.  Faster on\n"
+    << "        large devices, but results differ from the default search.\n"
+    << "\n"
+    << "    --route-bbox-margin <int>\n"
+    << "        Only search the routing resources near the bounding box of\n"
+    << "        each net, grown by <int> tiles.  The box is grown for nets\n"
+    << "        that fail or stay congested.\n"
+    << "\n"
+    << "    --route-multi-sink\n"
+    << "        Route all the targets of a net in one search instead of\n"
+    << "        restarting the search for each.  Faster on high-fanout\n"
+    << "        nets, but results differ from the default search.\n"
+    << "\n"
+    << "    --route-radix-queue\n"
+    << "        Keep the router search frontier in a radix heap instead of a\n"
+    << "        binary heap.  Ties are broken differently, so results differ.\n"
+    << "\n"
+    << "    --route-schedule <schedule>\n"
+    << "        Congestion cost schedule: default, or adaptive, which\n"
+    << "        raises the cost of shared routing resources each pass.\n"
+    << "        Default: default\n"
+    << "\n"
+    << "    --route-steiner <int>\n"
+    << "        Route nets with at least <int> targets along a rectilinear\n"
+    << "        Steiner tree over their tiles, searching near one edge of\n"
+    << "        the tree at a time.  Less search and wire on high-fanout\n"
+    << "        nets, but results differ from the default search.\n"
+    << "\n"
+    << "    --route-stall-passes <int>\n"
+    << "        Fail as unroutable when the fewest shared routing resources\n"
+    << "        so far did not improve in the last <int> passes, or is not\n"
+    << "        falling fast enough to reach none within the maximum\n"
+    << "        number of passes.\n"
+    << "\n"
+    << "    --route-timing <weight>\n"
+    << "        Add <weight> times the criticality of each net times the\n"
+    << "        delay of each wire, about 1 per wire, to the router cost,\n"
+    << "        so critical nets take faster routes.  Criticality is\n"
+    << "        updated after each pass.  Implies --report-timing.\n"
+    << "        Default: 0\n"
+    << "\n"
+    << "    --report-timing\n"
+    << "        After routing, report the estimated max delay and the\n"
+    << "        critical path.\n"
+    << "\n"
+    << "    --route-threads <int>\n"
+    << "        Route nets with disjoint bounding boxes concurrently on <int>\n"
+    << "        threads.  The result does not depend on <int>, but differs\n"
+    << "        from the default serial router.\n"
+    << "\n"
+    << "    --route-trace <file>\n"
+    << "        Write a line of JSON to <file> for each routing pass with its\n"
+    << "        wall time, the nets rerouted, the cnets expanded, pushed and\n"
+    << "        popped, and the overuse of each congested tile.  Not written\n"
+    << "        when the route comes from --cache-dir.\n"
+    << "\n"
     << "    -s <int>, --seed <int>\n"
     << "        Set seed for random generator to <int>.\n"
     << "        Default: 1\n"
     << "\n"
+    << "    --seeds <int>\n"
+    << "        Place and route with the <int> seeds starting at the seed\n"
+    << "        given by -s or -r, then write the routed result with the\n"
+    << "        shortest wire length.  Ties go to fewer routing passes.\n"
+    << "\n"
+    << "    --jobs <int>\n"
+    << "        Try up to <int> seeds at a time with --seeds, or run up\n"
+    << "        to <int> jobs at a time with --server.\n"
+    << "        Default: 1, or the number of processors with --server\n"
+    << "\n"
+    << "    --seed-successes <int>\n"
+    << "        Stop trying seeds once <int> have routed.  With --jobs,\n"
+    << "        which seeds get to finish can vary from run to run.\n"
+    << "        Default: all seeds\n"
+    << "\n"
     << "    -w <pcf-file>, --write-pcf <pcf-file>\n"
     << "        Write pin assignments to <pcf-file> after placement.\n"
     << "\n"
     << "    -o <output-file>, --output-file <output-file>\n"
     << "        Write output to <output-file>.\n"
     << "\n"
+    << "    --experimental-binary-output\n"
+    << "        Write the output as a packed bitstream instead of text.\n"
+    << "        Experimental: it has not been checked against icepack\n"
+    << "        output, so use icepack on the text for real hardware.\n"
+    << "        Not supported for the 5k and lm4k.\n"
+    << "\n"
+    << "    --server <socket>\n"
+    << "        Load the chipdbs of all devices, and the one given by -c,\n"
+    << "        once and run jobs from --client on the Unix socket\n"
+    << "        <socket> until interrupted.\n"
+    << "\n"
+    << "    --client <socket>\n"
+    << "        Run on the server listening on <socket>, with the other\n"
+    << "        options, standard streams and working directory of this\n"
+    << "        command.  Exits with the status of the job.\n"
+    << "\n"
+    << "    --stats-json <file>\n"
+    << "        Write the time and peak memory of each phase and placer and\n"
+    << "        router counters to <file> as JSON.\n"
+    << "\n"
+    << "    --low-memory\n"
+    << "        Lower peak memory: drop the chipdb wire names, which are only\n"
+    << "        used by --route-trace, and, unless a netlist is written with\n"
+    << "        -B, -V or --post-place-blif, the yosys src and hdlname\n"
+    << "        attributes, which are only written back out.  Free memory\n"
+    << "        is returned to the system and the peak is logged after\n"
+    << "        each stage.\n"
+    << "\n"
     << "    -v, --version\n"
     << "        Print version and exit.\n";
 }
 
+static const ChipDB *
+load_chipdb(const std::string &filename, int n_threads, bool low_memory)
+{
+  ChipDB *chipdb = read_chipdb(filename, n_threads);
+  // only for diagnostics, and not in binary chipdbs
+  if (low_memory)
+    std::vector<std::pair<int, std::string>>().swap(chipdb->net_tile_name);
+  return chipdb;
+}
+
+static int
+parse_unsigned(const char *what, const char *str)
+{
+  std::string s = str;
+  if (s.empty())
+    fatal(fmt("invalid empty " << what));
+
+  int x = 0;
+  for (char ch : s)
+    {
+      if (ch >= '0'
+          && ch <= '9')
+        x = x * 10 + (int)(ch - '0');
+      else
+        fatal(fmt("invalid character `"
+                  << ch
+                  << "' in unsigned integer literal in " << what));
+    }
+  return x;
+}
+
+static double
+parse_real(const char *what, const char *str)
+{
+  char *end;
+  double x = strtod(str, &end);
+  if (end == str
+      || *end
+      || x < 0)
+    fatal(fmt("invalid " << what << " `" << str << "'"));
+  return x;
+}
+
+// seconds, with an optional ms, s or m suffix
+double
+parse_duration(const char *what, const char *str)
+{
+  char *end;
+  double x = strtod(str, &end);
+  if (end == str
+      || x < 0)
+    fatal(fmt("invalid " << what << " `" << str << "'"));
+  
+  std::string unit = end;
+  if (unit == "ms")
+    x /= 1000;
+  else if (unit == "m")
+    x *= 60;
+  else if (unit != ""
+           && unit != "s")
+    fatal(fmt("invalid unit `" << unit << "' in " << what
+              << ", expected ms, s or m"));
+  return x;
+}
+
 struct null_ostream : public std::ostream
 {
   null_ostream() : std::ostream(0) {}
 };
 
-int
-main(int argc, const char **argv)
+#ifdef HAVE_FORK
+struct SeedResult
 {
-#ifdef __EMSCRIPTEN__
-  EM_ASM(
-    if (ENVIRONMENT_IS_NODE)
+  int wire_length;
+  int passes;
+};
+
+struct SeedRun
+{
+  unsigned seed;
+  int fd;
+  std::string place_checkpoint,
+    route_checkpoint;
+};
+
+static std::string
+temp_file(const char *what)
+{
+  const char *tmpdir = getenv("TMPDIR");
+  std::string name = fmt((tmpdir && *tmpdir ? tmpdir : "/tmp")
+                         << "/arachne-pnr-" << what << "-XXXXXX");
+  std::vector<char> buf(name.begin(), name.end());
+  buf.push_back('\0');
+  int fd = mkstemp(buf.data());
+  if (fd < 0)
+    fatal(fmt("mkstemp: " << strerror(errno)));
+  close(fd);
+  return buf.data();
+}
+
+// Place and route ds with each of n_seeds seeds starting at
+// first_seed, n_jobs at a time, each in a forked copy of the process
+// so ds itself is untouched.  Returns the seed to use, and the
+// checkpoints the winning copy wrote after place and after route,
+// which the caller resumes from and removes.
+static unsigned
+portfolio_seed(DesignState &ds,
+               const PlaceOptions &place_opts,
+               const RouteOptions &route_opts,
+               unsigned first_seed,
+               int n_seeds,
+               int n_jobs,
+               int n_successes,
+               std::string &place_checkpoint,
+               std::string &route_checkpoint)
+{
+  std::cout.flush();
+  std::cerr.flush();
+  logs->flush();
+  
+  std::map<pid_t, SeedRun> running;
+  int next = 0,
+    n_routed = 0;
+  SeedRun best_run = { 0, -1, "", "" };
+  SeedResult best = { 0, 0 };
+  bool stopping = false;
+  for (;;)
     {
-      FS.mkdir('/hostcwd');
-      FS.mount(NODEFS, { root: '.' }, '/hostcwd');
-      FS.mkdir('/hostfs');
-      FS.mount(NODEFS, { root: '/' }, '/hostfs');
+      while (!stopping
+             && next < n_seeds
+             && (int)running.size() < n_jobs)
+        {
+          unsigned seed = first_seed + (unsigned)next++;
+          if (!seed)
+            continue;
+          
+          SeedRun run = { seed, -1,
+                          temp_file("place"), temp_file("route") };
+          int fds[2];
+          if (pipe(fds) < 0)
+            fatal(fmt("pipe: " << strerror(errno)));
+          pid_t pid = fork();
+          if (pid < 0)
+            fatal(fmt("fork: " << strerror(errno)));
+          if (pid == 0)
+            {
+              close(fds[0]);
+              int null_fd = open("/dev/null", O_WRONLY);
+              if (null_fd >= 0)
+                {
+                  dup2(null_fd, 1);
+                  dup2(null_fd, 2);
+                }
+              logs = new std::ostream(new null_streambuf);
+              
+              random_generator rg(seed);
+              SeedResult r;
+              r.wire_length = place(rg, ds, place_opts);
+              write_checkpoint(run.place_checkpoint,
+                               CheckpointStage::PLACE, ds);
+              r.passes = route(ds, route_opts);
+              write_checkpoint(run.route_checkpoint,
+                               CheckpointStage::ROUTE, ds);
+              ssize_t n = write(fds[1], &r, sizeof(r));
+              _exit(n == (ssize_t)sizeof(r) ? 0 : 1);
+            }
+          close(fds[1]);
+          run.fd = fds[0];
+          running[pid] = run;
+        }
+      
+      if (running.empty())
+        break;
+      
+      int status;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          fatal(fmt("waitpid: " << strerror(errno)));
+        }
+      auto i = running.find(pid);
+      if (i == running.end())
+        continue;
+      SeedRun run = i->second;
+      unsigned seed = run.seed;
+      running.erase(i);
+      
+      SeedResult r;
+      bool routed = (WIFEXITED(status)
+                     && WEXITSTATUS(status) == 0
+                     && read(run.fd, &r, sizeof(r)) == (ssize_t)sizeof(r));
+      close(run.fd);
+      
+      if (!routed)
+        {
+          if (!stopping)
+            *logs << "  seed " << seed << ": failed\n";
+          unlink(run.place_checkpoint.c_str());
+          unlink(run.route_checkpoint.c_str());
+          continue;
+        }
+      
+      *logs << "  seed " << seed << ": wire length " << r.wire_length
+            << ", " << r.passes << " passes\n";
+      if (!best_run.seed
+          || r.wire_length < best.wire_length
+          || (r.wire_length == best.wire_length
+              && (r.passes < best.passes
+                  || (r.passes == best.passes
+                      && seed < best_run.seed))))
+        {
+          std::swap(best_run, run);
+          best = r;
+        }
+      if (run.seed)
+        {
+          unlink(run.place_checkpoint.c_str());
+          unlink(run.route_checkpoint.c_str());
+        }
+      
+      if (++n_routed >= n_successes
+          && !stopping)
+        {
+          stopping = true;
+          for (const auto &p : running)
+            kill(p.first, SIGKILL);
+        }
     }
-  );
+  
+  if (!best_run.seed)
+    fatal(fmt("failed to route with any of " << n_seeds << " seeds"));
+  place_checkpoint = best_run.place_checkpoint;
+  route_checkpoint = best_run.route_checkpoint;
+  return best_run.seed;
+}
+
+// resume ds from a checkpoint portfolio_seed's winning copy wrote
+static void
+read_seed_checkpoint(DesignState &ds, const std::string &filename)
+{
+  *logs << "read_checkpoint " << filename << "...\n";
+  CheckpointReader reader(filename, ds.chipdb);
+  reader.match_design(ds.top);
+  reader.read_state(ds);
+  unlink(filename.c_str());
+}
 #endif
 
-  program_name = argv[0];
+static std::string
+default_chipdb_file(const std::string &device)
+{
+#if defined(_WIN32) && defined(MXE_DIR_STRUCTURE)
+  return std::string("+/chipdb-") + device + ".bin";
+#else
+  return std::string("+/share/arachne-pnr/chipdb-") + device + ".bin";
+#endif
+}
+
+#ifdef HAVE_SERVER
+// chipdbs loaded by --server, by absolute path
+static std::map<std::string, const ChipDB *> resident_chipdbs;
+static bool in_server_job = false;
+
+static std::string
+resident_chipdb_key(const std::string &filename)
+{
+  std::string expanded = expand_filename(filename);
+  char *path = realpath(expanded.c_str(), nullptr);
+  if (!path)
+    return expanded;
+  std::string key = path;
+  free(path);
+  return key;
+}
+
+static int run(int argc, const char **argv);
+
+static int
+run_server_job(int argc, const char **argv)
+{
+  in_server_job = true;
+  stats = Stats();
+  return run(argc, argv);
+}
+#endif
+
+static int
+run(int argc, const char **argv)
+{
 
   bool help = false,
     quiet = false,
     do_promote_globals = true,
     route_only = false,
-    randomize_seed = false;
+    randomize_seed = false,
+    route_astar = false,
+    place_analytic = false,
+    place_multilevel = false,
+    place_chain_moves = false,
+    route_radix_queue = false,
+    route_multi_sink = false,
+    low_memory = false,
+    binary_output = false,
+    report_timing = false;
   std::string device = "1k";
   const char *chipdb_file = nullptr,
     *input_file = nullptr,
@@ -164,7 +630,31 @@ main(int argc, const char **argv)
     *output_file = nullptr,
     *seed_str = nullptr,
     *max_passes_str = nullptr,
+    *place_threads_str = nullptr,
+    *seeds_str = nullptr,
+    *stats_json = nullptr,
+    *jobs_str = nullptr,
+    *seed_successes_str = nullptr,
+    *route_threads_str = nullptr,
+    *route_bbox_margin_str = nullptr,
+    *route_schedule_str = nullptr,
+    *route_stall_passes_str = nullptr,
+    *route_steiner_str = nullptr,
+    *route_trace_file = nullptr,
+    *checkpoint_file = nullptr,
+    *checkpoint_after_str = nullptr,
+    *resume_file = nullptr,
+    *eco_file = nullptr,
+    *cache_dir = nullptr,
+    *place_schedule_str = nullptr,
+    *place_congestion_str = nullptr,
+    *place_timing_str = nullptr,
+    *route_timing_str = nullptr,
+    *place_time_budget_str = nullptr,
+    *server_socket = nullptr,
+    *client_socket = nullptr,
     *binary_chipdb = nullptr;
+  int client_arg = 0;
 
   for (int i = 1; i < argc; ++i)
     {
@@ -233,6 +723,46 @@ main(int argc, const char **argv)
             }
           else if (!strcmp(argv[i], "--route-only"))
             route_only = true;
+          else if (!strcmp(argv[i], "--checkpoint"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              checkpoint_file = argv[i];
+            }
+          else if (!strcmp(argv[i], "--checkpoint-after"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              checkpoint_after_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--resume"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              resume_file = argv[i];
+            }
+          else if (!strcmp(argv[i], "--eco"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              eco_file = argv[i];
+            }
+          else if (!strcmp(argv[i], "--cache-dir"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              cache_dir = argv[i];
+            }
           else if (!strcmp(argv[i], "-p")
                    || !strcmp(argv[i], "--pcf-file"))
             {
@@ -271,6 +801,59 @@ main(int argc, const char **argv)
               ++i;
               seed_str = argv[i];
             }
+          else if (!strcmp(argv[i], "--server"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              server_socket = argv[i];
+            }
+          else if (!strcmp(argv[i], "--client"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              client_arg = i;
+              ++i;
+              client_socket = argv[i];
+            }
+          else if (!strcmp(argv[i], "--low-memory"))
+            low_memory = true;
+          else if (!strcmp(argv[i], "--experimental-binary-output"))
+            binary_output = true;
+          else if (!strcmp(argv[i], "--stats-json"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              stats_json = argv[i];
+            }
+          else if (!strcmp(argv[i], "--seeds"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              seeds_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--jobs"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              jobs_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--seed-successes"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              seed_successes_str = argv[i];
+            }
           else if (!strcmp(argv[i], "-m")
                    || !strcmp(argv[i], "--max-passes"))
             {
@@ -280,6 +863,116 @@ main(int argc, const char **argv)
               ++i;
               max_passes_str = argv[i];
             }
+          else if (!strcmp(argv[i], "--place-threads"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              place_threads_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--route-threads"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_threads_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--place-congestion"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              place_congestion_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--place-timing"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              place_timing_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--route-timing"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_timing_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--route-trace"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_trace_file = argv[i];
+            }
+          else if (!strcmp(argv[i], "--report-timing"))
+            report_timing = true;
+          else if (!strcmp(argv[i], "--place-schedule"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              place_schedule_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--place-time-budget"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              place_time_budget_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--place-analytic"))
+            place_analytic = true;
+          else if (!strcmp(argv[i], "--place-multilevel"))
+            place_multilevel = true;
+          else if (!strcmp(argv[i], "--place-chain-moves"))
+            place_chain_moves = true;
+          else if (!strcmp(argv[i], "--route-astar"))
+            route_astar = true;
+          else if (!strcmp(argv[i], "--route-radix-queue"))
+            route_radix_queue = true;
+          else if (!strcmp(argv[i], "--route-multi-sink"))
+            route_multi_sink = true;
+          else if (!strcmp(argv[i], "--route-bbox-margin"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_bbox_margin_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--route-schedule"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_schedule_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--route-stall-passes"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_stall_passes_str = argv[i];
+            }
+          else if (!strcmp(argv[i], "--route-steiner"))
+            {
+              if (i + 1 >= argc)
+                fatal(fmt(argv[i] << ": expected argument"));
+
+              ++i;
+              route_steiner_str = argv[i];
+            }
           else if (!strcmp(argv[i], "-o")
                    || !strcmp(argv[i], "--output-file"))
             {
@@ -313,12 +1006,45 @@ main(int argc, const char **argv)
       exit(EXIT_SUCCESS);
     }
 
+#ifdef HAVE_SERVER
+  if ((server_socket || client_socket)
+      && in_server_job)
+    fatal("--server and --client cannot be used in a server job");
+  if (server_socket
+      && client_socket)
+    fatal("--server cannot be used with --client");
+  if (client_socket)
+    {
+      std::vector<std::string> args;
+      for (int i = 1; i < argc; ++i)
+        {
+          if (i == client_arg
+              || i == client_arg + 1)
+            continue;
+          args.push_back(argv[i]);
+        }
+      return run_on_server(client_socket, args);
+    }
+#else
+  if (server_socket
+      || client_socket)
+    fatal("--server and --client are not supported on this platform");
+#endif
+
   if (device != "384"
       && device != "1k"
       && device != "5k"
       && device != "lm4k"
       && device != "8k")
     fatal(fmt("unknown device: " << device));
+  if (binary_output)
+    {
+      if (device == "5k" || device == "lm4k")
+        fatal(fmt("--experimental-binary-output is not supported for the "
+                  << device));
+      warning("--experimental-binary-output has not been checked against "
+              "icepack; use icepack on the text output for real hardware");
+    }
 
   std::string package_name;
   if (package_name_cp)
@@ -365,10 +1091,120 @@ main(int argc, const char **argv)
   else
     seed = 1;
 
-  int max_passes = 0;
+  int n_seeds = 1;
+  if (seeds_str)
+    {
+      n_seeds = parse_unsigned("seeds value", seeds_str);
+      if (n_seeds < 1)
+        fatal("seeds value must be at least 1");
+#ifndef HAVE_FORK
+      if (n_seeds > 1)
+        fatal("--seeds is not supported on this platform");
+#endif
+      if (n_seeds > 1
+          && route_only)
+        fatal("--seeds cannot be used with --route-only");
+      if (n_seeds > 1
+          && route_trace_file)
+        fatal("--seeds cannot be used with --route-trace");
+    }
+  int n_jobs = 1;
+  if (server_socket)
+    n_jobs = std::max(1, (int)std::thread::hardware_concurrency());
+  if (jobs_str)
+    {
+      n_jobs = parse_unsigned("jobs value", jobs_str);
+      if (n_jobs < 1)
+        fatal("jobs value must be at least 1");
+    }
+  int n_seed_successes = n_seeds;
+  if (seed_successes_str)
+    {
+      n_seed_successes = parse_unsigned("seed-successes value",
+                                        seed_successes_str);
+      if (n_seed_successes < 1)
+        fatal("seed-successes value must be at least 1");
+    }
+
+  CheckpointStage checkpoint_after = CheckpointStage::NONE;
+  if (checkpoint_after_str)
+    {
+      if (!checkpoint_file)
+        fatal("--checkpoint-after requires --checkpoint");
+      checkpoint_after = parse_checkpoint_stage(checkpoint_after_str);
+    }
+  else if (checkpoint_file)
+    checkpoint_after = CheckpointStage::PLACE;
+  if (checkpoint_after != CheckpointStage::NONE
+      && checkpoint_after != CheckpointStage::ROUTE
+      && route_only)
+    fatal("--route-only can only be checkpointed after route");
+  if (resume_file)
+    {
+      if (input_file)
+        fatal("--resume does not take an input file");
+      if (route_only)
+        fatal("--resume cannot be used with --route-only");
+    }
+  if (eco_file
+      && route_only)
+    fatal("--eco cannot be used with --route-only");
+  if (eco_file
+      && place_analytic)
+    fatal("--eco cannot be used with --place-analytic");
+  if (eco_file
+      && place_multilevel)
+    fatal("--eco cannot be used with --place-multilevel");
+  if (place_analytic
+      && place_multilevel)
+    fatal("--place-analytic cannot be used with --place-multilevel");
+  if (cache_dir)
+    {
+      if (resume_file)
+        fatal("--cache-dir cannot be used with --resume");
+      if (route_only)
+        fatal("--cache-dir cannot be used with --route-only");
+      if (eco_file)
+        fatal("--cache-dir cannot be used with --eco");
+    }
+
+  PlaceOptions place_opts;
+  if (place_threads_str)
+    {
+      place_opts.threads = parse_unsigned("place-threads value",
+                                          place_threads_str);
+      if (place_opts.threads < 1)
+        fatal("place-threads value must be at least 1");
+    }
+  place_opts.analytic = place_analytic;
+  place_opts.multilevel = place_multilevel;
+  place_opts.chain_moves = place_chain_moves;
+  if (place_schedule_str)
+    {
+      std::string schedule = place_schedule_str;
+      if (schedule == "default")
+        place_opts.schedule = PlaceSchedule::DEFAULT;
+      else if (schedule == "adaptive")
+        place_opts.schedule = PlaceSchedule::ADAPTIVE;
+      else
+        fatal(fmt("unknown place schedule `" << schedule
+                  << "', expected default or adaptive"));
+    }
+  if (place_time_budget_str)
+    place_opts.time_budget = parse_duration("place-time-budget value",
+                                            place_time_budget_str);
+  if (place_congestion_str)
+    place_opts.congestion_weight = parse_real("place-congestion value",
+                                              place_congestion_str);
+  if (place_timing_str)
+    place_opts.timing_weight = parse_real("place-timing value",
+                                          place_timing_str);
+
+  RouteOptions route_opts;
   if (max_passes_str)
     {
       std::string max_passes_s = max_passes_str;
+      int max_passes = 0;
 
       if (max_passes_s.empty())
         fatal("invalid empty max-passes value");
@@ -383,9 +1219,92 @@ main(int argc, const char **argv)
                       << ch
                       << "' in unsigned integer literal in max-passes value"));
         }
+      route_opts.max_passes = max_passes;
     }
-  else
-    max_passes = 200;
+
+  if (route_threads_str)
+    {
+      route_opts.threads = parse_unsigned("route-threads value",
+                                          route_threads_str);
+      if (route_opts.threads < 1)
+        fatal("route-threads value must be at least 1");
+    }
+  route_opts.astar = route_astar;
+  route_opts.radix_queue = route_radix_queue;
+  route_opts.multi_sink = route_multi_sink;
+  if (route_timing_str)
+    route_opts.timing_weight = parse_real("route-timing value",
+                                          route_timing_str);
+  route_opts.report_timing = report_timing;
+  if (route_bbox_margin_str)
+    route_opts.bbox_margin = parse_unsigned("route-bbox-margin value",
+                                            route_bbox_margin_str);
+  if (route_schedule_str)
+    {
+      std::string schedule = route_schedule_str;
+      if (schedule == "default")
+        route_opts.schedule = RouteSchedule::DEFAULT;
+      else if (schedule == "adaptive")
+        route_opts.schedule = RouteSchedule::ADAPTIVE;
+      else
+        fatal(fmt("unknown route schedule `" << schedule
+                  << "', expected default or adaptive"));
+    }
+  if (route_stall_passes_str)
+    {
+      route_opts.stall_passes = parse_unsigned("route-stall-passes value",
+                                               route_stall_passes_str);
+      if (route_opts.stall_passes < 1)
+        fatal("route-stall-passes value must be at least 1");
+    }
+  if (route_steiner_str)
+    {
+      route_opts.steiner_fanout = parse_unsigned("route-steiner value",
+                                                 route_steiner_str);
+      if (route_opts.steiner_fanout < 2)
+        fatal("route-steiner value must be at least 2");
+    }
+
+#ifdef HAVE_SERVER
+  if (server_socket)
+    {
+      if (input_file)
+        fatal("--server does not take an input file");
+      
+      std::vector<std::string> files;
+      for (const char *dev : { "384", "1k", "5k", "lm4k", "8k" })
+        files.push_back(default_chipdb_file(dev));
+      if (chipdb_file)
+        files.push_back(chipdb_file);
+      for (const std::string &f : files)
+        {
+          std::string key = resident_chipdb_key(f);
+          if (contains_key(resident_chipdbs, key))
+            continue;
+          if (access(key.c_str(), R_OK) < 0)
+            {
+              *logs << "server: no chipdb " << f << "\n";
+              continue;
+            }
+          *logs << "server: read_chipdb " << f << "...\n";
+          resident_chipdbs[key] = read_chipdb(f);
+        }
+      
+      serve(server_socket, n_jobs, run_server_job);
+      
+      for (const auto &p : resident_chipdbs)
+        delete p.second;
+      resident_chipdbs.clear();
+      
+      logs = nullptr;
+      if (null_ostream)
+        {
+          delete null_ostream;
+          null_ostream = nullptr;
+        }
+      return 0;
+    }
+#endif
 
   if (randomize_seed)
     {
@@ -406,17 +1325,49 @@ main(int argc, const char **argv)
   if (chipdb_file)
     chipdb_file_s = chipdb_file;
   else
-#if defined(_WIN32) && defined(MXE_DIR_STRUCTURE)
-    chipdb_file_s = (std::string("+/chipdb-")
-                     + device
-                     + ".bin");
+    chipdb_file_s = default_chipdb_file(device);
+  *logs << "read_chipdb " << chipdb_file_s << "...\n";
+  stats.begin_phase("read_chipdb");
+  const ChipDB *chipdb = nullptr;
+  bool chipdb_resident = false;
+#ifdef HAVE_SERVER
+  if (!resident_chipdbs.empty())
+    {
+      auto i = resident_chipdbs.find(resident_chipdb_key(chipdb_file_s));
+      if (i != resident_chipdbs.end())
+        {
+          chipdb = i->second;
+          chipdb_resident = true;
+        }
+    }
+#endif
+  // Nothing before the DesignState needs the chipdb except
+  // --write-binary-chipdb and --resume, so with more than one core,
+  // load it on its own thread while the BLIF is read and pruned.
+  std::thread chipdb_thread;
+  if (!chipdb)
+    {
+      int n_threads = std::max(1, (int)std::thread::hardware_concurrency());
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+      chipdb = load_chipdb(chipdb_file_s, n_threads, low_memory);
 #else
-    chipdb_file_s = (std::string("+/share/arachne-pnr/chipdb-")
-                     + device
-                     + ".bin");
+      if (binary_chipdb
+          || n_threads == 1)
+        chipdb = load_chipdb(chipdb_file_s, n_threads, low_memory);
+      else
+        chipdb_thread = std::thread([&chipdb, chipdb_file_s, n_threads,
+                                     low_memory]() {
+            chipdb = load_chipdb(chipdb_file_s, n_threads, low_memory);
+          });
 #endif
-  *logs << "read_chipdb " << chipdb_file_s << "...\n";
-  const ChipDB *chipdb = read_chipdb(chipdb_file_s);
+    }
+  auto join_chipdb = [&]() {
+    if (!chipdb_thread.joinable())
+      return;
+    // what's left of loading it after the netlist passes
+    stats.begin_phase("wait_chipdb");
+    chipdb_thread.join();
+  };
 
   if (binary_chipdb)
     {
@@ -431,7 +1382,8 @@ main(int argc, const char **argv)
       chipdb->bwrite(obs);
 
       // clean up
-      if (chipdb)
+      if (chipdb
+          && !chipdb_resident)
         delete chipdb;
 
       logs = nullptr;
@@ -444,26 +1396,9 @@ main(int argc, const char **argv)
       return 0;
     }
 
-  *logs << "  supported packages: ";
-  bool first = true;
-  for (const auto &p : chipdb->packages)
-    {
-      if (first)
-        first = false;
-      else
-        *logs << ", ";
-      *logs << p.first;
-    }
-  *logs << "\n";
-
-  // chipdb->dump(std::cout);
-
-  auto package_i = chipdb->packages.find(package_name);
-  if (package_i == chipdb->packages.end())
-    fatal(fmt("unknown package `" << package_name << "'"));
-  const Package &package = package_i->second;
-
 #ifdef __AFL_HAVE_MANUAL_CONTROL
+  // fork with the chipdb loaded
+  join_chipdb();
   __AFL_INIT();
 #endif
 
@@ -471,29 +1406,213 @@ main(int argc, const char **argv)
   while (__AFL_LOOP(1000)) {
   */
 
+  StageCache *cache = nullptr;
+  std::string cache_hit;
+  std::string stdin_blif;
+  bool stdin_read = false;
+  if (cache_dir)
+    {
+      cache = new StageCache(cache_dir);
+      
+      uint64_t input_h;
+      if (input_file)
+        input_h = hash_file(hash_init, input_file);
+      else
+        {
+          std::ostringstream ss;
+          ss << std::cin.rdbuf();
+          stdin_blif = ss.str();
+          stdin_read = true;
+          input_h = hash_string(hash_init, stdin_blif);
+        }
+      
+      std::ostringstream route_key;
+      route_key << route_opts.max_passes
+                << " " << route_opts.threads
+                << " " << route_opts.astar
+                << " " << route_opts.radix_queue
+                << " " << route_opts.multi_sink
+                << " " << (int)route_opts.schedule
+                << " " << route_opts.stall_passes
+                << " " << route_opts.bbox_margin
+                << " " << route_opts.steiner_fanout
+                << " " << route_opts.timing_weight;
+      
+      struct stat chipdb_st;
+      std::string chipdb_expanded = expand_filename(chipdb_file_s);
+      if (stat(chipdb_expanded.c_str(), &chipdb_st) < 0)
+        fatal(fmt("failed to stat `" << chipdb_expanded << "': "
+                  << strerror(errno)));
+      cache->set_key(CheckpointStage::PACK,
+                     fmt(version_str
+                         << "\n" << chipdb_expanded
+                         << " " << chipdb_st.st_size
+                         << " " << chipdb_st.st_mtime
+                         << "\n" << device
+                         << " " << package_name
+                         << " " << input_h
+                         << " " << (pcf_file ? hash_file(hash_init, pcf_file) : 0)
+                         << " " << do_promote_globals
+                         // attributes may be dropped
+                         << " " << low_memory));
+      cache->set_key(CheckpointStage::PLACE,
+                     fmt(seed
+                         << " " << place_opts.threads
+                         << " " << place_opts.analytic
+                         << " " << place_opts.multilevel
+                         << " " << place_opts.chain_moves
+                         << " " << (int)place_opts.schedule
+                         << " " << place_opts.time_budget
+                         << " " << place_opts.congestion_weight
+                         << " " << place_opts.timing_weight
+                         << " " << n_seeds
+                         << " " << n_seed_successes
+                         << " " << n_jobs
+                         << " " << (n_seeds > 1 ? route_key.str() : "")));
+      cache->set_key(CheckpointStage::ROUTE, route_key.str());
+      
+      // don't skip the stages that write requested outputs
+      CheckpointStage max = CheckpointStage::ROUTE;
+      if (pack_blif
+          || pack_verilog)
+        max = CheckpointStage::NONE;
+      else if (post_place_pcf
+               || place_blif)
+        max = CheckpointStage::PACK;
+      if (checkpoint_after != CheckpointStage::NONE
+          && checkpoint_after <= max)
+        max = (CheckpointStage)((int)checkpoint_after - 1);
+      
+      CheckpointStage hit = CheckpointStage::NONE;
+      if (max != CheckpointStage::NONE)
+        hit = cache->lookup(max);
+      if (hit != CheckpointStage::NONE)
+        {
+          *logs << "cache: hit after " << checkpoint_stage_name(hit) << "\n";
+          stats.count("cache_hit_stage", (int)hit);
+          cache_hit = cache->entry(hit);
+          resume_file = cache_hit.c_str();
+        }
+      else
+        *logs << "cache: miss\n";
+    }
+
   Design *d;
-  if (input_file)
+  CheckpointReader *resume = nullptr;
+  CheckpointStage resume_stage = CheckpointStage::NONE;
+  if (resume_file)
+    {
+      join_chipdb();
+      *logs << "read_checkpoint " << resume_file << "...\n";
+      stats.begin_phase("read_checkpoint");
+      resume = new CheckpointReader(resume_file, chipdb);
+      resume_stage = resume->stage();
+      if (checkpoint_after != CheckpointStage::NONE
+          && checkpoint_after <= resume_stage)
+        fatal(fmt("checkpoint is already after "
+                  << checkpoint_stage_name(resume_stage)));
+      d = resume->read_design();
+    }
+  else if (input_file)
     {
       *logs << "read_blif " << input_file << "...\n";
+      stats.begin_phase("read_blif");
       d = read_blif(input_file);
     }
   else
     {
       *logs << "read_blif <stdin>...\n";
-      d = read_blif("<stdin>", std::cin);
+      stats.begin_phase("read_blif");
+      if (stdin_read)
+        {
+          std::istringstream is(stdin_blif);
+          d = read_blif("<stdin>", is);
+        }
+      else
+        d = read_blif("<stdin>", std::cin);
     }
   // d->dump();
 
-  *logs << "prune...\n";
-  d->prune();
-  d->check_boundary_nets();
+  if (!resume)
+    {
+      *logs << "prune...\n";
+      stats.begin_phase("prune");
+      d->prune();
+      d->check_boundary_nets();
+    }
+  if (low_memory
+      && !pack_blif
+      && !pack_verilog
+      && !place_blif)
+    {
+      // yosys bookkeeping, which is only written back out; the flow
+      // reads other attributes, like loc, ROUTE_THROUGH_FABRIC and
+      // SDA_INPUT_DELAYED, so anything not named here is kept
+      static const std::set<std::string> output_only_attrs = {
+        "src", "hdlname", "module_not_derived",
+      };
+      for (Instance *inst : d->top()->instances())
+        inst->drop_attrs(output_only_attrs);
+    }
 #ifndef NDEBUG
   d->check();
 #endif
   // d->dump();
 
+  join_chipdb();
+  *logs << "  supported packages: ";
+  bool first = true;
+  for (const auto &p : chipdb->packages)
+    {
+      if (first)
+        first = false;
+      else
+        *logs << ", ";
+      *logs << p.first;
+    }
+  *logs << "\n";
+
+  // chipdb->dump(std::cout);
+
+  auto package_i = chipdb->packages.find(package_name);
+  if (package_i == chipdb->packages.end())
+    fatal(fmt("unknown package `" << package_name << "'"));
+  const Package &package = package_i->second;
+
+  auto log_memory = [&]() {
+    if (!low_memory)
+      return;
+    release_free_memory();
+    *logs << "  max rss " << max_rss_kib() / 1024 << " MiB\n";
+  };
+  
   {
     DesignState ds(chipdb, package, d);
+    Eco eco;
+    // set by --seeds to the winning copy's routed checkpoint
+    std::string seed_route_checkpoint;
+    if (resume)
+      {
+        resume->read_state(ds);
+        delete resume;
+        resume = nullptr;
+      }
+
+    auto write_checkpoint_after = [&](CheckpointStage stage) {
+      if (checkpoint_after != stage)
+        return;
+      *logs << "write_checkpoint " << checkpoint_file << "...\n";
+      stats.begin_phase("write_checkpoint");
+      write_checkpoint(checkpoint_file, stage, ds);
+    };
+
+    auto write_cache = [&](CheckpointStage stage) {
+      if (!cache)
+        return;
+      *logs << "write_cache " << cache->entry(stage) << "...\n";
+      stats.begin_phase("write_cache");
+      cache->store(stage, ds);
+    };
 
     if (route_only)
       {
@@ -508,140 +1627,217 @@ main(int argc, const char **argv)
       }
     else
       {
-        if (pcf_file)
+        if (resume_stage < CheckpointStage::PACK)
           {
-            *logs << "read_pcf " << pcf_file << "...\n";
-            read_pcf(pcf_file, ds);
-          }
+            if (pcf_file)
+              {
+                *logs << "read_pcf " << pcf_file << "...\n";
+                stats.begin_phase("read_pcf");
+                read_pcf(pcf_file, ds);
+              }
 
-        *logs << "instantiate_io...\n";
-        instantiate_io(d);
-#ifndef NDEBUG
-        d->check();
-#endif
-        // d->dump();
+            pack_design_or_exit(ds);
+            // d->dump();
 
-        *logs << "pack...\n";
-        pack(ds);
-#ifndef NDEBUG
-        d->check();
-#endif
-        // d->dump();
+            if (pack_blif)
+              {
+                *logs << "write_blif " << pack_blif << "\n";
+                stats.begin_phase("write_blif");
+                std::string expanded = expand_filename(pack_blif);
+                std::ofstream fs(expanded);
+                if (fs.fail())
+                  fatal(fmt("write_blif: failed to open `" << expanded << "': "
+                            << strerror(errno)));
+                fs << "# " << version_str << "\n";
+                d->write_blif(fs);
+              }
+            if (pack_verilog)
+              {
+                *logs << "write_verilog " << pack_verilog << "\n";
+                stats.begin_phase("write_verilog");
+                std::string expanded = expand_filename(pack_verilog);
+                std::ofstream fs(expanded);
+                if (fs.fail())
+                  fatal(fmt("write_verilog: failed to open `" << expanded << "': "
+                            << strerror(errno)));
+                fs << "/* " << version_str << " */\n";
+                d->write_verilog(fs);
+              }
 
-        if (pack_blif)
-          {
-            *logs << "write_blif " << pack_blif << "\n";
-            std::string expanded = expand_filename(pack_blif);
-            std::ofstream fs(expanded);
-            if (fs.fail())
-              fatal(fmt("write_blif: failed to open `" << expanded << "': "
-                        << strerror(errno)));
-            fs << "# " << version_str << "\n";
-            d->write_blif(fs);
+            constrain_design_or_exit(ds, do_promote_globals);
+            // d->dump();
+            log_memory();
+
+            write_checkpoint_after(CheckpointStage::PACK);
+            write_cache(CheckpointStage::PACK);
           }
-        if (pack_verilog)
+
+        if (eco_file
+            && resume_stage < CheckpointStage::ROUTE)
           {
-            *logs << "write_verilog " << pack_verilog << "\n";
-            std::string expanded = expand_filename(pack_verilog);
-            std::ofstream fs(expanded);
-            if (fs.fail())
-              fatal(fmt("write_verilog: failed to open `" << expanded << "': "
-                        << strerror(errno)));
-            fs << "/* " << version_str << " */\n";
-            d->write_verilog(fs);
+            *logs << "read_eco " << eco_file << "...\n";
+            stats.begin_phase("read_eco");
+            read_eco(eco_file, ds, eco);
+            place_opts.eco = &eco;
+            route_opts.eco = &eco;
           }
 
-        *logs << "place_constraints...\n";
-        place_constraints(ds);
-#ifndef NDEBUG
-        d->check();
-#endif
-
-        // d->dump();
-
-        *logs << "promote_globals...\n";
-        promote_globals(ds, do_promote_globals);
-#ifndef NDEBUG
-        d->check();
-#endif
-        // d->dump();
-
-        *logs << "realize_constants...\n";
-        realize_constants(chipdb, d);
-#ifndef NDEBUG
-        d->check();
+        if (resume_stage < CheckpointStage::PLACE)
+          {
+            bool placed = false;
+#ifdef HAVE_FORK
+            if (n_seeds > 1)
+              {
+                *logs << "try_seeds...\n";
+                stats.begin_phase("try_seeds");
+                std::string place_checkpoint;
+                seed = portfolio_seed(ds, place_opts, route_opts,
+                                      seed, n_seeds, n_jobs, n_seed_successes,
+                                      place_checkpoint, seed_route_checkpoint);
+                *logs << "seed: " << seed << "\n";
+                
+                // the winning copy's placement, rather than placing
+                // again, which under --place-time-budget needn't give
+                // the same result
+                stats.begin_phase("read_checkpoint");
+                read_seed_checkpoint(ds, place_checkpoint);
+                placed = true;
+              }
 #endif
 
-        *logs << "place...\n";
-        // d->dump();
-        place(rg, ds);
+            if (!placed)
+              {
+                *logs << "place...\n";
+                stats.begin_phase("place");
+                // d->dump();
+                place(rg, ds, place_opts);
+              }
+            log_memory();
 #ifndef NDEBUG
-        d->check();
+            d->check();
 #endif
-        // d->dump();
+            // d->dump();
 
-        if (post_place_pcf)
-          {
-            *logs << "write_pcf " << post_place_pcf << "...\n";
-            std::string expanded = expand_filename(post_place_pcf);
-            std::ofstream fs(expanded);
-            if (fs.fail())
-              fatal(fmt("write_pcf: failed to open `" << expanded << "': "
-                        << strerror(errno)));
-            fs << "# " << version_str << "\n";
-            for (const auto &p : ds.placement)
+            if (post_place_pcf)
               {
-                if (ds.models.is_io(p.first))
+                *logs << "write_pcf " << post_place_pcf << "...\n";
+                stats.begin_phase("write_pcf");
+                std::string expanded = expand_filename(post_place_pcf);
+                std::ofstream fs(expanded);
+                if (fs.fail())
+                  fatal(fmt("write_pcf: failed to open `" << expanded << "': "
+                            << strerror(errno)));
+                TextWriter w(fs);
+                w << "# " << version_str << '\n';
+                for (const auto &p : ds.placement)
                   {
-                    const Location &loc = chipdb->cell_location[p.second];
-                    std::string pin = package.loc_pin.at(loc);
-                    Port *top_port = (p.first
-                                      ->find_port("PACKAGE_PIN")
-                                      ->connection_other_port());
-                    assert(isa<Model>(top_port->node())
-                           && cast<Model>(top_port->node()) == ds.top);
-
-                    fs << "set_io " << top_port->name() << " " << pin << "\n";
+                    if (ds.models.is_io(p.first))
+                      {
+                        const Location &loc = chipdb->cell_location[p.second];
+                        std::string pin = package.loc_pin.at(loc);
+                        Port *top_port = (p.first
+                                          ->find_port("PACKAGE_PIN")
+                                          ->connection_other_port());
+                        assert(isa<Model>(top_port->node())
+                               && cast<Model>(top_port->node()) == ds.top);
+
+                        w << "set_io " << top_port->name() << ' ' << pin << '\n';
+                      }
                   }
               }
-          }
 
-        if (place_blif)
-          {
-            for (const auto &p : ds.placement)
+            if (place_blif)
               {
-                // p.first->set_attr("loc", fmt(p.second));
-                const Location &loc = chipdb->cell_location[p.second];
-                int t = loc.tile();
-                int pos = loc.pos();
-                p.first->set_attr("loc",
-                                  fmt(chipdb->tile_x(t)
-                                      << "," << chipdb->tile_y(t)
-                                      << "/" << pos));
+                for (const auto &p : ds.placement)
+                  {
+                    // p.first->set_attr("loc", fmt(p.second));
+                    const Location &loc = chipdb->cell_location[p.second];
+                    int t = loc.tile();
+                    int pos = loc.pos();
+                    p.first->set_attr("loc",
+                                      fmt(chipdb->tile_x(t)
+                                          << "," << chipdb->tile_y(t)
+                                          << "/" << pos));
+                  }
+
+                *logs << "write_blif " << place_blif << "\n";
+                stats.begin_phase("write_blif");
+                std::string expanded = expand_filename(place_blif);
+                std::ofstream fs(expanded);
+                if (fs.fail())
+                  fatal(fmt("write_blif: failed to open `" << expanded << "': "
+                            << strerror(errno)));
+                fs << "# " << version_str << "\n";
+                d->write_blif(fs);
               }
 
-            *logs << "write_blif " << place_blif << "\n";
-            std::string expanded = expand_filename(place_blif);
-            std::ofstream fs(expanded);
-            if (fs.fail())
-              fatal(fmt("write_blif: failed to open `" << expanded << "': "
-                        << strerror(errno)));
-            fs << "# " << version_str << "\n";
-            d->write_blif(fs);
+            write_checkpoint_after(CheckpointStage::PLACE);
+            write_cache(CheckpointStage::PLACE);
           }
       }
 
     // d->dump();
 
-    *logs << "route...\n";
-    route(ds, max_passes);
+    if (!seed_route_checkpoint.empty())
+      {
+#ifdef HAVE_FORK
+        stats.begin_phase("read_checkpoint");
+        read_seed_checkpoint(ds, seed_route_checkpoint);
+        log_memory();
+#ifndef NDEBUG
+        d->check();
+#endif
+
+        write_checkpoint_after(CheckpointStage::ROUTE);
+        write_cache(CheckpointStage::ROUTE);
+#endif
+      }
+    else if (resume_stage < CheckpointStage::ROUTE)
+      {
+        *logs << "route...\n";
+        stats.begin_phase("route");
+        std::ofstream trace_fs;
+        if (route_trace_file)
+          {
+            std::string expanded = expand_filename(route_trace_file);
+            trace_fs.open(expanded);
+            if (trace_fs.fail())
+              fatal(fmt("route: failed to open `" << expanded << "': "
+                        << strerror(errno)));
+            route_opts.trace = &trace_fs;
+          }
+        route(ds, route_opts);
+        route_opts.trace = nullptr;
+        log_memory();
 #ifndef NDEBUG
-    d->check();
+        d->check();
 #endif
 
-    if (output_file)
+        write_checkpoint_after(CheckpointStage::ROUTE);
+        write_cache(CheckpointStage::ROUTE);
+      }
+
+    if (binary_output)
+      {
+        const char *name = output_file ? output_file : "<stdout>";
+        *logs << "write_bin " << name << "...\n";
+        stats.begin_phase("write_bin");
+        if (output_file)
+          {
+            std::string expanded = expand_filename(output_file);
+            std::ofstream fs(expanded, std::ios::binary);
+            if (fs.fail())
+              fatal(fmt("write_bin: failed to open `" << expanded << "': "
+                        << strerror(errno)));
+            ds.conf.write_bin(fs, chipdb, d, ds.placement);
+          }
+        else
+          ds.conf.write_bin(std::cout, chipdb, d, ds.placement);
+      }
+    else if (output_file)
       {
         *logs << "write_txt " << output_file << "...\n";
+        stats.begin_phase("write_txt");
         std::string expanded = expand_filename(output_file);
         std::ofstream fs(expanded);
         if (fs.fail())
@@ -652,18 +1848,34 @@ main(int argc, const char **argv)
     else
       {
         *logs << "write_txt <stdout>...\n";
+        stats.begin_phase("write_txt");
         ds.conf.write_txt(std::cout, chipdb, d, ds.placement, ds.cnet_net);
       }
+    stats.end_phase();
   }
 
+  if (stats_json)
+    {
+      *logs << "write_stats " << stats_json << "...\n";
+      std::string expanded = expand_filename(stats_json);
+      std::ofstream fs(expanded);
+      if (fs.fail())
+        fatal(fmt("write_stats: failed to open `" << expanded << "': "
+                  << strerror(errno)));
+      stats.write_json(fs);
+    }
+
   if (d)
     delete d;
+  if (cache)
+    delete cache;
 
   /*
   }
   */
 
-  if (chipdb)
+  if (chipdb
+      && !chipdb_resident)
     delete chipdb;
 
   logs = nullptr;
@@ -675,3 +1887,22 @@ main(int argc, const char **argv)
 
   return 0;
 }
+
+int
+main(int argc, const char **argv)
+{
+#ifdef __EMSCRIPTEN__
+  EM_ASM(
+    if (ENVIRONMENT_IS_NODE)
+    {
+      FS.mkdir('/hostcwd');
+      FS.mount(NODEFS, { root: '.' }, '/hostcwd');
+      FS.mkdir('/hostfs');
+      FS.mount(NODEFS, { root: '/' }, '/hostfs');
+    }
+  );
+#endif
+
+  program_name = argv[0];
+  return run(argc, argv);
+}
@@ -0,0 +1,112 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "arachne.hh"
+#include "io.hh"
+#include "pack.hh"
+#include "pcf.hh"
+#include "global.hh"
+#include "constant.hh"
+#include "stats.hh"
+
+void
+pack_design_or_exit(DesignState &ds)
+{
+  *logs << "instantiate_io...\n";
+  stats.begin_phase("instantiate_io");
+  instantiate_io(ds.d);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+  
+  *logs << "pack...\n";
+  stats.begin_phase("pack");
+  pack(ds);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+}
+
+void
+constrain_design_or_exit(DesignState &ds, bool do_promote)
+{
+  *logs << "place_constraints...\n";
+  stats.begin_phase("place_constraints");
+  place_constraints(ds);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+  
+  *logs << "promote_globals...\n";
+  stats.begin_phase("promote_globals");
+  promote_globals(ds, do_promote);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+  
+  *logs << "realize_constants...\n";
+  stats.begin_phase("realize_constants");
+  realize_constants(ds.chipdb, ds.d);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+  
+  ds.index_netlist();
+}
+
+void
+pack_design(DesignState &ds)
+{
+  FatalThrows throws;
+  pack_design_or_exit(ds);
+}
+
+void
+constrain_design(DesignState &ds, bool do_promote)
+{
+  FatalThrows throws;
+  constrain_design_or_exit(ds, do_promote);
+}
+
+int
+place_and_route(DesignState &ds, const FlowOptions &opts)
+{
+  FatalThrows throws;
+  stats = Stats();
+  
+  if (!opts.seed)
+    fatal("zero seed");
+  
+  pack_design(ds);
+  constrain_design(ds, opts.promote_globals);
+  
+  *logs << "place...\n";
+  stats.begin_phase("place");
+  random_generator rg(opts.seed);
+  int wire_length = place(rg, ds, opts.place);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+  
+  *logs << "route...\n";
+  stats.begin_phase("route");
+  route(ds, opts.route);
+#ifndef NDEBUG
+  ds.d->check();
+#endif
+  stats.end_phase();
+  
+  return wire_length;
+}
@@ -0,0 +1,80 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_ARACHNE_HH
+#define PNR_ARACHNE_HH
+
+// The arachne-pnr flow as a library (lib/libarachne.a), for programs
+// that build the netlist in memory and want the placement and
+// bitstream back the same way.  A chipdb from read_chipdb can be
+// shared by any number of designs.  Point logs at a stream before
+// calling in.  The entry points below report errors by throwing
+// FatalError (see util.hh) with the message arachne-pnr would print,
+// so the process can go on to the next design; errors on the placer
+// and router worker threads still exit.  ds is not usable after one.
+//
+//   const ChipDB *chipdb = read_chipdb("chipdb-1k.bin");
+//   Design *d = new Design;
+//   d->create_standard_models();
+//   ... build d, as read_blif would ...
+//   d->prune();
+//   DesignState ds(chipdb, chipdb->packages.at("tq144"), d);
+//   extend(ds.constraints.net_pin_loc, "clk", ...);
+//   place_and_route(ds, FlowOptions());
+//   // ds.placement, ds.conf; ds.conf.write_txt(...) for text, or
+//   // ds.conf.write_bin(...) for a bitstream
+
+#include "netlist.hh"
+#include "chipdb.hh"
+#include "designstate.hh"
+#include "configuration.hh"
+#include "place.hh"
+#include "route.hh"
+#include "util.hh"
+
+class FlowOptions
+{
+public:
+  bool promote_globals;
+  unsigned seed;
+  PlaceOptions place;
+  RouteOptions route;
+  
+  FlowOptions()
+    : promote_globals(true),
+      seed(1)
+  {}
+};
+
+// instantiate_io and pack
+void pack_design(DesignState &ds);
+
+// place_constraints (from ds.constraints), promote_globals and
+// realize_constants, then indexes the netlist: everything between
+// packing and placement
+void constrain_design(DesignState &ds, bool do_promote);
+
+// as above, but errors print the message and exit, for arachne-pnr
+// itself
+void pack_design_or_exit(DesignState &ds);
+void constrain_design_or_exit(DesignState &ds, bool do_promote);
+
+// pack_design, constrain_design, place and route.  ds.d must be
+// pruned.  Starts stats over, so it holds this design's phases and
+// counters only; callers running the steps themselves can do the same
+// with stats = Stats().  Returns the wire length of the placement.
+int place_and_route(DesignState &ds, const FlowOptions &opts);
+
+#endif
@@ -26,20 +26,128 @@
 #include <iostream>
 #include <string>
 
-class BlifParser : public LineParser
+enum class Directive
 {
-  BitVector stobv(const std::string &s_);
+  MODEL, INPUTS, OUTPUTS, NAMES, GATE, ATTR, PARAM, END, UNKNOWN,
+};
+
+static Directive
+directive(const StringRef &cmd)
+{
+  switch(cmd.size())
+    {
+    case 4:
+      if (cmd == ".end")
+        return Directive::END;
+      break;
+    case 5:
+      if (cmd == ".gate")
+        return Directive::GATE;
+      if (cmd == ".attr")
+        return Directive::ATTR;
+      break;
+    case 6:
+      if (cmd == ".names")
+        return Directive::NAMES;
+      if (cmd == ".param")
+        return Directive::PARAM;
+      if (cmd == ".model")
+        return Directive::MODEL;
+      break;
+    case 7:
+      if (cmd == ".inputs")
+        return Directive::INPUTS;
+      break;
+    case 8:
+      if (cmd == ".outputs")
+        return Directive::OUTPUTS;
+      break;
+    }
+  return Directive::UNKNOWN;
+}
+
+// Nets of the model being parsed by name, so lookups don't build a
+// std::string for each reference.  Open addressing with linear
+// probing; nets are still added to the model's map.
+class NetTable
+{
+  std::vector<std::pair<size_t, Net *>> slots;
+  size_t mask;
+  size_t n;
+  
+  void grow();
+  
+public:
+  NetTable(size_t capacity);
+  
+  Net *find_or_add(Model *top, const StringRef &name);
+};
+
+NetTable::NetTable(size_t capacity)
+  : n(0)
+{
+  size_t n_slots = 64;
+  while (n_slots < 2 * capacity)
+    n_slots <<= 1;
+  slots.resize(n_slots, std::make_pair(0, nullptr));
+  mask = n_slots - 1;
+}
+
+void
+NetTable::grow()
+{
+  std::vector<std::pair<size_t, Net *>> old(slots.size() * 2,
+                                            std::make_pair(0, nullptr));
+  old.swap(slots);
+  mask = slots.size() - 1;
+  for (const auto &p : old)
+    {
+      if (!p.second)
+        continue;
+      size_t i = p.first & mask;
+      while (slots[i].second)
+        i = (i + 1) & mask;
+      slots[i] = p;
+    }
+}
+
+Net *
+NetTable::find_or_add(Model *top, const StringRef &name)
+{
+  size_t h = name.hash();
+  size_t i = h & mask;
+  for (;;)
+    {
+      const auto &p = slots[i];
+      if (!p.second)
+        break;
+      if (p.first == h
+          && StringRef(p.second->name()) == name)
+        return p.second;
+      i = (i + 1) & mask;
+    }
+  
+  Net *net = top->find_or_add_net(name.str());
+  slots[i] = std::make_pair(h, net);
+  if (2 * ++n > slots.size())
+    grow();
+  return net;
+}
+
+class BlifParser : public BufferedLineParser
+{
+  BitVector stobv(const StringRef &s_);
   
 public:
   BlifParser(const std::string &f, std::istream &s_)
-    : LineParser(f, s_)
+    : BufferedLineParser(f, s_)
   {}
   
   Design *parse();
 };
 
 BitVector
-BlifParser::stobv(const std::string &s_)
+BlifParser::stobv(const StringRef &s_)
 {
   int n = s_.size();
   BitVector bv(n);
@@ -70,8 +178,11 @@ BlifParser::parse()
   Model *io_od_a_model = d->find_model("SB_IO_OD_A");
 
   Model *top = nullptr;
+  // roughly one net per 64 bytes of input
+  NetTable net_table(input_size() / 64);
   
   std::vector<std::pair<Net *, Net *>> unify;
+  std::string formal;
   
   Instance *inst = nullptr;
   for (;;)
@@ -89,56 +200,59 @@ BlifParser::parse()
       if (line[0] == '.')
         {
         L:
-          std::string cmd = words[0];
-          if (cmd == ".model")
+          StringRef cmd = words[0];
+          Directive dir = directive(cmd);
+          if (dir == Directive::MODEL)
             {
               if (words.size() != 2)
                 fatal(fmt("invalid .model directive: expected exactly 1 argument, got " << words.size()-1));
               if (top)
                 fatal("definition of multiple models is not supported");
 
-              top = new Model(d, words[1]);
+              top = new Model(d, words[1].str());
               d->set_top(top);
             }
-          else if (cmd == ".inputs")
+          else if (dir == Directive::INPUTS)
             {
               if (!top)
                 fatal(".inputs directive outside of model definition");
 
               for (unsigned i = 1; i < words.size(); i ++)
                 {
-                  Port *port = top->find_port(words[i]);
+                  std::string name = words[i].str();
+                  Port *port = top->find_port(name);
                   if (port)
                     {
                       if (port->direction() == Direction::OUT)
                         port->set_direction(Direction::INOUT);
                     }
                   else
-                    port = top->add_port(words[i], Direction::IN);
-                  Net *net = top->find_or_add_net(words[i]);
+                    port = top->add_port(name, Direction::IN);
+                  Net *net = net_table.find_or_add(top, words[i]);
                   port->connect(net);
                 }
             }
-          else if (cmd == ".outputs")
+          else if (dir == Directive::OUTPUTS)
             {
               if (!top)
                 fatal(".outputs directive outside of model definition");
 
               for (unsigned i = 1; i < words.size(); i ++)
                 {
-                  Port *port = top->find_port(words[i]);
+                  std::string name = words[i].str();
+                  Port *port = top->find_port(name);
                   if (port)
                     {
                       if (port->direction() == Direction::IN)
                         port->set_direction(Direction::INOUT);
                     }
                   else
-                    port = top->add_port(words[i], Direction::OUT);
-                  Net *net = top->find_or_add_net(words[i]);
+                    port = top->add_port(name, Direction::OUT);
+                  Net *net = net_table.find_or_add(top, words[i]);
                   port->connect(net);
                 }
             }
-          else if (cmd == ".names")
+          else if (dir == Directive::NAMES)
             {
               if (!top)
                 fatal(".names directive outside of model definition");
@@ -151,7 +265,7 @@ BlifParser::parse()
               // output is assigned no value; set to zero
               if (n == 2)
                 {
-                  names_net = top->find_or_add_net(words[1]);
+                  names_net = net_table.find_or_add(top, words[1]);
                   names_net->set_is_constant(true);
                   names_net->set_constant(Value::ZERO);
                 }
@@ -159,8 +273,9 @@ BlifParser::parse()
               // output is assigned input; unify nets
               else if (n == 3)
                 {
-                  unify.push_back(std::make_pair(top->find_or_add_net(words[1]),
-                                                 top->find_or_add_net(words[2])));
+                  Net *n1 = net_table.find_or_add(top, words[1]);
+                  Net *n2 = net_table.find_or_add(top, words[2]);
+                  unify.push_back(std::make_pair(n1, n2));
                 }
               else
                 fatal(fmt("invalid .names directive: expected 1 or 2 arguments, got " << n-1));
@@ -196,7 +311,7 @@ BlifParser::parse()
                   // .names + 1 argument
                   if (n == 2)
                     {
-                      const std::string &output = words[0];
+                      StringRef output = words[0];
                       if (output == "1")
                         names_net->set_constant(Value::ONE);
                       else if (output != "0")
@@ -212,7 +327,7 @@ BlifParser::parse()
                     }
                 }
             }
-          else if (cmd == ".gate")
+          else if (dir == Directive::GATE)
             {
               if (!top)
                 fatal(".gate directive outside of model definition");
@@ -220,8 +335,8 @@ BlifParser::parse()
               if (words.size() < 2)
                 fatal("invalid .gate directive: missing name");
               
-              const std::string &n = words[1];
-              Model *inst_of = d->find_model(n);
+              StringRef n = words[1];
+              Model *inst_of = d->find_model(n.str());
               if (!inst_of)
                 fatal(fmt("unknown model `" << n << "'"));
               
@@ -229,26 +344,25 @@ BlifParser::parse()
               
               for (unsigned i = 2; i < words.size(); i ++)
                 {
-                  const std::string &w = words[i];
+                  StringRef w = words[i];
                   std::size_t p = w.find('=');
-                  if (p == std::string::npos)
+                  if (p == StringRef::npos)
                     fatal("invalid formal-actual");
                   
-                  std::string formal(w, 0, p),
-                    actual(w, p+1);
-                  
+                  StringRef actual = w.substr(p+1);
                   if (actual.empty())
                     continue;
                   
+                  formal.assign(w.data(), p);
                   Port *port = inst->find_port(formal);
                   if (!port)
                     fatal(fmt("unknown formal `" << formal << "'"));
                   
-                  Net *net = top->find_or_add_net(actual);
+                  Net *net = net_table.find_or_add(top, actual);
                   port->connect(net);
                 }
             }
-          else if (cmd == ".attr")
+          else if (dir == Directive::ATTR)
             {
               if (words.size() != 3)
                 fatal(fmt("invalid .attr directive: expected exactly 2 arguments, got " << words.size()-1));
@@ -258,16 +372,16 @@ BlifParser::parse()
               if (words[2][0] == '"')
                 {
                   assert(words[2].back() == '"');
-                  inst->set_attr(words[1], 
-                                 Const(lp, words[2].substr(1, words[2].size() - 2)));
+                  inst->set_attr(words[1].str(),
+                                 Const(lp, words[2].substr(1, words[2].size() - 2).str()));
                 }
               else
                 {
-                  inst->set_attr(words[1],
+                  inst->set_attr(words[1].str(),
                                  Const(lp, stobv(words[2])));
                 }
             }
-          else if (cmd == ".param")
+          else if (dir == Directive::PARAM)
             {
               if (words.size() != 3)
                 fatal(fmt("invalid .param directive: expected exactly 2 arguments, got " << words.size()-1));
@@ -277,16 +391,16 @@ BlifParser::parse()
               if (words[2][0] == '"')
                 {
                   assert(words[2].back() == '"');
-                  inst->set_param(words[1], 
-                                  Const(lp, words[2].substr(1, words[2].size() - 2)));
+                  inst->set_param(words[1].str(),
+                                  Const(lp, words[2].substr(1, words[2].size() - 2).str()));
                 }
               else
                 {
-                  inst->set_param(words[1],
+                  inst->set_param(words[1].str(),
                                   Const(lp, stobv(words[2])));
                 }
             }
-          else if (cmd == ".end")
+          else if (dir == Directive::END)
             {
               if (!top)
                 fatal(".end directive outside of model definition");
@@ -357,13 +471,13 @@ BlifParser::parse()
   for (auto od_i : io_od_to_rep)
     {
       Instance *od_a_inst = top->add_instance(io_od_a_model);
-      for (auto port : od_a_inst->ports())
+      for (Port *port : od_a_inst->ports())
         {
           std::string sb_name;
-          for (auto chr : port.first)
+          for (auto chr : port->name())
             if (chr != '_')
                sb_name += chr;
-          od_a_inst->find_port(port.first)->connect(od_i->find_port(sb_name)->connection());
+          port->connect(od_i->find_port(sb_name)->connection());
         }
       for (auto param : od_i->params())
         {
@@ -375,17 +489,17 @@ BlifParser::parse()
   
   Models models(d);
   std::map<Port *, Direction> inout_redir;
-  for (const auto &p : top->ports())
+  for (Port *p : top->ports())
     {
-      if (p.second->is_bidir())
+      if (p->is_bidir())
         {
-          Net *n = p.second->connection();
+          Net *n = p->connection();
           if (n)
             {
               bool has_input = false, has_output = false, has_tristate = false;
               for (const auto &q : n->connections())
                 {
-                  if (q == p.second)
+                  if (q == p)
                     continue;
 
                   if (q->is_input())
@@ -408,20 +522,20 @@ BlifParser::parse()
 
               // inout net has a tristate driver and used as an input, illegal
               if (has_input && has_tristate)
-                  fatal(fmt("toplevel inout port '" << p.second->name()
+                  fatal(fmt("toplevel inout port '" << p->name()
                             << "' connected to tristate buffer and driving a net"));
 
               // inout net used as output
               else if (has_output && !has_tristate)
-                inout_redir[p.second] = Direction::OUT;
+                inout_redir[p] = Direction::OUT;
 
               // inout net used as input
               else if (!has_output)
-                inout_redir[p.second] = Direction::IN;
+                inout_redir[p] = Direction::IN;
 
               // inout net unused
               else if (n->connections().size() == 1)
-                inout_redir[p.second] = Direction::IN;
+                inout_redir[p] = Direction::IN;
             }
         }
     }
@@ -0,0 +1,151 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cache.hh"
+#include "designstate.hh"
+#include "util.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+uint64_t
+hash_bytes(uint64_t h, const char *p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    {
+      h ^= (unsigned char)p[i];
+      h *= 1099511628211ull;
+    }
+  return h;
+}
+
+uint64_t
+hash_string(uint64_t h, const std::string &s)
+{
+  // length first, so consecutive strings can't run together
+  uint64_t n = s.size();
+  h = hash_bytes(h, reinterpret_cast<const char *>(&n), sizeof(n));
+  return hash_bytes(h, s.data(), s.size());
+}
+
+uint64_t
+hash_file(uint64_t h, const std::string &filename)
+{
+  std::string expanded = expand_filename(filename);
+  std::ifstream ifs(expanded, std::ifstream::in | std::ifstream::binary);
+  if (ifs.fail())
+    fatal(fmt("failed to open `" << expanded << "': "
+              << strerror(errno)));
+  char buf[1 << 16];
+  while (ifs)
+    {
+      ifs.read(buf, sizeof(buf));
+      h = hash_bytes(h, buf, ifs.gcount());
+    }
+  if (ifs.bad())
+    fatal(fmt("failed to read `" << expanded << "': "
+              << strerror(errno)));
+  return h;
+}
+
+static int
+stage_index(CheckpointStage stage)
+{
+  assert(stage >= CheckpointStage::PACK
+         && stage <= CheckpointStage::ROUTE);
+  return (int)stage - (int)CheckpointStage::PACK;
+}
+
+StageCache::StageCache(const std::string &dir_)
+  : dir(expand_filename(dir_)),
+    key{0, 0, 0}
+{
+#ifdef _WIN32
+  int r = _mkdir(dir.c_str());
+#else
+  int r = mkdir(dir.c_str(), 0777);
+#endif
+  if (r < 0
+      && errno != EEXIST)
+    fatal(fmt("cache: failed to create `" << dir << "': "
+              << strerror(errno)));
+}
+
+void
+StageCache::set_key(CheckpointStage stage, const std::string &material)
+{
+  int i = stage_index(stage);
+  uint64_t h = hash_init;
+  if (i > 0)
+    {
+      assert(key[i - 1]);
+      h = hash_bytes(h, reinterpret_cast<const char *>(&key[i - 1]), sizeof(key[i - 1]));
+    }
+  key[i] = hash_string(h, material);
+}
+
+std::string
+StageCache::entry(CheckpointStage stage) const
+{
+  uint64_t h = key[stage_index(stage)];
+  assert(h);
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)h);
+  return dir + "/" + checkpoint_stage_name(stage) + "-" + hex + ".ckpt";
+}
+
+CheckpointStage
+StageCache::lookup(CheckpointStage max) const
+{
+  for (CheckpointStage stage = max;
+       stage >= CheckpointStage::PACK;
+       stage = (CheckpointStage)((int)stage - 1))
+    {
+      struct stat st;
+      if (stat(entry(stage).c_str(), &st) == 0)
+        return stage;
+    }
+  return CheckpointStage::NONE;
+}
+
+void
+StageCache::store(CheckpointStage stage, const DesignState &ds) const
+{
+  // write under a temporary name and rename, so concurrent runs never
+  // see a partial entry
+  std::string filename = entry(stage);
+#ifdef _WIN32
+  std::string tmp = filename + ".tmp";
+#else
+  std::string tmp = fmt(filename << "." << getpid() << ".tmp");
+#endif
+  write_checkpoint(tmp, stage, ds);
+#ifdef _WIN32
+  remove(filename.c_str());
+#endif
+  if (rename(tmp.c_str(), filename.c_str()) < 0)
+    fatal(fmt("cache: failed to rename `" << tmp << "' to `" << filename << "': "
+              << strerror(errno)));
+}
@@ -0,0 +1,57 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_CACHE_HH
+#define PNR_CACHE_HH
+
+#include "checkpoint.hh"
+
+#include <cstdint>
+#include <string>
+
+class DesignState;
+
+// FNV-1a, for cache keys
+uint64_t hash_bytes(uint64_t h, const char *p, size_t n);
+uint64_t hash_string(uint64_t h, const std::string &s);
+uint64_t hash_file(uint64_t h, const std::string &filename);
+
+static const uint64_t hash_init = 14695981039346656037ull;
+
+// Checkpoints after pack, place and route in a directory, each named
+// by a hash of everything that stage's result depends on, so a later
+// run with the same inputs and options can resume from the last stage
+// it shares.
+class StageCache
+{
+  std::string dir;
+  // per stage, PACK to ROUTE
+  uint64_t key[3];
+  
+public:
+  StageCache(const std::string &dir_);
+  
+  // the key of each stage covers the key of the stage before and
+  // material, set in stage order
+  void set_key(CheckpointStage stage, const std::string &material);
+  
+  std::string entry(CheckpointStage stage) const;
+  
+  // the last stage up to max with an entry, or NONE
+  CheckpointStage lookup(CheckpointStage max) const;
+  void store(CheckpointStage stage, const DesignState &ds) const;
+};
+
+#endif
@@ -0,0 +1,537 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "checkpoint.hh"
+#include "chipdb.hh"
+#include "designstate.hh"
+#include "hashmap.hh"
+#include "netlist.hh"
+#include "util.hh"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+static const char *checkpoint_magic = "arachne-pnr checkpoint";
+
+const char *
+checkpoint_stage_name(CheckpointStage stage)
+{
+  switch(stage)
+    {
+    case CheckpointStage::NONE:
+      return "none";
+    case CheckpointStage::PACK:
+      return "pack";
+    case CheckpointStage::PLACE:
+      return "place";
+    case CheckpointStage::ROUTE:
+      return "route";
+    }
+  abort();
+  return nullptr;
+}
+
+CheckpointStage
+parse_checkpoint_stage(const std::string &s)
+{
+  if (s == "pack")
+    return CheckpointStage::PACK;
+  if (s == "place")
+    return CheckpointStage::PLACE;
+  if (s == "route")
+    return CheckpointStage::ROUTE;
+  fatal(fmt("unknown checkpoint stage `" << s
+            << "', expected pack, place or route"));
+  return CheckpointStage::NONE;
+}
+
+void
+bwrite_bits(obstream &obs, const BitVector &bv)
+{
+  int n = bv.size();
+  std::string bytes((n + 7) / 8, 0);
+  for (int i = 0; i < n; ++i)
+    if (bv[i])
+      bytes[i / 8] |= 1 << (i % 8);
+  obs << n << bytes;
+}
+
+void
+bread_bits(ibstream &ibs, BitVector &bv)
+{
+  int n;
+  std::string bytes;
+  ibs >> n >> bytes;
+  if (n < 0
+      || (int)bytes.size() != (n + 7) / 8)
+    fatal("read_checkpoint: invalid bit vector");
+  bv.resize(n);
+  for (int i = 0; i < n; ++i)
+    bv[i] = (bytes[i / 8] >> (i % 8)) & 1;
+}
+
+static void
+bwrite_const_map(obstream &obs, const std::map<std::string, Const> &m)
+{
+  obs << m.size();
+  for (const auto &p : m)
+    {
+      const Const &c = p.second;
+      const LexicalPosition &lp = c.lexpos();
+      obs << p.first
+          << lp.internal << lp.file << lp.line
+          << c.is_bits();
+      if (c.is_bits())
+        bwrite_bits(obs, c.as_bits());
+      else
+        obs << c.as_string();
+    }
+}
+
+static std::vector<std::pair<std::string, Const>>
+bread_const_map(ibstream &ibs)
+{
+  size_t n;
+  ibs >> n;
+  std::vector<std::pair<std::string, Const>> v;
+  for (size_t i = 0; i < n; ++i)
+    {
+      std::string name;
+      LexicalPosition lp;
+      bool is_bits;
+      ibs >> name
+          >> lp.internal >> lp.file >> lp.line
+          >> is_bits;
+      if (is_bits)
+        {
+          BitVector bv;
+          bread_bits(ibs, bv);
+          v.push_back(std::make_pair(name, Const(lp, bv)));
+        }
+      else
+        {
+          std::string sv;
+          ibs >> sv;
+          v.push_back(std::make_pair(name, Const(lp, sv)));
+        }
+    }
+  return v;
+}
+
+static void
+bwrite_port(obstream &obs, const Port *p)
+{
+  obs << p->name()
+      << (int)p->direction()
+      << (int)p->undriven();
+}
+
+// The top model's ports, nets and instances are written in creation
+// order, so they are recreated in the same relative order and
+// IdLess-ordered containers iterate as in the original run.
+void
+write_checkpoint(const std::string &filename,
+                 CheckpointStage stage,
+                 const DesignState &ds)
+{
+  assert(stage != CheckpointStage::NONE);
+  
+  std::string expanded = expand_filename(filename);
+  std::ofstream ofs(expanded, std::ofstream::out | std::ofstream::binary);
+  if (ofs.fail())
+    fatal(fmt("write_checkpoint: failed to open `" << expanded << "': "
+              << strerror(errno)));
+  obstream obs(ofs);
+  
+  const ChipDB *chipdb = ds.chipdb;
+  obs << std::string(checkpoint_magic)
+      << std::string(version_str)
+      << chipdb->device
+      << chipdb->n_tiles
+      << chipdb->n_cells
+      << chipdb->n_nets
+      << (int)stage;
+  
+  const Model *top = ds.top;
+  obs << top->name();
+  bwrite_const_map(obs, top->params());
+  
+  std::vector<Net *> nets;
+  for (const auto &p : top->nets())
+    nets.push_back(p.second);
+  std::sort(nets.begin(), nets.end(), IdLess());
+  HashMap<const Net *, int> net_idx;
+  net_idx.reserve(nets.size());
+  for (int i = 0; i < (int)nets.size(); ++i)
+    net_idx[nets[i]] = i;
+  
+  HashMap<const Instance *, int> inst_idx;
+  inst_idx.reserve(top->instances().size());
+  for (Instance *inst : top->instances())
+    {
+      int i = inst_idx.size();
+      inst_idx[inst] = i;
+    }
+  
+  const std::vector<Port *> &ports = top->ordered_ports();
+  obs << ports.size()
+      << nets.size()
+      << top->instances().size();
+  
+  IdLess id_less;
+  auto pi = ports.begin();
+  auto ni = nets.begin();
+  auto ii = top->instances().begin();
+  for (;;)
+    {
+      const Identified *next = nullptr;
+      char tag = 0;
+      if (pi != ports.end())
+        {
+          next = *pi;
+          tag = 'p';
+        }
+      if (ni != nets.end()
+          && (!next || id_less((const Identified *)*ni, next)))
+        {
+          next = *ni;
+          tag = 'n';
+        }
+      if (ii != top->instances().end()
+          && (!next || id_less((const Identified *)*ii, next)))
+        {
+          next = *ii;
+          tag = 'i';
+        }
+      if (!next)
+        break;
+      
+      obs << tag;
+      if (tag == 'p')
+        {
+          bwrite_port(obs, *pi);
+          ++pi;
+        }
+      else if (tag == 'n')
+        {
+          const Net *n = *ni;
+          obs << n->name()
+              << n->is_constant()
+              << (int)n->constant();
+          ++ni;
+        }
+      else
+        {
+          const Instance *inst = *ii;
+          obs << inst->instance_of()->name();
+          bwrite_const_map(obs, inst->params());
+          bwrite_const_map(obs, inst->attrs());
+          obs << inst->ordered_ports().size();
+          for (const Port *p : inst->ordered_ports())
+            bwrite_port(obs, p);
+          ++ii;
+        }
+    }
+  
+  auto conn = [&](const Port *p) {
+    return p->connection() ? net_idx.at(p->connection()) : -1;
+  };
+  
+  for (const Port *p : ports)
+    obs << conn(p);
+  for (const Instance *inst : top->instances())
+    for (const Port *p : inst->ordered_ports())
+      obs << conn(p);
+  
+  obs << ds.constraints.net_pin_loc
+      << ds.constraints.net_pin_pull_up;
+  obs << ds.constraints.regions.size();
+  for (const Region &r : ds.constraints.regions)
+    obs << r.pattern << r.xmin << r.ymin << r.xmax << r.ymax;
+  
+  obs << ds.chains.chains.size();
+  for (const auto &v : ds.chains.chains)
+    {
+      obs << v.size();
+      for (const Instance *inst : v)
+        obs << inst_idx.at(inst);
+    }
+  
+  obs << ds.locked.size();
+  for (const Instance *inst : ds.locked)
+    obs << inst_idx.at(inst);
+  
+  obs << ds.placement.size();
+  for (const auto &p : ds.placement)
+    obs << inst_idx.at(p.first) << p.second;
+  
+  obs << ds.gb_inst_gc.size();
+  for (const auto &p : ds.gb_inst_gc)
+    obs << inst_idx.at(p.first) << p.second;
+  
+  if (stage >= CheckpointStage::PLACE)
+    ds.conf.bwrite(obs);
+  
+  if (stage >= CheckpointStage::ROUTE)
+    {
+      std::vector<std::pair<int, int>> cnet_net;
+      for (int i = 0; i < (int)ds.cnet_net.size(); ++i)
+        if (ds.cnet_net[i])
+          cnet_net.push_back(std::make_pair(i, net_idx.at(ds.cnet_net[i])));
+      obs << cnet_net;
+    }
+}
+
+CheckpointReader::CheckpointReader(const std::string &filename_,
+                                   const ChipDB *chipdb)
+  : filename(filename_),
+    fs(expand_filename(filename_), std::ifstream::in | std::ifstream::binary),
+    ibs(fs),
+    m_stage(CheckpointStage::NONE)
+{
+  if (fs.fail())
+    fatal(fmt("read_checkpoint: failed to open `"
+              << expand_filename(filename) << "': "
+              << strerror(errno)));
+  
+  std::string magic, version, device;
+  ibs >> magic;
+  if (magic != checkpoint_magic)
+    fatal(fmt("read_checkpoint: `" << filename << "' is not a checkpoint"));
+  ibs >> version;
+  if (version != version_str)
+    fatal(fmt("checkpoint and arachne-pnr versions do not match (checkpoint: "
+              << version
+              << ", arachne-pnr: "
+              << version_str << ")"));
+  
+  int n_tiles, n_cells, n_nets, stage;
+  ibs >> device >> n_tiles >> n_cells >> n_nets >> stage;
+  if (device != chipdb->device
+      || n_tiles != chipdb->n_tiles
+      || n_cells != chipdb->n_cells
+      || n_nets != chipdb->n_nets)
+    fatal(fmt("read_checkpoint: checkpoint was written for a different chipdb (device "
+              << device << ")"));
+  if (stage <= (int)CheckpointStage::NONE
+      || stage > (int)CheckpointStage::ROUTE)
+    fatal("read_checkpoint: invalid stage");
+  m_stage = (CheckpointStage)stage;
+}
+
+Net *
+CheckpointReader::read_net()
+{
+  int i;
+  ibs >> i;
+  if (i == -1)
+    return nullptr;
+  if (i < 0 || i >= (int)nets.size())
+    fatal("read_checkpoint: invalid net index");
+  return nets[i];
+}
+
+Instance *
+CheckpointReader::read_instance()
+{
+  int i;
+  ibs >> i;
+  if (i < 0 || i >= (int)instances.size())
+    fatal("read_checkpoint: invalid instance index");
+  return instances[i];
+}
+
+Design *
+CheckpointReader::read_design()
+{
+  Design *d = new Design;
+  d->create_standard_models();
+  
+  std::string top_name;
+  ibs >> top_name;
+  Model *top = new Model(d, top_name);
+  d->set_top(top);
+  for (const auto &p : bread_const_map(ibs))
+    {
+      if (p.second.is_bits())
+        top->set_param(p.first, p.second.as_bits());
+      else
+        top->set_param(p.first, p.second.as_string());
+    }
+  
+  size_t n_ports, n_nets, n_instances;
+  ibs >> n_ports >> n_nets >> n_instances;
+  
+  std::vector<Port *> ports;
+  for (size_t k = 0; k < n_ports + n_nets + n_instances; ++k)
+    {
+      char tag;
+      ibs >> tag;
+      if (tag == 'p')
+        {
+          std::string name;
+          int dir, undriven;
+          ibs >> name >> dir >> undriven;
+          ports.push_back(top->add_port(name, (Direction)dir, (Value)undriven));
+        }
+      else if (tag == 'n')
+        {
+          std::string name;
+          bool is_constant;
+          int constant;
+          ibs >> name >> is_constant >> constant;
+          if (top->find_net(name))
+            fatal(fmt("read_checkpoint: duplicate net `" << name << "'"));
+          Net *n = top->find_or_add_net(name);
+          n->set_is_constant(is_constant);
+          n->set_constant((Value)constant);
+          nets.push_back(n);
+        }
+      else if (tag == 'i')
+        {
+          std::string model_name;
+          ibs >> model_name;
+          Model *inst_of = d->find_model(model_name);
+          if (!inst_of)
+            fatal(fmt("read_checkpoint: unknown model `" << model_name << "'"));
+          
+          Instance *inst = top->add_instance(inst_of);
+          for (const auto &p : bread_const_map(ibs))
+            inst->set_param(p.first, p.second);
+          for (const auto &p : bread_const_map(ibs))
+            inst->set_attr(p.first, p.second);
+          
+          size_t n_inst_ports;
+          ibs >> n_inst_ports;
+          for (size_t j = 0; j < n_inst_ports; ++j)
+            {
+              std::string name;
+              int dir, undriven;
+              ibs >> name >> dir >> undriven;
+              Port *p = inst->find_port(name);
+              if (!p)
+                p = inst->add_port(name, (Direction)dir, (Value)undriven);
+              p->set_direction((Direction)dir);
+              p->set_undriven((Value)undriven);
+            }
+          instances.push_back(inst);
+        }
+      else
+        fatal("read_checkpoint: invalid netlist entry");
+    }
+  if (ports.size() != n_ports
+      || nets.size() != n_nets
+      || instances.size() != n_instances)
+    fatal("read_checkpoint: invalid netlist");
+  
+  for (Port *p : ports)
+    if (Net *n = read_net())
+      p->connect(n);
+  for (Instance *inst : instances)
+    for (Port *p : inst->ordered_ports())
+      if (Net *n = read_net())
+        p->connect(n);
+  
+  return d;
+}
+
+void
+CheckpointReader::match_design(Model *top)
+{
+  Design *d = read_design();
+  size_t n_nets = nets.size(),
+    n_instances = instances.size();
+  delete d;
+  
+  nets.clear();
+  for (const auto &p : top->nets())
+    nets.push_back(p.second);
+  std::sort(nets.begin(), nets.end(), IdLess());
+  instances.assign(top->instances().begin(), top->instances().end());
+  if (nets.size() != n_nets
+      || instances.size() != n_instances)
+    fatal("read_checkpoint: checkpoint does not match the design");
+}
+
+void
+CheckpointReader::read_state(DesignState &ds)
+{
+  ds.chains.chains.clear();
+  ds.locked.clear();
+  ds.placement.clear();
+  ds.gb_inst_gc.clear();
+  
+  ibs >> ds.constraints.net_pin_loc
+      >> ds.constraints.net_pin_pull_up;
+  
+  size_t n;
+  ibs >> n;
+  ds.constraints.regions.resize(n);
+  for (Region &r : ds.constraints.regions)
+    ibs >> r.pattern >> r.xmin >> r.ymin >> r.xmax >> r.ymax;
+  
+  ibs >> n;
+  ds.chains.chains.resize(n);
+  for (auto &v : ds.chains.chains)
+    {
+      size_t m;
+      ibs >> m;
+      for (size_t i = 0; i < m; ++i)
+        v.push_back(read_instance());
+    }
+  
+  ibs >> n;
+  for (size_t i = 0; i < n; ++i)
+    ds.locked.insert(read_instance());
+  
+  ibs >> n;
+  for (size_t i = 0; i < n; ++i)
+    {
+      Instance *inst = read_instance();
+      int cell;
+      ibs >> cell;
+      if (cell < 1 || cell > ds.chipdb->n_cells)
+        fatal("read_checkpoint: invalid cell");
+      ds.placement[inst] = cell;
+    }
+  
+  ibs >> n;
+  for (size_t i = 0; i < n; ++i)
+    {
+      Instance *inst = read_instance();
+      uint8_t gc;
+      ibs >> gc;
+      ds.gb_inst_gc[inst] = gc;
+    }
+  
+  if (m_stage >= CheckpointStage::PLACE)
+    ds.conf.bread(ibs);
+  
+  if (m_stage >= CheckpointStage::ROUTE)
+    {
+      std::vector<std::pair<int, int>> cnet_net;
+      ibs >> cnet_net;
+      ds.cnet_net.assign(ds.chipdb->n_nets, nullptr);
+      for (const auto &p : cnet_net)
+        {
+          if (p.first < 0 || p.first >= ds.chipdb->n_nets
+              || p.second < 0 || p.second >= (int)nets.size())
+            fatal("read_checkpoint: invalid routing");
+          ds.cnet_net[p.first] = nets[p.second];
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+
+#ifndef PNR_CHECKPOINT_HH
+#define PNR_CHECKPOINT_HH
+
+#include "bstream.hh"
+#include "bitvector.hh"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+class ChipDB;
+class Design;
+class DesignState;
+class Model;
+class Net;
+class Instance;
+
+// Stages a run can be checkpointed after.  pack covers everything
+// before placement.
+enum class CheckpointStage
+{
+  NONE, PACK, PLACE, ROUTE,
+};
+
+const char *checkpoint_stage_name(CheckpointStage stage);
+CheckpointStage parse_checkpoint_stage(const std::string &s);
+
+void bwrite_bits(obstream &obs, const BitVector &bv);
+void bread_bits(ibstream &ibs, BitVector &bv);
+
+void write_checkpoint(const std::string &filename,
+                      CheckpointStage stage,
+                      const DesignState &ds);
+
+class CheckpointReader
+{
+  std::string filename;
+  std::ifstream fs;
+  ibstream ibs;
+  CheckpointStage m_stage;
+  
+  // by index in the checkpoint
+  std::vector<Net *> nets;
+  std::vector<Instance *> instances;
+  
+  Net *read_net();
+  Instance *read_instance();
+  
+public:
+  CheckpointReader(const std::string &filename_, const ChipDB *chipdb);
+  
+  CheckpointStage stage() const { return m_stage; }
+  
+  Design *read_design();
+  // reads the netlist of a checkpoint written from top itself, as by
+  // a forked copy of the process, and binds it to top's nets and
+  // instances instead of new ones
+  void match_design(Model *top);
+  void read_state(DesignState &ds);
+};
+
+#endif
@@ -16,11 +16,14 @@
 #include "chipdb.hh"
 #include "util.hh"
 #include "line_parser.hh"
+#include "threadpool.hh"
 
 #include <cassert>
 #include <cstring>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 std::ostream &
 operator<<(std::ostream &s, const CBit &cbit)
@@ -103,22 +106,7 @@ tile_type_name(TileType t)
   return std::string();
 }
 
-obstream &operator<<(obstream &obs, const Switch &sw)
-{
-  obs << sw.bidir
-      << sw.tile
-      << sw.out
-      << sw.cbits.size();
-  for (const CBit &cbit : sw.cbits)
-    {
-      assert(cbit.tile == sw.tile);
-      obs << cbit.row << cbit.col;
-    }
-  obs << sw.in_val;
-  return obs;
-}
-
-ibstream &operator>>(ibstream &ibs, Switch &sw)
+ibstream &operator>>(ibstream &ibs, SwitchSpec &sw)
 {
   size_t n_cbits;
   ibs >> sw.bidir
@@ -247,8 +235,8 @@ ChipDB::dump(std::ostream &s) const
   
   std::vector<std::vector<std::pair<int, std::string>>> net_tile_names(n_nets);
   for (int i = 0; i < n_tiles; ++i)
-    for (const auto &p : tile_nets[i])
-      net_tile_names[p.second].push_back(std::make_pair(i, p.first));
+    for (const TileNet &tn : tile_nets(i))
+      net_tile_names[tn.net].push_back(std::make_pair(i, net_name(tn.name)));
   
   for (int i = 0; i < n_nets; ++i)
     {
@@ -261,23 +249,24 @@ ChipDB::dump(std::ostream &s) const
   for (unsigned i = 0; i < switches.size(); ++i)
     {
       const Switch &sw = switches[i];
+      Range<CBit> cbits = switch_cbits_of(i);
       
       s << (sw.bidir ? ".routing" : ".buffer")
         << " " << tile_x(sw.tile) << " " << tile_y(sw.tile) << " " << sw.out;
-      for (const CBit &cb : sw.cbits)
+      for (const CBit &cb : cbits)
         s << " B" << cb.row << "[" << cb.col << "]";
       s << "\n";
       
-      for (const auto &p : sw.in_val)
+      for (const SwitchIn &si : switch_ins_of(i))
         {
-          for (int j = 0; j < (int)sw.cbits.size(); ++j)
+          for (int j = 0; j < (int)cbits.size(); ++j)
             {
-              if (p.second & (1 << j))
+              if (si.val & (1 << j))
                 s << "1";
               else
                 s << "0";
             }     
-          s << " " << p.first << "\n";
+          s << " " << si.net << "\n";
         }
       s << "\n";
     }
@@ -295,18 +284,49 @@ ChipDB::set_device(const std::string &d,
   n_nets = n_nets_;
   
   tile_type.resize(n_tiles, TileType::EMPTY);
-  tile_nets.resize(n_tiles);
   
   net_tile_name.resize(n_nets);
-  out_switches.resize(n_nets);
-  in_switches.resize(n_nets);
 }
 
-class ChipDBParser : public LineParser
+// a line of a .net section: net is called name in tile
+class NetEntry
+{
+public:
+  int tile;
+  int net;
+  StringRef name;
+  // the first line of its section, which names the net
+  bool first;
+  
+  NetEntry(int t, int n, StringRef name_, bool first_)
+    : tile(t), net(n), name(name_), first(first_)
+  {}
+};
+
+// a command and the lines up to the next, of the text chipdb
+class ChipDBSection
+{
+public:
+  const char *b, *e;
+  int line;
+  // .net, .buffer or .routing, parsed in parallel
+  bool routing;
+};
+
+class ChipDBParser : public BufferedLineParser
 {
   ChipDB *chipdb;
+  std::vector<std::map<std::string, int>> tile_nets;
+  std::vector<SwitchSpec> switches;
+  std::vector<NetEntry> net_entries;
   
-  CBit parse_cbit(int tile, const std::string &s);
+  int parse_int(StringRef s) const;
+  CBit parse_cbit(int tile, StringRef s) const;
+  
+  std::vector<ChipDBSection> split_sections() const;
+  void parse_cmd();
+  void parse_routing(const std::vector<ChipDBSection> &sections,
+                     int n_threads);
   
   void parse_cmd_device();
   void parse_cmd_pins();
@@ -324,14 +344,44 @@ class ChipDBParser : public LineParser
   
 public:
   ChipDBParser(const std::string &f, std::istream &s_)
-    : LineParser(f, s_), chipdb(nullptr)
+    : BufferedLineParser(f, s_), chipdb(nullptr)
+  {}
+  // parses .net, .buffer and .routing sections in [b, e) of another
+  // parser's input into net_entries and switches
+  ChipDBParser(const std::string &f, ChipDB *chipdb_,
+               const char *b, const char *e, int first_line)
+    : BufferedLineParser(f, b, e, first_line), chipdb(chipdb_)
   {}
   
-  ChipDB *parse();
+  ChipDB *parse(int n_threads);
 };
 
+int
+ChipDBParser::parse_int(StringRef s) const
+{
+  const char *p = s.begin();
+  bool neg = false;
+  if (p != s.end()
+      && *p == '-')
+    {
+      neg = true;
+      ++p;
+    }
+  if (p == s.end())
+    fatal(fmt("invalid integer `" << s << "'"));
+  
+  int x = 0;
+  for (; p != s.end(); ++p)
+    {
+      if (*p < '0' || *p > '9')
+        fatal(fmt("invalid integer `" << s << "'"));
+      x = x * 10 + (*p - '0');
+    }
+  return neg ? -x : x;
+}
+
 CBit
-ChipDBParser::parse_cbit(int t, const std::string &s_)
+ChipDBParser::parse_cbit(int t, StringRef s_) const
 {
   std::size_t lbr = s_.find('['),
     rbr = s_.find(']');
@@ -341,11 +391,10 @@ ChipDBParser::parse_cbit(int t, const std::string &s_)
       || rbr == std::string::npos)
     fatal("invalid cbit spec");
   
-  std::string rows(&s_[1], &s_[lbr]),
-    cols(&s_[lbr + 1], &s_[rbr]);
-  
-  int r = std::stoi(rows),
-    c = std::stoi(cols);
+  if (rbr < lbr)
+    fatal("invalid cbit spec");
+  int r = parse_int(s_.substr(1, lbr - 1)),
+    c = parse_int(s_.substr(lbr + 1, rbr - lbr - 1));
   
   return CBit(t, r, c);
 }
@@ -356,10 +405,11 @@ ChipDBParser::parse_cmd_device()
   if (words.size() != 5)
     fatal("wrong number of arguments");
   
-  chipdb->set_device(words[1],
-                     std::stoi(words[2]),
-                     std::stoi(words[3]),
-                     std::stoi(words[4]));
+  chipdb->set_device(words[1].str(),
+                     parse_int(words[2]),
+                     parse_int(words[3]),
+                     parse_int(words[4]));
+  tile_nets.resize(chipdb->n_tiles);
   
   // next command
   read_line();
@@ -371,7 +421,7 @@ ChipDBParser::parse_cmd_pins()
   if (words.size() != 2)
     fatal("wrong number of arguments");
   
-  const std::string &package_name = words[1];
+  std::string package_name = words[1].str();
   Package &package = chipdb->packages[package_name];
   
   package.name = package_name;
@@ -386,10 +436,10 @@ ChipDBParser::parse_cmd_pins()
       if (words.size() != 4)
         fatal("invalid .pins entry");
       
-      const std::string &pin = words[0];
-      int x = std::stoi(words[1]),
-        y = std::stoi(words[2]),
-        pos = std::stoi(words[3]);
+      std::string pin = words[0].str();
+      int x = parse_int(words[1]),
+        y = parse_int(words[2]),
+        pos = parse_int(words[3]);
       int t = chipdb->tile(x, y);
       Location loc(t, pos);
       extend(package.pin_loc, pin, loc);
@@ -413,10 +463,10 @@ ChipDBParser::parse_cmd_gbufpin()
       if (words.size() != 4)
         fatal("invalid .gbufpin entry");
       
-      int x = std::stoi(words[0]),
-        y = std::stoi(words[1]),
-        pos = std::stoi(words[2]),
-        glb_num = std::stoi(words[3]);
+      int x = parse_int(words[0]),
+        y = parse_int(words[1]),
+        pos = parse_int(words[2]),
+        glb_num = parse_int(words[3]);
       int t = chipdb->tile(x, y);
       Location loc(t, pos);
       extend(chipdb->loc_pin_glb_num, loc, glb_num);
@@ -431,8 +481,8 @@ ChipDBParser::parse_cmd_tile()
   if (words.size() != 3)
     fatal("wrong number of arguments");
   
-  int x = std::stoi(words[1]),
-    y = std::stoi(words[2]);
+  int x = parse_int(words[1]),
+    y = parse_int(words[2]);
   if (x < 0 || x >= chipdb->width)
     fatal("tile x out of range");
   if (y < 0 || y >= chipdb->height)
@@ -440,7 +490,7 @@ ChipDBParser::parse_cmd_tile()
   
   int t = chipdb->tile(x, y);
   
-  const std::string &cmd = words[0];
+  StringRef cmd = words[0];
   if (cmd == ".io_tile")
     {
       chipdb->tile_type[t] = TileType::IO;
@@ -489,7 +539,7 @@ ChipDBParser::parse_cmd_tile_bits()
     fatal("wrong number of arguments");
   
   TileType ty;
-  const std::string &cmd = words[0];
+  StringRef cmd = words[0];
   if (cmd == ".io_tile_bits")
     ty = TileType::IO;
   else if (cmd == ".logic_tile_bits")
@@ -512,8 +562,8 @@ ChipDBParser::parse_cmd_tile_bits()
       ty = TileType::IPCON;
     }
   
-  int n_columns = std::stoi(words[1]),
-    n_rows = std::stoi(words[2]);
+  int n_columns = parse_int(words[1]),
+    n_rows = parse_int(words[2]);
   
   extend(chipdb->tile_cbits_block_size,
          ty,
@@ -529,7 +579,7 @@ ChipDBParser::parse_cmd_tile_bits()
       if (words.size() < 2)
         fatal("invalid tile entry");
       
-      const std::string &func = words[0];
+      std::string func = words[0].str();
       
       std::vector<CBit> cbits(words.size() - 1);
       for (unsigned i = 1; i < words.size(); ++i)
@@ -546,8 +596,9 @@ ChipDBParser::parse_cmd_net()
   if (words.size() != 2)
     fatal("wrong number of arguments");
   
-  int n = std::stoi(words[1]);
-  if (n < 0)
+  int n = parse_int(words[1]);
+  if (n < 0
+      || n >= chipdb->n_nets)
     fatal("invalid net index");
   
   bool first = true;
@@ -561,20 +612,16 @@ ChipDBParser::parse_cmd_net()
       if (words.size() != 3)
         fatal("invalid .net entry");
       
-      int x = std::stoi(words[0]),
-        y = std::stoi(words[1]);
+      int x = parse_int(words[0]),
+        y = parse_int(words[1]);
       if (x < 0 || x >= chipdb->width)
         fatal("tile x out of range");
       if (y < 0 || y >= chipdb->height)
         fatal("tile y out of range");
       int t = chipdb->tile(x, y);
       
-      if (first)
-        {
-          chipdb->net_tile_name[n] = std::make_pair(t, words[2]);
-          first = false;
-        }
-      extend(chipdb->tile_nets[t], words[2], n);
+      net_entries.push_back(NetEntry(t, n, words[2], first));
+      first = false;
     }
 }
 
@@ -586,23 +633,28 @@ ChipDBParser::parse_cmd_buffer_routing()
   
   bool bidir = words[0] == ".routing";
   
-  int x = std::stoi(words[1]),
-    y = std::stoi(words[2]);
+  int x = parse_int(words[1]),
+    y = parse_int(words[2]);
   if (x < 0 || x >= chipdb->width)
     fatal("tile x out of range");
   if (y < 0 || y >= chipdb->height)
     fatal("tile y out of range");
   int t = chipdb->tile(x, y);
   
-  int n = std::stoi(words[3]);
-  if (n < 0)
+  int n = parse_int(words[3]);
+  if (n < 0
+      || n >= chipdb->n_nets)
     fatal("invalid net index");
   
-  std::vector<CBit> cbits(words.size() - 4);
+  SwitchSpec sw;
+  sw.bidir = bidir;
+  sw.tile = t;
+  sw.out = n;
+  sw.cbits.resize(words.size() - 4);
   for (unsigned i = 4; i < words.size(); i ++)
-    cbits[i - 4] = parse_cbit(t, words[i]);
+    sw.cbits[i - 4] = parse_cbit(t, words[i]);
   
-  std::map<int, unsigned> in_val;             
+  std::map<int, unsigned> &in_val = sw.in_val;
   
   for (;;)
     {
@@ -610,21 +662,20 @@ ChipDBParser::parse_cmd_buffer_routing()
       if (eof()
           || line[0] == '.')
         {
-          chipdb->switches.push_back(Switch(bidir,
-                                            t,
-                                            n,
-                                            in_val,
-                                            cbits));
+          switches.push_back(std::move(sw));
           return;
         }
       
-      const std::string &sval = words[0];
+      StringRef sval = words[0];
       
       if (words.size() != 2
-          || sval.size() != cbits.size())
+          || sval.size() != sw.cbits.size())
         fatal("invalid .buffer/.routing entry");
       
-      int n2 = std::stoi(words[1]);
+      int n2 = parse_int(words[1]);
+      if (n2 < 0
+          || n2 >= chipdb->n_nets)
+        fatal("invalid net index");
       
       unsigned val = 0;
       for (unsigned i = 0; i < sval.size(); i ++)
@@ -655,10 +706,10 @@ ChipDBParser::parse_cmd_colbuf()
       if (words.size() != 4)
         fatal("invalid .colbuf entry");
       
-      int src_x = std::stoi(words[0]);
-      int src_y = std::stoi(words[1]);
-      int dst_x = std::stoi(words[2]);
-      int dst_y = std::stoi(words[3]);
+      int src_x = parse_int(words[0]);
+      int src_y = parse_int(words[1]);
+      int dst_x = parse_int(words[2]);
+      int dst_y = parse_int(words[3]);
       
       chipdb->tile_colbuf_tile[chipdb->tile(dst_x, dst_y)]
         = chipdb->tile(src_x, src_y);
@@ -678,11 +729,11 @@ ChipDBParser::parse_cmd_gbufin()
       if (words.size() != 3)
         fatal("invalid .gbufin entry");
       
-      int g = std::stoi(words[2]);
+      int g = parse_int(words[2]);
       assert(g < chipdb->n_global_nets);
       
       extend(chipdb->gbufin,
-             std::make_pair(std::stoi(words[0]), std::stoi(words[1])),
+             std::make_pair(parse_int(words[0]), parse_int(words[1])),
              g);
     }
 }
@@ -700,8 +751,8 @@ ChipDBParser::parse_cmd_iolatch()
       if (words.size() != 2)
         fatal("invalid .iolatch entry");
       
-      int x = std::stoi(words[0]),
-        y = std::stoi(words[1]);
+      int x = parse_int(words[0]),
+        y = parse_int(words[1]);
       chipdb->iolatch.push_back(chipdb->tile(x, y));
     }
 }
@@ -719,13 +770,13 @@ ChipDBParser::parse_cmd_ieren()
         if (words.size() != 6)
           fatal("invalid .ieren entry");
         
-        int pio_t = chipdb->tile(std::stoi(words[0]),
-                                 std::stoi(words[1])),
-          ieren_t = chipdb->tile(std::stoi(words[3]),
-                                 std::stoi(words[4]));
+        int pio_t = chipdb->tile(parse_int(words[0]),
+                                 parse_int(words[1])),
+          ieren_t = chipdb->tile(parse_int(words[3]),
+                                 parse_int(words[4]));
         
-        Location pio(pio_t, std::stoi(words[2])),
-          ieren(ieren_t, std::stoi(words[5]));
+        Location pio(pio_t, parse_int(words[2])),
+          ieren(ieren_t, parse_int(words[5]));
         extend(chipdb->ieren, pio, ieren);
       }
 }
@@ -743,12 +794,12 @@ ChipDBParser::parse_cmd_extra_bits()
       if (words.size() != 4)
         fatal("invalid .extra_bits entry");
       
-      int bank_num = std::stoi(words[1]),
-        addr_x = std::stoi(words[2]),
-        addr_y = std::stoi(words[3]);
+      int bank_num = parse_int(words[1]),
+        addr_x = parse_int(words[2]),
+        addr_y = parse_int(words[3]);
       
       extend(chipdb->extra_bits,
-             words[0],
+             words[0].str(),
              std::make_tuple(bank_num, addr_x, addr_y));
     }
 }
@@ -761,12 +812,12 @@ ChipDBParser::parse_cmd_extra_cell()
   
   
               
-  const std::string &cell_type = words[(words.size() >= 5) ? 4 : 3];
-  int x = std::stoi(words[1]),
-    y = std::stoi(words[2]);
+  StringRef cell_type = words[(words.size() >= 5) ? 4 : 3];
+  int x = parse_int(words[1]),
+    y = parse_int(words[2]);
   int z = 0;
   if(words.size() >= 5)
-    z = std::stoi(words[3]);
+    z = parse_int(words[3]);
   int t = chipdb->tile(x, y);
   
   int c = 0;
@@ -810,7 +861,7 @@ ChipDBParser::parse_cmd_extra_cell()
 
       if (words.size() > 0 && words[0] == "LOCKED") {
         for (size_t i = 1; i < words.size(); i++)
-          extend(locked_pkgs, words[i]);
+          extend(locked_pkgs, words[i].str());
         continue;
       }
 
@@ -818,75 +869,222 @@ ChipDBParser::parse_cmd_extra_cell()
       if (words.size() != 4)
         fatal("invalid .extra_cell entry");
       
-      int mfv_t = chipdb->tile(std::stoi(words[1]),
-                               std::stoi(words[2]));
-      extend(mfvs, words[0],
+      int mfv_t = chipdb->tile(parse_int(words[1]),
+                               parse_int(words[2]));
+      extend(mfvs, words[0].str(),
              std::make_pair(mfv_t,
-                            words[3]));
+                            words[3].str()));
+    }
+}
+
+// Split the input at the lines that start a command.  The first
+// section is whatever comes before the first command.
+std::vector<ChipDBSection>
+ChipDBParser::split_sections() const
+{
+  StringRef in = input();
+  std::vector<ChipDBSection> sections;
+  
+  ChipDBSection sec;
+  sec.b = in.begin();
+  sec.line = 1;
+  sec.routing = false;
+  int line_no = 1;
+  for (const char *p = in.begin(); p != in.end(); )
+    {
+      if (*p == '.'
+          && p != sec.b)
+        {
+          sec.e = p;
+          sections.push_back(sec);
+          sec.b = p;
+          sec.line = line_no;
+        }
+      if (p == sec.b)
+        {
+          auto starts = [&](const char *cmd)
+            {
+              size_t n = strlen(cmd);
+              return ((size_t)(in.end() - p) >= n
+                      && !memcmp(p, cmd, n));
+            };
+          sec.routing = (starts(".net ")
+                         || starts(".buffer ")
+                         || starts(".routing "));
+        }
+      
+      const char *nl = (const char *)memchr(p, '\n', in.end() - p);
+      if (!nl)
+        break;
+      p = nl + 1;
+      ++line_no;
     }
+  sec.e = in.end();
+  sections.push_back(sec);
+  return sections;
+}
+
+void
+ChipDBParser::parse_cmd()
+{
+  if (line[0] != '.')
+    fatal(fmt("expected command, got '" << words[0] << "'"));
+  
+  StringRef cmd = words[0];
+  if (cmd == ".device")
+    parse_cmd_device();
+  else if (cmd == ".pins")
+    parse_cmd_pins();
+  else if (cmd == ".gbufpin")
+    parse_cmd_gbufpin();
+  else if (cmd == ".io_tile"
+           || cmd == ".logic_tile"
+           || cmd == ".ramb_tile"
+           || cmd == ".ramt_tile"
+           || cmd == ".dsp0_tile"
+           || cmd == ".dsp1_tile"
+           || cmd == ".dsp2_tile"
+           || cmd == ".dsp3_tile"
+           || cmd == ".ipcon_tile")
+    parse_cmd_tile();
+  else if (cmd == ".io_tile_bits"
+           || cmd == ".logic_tile_bits"
+           || cmd == ".ramb_tile_bits"
+           || cmd == ".ramt_tile_bits"
+           || cmd == ".dsp0_tile_bits"
+           || cmd == ".dsp1_tile_bits"
+           || cmd == ".dsp2_tile_bits"
+           || cmd == ".dsp3_tile_bits"
+           || cmd == ".ipcon_tile_bits")
+    parse_cmd_tile_bits();
+  else if (cmd == ".net")
+    parse_cmd_net();
+  else if (cmd == ".buffer"
+           || cmd == ".routing")
+    parse_cmd_buffer_routing();
+  else if (cmd == ".colbuf")
+    parse_cmd_colbuf();
+  else if (cmd == ".gbufin")
+    parse_cmd_gbufin();
+  else if (cmd == ".iolatch")
+    parse_cmd_iolatch();
+  else if (cmd == ".ieren")
+    parse_cmd_ieren();
+  else if (cmd == ".extra_bits")
+    parse_cmd_extra_bits();
+  else if (cmd == ".extra_cell")
+    parse_cmd_extra_cell();
+  else
+    fatal(fmt("unknown directive '" << cmd << "'"));
+}
+
+// The .net, .buffer and .routing sections are most of the input.
+// They are parsed in parallel, in runs of consecutive sections, and
+// the results merged in input order, so the chipdb doesn't depend on
+// the number of threads.
+void
+ChipDBParser::parse_routing(const std::vector<ChipDBSection> &sections,
+                            int n_threads)
+{
+  if (sections.empty())
+    return;
+  
+  size_t total = 0;
+  for (const ChipDBSection &sec : sections)
+    total += sec.e - sec.b;
+  
+  int n_tasks = std::min((int)sections.size(), 4 * n_threads);
+  std::vector<std::pair<int, int>> task_sections;
+  int i = 0;
+  size_t done = 0;
+  for (int k = 0; k < n_tasks; ++k)
+    {
+      int begin = i;
+      size_t goal = total * (k + 1) / n_tasks;
+      while (i < (int)sections.size()
+             && (i == begin
+                 || done < goal))
+        {
+          done += sections[i].e - sections[i].b;
+          ++i;
+        }
+      if (k == n_tasks - 1)
+        i = sections.size();
+      task_sections.push_back(std::make_pair(begin, i));
+    }
+  
+  std::vector<std::unique_ptr<ChipDBParser>> parsers(n_tasks);
+  ThreadPool pool(n_threads);
+  pool.run(n_tasks, [&](int k, int)
+           {
+             int begin = task_sections[k].first,
+               end = task_sections[k].second;
+             if (begin == end)
+               return;
+             ChipDBParser *p = new ChipDBParser(lp.file, chipdb,
+                                                sections[begin].b,
+                                                sections[end - 1].e,
+                                                sections[begin].line);
+             parsers[k].reset(p);
+             for (int j = begin; j < end; ++j)
+               {
+                 p->seek(sections[j].b, sections[j].e, sections[j].line);
+                 p->read_line();
+                 while (!p->eof())
+                   p->parse_cmd();
+               }
+           });
+  
+  for (const auto &p : parsers)
+    {
+      if (!p)
+        continue;
+      for (SwitchSpec &sw : p->switches)
+        switches.push_back(std::move(sw));
+      for (const NetEntry &ne : p->net_entries)
+        if (ne.first)
+          chipdb->net_tile_name[ne.net] = std::make_pair(ne.tile,
+                                                         ne.name.str());
+    }
+  
+  // tile_nets, split by tile
+  pool.run(n_threads, [&](int k, int)
+           {
+             for (const auto &p : parsers)
+               {
+                 if (!p)
+                   continue;
+                 for (const NetEntry &ne : p->net_entries)
+                   if (ne.tile % n_threads == k)
+                     extend(tile_nets[ne.tile], ne.name.str(), ne.net);
+               }
+           });
 }
 
 ChipDB *
-ChipDBParser::parse()
+ChipDBParser::parse(int n_threads)
 {
   chipdb = new ChipDB;
   
-  read_line();
-  for (;;)
+  std::vector<ChipDBSection> routing;
+  for (const ChipDBSection &sec : split_sections())
     {
-      if (eof())
-        break;
-      if (line[0] != '.')
-        fatal(fmt("expected command, got '" << words[0] << "'"));
+      if (sec.routing)
+        {
+          routing.push_back(sec);
+          continue;
+        }
       
-      const std::string &cmd = words[0];
-      if (cmd == ".device")
-        parse_cmd_device();
-      else if (cmd == ".pins")
-        parse_cmd_pins();
-      else if (cmd == ".gbufpin")
-        parse_cmd_gbufpin();
-      else if (cmd == ".io_tile"
-               || cmd == ".logic_tile"
-               || cmd == ".ramb_tile"
-               || cmd == ".ramt_tile"
-               || cmd == ".dsp0_tile"
-               || cmd == ".dsp1_tile"
-               || cmd == ".dsp2_tile"
-               || cmd == ".dsp3_tile"
-               || cmd == ".ipcon_tile")
-        parse_cmd_tile();
-      else if (cmd == ".io_tile_bits"
-               || cmd == ".logic_tile_bits"
-               || cmd == ".ramb_tile_bits"
-               || cmd == ".ramt_tile_bits"
-               || cmd == ".dsp0_tile_bits"
-               || cmd == ".dsp1_tile_bits"
-               || cmd == ".dsp2_tile_bits"
-               || cmd == ".dsp3_tile_bits"
-               || cmd == ".ipcon_tile_bits")
-        parse_cmd_tile_bits();
-      else if (cmd == ".net")
-        parse_cmd_net();
-      else if (cmd == ".buffer"
-               || cmd == ".routing")
-        parse_cmd_buffer_routing();
-      else if (cmd == ".colbuf")
-        parse_cmd_colbuf();
-      else if (cmd == ".gbufin")
-        parse_cmd_gbufin();
-      else if (cmd == ".iolatch")
-        parse_cmd_iolatch();
-      else if (cmd == ".ieren")
-        parse_cmd_ieren();
-      else if (cmd == ".extra_bits")
-        parse_cmd_extra_bits();
-      else if (cmd == ".extra_cell")
-        parse_cmd_extra_cell();
-      else
-        fatal(fmt("unknown directive '" << cmd << "'"));
+      seek(sec.b, sec.e, sec.line);
+      read_line();
+      while (!eof())
+        parse_cmd();
     }
   
+  // needs the .device
+  parse_routing(routing, n_threads);
+  
+  chipdb->set_routing(tile_nets, switches);
   chipdb->finalize();
   return chipdb;
 }
@@ -895,12 +1093,13 @@ void
 ChipDB::finalize()
 {
   int t1c1 = tile(1, 1);
-  for (const auto &p : tile_nets[t1c1])
+  for (const TileNet &tn : tile_nets(t1c1))
     {
-      if (is_prefix("glb_netwk_", p.first))
+      const char *name = net_name(tn.name);
+      if (is_prefix("glb_netwk_", name))
         {
-          int n = std::stoi(&p.first[10]);
-          extend(net_global, p.second, n);
+          int n = std::stoi(&name[10]);
+          extend(net_global, tn.net, n);
         }
     }
   
@@ -949,88 +1148,419 @@ ChipDB::finalize()
       assert(tile_pos_cell[t][pos] == 0);
       tile_pos_cell[t][pos] = i;
     }
-  
-  in_switches.resize(n_nets);
-  out_switches.resize(n_nets);
-  for (size_t s = 0;  s < switches.size(); ++s)
-    {
-      int out = switches[s].out;
-      extend(out_switches[out], s);
-      for (const auto &p : switches[s].in_val)
-        extend(in_switches[p.first], s);
-    }
-}
-
-int
-ChipDB::find_switch(int in, int out) const
-{
-  std::vector<int> t;
-  std::set_intersection(out_switches[out].begin(),
-                        out_switches[out].end(),
-                        in_switches[in].begin(),
-                        in_switches[in].end(),
-                        std::back_insert_iterator<std::vector<int>>(t));
-  assert(t.size() == 1);
-  int s = t[0];
-  assert(switches[s].out == out);
-  assert(contains_key(switches[s].in_val, in));
-  return s;
 }
 
 void
-ChipDB::bwrite(obstream &obs) const
+ChipDB::set_routing(const std::vector<std::map<std::string, int>> &tile_nets_,
+                    const std::vector<SwitchSpec> &switches_)
 {
-  std::vector<std::string> net_names;
-  std::map<std::string, int> net_name_idx;
+  assert((int)tile_nets_.size() == n_tiles);
   
-  std::vector<std::map<int, int>> tile_nets_idx(n_tiles);
+  // names are numbered in sorted order, so each tile's nets, sorted
+  // by name, are also sorted by name index
+  std::map<std::string, int> name_idx;
   for (int t = 0; t < n_tiles; ++t)
+    for (const auto &p : tile_nets_[t])
+      name_idx.insert(std::make_pair(p.first, 0));
+  
+  std::vector<char> chars;
+  std::vector<int> name_offset;
+  for (auto &p : name_idx)
     {
-      for (const auto &p : tile_nets[t])
+      p.second = name_offset.size();
+      name_offset.push_back(chars.size());
+      chars.insert(chars.end(), p.first.begin(), p.first.end());
+      chars.push_back(0);
+    }
+  
+  std::vector<int> tn_offset;
+  std::vector<TileNet> tn_entries;
+  tn_offset.reserve(n_tiles + 1);
+  for (int t = 0; t < n_tiles; ++t)
+    {
+      tn_offset.push_back(tn_entries.size());
+      for (const auto &p : tile_nets_[t])
         {
-          int ni;
-          auto i = net_name_idx.find(p.first);
-          if (i == net_name_idx.end())
+          TileNet tn;
+          tn.name = name_idx.at(p.first);
+          tn.net = p.second;
+          tn_entries.push_back(tn);
+        }
+    }
+  tn_offset.push_back(tn_entries.size());
+  
+  net_name_chars.assign(std::move(chars));
+  net_name_offset.assign(std::move(name_offset));
+  tile_net_offset.assign(std::move(tn_offset));
+  tile_net_entries.assign(std::move(tn_entries));
+  
+  std::vector<NetClass> classes(n_nets, NetClass::OTHER);
+  std::vector<NetBBox> bboxes(n_nets);
+  std::vector<bool> seen(n_nets, false);
+  for (int t = 0; t < n_tiles; ++t)
+    {
+      int x = tile_x(t),
+        y = tile_y(t);
+      for (const TileNet &tn : tile_nets(t))
+        {
+          NetBBox &b = bboxes[tn.net];
+          if (!seen[tn.net])
             {
-              ni = net_name_idx.size();
-              net_names.push_back(p.first);
-              net_name_idx.insert(std::make_pair(p.first, ni));
+              seen[tn.net] = true;
+              b.xmin = b.xmax = x;
+              b.ymin = b.ymax = y;
             }
           else
-            ni = i->second;
-          extend(tile_nets_idx[t], ni, p.second);
+            {
+              b.xmin = std::min(b.xmin, x);
+              b.xmax = std::max(b.xmax, x);
+              b.ymin = std::min(b.ymin, y);
+              b.ymax = std::max(b.ymax, y);
+            }
+          
+          if (classes[tn.net] != NetClass::OTHER)
+            continue;
+          const char *name = net_name(tn.name);
+          if (is_prefix("local_", name))
+            classes[tn.net] = NetClass::LOCAL;
+          else if (is_prefix("glb_netwk_", name))
+            classes[tn.net] = NetClass::GLOBAL;
+          else if (is_prefix("span4_", name)
+                   || is_prefix("sp4_", name))
+            classes[tn.net] = NetClass::SPAN4;
+          else if (is_prefix("span12_", name)
+                   || is_prefix("sp12_", name))
+            classes[tn.net] = NetClass::SPAN12;
         }
     }
+  for (int i = 0; i < n_nets; ++i)
+    if (!seen[i])
+      fatal(fmt("chipdb: net " << i << " is in no tile"));
+  net_class.assign(std::move(classes));
+  net_bbox.assign(std::move(bboxes));
+  
+  std::vector<Switch> sws;
+  std::vector<SwitchIn> ins;
+  std::vector<CBit> cbits;
+  std::vector<int> n_fanout(n_nets, 0);
+  sws.reserve(switches_.size());
+  for (int s = 0; s < (int)switches_.size(); ++s)
+    {
+      const SwitchSpec &spec = switches_[s];
+      
+      Switch sw;
+      sw.bidir = spec.bidir;
+      sw.tile = spec.tile;
+      sw.out = spec.out;
+      sw.cbits_begin = cbits.size();
+      cbits.insert(cbits.end(), spec.cbits.begin(), spec.cbits.end());
+      sw.cbits_end = cbits.size();
+      sw.ins_begin = ins.size();
+      for (const auto &p : spec.in_val)
+        {
+          SwitchIn si;
+          si.net = p.first;
+          si.val = p.second;
+          ins.push_back(si);
+          
+          assert(p.first != spec.out);
+          ++n_fanout[p.first];
+        }
+      sw.ins_end = ins.size();
+      sws.push_back(sw);
+    }
+  
+  std::vector<int> f_offset(n_nets + 1);
+  f_offset[0] = 0;
+  for (int i = 0; i < n_nets; ++i)
+    f_offset[i + 1] = f_offset[i] + n_fanout[i];
+  
+  std::vector<int> next(f_offset.begin(), f_offset.end() - 1);
+  std::vector<FanoutEdge> f_edges(ins.size());
+  for (int s = 0; s < (int)sws.size(); ++s)
+    {
+      const Switch &sw = sws[s];
+      for (int k = sw.ins_begin; k < sw.ins_end; ++k)
+        {
+          FanoutEdge &fe = f_edges[next[ins[k].net]++];
+          fe.out = sw.out;
+          fe.sw = s;
+          fe.val = ins[k].val;
+        }
+    }
+  
+  switches.assign(std::move(sws));
+  switch_ins.assign(std::move(ins));
+  switch_cbits.assign(std::move(cbits));
+  fanout_offset.assign(std::move(f_offset));
+  fanout_edges.assign(std::move(f_edges));
+}
+
+int
+ChipDB::net_name_index(const std::string &name) const
+{
+  int lo = 0,
+    hi = net_name_offset.size();
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+      int c = strcmp(net_name(mid), name.c_str());
+      if (c == 0)
+        return mid;
+      if (c < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return -1;
+}
+
+int
+ChipDB::tile_net(int t, int name) const
+{
+  Range<TileNet> r = tile_nets(t);
+  const TileNet *i = std::lower_bound(r.begin(), r.end(), name,
+                                      [](const TileNet &tn, int k) {
+                                        return tn.name < k;
+                                      });
+  if (i == r.end()
+      || i->name != name)
+    return -1;
+  return i->net;
+}
+
+int
+ChipDB::tile_net(int t, const std::string &name) const
+{
+  int ni = net_name_index(name);
+  if (ni < 0)
+    return -1;
+  return tile_net(t, ni);
+}
+
+// Binary chipdb.  A fixed header locates an ibstream-encoded block
+// holding the small tables, followed by the flat routing tables, each
+// 8-byte aligned so a mapped chipdb can be used in place.  Binary
+// chipdbs written before the flat format start with the version
+// string instead and are still read by bread().
+
+static const char flat_chipdb_magic[16] = "\0arachne-chipdb";
+static const uint32_t flat_chipdb_format = 4;
+
+enum FlatSection : int {
+  NET_NAME_CHARS, NET_NAME_OFFSET,
+  TILE_NET_OFFSET, TILE_NET_ENTRIES,
+  NET_CLASS, NET_BBOX,
+  SWITCHES, SWITCH_INS, SWITCH_CBITS,
+  FANOUT_OFFSET, FANOUT_EDGES,
+  N_FLAT_SECTIONS
+};
+
+class FlatChipDBHeader
+{
+public:
+  char magic[16];
+  uint32_t format;
+  uint32_t n_sections;
+  uint64_t header_offset;
+  uint64_t header_size;
+  // offset in bytes, size in elements
+  uint64_t section_offset[N_FLAT_SECTIONS];
+  uint64_t section_size[N_FLAT_SECTIONS];
+};
+
+class MemoryBuf : public std::streambuf
+{
+public:
+  MemoryBuf(const char *b, const char *e)
+  {
+    setg(const_cast<char *>(b), const_cast<char *>(b), const_cast<char *>(e));
+  }
+};
+
+static void
+check_chipdb_version(const std::string &dbversion)
+{
+  if (dbversion != version_str)
+    {
+      fatal(fmt("chipdb and arachne-pnr versions do not match (chipdb: "
+                << dbversion 
+                << ", arachne-pnr: "
+                << version_str << ")"));
+    }
+}
+
+template<typename T> static void
+add_section(FlatChipDBHeader &h, uint64_t &pos, int i, const FlatArray<T> &a)
+{
+  pos = (pos + 7) & ~(uint64_t)7;
+  h.section_offset[i] = pos;
+  h.section_size[i] = a.size();
+  pos += a.size() * sizeof(T);
+}
+
+template<typename T> static void
+write_section(obstream &obs, uint64_t &pos, const FlatChipDBHeader &h, int i, const FlatArray<T> &a)
+{
+  static const char zeros[8] = {0};
+  assert(h.section_offset[i] >= pos
+         && h.section_offset[i] - pos < 8);
+  obs.write(zeros, h.section_offset[i] - pos);
+  obs.write(reinterpret_cast<const char *>(a.data()), a.size() * sizeof(T));
+  pos = h.section_offset[i] + a.size() * sizeof(T);
+}
+
+template<typename T> static void
+map_section(const MappedFile &mf, const FlatChipDBHeader &h, int i, FlatArray<T> &a)
+{
+  uint64_t offset = h.section_offset[i],
+    n = h.section_size[i];
+  if (offset % 8 != 0
+      || offset > mf.size()
+      || n > (mf.size() - offset) / sizeof(T))
+    fatal("read_chipdb: corrupt binary chipdb");
+  a.refer(reinterpret_cast<const T *>(mf.data() + offset), n);
+}
 
-  obs << std::string(version_str)
-      << device
-      << width
-      << height
+void
+ChipDB::bwrite(obstream &obs) const
+{
+  std::ostringstream hs;
+  obstream hobs(hs);
+  hobs << std::string(version_str)
+       << device
+       << width
+       << height
     // n_tiles = width * height
-      << n_nets
+       << n_nets
     // n_global_nets = 8
-      << packages
-      << loc_pin_glb_num
-      << iolatch
-      << ieren
-      << extra_bits
-      << gbufin
-      << tile_colbuf_tile
-      << tile_type
+       << packages
+       << loc_pin_glb_num
+       << iolatch
+       << ieren
+       << extra_bits
+       << gbufin
+       << tile_colbuf_tile
+       << tile_type
     // net_tile_name
-      << net_names
-      << tile_nets_idx // tile_nets
-      << tile_nonrouting_cbits
-      << n_cells
-      << cell_type
-      << cell_location
-      << cell_mfvs
-      << cell_locked_pkgs
-      << cell_type_cells
+       << tile_nonrouting_cbits
+       << n_cells
+       << cell_type
+       << cell_location
+       << cell_mfvs
+       << cell_locked_pkgs
+       << cell_type_cells
     // bank_cells
-      << switches
-    // in_switches, out_switches
-      << tile_cbits_block_size;
+       << tile_cbits_block_size;
+  std::string header = hs.str();
+  
+  FlatChipDBHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, flat_chipdb_magic, sizeof(h.magic));
+  h.format = flat_chipdb_format;
+  h.n_sections = N_FLAT_SECTIONS;
+  h.header_offset = sizeof(h);
+  h.header_size = header.size();
+  
+  uint64_t pos = h.header_offset + h.header_size;
+  add_section(h, pos, NET_NAME_CHARS, net_name_chars);
+  add_section(h, pos, NET_NAME_OFFSET, net_name_offset);
+  add_section(h, pos, TILE_NET_OFFSET, tile_net_offset);
+  add_section(h, pos, TILE_NET_ENTRIES, tile_net_entries);
+  add_section(h, pos, NET_CLASS, net_class);
+  add_section(h, pos, NET_BBOX, net_bbox);
+  add_section(h, pos, SWITCHES, switches);
+  add_section(h, pos, SWITCH_INS, switch_ins);
+  add_section(h, pos, SWITCH_CBITS, switch_cbits);
+  add_section(h, pos, FANOUT_OFFSET, fanout_offset);
+  add_section(h, pos, FANOUT_EDGES, fanout_edges);
+  
+  obs.write(reinterpret_cast<const char *>(&h), sizeof(h));
+  obs.write(header.data(), header.size());
+  
+  pos = h.header_offset + h.header_size;
+  write_section(obs, pos, h, NET_NAME_CHARS, net_name_chars);
+  write_section(obs, pos, h, NET_NAME_OFFSET, net_name_offset);
+  write_section(obs, pos, h, TILE_NET_OFFSET, tile_net_offset);
+  write_section(obs, pos, h, TILE_NET_ENTRIES, tile_net_entries);
+  write_section(obs, pos, h, NET_CLASS, net_class);
+  write_section(obs, pos, h, NET_BBOX, net_bbox);
+  write_section(obs, pos, h, SWITCHES, switches);
+  write_section(obs, pos, h, SWITCH_INS, switch_ins);
+  write_section(obs, pos, h, SWITCH_CBITS, switch_cbits);
+  write_section(obs, pos, h, FANOUT_OFFSET, fanout_offset);
+  write_section(obs, pos, h, FANOUT_EDGES, fanout_edges);
+}
+
+void
+ChipDB::bmap(std::unique_ptr<MappedFile> mf)
+{
+  FlatChipDBHeader h;
+  if (mf->size() < sizeof(h))
+    fatal("read_chipdb: corrupt binary chipdb");
+  memcpy(&h, mf->data(), sizeof(h));
+  assert(!memcmp(h.magic, flat_chipdb_magic, sizeof(h.magic)));
+  if (h.format != flat_chipdb_format
+      || h.n_sections != N_FLAT_SECTIONS)
+    fatal(fmt("read_chipdb: unsupported binary chipdb format " << h.format));
+  if (h.header_offset > mf->size()
+      || h.header_size > mf->size() - h.header_offset)
+    fatal("read_chipdb: corrupt binary chipdb");
+  
+  const char *hp = mf->data() + h.header_offset;
+  MemoryBuf buf(hp, hp + h.header_size);
+  std::istream is(&buf);
+  ibstream ibs(is);
+  
+  std::string dbversion;
+  ibs >> dbversion;
+  check_chipdb_version(dbversion);
+  ibs >> device
+      >> width
+      >> height
+    // n_tiles = width * height
+      >> n_nets
+    // n_global_nets = 8
+      >> packages
+      >> loc_pin_glb_num
+      >> iolatch
+      >> ieren
+      >> extra_bits
+      >> gbufin
+      >> tile_colbuf_tile
+      >> tile_type
+    // net_tile_name
+      >> tile_nonrouting_cbits
+      >> n_cells
+      >> cell_type
+      >> cell_location
+      >> cell_mfvs
+      >> cell_locked_pkgs
+      >> cell_type_cells
+    // bank_cells
+      >> tile_cbits_block_size;
+  
+  n_tiles = width * height;
+  
+  map_section(*mf, h, NET_NAME_CHARS, net_name_chars);
+  map_section(*mf, h, NET_NAME_OFFSET, net_name_offset);
+  map_section(*mf, h, TILE_NET_OFFSET, tile_net_offset);
+  map_section(*mf, h, TILE_NET_ENTRIES, tile_net_entries);
+  map_section(*mf, h, NET_CLASS, net_class);
+  map_section(*mf, h, NET_BBOX, net_bbox);
+  map_section(*mf, h, SWITCHES, switches);
+  map_section(*mf, h, SWITCH_INS, switch_ins);
+  map_section(*mf, h, SWITCH_CBITS, switch_cbits);
+  map_section(*mf, h, FANOUT_OFFSET, fanout_offset);
+  map_section(*mf, h, FANOUT_EDGES, fanout_edges);
+  if ((int)tile_net_offset.size() != n_tiles + 1
+      || (int)net_class.size() != n_nets
+      || (int)net_bbox.size() != n_nets
+      || (int)fanout_offset.size() != n_nets + 1)
+    fatal("read_chipdb: corrupt binary chipdb");
+  mapped = std::move(mf);
+  
+  finalize();
 }
 
 void
@@ -1038,15 +1568,10 @@ ChipDB::bread(ibstream &ibs)
 {
   std::vector<std::string> net_names;
   std::vector<std::map<int, int>> tile_nets_idx;
+  std::vector<SwitchSpec> switches_;
   std::string dbversion;
   ibs >> dbversion;
-  if(dbversion != version_str)
-   {
-     fatal(fmt("chipdb and arachne-pnr versions do not match (chipdb: "
-              << dbversion 
-              << ", arachne-pnr: "
-              << version_str << ")"));
-   }
+  check_chipdb_version(dbversion);
   ibs >> device
       >> width
       >> height
@@ -1072,25 +1597,26 @@ ChipDB::bread(ibstream &ibs)
       >> cell_locked_pkgs
       >> cell_type_cells
     // bank_cells
-      >> switches
+      >> switches_
     // in_switches, out_switches
       >> tile_cbits_block_size;
   
   n_tiles = width * height;
   
   tile_nets_idx.resize(n_tiles);
-  tile_nets.resize(n_tiles);
+  std::vector<std::map<std::string, int>> tile_nets_(n_tiles);
   for (int i = 0; i < n_tiles; ++i)
     {
       for (const auto &p : tile_nets_idx[i])
-        extend(tile_nets[i], net_names[p.first], p.second);
+        extend(tile_nets_[i], net_names[p.first], p.second);
     }
   
+  set_routing(tile_nets_, switches_);
   finalize();
 }
 
 ChipDB *
-read_chipdb(const std::string &filename)
+read_chipdb(const std::string &filename, int n_threads)
 {
   std::string expanded = expand_filename(filename);
   std::ifstream ifs(expanded, std::ifstream::in | std::ifstream::binary);
@@ -1101,13 +1627,27 @@ read_chipdb(const std::string &filename)
   if (is_suffix(expanded, ".bin"))
     {
       chipdb = new ChipDB;
-      ibstream ibs(ifs);
-      chipdb->bread(ibs);
+      
+      char magic[sizeof(flat_chipdb_magic)];
+      ifs.read(magic, sizeof(magic));
+      if (ifs.gcount() == sizeof(magic)
+          && !memcmp(magic, flat_chipdb_magic, sizeof(magic)))
+        {
+          ifs.close();
+          chipdb->bmap(std::unique_ptr<MappedFile>(new MappedFile(expanded)));
+        }
+      else
+        {
+          ifs.clear();
+          ifs.seekg(0);
+          ibstream ibs(ifs);
+          chipdb->bread(ibs);
+        }
     }
   else
     {
       ChipDBParser parser(filename, ifs);
-      chipdb = parser.parse();
+      chipdb = parser.parse(n_threads);
     }
   return chipdb;
 }
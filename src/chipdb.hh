@@ -20,12 +20,14 @@
 #include "hashmap.hh"
 #include "bstream.hh"
 #include "vector.hh"
+#include "flatarray.hh"
 
 #include <ostream>
 #include <string>
 #include <vector>
 #include <map>
 #include <set>
+#include <memory>
 #include <cassert>
 
 class CBit
@@ -99,11 +101,12 @@ public:
   std::set<CBit> cbits() const;
 };
 
-class Switch
+// Switch as read from the text chipdb (and old binary chipdbs).
+// ChipDB::set_routing packs these into the flat tables below.
+class SwitchSpec
 {
 public:
-  friend obstream &operator<<(obstream &obs, const Switch &sw);
-  friend ibstream &operator>>(ibstream &ibs, Switch &sw);
+  friend ibstream &operator>>(ibstream &ibs, SwitchSpec &sw);
   
   bool bidir; // routing
   int tile;
@@ -112,12 +115,12 @@ public:
   std::vector<CBit> cbits;
   
 public:
-  Switch() {}
-  Switch(bool bi,
-         int t,
-         int o,
-         const std::map<int, unsigned> &iv,
-         const std::vector<CBit> &cb)
+  SwitchSpec() {}
+  SwitchSpec(bool bi,
+             int t,
+             int o,
+             const std::map<int, unsigned> &iv,
+             const std::vector<CBit> &cb)
     : bidir(bi),
       tile(t),
       out(o),
@@ -126,8 +129,61 @@ public:
   {}
 };
 
-obstream &operator<<(obstream &obs, const Switch &sw);
-ibstream &operator>>(ibstream &ibs, Switch &sw);
+ibstream &operator>>(ibstream &ibs, SwitchSpec &sw);
+
+// Records of the flat routing tables.  Every field is 32 bits wide so
+// the binary chipdb written on the build host can be mapped as is by
+// a cross-compiled arachne-pnr.
+class TileNet
+{
+public:
+  int name;  // index into the net name table
+  int net;
+};
+
+class SwitchIn
+{
+public:
+  int net;
+  unsigned val;
+};
+
+class FanoutEdge
+{
+public:
+  int out;
+  int sw;
+  unsigned val;
+};
+
+// bounding box of the tiles a net appears in
+class NetBBox
+{
+public:
+  int xmin;
+  int xmax;
+  int ymin;
+  int ymax;
+};
+
+class Switch
+{
+public:
+  int bidir; // routing
+  int tile;
+  int out;
+  // [cbits_begin, cbits_end) in switch_cbits
+  int cbits_begin;
+  int cbits_end;
+  // [ins_begin, ins_end) in switch_ins, sorted by net
+  int ins_begin;
+  int ins_end;
+};
+
+// wire class, from the net's tile names
+enum class NetClass : int {
+  OTHER, LOCAL, GLOBAL, SPAN4, SPAN12
+};
 
 enum class TileType : int {
   EMPTY, IO, LOGIC, RAMB, RAMT, DSP0, DSP1, DSP2, DSP3, IPCON
@@ -241,7 +297,18 @@ public:
   
   std::vector<TileType> tile_type;
   std::vector<std::pair<int, std::string>> net_tile_name;
-  std::vector<std::map<std::string, int>> tile_nets;
+  
+  // interned tile net names, NUL-terminated, in sorted order
+  FlatArray<char> net_name_chars;
+  FlatArray<int> net_name_offset;
+  
+  // tile_nets(t) sorted by name
+  FlatArray<int> tile_net_offset;
+  FlatArray<TileNet> tile_net_entries;
+  
+  // per net, computed by set_routing
+  FlatArray<NetClass> net_class;
+  FlatArray<NetBBox> net_bbox;
   
   std::map<TileType,
           std::map<std::string, std::vector<CBit>>>
@@ -269,16 +336,53 @@ public:
   std::vector<std::vector<int>> bank_cells;
   
   // buffers and routing
-  std::vector<Switch> switches;
+  FlatArray<Switch> switches;
+  FlatArray<SwitchIn> switch_ins;
+  FlatArray<CBit> switch_cbits;
+  
+  // routing graph: the edges out of net n are
+  // fanout_edges[fanout_offset[n] .. fanout_offset[n+1]), one per
+  // switch n is an input of, in switch order
+  FlatArray<int> fanout_offset;
+  FlatArray<FanoutEdge> fanout_edges;
   
-  std::vector<std::set<int>> out_switches;
-  std::vector<std::set<int>> in_switches;
+  std::unique_ptr<MappedFile> mapped;
   
   std::map<TileType, std::pair<int, int>> tile_cbits_block_size;
   
   int add_cell(CellType type, const Location &loc);
   bool is_global_net(int i) const { return i < n_global_nets; }
-  int find_switch(int in, int out) const;
+  
+  const char *net_name(int i) const
+  {
+    return &net_name_chars[net_name_offset[i]];
+  }
+  Range<TileNet> tile_nets(int t) const
+  {
+    return tile_net_entries.range(tile_net_offset[t], tile_net_offset[t + 1]);
+  }
+  // index of name in the net name table, or -1
+  int net_name_index(const std::string &name) const;
+  // -1 if tile t has no net called name, given as an index into the
+  // net name table or as a string
+  int tile_net(int t, int name) const;
+  int tile_net(int t, const std::string &name) const;
+  
+  Range<CBit> switch_cbits_of(int s) const
+  {
+    const Switch &sw = switches[s];
+    return switch_cbits.range(sw.cbits_begin, sw.cbits_end);
+  }
+  Range<SwitchIn> switch_ins_of(int s) const
+  {
+    const Switch &sw = switches[s];
+    return switch_ins.range(sw.ins_begin, sw.ins_end);
+  }
+  
+  Range<FanoutEdge> fanout(int n) const
+  {
+    return fanout_edges.range(fanout_offset[n], fanout_offset[n + 1]);
+  }
   
   int tile(int x, int y) const
   {
@@ -313,6 +417,8 @@ public:
   }
   
   void set_device(const std::string &d, int w, int h, int n_nets_);
+  void set_routing(const std::vector<std::map<std::string, int>> &tile_nets_,
+                   const std::vector<SwitchSpec> &switches_);
   void finalize();
   
 public:
@@ -321,8 +427,10 @@ public:
   void dump(std::ostream &s) const;
   void bwrite(obstream &obs) const;
   void bread(ibstream &ibs);
+  void bmap(std::unique_ptr<MappedFile> mf);
 };
 
-ChipDB *read_chipdb(const std::string &filename);
+// text chipdbs are parsed with n_threads threads
+ChipDB *read_chipdb(const std::string &filename, int n_threads = 1);
 
 #endif
@@ -14,6 +14,7 @@
    along with this program. If not, see <http://www.gnu.org/licenses/>. */
 
 #include "configuration.hh"
+#include "checkpoint.hh"
 #include "chipdb.hh"
 #include "util.hh"
 #include "netlist.hh"
@@ -21,33 +22,95 @@
 #include <cassert>
 #include <iostream>
 
-Configuration::Configuration()
+Configuration::Configuration(const ChipDB *chipdb)
+  : tile_offset(chipdb->n_tiles),
+    tile_width(chipdb->n_tiles, 0),
+    tile_height(chipdb->n_tiles, 0)
 {
+  int n = 0;
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    {
+      tile_offset[t] = n;
+      
+      TileType ty = chipdb->tile_type[t];
+      if (ty == TileType::EMPTY)
+        continue;
+      
+      std::tie(tile_width[t], tile_height[t])
+        = chipdb->tile_cbits_block_size.at(ty);
+      n += tile_width[t] * tile_height[t];
+    }
+  
+  cbits.resize(n);
+  cbits_set.resize(n);
+}
+
+void
+Configuration::bwrite(obstream &obs) const
+{
+  bwrite_bits(obs, cbits);
+  bwrite_bits(obs, cbits_set);
+  obs << extra_cbits;
+}
+
+void
+Configuration::bread(ibstream &ibs)
+{
+  BitVector cbits2, cbits_set2;
+  bread_bits(ibs, cbits2);
+  bread_bits(ibs, cbits_set2);
+  if (cbits2.size() != cbits.size()
+      || cbits_set2.size() != cbits_set.size())
+    fatal("read_checkpoint: configuration does not match chipdb");
+  cbits = cbits2;
+  cbits_set = cbits_set2;
+  ibs >> extra_cbits;
 }
 
 void
 Configuration::set_cbit(const CBit &value_cbit, bool value)
 {
-  assert(!contains_key(cbits, value_cbit)
-         || cbits.at(value_cbit) == value);
+  int i = cbit_index(value_cbit);
+  assert(!cbits_set[i]
+         || cbits[i] == value);
   // *logs << value_cbit << " = " << value << "\n";
-  cbits[value_cbit] = value;
+  cbits_set[i] = true;
+  cbits[i] = value;
 }
 
 void
-Configuration::set_cbits(const std::vector<CBit> &value_cbits,
+Configuration::set_cbits(Range<CBit> value_cbits,
                          unsigned value)
 {
   for (unsigned i = 0; i < value_cbits.size(); ++i)
     set_cbit(value_cbits[i], (bool)(value & (1 << i)));
 }
 
+unsigned
+Configuration::get_cbits(Range<CBit> value_cbits) const
+{
+  unsigned value = 0;
+  for (unsigned i = 0; i < value_cbits.size(); ++i)
+    if (get_cbit(value_cbits[i]))
+      value |= (1 << i);
+  return value;
+}
+
 void
 Configuration::set_extra_cbit(const std::tuple<int, int, int> &t)
 {
   extend(extra_cbits, t);
 }
 
+// INIT_0 .. INIT_F of a RAM, 256 bits each
+static BitVector
+ram_init(Instance *inst, int i)
+{
+  BitVector init_i = inst->get_param(fmt("INIT_" << hexdigit(i, 'A'))).as_bits();
+  init_i.resize(256);
+  return init_i;
+}
+
 void
 Configuration::write_txt(std::ostream &s,
                          const ChipDB *chipdb,
@@ -68,25 +131,16 @@ Configuration::write_txt(std::ostream &s,
         y = chipdb->tile_y(t);
       s << "." << tile_type_name(ty) << " " << x << " " << y << "\n";
       
-      int bw, bh;
-      std::tie(bw, bh) = chipdb->tile_cbits_block_size.at(ty);
+      int bw = tile_width[t],
+        bh = tile_height[t];
       
+      std::string line(bw + 1, '\n');
+      int i = tile_offset[t];
       for (int r = 0; r < bh; r ++)
         {
           for (int c = 0; c < bw; c ++)
-            {
-              auto i = cbits.find(CBit(t, r, c));
-              if (i != cbits.end())
-                {
-                  if (i->second)
-                    s << "1";
-                  else
-                    s << "0";
-                }
-              else
-                s << "0";
-            }
-          s << "\n";
+            line[c] = cbits[i++] ? '1' : '0';
+          s << line;
         }
     }
   
@@ -114,8 +168,7 @@ Configuration::write_txt(std::ostream &s,
           s << ".ram_data " << x << " " << (y-1) << "\n";
           for (int i = 0; i < 16; ++i)
             {
-              BitVector init_i = p.first->get_param(fmt("INIT_" << hexdigit(i, 'A'))).as_bits();
-              init_i.resize(256);
+              BitVector init_i = ram_init(p.first, i);
               for (int j = 63; j >= 0; --j)
                 {
                   int v = (((int)init_i[j*4 + 3] << 3)
@@ -136,3 +189,258 @@ Configuration::write_txt(std::ostream &s,
         s << ".sym " << i << " " << n->name() << "\n";
     }
 }
+
+// The packed bitstream, as icepack writes it.  The configuration RAM
+// is four banks, one per quadrant of the chip, and a tile's bits are
+// placed by their distance from the edge of the chip, so the right
+// and top halves are mirrored.  The bitstream is a sequence of
+// commands, each an opcode nibble and an argument length nibble
+// followed by the big-endian argument, and is checked with a
+// CRC-16-CCITT.
+
+class BitstreamWriter
+{
+  std::ostream &s;
+  
+public:
+  uint16_t crc;
+  
+  BitstreamWriter(std::ostream &s_) : s(s_), crc(0) {}
+  
+  void write_byte(uint8_t b)
+  {
+    s.put((char)b);
+    for (int i = 7; i >= 0; --i)
+      {
+        bool x = ((crc >> 15) ^ (b >> i)) & 1;
+        crc = (crc << 1) ^ (x ? 0x1021 : 0);
+      }
+  }
+  
+  void command(int op, unsigned arg, int n_bytes)
+  {
+    write_byte((op << 4) | n_bytes);
+    for (int i = n_bytes - 1; i >= 0; --i)
+      write_byte(arg >> (8 * i));
+  }
+  
+  // bits [b, e) of bv, msb first
+  void write_bits(const BitVector &bv, int b, int e)
+  {
+    assert((e - b) % 8 == 0);
+    for (int i = b; i < e; i += 8)
+      {
+        uint8_t x = 0;
+        for (int j = 0; j < 8; ++j)
+          x = (x << 1) | (bv[i + j] ? 1 : 0);
+        write_byte(x);
+      }
+  }
+};
+
+static const int io_top_bottom_permx[18] = {
+  23, 25, 26, 27, 16, 17, 18, 19, 20, 14, 32, 33, 34, 35, 36, 37, 4, 5,
+};
+static const int io_top_bottom_permy[16] = {
+  0, 1, 3, 2, 4, 5, 7, 6, 8, 9, 11, 10, 12, 13, 15, 14,
+};
+
+// rows of BRAM written per data command
+static const int bram_chunk = 128;
+
+void
+Configuration::write_bin(std::ostream &s,
+                         const ChipDB *chipdb,
+                         Design *d,
+                         const std::map<Instance *, int, IdLess> &placement) const
+{
+  // the 5k and lm4k banks aren't laid out like the quadrants below
+  if (chipdb->device != "384"
+      && chipdb->device != "1k"
+      && chipdb->device != "8k")
+    fatal(fmt("write_bin: device " << chipdb->device
+              << " not supported, write text and use icepack"));
+  
+  int chip_width = chipdb->width - 2,
+    chip_height = chipdb->height - 2;
+  
+  // cbits block width of each column, and of the edge IO columns
+  int io_width = chipdb->tile_cbits_block_size.at(TileType::IO).first;
+  std::vector<int> col_width(chipdb->width, io_width);
+  for (int x = 1; x <= chip_width; ++x)
+    {
+      TileType ty = chipdb->tile_type[chipdb->tile(x, 1)];
+      col_width[x] = chipdb->tile_cbits_block_size.at(ty).first;
+    }
+  
+  // bank_xoff[x] is the offset of column x from the edge of its half
+  std::vector<int> bank_xoff(chipdb->width);
+  int left = 0,
+    right = 0;
+  for (int i = 0; i <= chip_width / 2; ++i)
+    {
+      bank_xoff[i] = left;
+      left += col_width[i];
+      bank_xoff[chip_width + 1 - i] = right;
+      right += col_width[chip_width + 1 - i];
+    }
+  assert(left == right);
+  int cram_width = left + 2,
+    cram_height = 16 * (chip_height / 2 + 1);
+  
+  std::vector<BitVector> cram(4, BitVector(cram_width * cram_height));
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    {
+      TileType ty = chipdb->tile_type[t];
+      if (ty == TileType::EMPTY)
+        continue;
+      
+      int x = chipdb->tile_x(t),
+        y = chipdb->tile_y(t);
+      bool right_half = x > chip_width / 2,
+        top_half = y > chip_height / 2,
+        left_right_io = x == 0 || x == chip_width + 1;
+      int bank = (right_half ? 2 : 0) | (top_half ? 1 : 0),
+        ty_off = top_half ? chip_height + 1 - y : y,
+        xoff = bank_xoff[x],
+        yoff = 16 * ty_off,
+        cw = col_width[x];
+      
+      int i = tile_offset[t];
+      for (int r = 0; r < tile_height[t]; ++r)
+        for (int c = 0; c < tile_width[t]; ++c, ++i)
+          {
+            if (!cbits[i])
+              continue;
+            
+            int cram_x, cram_y;
+            if (ty == TileType::IO
+                && !left_right_io)
+              {
+                cram_x = (right_half
+                          ? xoff + cw - 1 - io_top_bottom_permx[c]
+                          : xoff + io_top_bottom_permx[c]);
+                cram_y = yoff + 15 - io_top_bottom_permy[r];
+              }
+            else
+              {
+                cram_x = (right_half || left_right_io
+                          ? xoff + cw - 1 - c
+                          : xoff + c);
+                cram_y = top_half ? yoff + 15 - r : yoff + r;
+              }
+            cram[bank][cram_y * cram_width + cram_x] = true;
+          }
+    }
+  
+  for (const auto &t : extra_cbits)
+    {
+      int bank = std::get<0>(t),
+        cram_x = std::get<1>(t),
+        cram_y = std::get<2>(t);
+      cram[bank][cram_y * cram_width + cram_x] = true;
+    }
+  
+  // BRAM: 16 columns per RAM, four banks again by quadrant
+  bool has_ram = false;
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    if (chipdb->tile_type[t] == TileType::RAMB)
+      has_ram = true;
+  int bram_width = has_ram ? 16 * (chip_height / 4) : 0,
+    bram_height = 2 * bram_chunk;
+  
+  std::vector<BitVector> bram(4, BitVector(bram_width * bram_height));
+  Models models(d);
+  for (const auto &p : placement)
+    {
+      if (!models.is_ramX(p.first))
+        continue;
+      
+      const Location &loc = chipdb->cell_location[p.second];
+      int x = chipdb->tile_x(loc.tile()),
+        y = chipdb->tile_y(loc.tile()) - 1;
+      bool right_half = x > chip_width / 2,
+        top_half = y > chip_height / 2;
+      int bank = (right_half ? 2 : 0) | (top_half ? 1 : 0),
+        y_off = top_half ? y - chip_height / 2 - 1 : y - 1,
+        xoff = 16 * (y_off / 2);
+      
+      for (int i = 0; i < 16; ++i)
+        {
+          BitVector init_i = ram_init(p.first, i);
+          for (int j = 0; j < 256; ++j)
+            {
+              if (!init_i[j])
+                continue;
+              int k = 256 * i + 16 * (j / 16) + 15 - j % 16,
+                bram_x = xoff + k % 16,
+                bram_y = k / 16;
+              bram[bank][bram_y * bram_width + bram_x] = true;
+            }
+        }
+    }
+  
+  BitstreamWriter w(s);
+  
+  // comment, not part of the checked bitstream
+  s.put((char)0xff);
+  s.put(0);
+  s << version_str;
+  s.put(0);
+  s.put(0);
+  s.put((char)0xff);
+  
+  // sync
+  w.write_byte(0x7e);
+  w.write_byte(0xaa);
+  w.write_byte(0x99);
+  w.write_byte(0x7e);
+  
+  // low frequency range, reset CRC, warmboot enabled
+  w.command(5, 0x00, 1);
+  w.command(0, 0x05, 1);
+  w.crc = 0xffff;
+  w.command(9, 0x0020, 2);
+  
+  // bank width, height and offset
+  w.command(6, cram_width - 1, 2);
+  w.command(7, cram_height, 2);
+  w.command(8, 0, 2);
+  for (int bank = 0; bank < 4; ++bank)
+    {
+      w.command(1, bank, 1);
+      w.command(0, 0x01, 1);
+      w.write_bits(cram[bank], 0, cram_width * cram_height);
+      w.write_byte(0);
+      w.write_byte(0);
+    }
+  
+  if (bram_width)
+    {
+      w.command(6, bram_width - 1, 2);
+      w.command(7, bram_chunk, 2);
+      for (int bank = 0; bank < 4; ++bank)
+        {
+          w.command(1, bank, 1);
+          for (int offset = 0; offset < bram_height; offset += bram_chunk)
+            {
+              w.command(8, offset, 2);
+              w.command(0, 0x03, 1);
+              w.write_bits(bram[bank],
+                           offset * bram_width,
+                           (offset + bram_chunk) * bram_width);
+              w.write_byte(0);
+              w.write_byte(0);
+            }
+        }
+    }
+  
+  w.write_byte(0x22);
+  uint16_t crc = w.crc;
+  w.write_byte(crc >> 8);
+  w.write_byte(crc);
+  
+  // wake up, and a padding byte
+  w.command(0, 0x06, 1);
+  w.write_byte(0);
+}
@@ -17,6 +17,7 @@
 #define PNR_CONFIGURATION_HH
 
 #include "chipdb.hh"
+#include "bitvector.hh"
 #include <ostream>
 
 class Design;
@@ -27,22 +28,48 @@ class IdLess;
 class Configuration
 {
 private:
-  std::map<CBit, bool> cbits;
+  // bit tile_offset[t] + row * tile_width[t] + col is CBit(t, row, col)
+  std::vector<int> tile_offset;
+  std::vector<int> tile_width;
+  std::vector<int> tile_height;
+  BitVector cbits;
+  // cbits that have been set, to catch conflicting assignments
+  BitVector cbits_set;
   std::set<std::tuple<int, int, int>> extra_cbits;
   
+  int cbit_index(const CBit &cbit) const
+  {
+    assert(cbit.row >= 0 && cbit.row < tile_height[cbit.tile]
+           && cbit.col >= 0 && cbit.col < tile_width[cbit.tile]);
+    return tile_offset[cbit.tile] + cbit.row * tile_width[cbit.tile] + cbit.col;
+  }
+  
 public:
-  Configuration();
+  Configuration(const ChipDB *chipdb);
   
   void set_cbit(const CBit &cbit, bool value);
-  void set_cbits(const std::vector<CBit> &value_cbits,
+  void set_cbits(Range<CBit> value_cbits,
                  unsigned value);
   void set_extra_cbit(const std::tuple<int, int, int> &t);
   
+  bool get_cbit(const CBit &cbit) const { return cbits[cbit_index(cbit)]; }
+  unsigned get_cbits(Range<CBit> value_cbits) const;
+  
+  // for checkpoints; the tile layout comes from the chipdb
+  void bwrite(obstream &obs) const;
+  void bread(ibstream &ibs);
+  
   void write_txt(std::ostream &s,
                  const ChipDB *chipdb,
                  Design *d,
                  const std::map<Instance *, int, IdLess> &placement,
                  const std::vector<Net *> &cnet_net);
+  // the packed .bin bitstream, for 384, 1k and 8k devices; not yet
+  // checked byte for byte against icepack
+  void write_bin(std::ostream &s,
+                 const ChipDB *chipdb,
+                 Design *d,
+                 const std::map<Instance *, int, IdLess> &placement) const;
 };
 
 #endif
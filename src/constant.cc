@@ -41,18 +41,18 @@ realize_constants(const ChipDB *chipdb, Design *d)
   
   for (Instance *inst : top->instances())
     {
-      for (const auto &p : inst->ports())
+      for (Port *p : inst->ports())
         {
           if ((models.is_io(inst)
-               && p.second->name() == "PACKAGE_PIN")
+               && p->name() == "PACKAGE_PIN")
               || (models.is_lc(inst)
-                  && p.second->name() == "CIN"))
+                  && p->name() == "CIN"))
             continue;
           
-          Net *n = p.second->connection();
+          Net *n = p->connection();
           if (n
               && n->is_constant()
-              && n->constant() != p.second->undriven())
+              && n->constant() != p->undriven())
             {
               Value v = n->constant();
               
@@ -103,7 +103,7 @@ realize_constants(const ChipDB *chipdb, Design *d)
                   new_n = actual_const1;
                 }
               
-              p.second->connect(new_n);
+              p->connect(new_n);
               
               if (n->connections().empty())
                 {
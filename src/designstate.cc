@@ -20,7 +20,8 @@ DesignState::DesignState(const ChipDB *chipdb_, const Package &package_, Design
     package(package_),
     d(d_),
     models(d_),
-    top(d_->top())
+    top(d_->top()),
+    conf(chipdb_)
 {
 }
 
@@ -65,3 +66,17 @@ DesignState::pll_out_io_cells(Instance *inst, int cell) const
   
   return r;
 }
+
+void
+DesignState::index_netlist()
+{
+  m_netlist_index.reset(new NetlistIndex(d));
+}
+
+const NetlistIndex &
+DesignState::netlist_index()
+{
+  if (!m_netlist_index)
+    index_netlist();
+  return *m_netlist_index;
+}
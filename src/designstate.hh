@@ -17,11 +17,14 @@
 #define PNR_DESIGNSTATE_HH
 
 #include "netlist.hh"
+#include "netlistindex.hh"
 #include "chipdb.hh"
 #include "pcf.hh"
 #include "carry.hh"
 #include "configuration.hh"
 
+#include <memory>
+
 class DesignState
 {
 public:
@@ -38,11 +41,20 @@ public:
   std::vector<Net *> cnet_net;
   Configuration conf;
   
+private:
+  std::unique_ptr<NetlistIndex> m_netlist_index;
+  
 public:
   DesignState(const ChipDB *chipdb_, const Package &package_, Design *d_);
   
   bool is_dual_pll(Instance *inst) const;
   std::vector<int> pll_out_io_cells(Instance *inst, int cell) const;
+  
+  // Indexes the netlist once it is final, after realize_constants.
+  // netlist_index() builds the index if it has not been yet, for
+  // designs read from a checkpoint.
+  void index_netlist();
+  const NetlistIndex &netlist_index();
 };
 
 #endif
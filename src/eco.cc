@@ -0,0 +1,193 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "eco.hh"
+#include "checkpoint.hh"
+#include "designstate.hh"
+#include "util.hh"
+
+#include <cassert>
+
+Eco::Eco()
+  : ref_d(nullptr),
+    ref_ds(nullptr)
+{
+}
+
+Eco::~Eco()
+{
+  delete ref_ds;
+  delete ref_d;
+}
+
+bool
+Eco::routed() const
+{
+  return !ref_ds->cnet_net.empty();
+}
+
+const Configuration &
+Eco::ref_conf() const
+{
+  return ref_ds->conf;
+}
+
+const Net *
+Eco::ref_cnet_net(int cn) const
+{
+  return ref_ds->cnet_net[cn];
+}
+
+// Instances have no names, so an instance is identified by its model
+// and the nets it drives, whose names come from the input netlist, or
+// by all its nets if it drives nothing.  Returns "" for an instance
+// with no connections.
+static std::string
+instance_key(const Instance *inst)
+{
+  std::string key;
+  for (int outputs = 1; outputs >= 0 && key.empty(); --outputs)
+    for (const Port *port : inst->ports())
+      {
+        Net *n = port->connection();
+        if (!n
+            || (outputs
+                && !port->is_output()
+                && !port->is_bidir()))
+          continue;
+        key += ' ';
+        key += port->name();
+        key += '=';
+        key += n->name();
+      }
+  if (key.empty())
+    return key;
+  return inst->instance_of()->name() + key;
+}
+
+static bool
+same_const(const Const &a, const Const &b)
+{
+  if (a.is_bits() != b.is_bits())
+    return false;
+  if (!a.is_bits())
+    return a.as_string() == b.as_string();
+
+  const BitVector &abits = a.as_bits(),
+    &bbits = b.as_bits();
+  if (abits.size() != bbits.size())
+    return false;
+  for (int i = 0; i < (int)abits.size(); ++i)
+    if (abits[i] != bbits[i])
+      return false;
+  return true;
+}
+
+static bool
+same_params(const Instance *a, const Instance *b)
+{
+  const auto &ap = a->params(),
+    &bp = b->params();
+  if (ap.size() != bp.size())
+    return false;
+  for (auto i = ap.begin(), j = bp.begin(); i != ap.end(); ++i, ++j)
+    {
+      if (i->first != j->first
+          || !same_const(i->second, j->second))
+        return false;
+    }
+  return true;
+}
+
+static bool
+same_connections(const Instance *a, const Instance *b)
+{
+  const auto &aports = a->ports(),
+    &bports = b->ports();
+  if (aports.size() != bports.size())
+    return false;
+  for (auto i = aports.begin(), j = bports.begin(); i != aports.end(); ++i, ++j)
+    {
+      if ((*i)->name() != (*j)->name())
+        return false;
+      const Net *an = (*i)->connection(),
+        *bn = (*j)->connection();
+      if (!an != !bn)
+        return false;
+      if (an && an->name() != bn->name())
+        return false;
+    }
+  return true;
+}
+
+void
+read_eco(const std::string &filename, const DesignState &ds, Eco &eco)
+{
+  CheckpointReader reader(filename, ds.chipdb);
+  if (reader.stage() < CheckpointStage::PLACE)
+    fatal(fmt("read_eco: checkpoint `" << filename << "' is not placed"));
+
+  eco.ref_d = reader.read_design();
+  eco.ref_ds = new DesignState(ds.chipdb, ds.package, eco.ref_d);
+  reader.read_state(*eco.ref_ds);
+
+  // keys that occur more than once are ambiguous and not matched
+  std::map<std::string, Instance *> ref_key_inst;
+  for (const auto &p : eco.ref_ds->placement)
+    {
+      std::string key = instance_key(p.first);
+      if (key.empty())
+        continue;
+      auto i = ref_key_inst.insert(std::make_pair(key, p.first));
+      if (!i.second)
+        i.first->second = nullptr;
+    }
+
+  std::map<std::string, Instance *> key_inst;
+  for (Instance *inst : ds.top->instances())
+    {
+      std::string key = instance_key(inst);
+      if (key.empty())
+        continue;
+      auto i = key_inst.insert(std::make_pair(key, inst));
+      if (!i.second)
+        i.first->second = nullptr;
+    }
+
+  int n_changed = 0;
+  for (const auto &p : key_inst)
+    {
+      Instance *inst = p.second;
+      if (!inst)
+        continue;
+      auto i = ref_key_inst.find(p.first);
+      if (i == ref_key_inst.end()
+          || !i->second)
+        continue;
+      Instance *ref_inst = i->second;
+
+      extend(eco.cell, inst, eco.ref_ds->placement.at(ref_inst));
+      if (same_params(inst, ref_inst)
+          && same_connections(inst, ref_inst))
+        extend(eco.unchanged, inst);
+      else
+        ++n_changed;
+    }
+
+  int n_instances = ds.top->instances().size();
+  *logs << "  " << eco.unchanged.size() << " unchanged, "
+        << n_changed << " changed, "
+        << (n_instances - (int)eco.cell.size()) << " new instances\n";
+}
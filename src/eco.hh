@@ -0,0 +1,60 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_ECO_HH
+#define PNR_ECO_HH
+
+#include "netlist.hh"
+
+#include <map>
+#include <set>
+#include <string>
+
+class DesignState;
+class Configuration;
+
+// The previous placement and routing of a design, from a checkpoint,
+// matched against the current (edited) design.  Instances are matched
+// by model and the names of the nets they drive.
+class Eco
+{
+public:
+  // the reference design and its state
+  Design *ref_d;
+  DesignState *ref_ds;
+
+  // previous cell of each matched instance
+  std::map<Instance *, int, IdLess> cell;
+  // matched instances with the same parameters and connections as
+  // before; the placer leaves these where they were
+  std::set<Instance *, IdLess> unchanged;
+
+  Eco();
+  Eco(const Eco &) = delete;
+  Eco &operator=(const Eco &) = delete;
+  ~Eco();
+
+  // true if the reference was routed, so routes can be reused
+  bool routed() const;
+  const Configuration &ref_conf() const;
+  // the reference net on cnet, or nullptr; only port cnets are known
+  const Net *ref_cnet_net(int cn) const;
+};
+
+// Read the placed or routed checkpoint in filename and match its
+// instances against those of ds.
+void read_eco(const std::string &filename, const DesignState &ds, Eco &eco);
+
+#endif
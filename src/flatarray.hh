@@ -0,0 +1,94 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_FLATARRAY_HH
+#define PNR_FLATARRAY_HH
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+template<typename T>
+class Range
+{
+  const T *b;
+  const T *e;
+
+public:
+  Range() : b(nullptr), e(nullptr) {}
+  Range(const T *b_, const T *e_) : b(b_), e(e_) {}
+  Range(const std::vector<T> &v) : b(v.data()), e(v.data() + v.size()) {}
+
+  const T *begin() const { return b; }
+  const T *end() const { return e; }
+  bool empty() const { return b == e; }
+  size_t size() const { return e - b; }
+
+  const T &operator[](size_t i) const
+  {
+    assert(i < size());
+    return b[i];
+  }
+};
+
+// Read-only array that either owns its elements or refers to memory
+// owned by someone else (e.g., a mapped binary chipdb).
+template<typename T>
+class FlatArray
+{
+  std::vector<T> storage;
+  const T *p;
+  size_t n;
+
+public:
+  FlatArray() : p(nullptr), n(0) {}
+  FlatArray(const FlatArray &) = delete;
+  FlatArray &operator=(const FlatArray &) = delete;
+
+  void assign(std::vector<T> &&v)
+  {
+    storage = std::move(v);
+    p = storage.data();
+    n = storage.size();
+  }
+
+  void refer(const T *p_, size_t n_)
+  {
+    std::vector<T>().swap(storage);
+    p = p_;
+    n = n_;
+  }
+
+  const T *data() const { return p; }
+  bool empty() const { return n == 0; }
+  size_t size() const { return n; }
+
+  const T *begin() const { return p; }
+  const T *end() const { return p + n; }
+
+  const T &operator[](size_t i) const
+  {
+    assert(i < n);
+    return p[i];
+  }
+
+  Range<T> range(size_t b, size_t e) const
+  {
+    assert(b <= e && e <= n);
+    return Range<T>(p + b, p + e);
+  }
+};
+
+#endif
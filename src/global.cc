@@ -216,16 +216,11 @@ void
 Promoter::make_routable(Net *n, int gc)
 {
   Net *internal = nullptr;
-  for (auto i = n->connections().begin();
-       i != n->connections().end();)
-    {
-      Port *p = *i;
-      ++i;
-      
+  n->for_each_connection([&](Port *p) {
       if (!p->is_input())
-        continue;
+        return;
       if (routable(gc, p))
-        continue;
+        return;
       
       if (!internal)
         {
@@ -240,14 +235,14 @@ Promoter::make_routable(Net *n, int gc)
           pass_inst->find_port("O")->connect(internal);
         }
       p->connect(internal);
-    }
+    });
 }
 
 void
 Promoter::promote(bool do_promote)
 {
   std::vector<Net *> nets;
-  std::map<Net *, int, IdLess> net_idx;
+  HashMap<Net *, int> net_idx;
   std::tie(nets, net_idx) = top->index_nets();
   int n_nets = nets.size();
   
@@ -488,14 +483,10 @@ Promoter::promote(bool do_promote)
         
         int n_conn = 0;
         int n_conn_promoted = 0;
-        for (auto i = n->connections().begin();
-             i != n->connections().end();)
-          {
-            Port *conn = *i;
-            ++i;
+        n->for_each_connection([&](Port *conn) {
             if (conn->is_output()
                 || conn->is_bidir())
-              continue;
+              return;
             
             ++n_conn;
             int conn_gc = port_gc(conn, true);
@@ -504,7 +495,7 @@ Promoter::promote(bool do_promote)
                 ++n_conn_promoted;
                 conn->connect(t);
               }
-          }
+          });
         
         gb_inst->find_port("USER_SIGNAL_TO_GLOBAL_BUFFER")->connect(n);
         gb_inst->find_port("GLOBAL_BUFFER_OUTPUT")->connect(t);
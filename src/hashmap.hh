@@ -16,8 +16,12 @@
 #ifndef PNR_HASHMAP_HH
 #define PNR_HASHMAP_HH
 
+#include "hashtable.hh"
+
 #include <functional>
-#include <unordered_map>
+#include <initializer_list>
+#include <stdexcept>
+#include <tuple>
 
 template<typename Key,
          typename T,
@@ -25,120 +29,177 @@ template<typename Key,
          typename KeyEqual = std::equal_to<Key>>
 class HashMap
 {
-  using underlying_t = std::unordered_map<Key, T, Hash>;
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const Key, T>;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using pointer = value_type *;
+  using const_pointer = const value_type *;
+  
+private:
+  class KeyOf
+  {
+  public:
+    const Key &operator()(const value_type &v) const { return v.first; }
+  };
   
-  underlying_t m;
+  using table_t = HashTable<value_type, Key, KeyOf, Hash, KeyEqual>;
   
-public:
-  using key_type = typename underlying_t::key_type;
-  using mapped_type = typename underlying_t::mapped_type;
-  using value_type = typename underlying_t::value_type;
-  using size_type = typename underlying_t::size_type;
-  using difference_type = typename underlying_t::difference_type;
-  using hasher = typename underlying_t::hasher;
-  using key_equal = typename underlying_t::key_equal;
-  using allocator_type = typename underlying_t::allocator_type;
-  using reference = typename underlying_t::reference;
-  using const_reference = typename underlying_t::const_reference;
-  using pointer = typename underlying_t::pointer;
-  using const_pointer = typename underlying_t::const_pointer;
+  table_t m;
   
+public:
   class const_iterator
   {
     friend class HashMap;
-    typename underlying_t::const_iterator i;
+    // null for end
+    value_type *p;
+    size_type i;
+    
+    const_iterator(value_type *p_, size_type i_) : p(p_), i(i_) {}
     
 public:
-    const_iterator() {}
-    const_iterator(typename underlying_t::const_iterator i_) : i(i_) {}
+    const_iterator() : p(nullptr), i(0) {}
     
-    bool operator==(const const_iterator &that) { return i == that.i; }
-    bool operator!=(const const_iterator &that) { return i != that.i; }
+    bool operator==(const const_iterator &that) const { return p == that.p; }
+    bool operator!=(const const_iterator &that) const { return p != that.p; }
     
     // hash table: cannot modify keys
-    const value_type &operator*() { return *i; }
-    const value_type &operator*() const { return *i; }
-    const value_type *operator->() { return i.operator->(); }
-    const value_type *operator->() const { return i.operator->(); }
+    const value_type &operator*() const { return *p; }
+    const value_type *operator->() const { return p; }
     
     // not incrementable
   };
   
   using iterator = const_iterator;
   
+private:
+  const_iterator iter(size_type i) const
+  {
+    if (i == m.end_index())
+      return const_iterator();
+    return const_iterator(const_cast<value_type *>(&m.at_index(i)), i);
+  }
+  
 public:
   HashMap() {}
+  HashMap(std::initializer_list<value_type> ilist) { insert(ilist); }
   
-  iterator begin() { return iterator(m.begin()); }
-  const_iterator begin() const { return const_iterator(m.begin()); }
-  const_iterator cbegin() const { return const_iterator(m.cbegin()); }
+  const_iterator begin() const { return iter(m.begin_index()); }
+  const_iterator cbegin() const { return begin(); }
   
-  iterator end() { return iterator(m.end()); }
-  const_iterator end() const { return const_iterator(m.end()); }
-  const_iterator cend() const { return const_iterator(m.cend()); }
+  const_iterator end() const { return const_iterator(); }
+  const_iterator cend() const { return end(); }
   
   bool empty() const { return m.empty(); }
   
   size_type size() const { return m.size(); }
   size_type max_size() const { return m.max_size(); }
   
-  iterator erase(const_iterator pos) { return iterator(m.erase(pos.i)); }
-  // no first, last: can't iterate
+  void reserve(size_type count) { m.reserve(count); }
+  
+  // returns end(): can't iterate
+  iterator erase(const_iterator pos)
+  {
+    m.erase_index(pos.i);
+    return end();
+  }
   size_type erase(const key_type &key) { return m.erase(key); }
   
-  void clear() { return m.clear(); }
+  void clear() { m.clear(); }
   
-  std::pair<iterator,bool> insert(const value_type &value) 
+  std::pair<iterator,bool> insert(const value_type &value)
   {
-    const auto &p = m.insert(value);
-    return std::make_pair(iterator(p.first), p.second);
+    auto p = m.emplace(value.first, value);
+    return std::make_pair(iter(p.first), p.second);
   }
   template<typename P>
   std::pair<iterator,bool> insert(P &&value)
   {
-    const auto &p = m.insert(value);
-    return std::make_pair(iterator(p.first), p.second);
+    value_type v(std::forward<P>(value));
+    auto p = m.emplace(v.first, std::move(v));
+    return std::make_pair(iter(p.first), p.second);
   }
-  std::pair<iterator,bool> insert(value_type &&value) 
+  std::pair<iterator,bool> insert(value_type &&value)
   {
-    const auto &p = m.insert(value);
-    return std::make_pair(iterator(p.first), p.second);
+    auto p = m.emplace(value.first, std::move(value));
+    return std::make_pair(iter(p.first), p.second);
   }
-  iterator insert(const_iterator hint, const value_type &value)
+  iterator insert(const_iterator, const value_type &value)
   {
-    return iterator(m.insert(hint, value));
+    return insert(value).first;
   }
   template<typename P>
-  iterator insert(const_iterator hint, P &&value)
+  iterator insert(const_iterator, P &&value)
   {
-    return iterator(m.insert(hint, value));
+    return insert(std::forward<P>(value)).first;
   }
-  iterator insert(const_iterator hint, value_type &&value)
+  iterator insert(const_iterator, value_type &&value)
   {
-    return iterator(m.insert(hint, value));
+    return insert(std::move(value)).first;
   }
   template<class InputIt>
-  void insert(InputIt first, InputIt last) { m.insert(first, last); }
-  void insert(std::initializer_list<value_type> ilist) { return m.insert(ilist); }
-  
-  T &operator[](const Key &key) { return m[key]; }
-  T &operator[](Key &&key) { return m[key]; }
+  void insert(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+  void insert(std::initializer_list<value_type> ilist) { insert(ilist.begin(), ilist.end()); }
   
-  iterator find(const Key &key) { return iterator(m.find(key)); }
-  const_iterator find(const Key &key) const { return const_iterator(m.find(key)); }
+  T &operator[](const Key &key)
+  {
+    auto p = m.emplace(key, std::piecewise_construct,
+                       std::forward_as_tuple(key),
+                       std::forward_as_tuple());
+    return m.at_index(p.first).second;
+  }
+  T &operator[](Key &&key)
+  {
+    Key k(std::move(key));
+    return (*this)[k];
+  }
   
-  T &at(const Key &key) { return m.at(key); }
-  const T &at(const Key &key) const { return m.at(key); }
+  iterator find(const Key &key) const { return iter(m.find_index(key)); }
   
-  size_type count(const key_type &key) const { return m.key(); }
+  T &at(const Key &key)
+  {
+    size_type i = m.find_index(key);
+    if (i == m.end_index())
+      throw std::out_of_range("HashMap::at");
+    return m.at_index(i).second;
+  }
+  const T &at(const Key &key) const
+  {
+    size_type i = m.find_index(key);
+    if (i == m.end_index())
+      throw std::out_of_range("HashMap::at");
+    return m.at_index(i).second;
+  }
   
-  bool operator ==(const HashMap &hs) { return m == hs.m; }
-  bool operator !=(const HashMap &hs) { return m != hs.m; }
+  size_type count(const key_type &key) const { return m.find_index(key) != m.end_index(); }
   
-  underlying_t &underlying() { return m; }
-  const underlying_t &underlying() const { return m; }
+  bool operator==(const HashMap &that) const
+  {
+    if (size() != that.size())
+      return false;
+    for (size_type i = 0; i < m.end_index(); ++i)
+      {
+        if (!m.occupied(i))
+          continue;
+        const value_type &v = m.at_index(i);
+        size_type j = that.m.find_index(v.first);
+        if (j == that.m.end_index()
+            || !(that.m.at_index(j).second == v.second))
+          return false;
+      }
+    return true;
+  }
+  bool operator!=(const HashMap &that) const { return !(*this == that); }
 };
 
-
-
 #endif
@@ -16,107 +16,139 @@
 #ifndef PNR_HASHSET_HH
 #define PNR_HASHSET_HH
 
-#include <functional>
-#include <unordered_set>
+#include "hashtable.hh"
 
-template<typename T> struct Hash;
+#include <functional>
+#include <initializer_list>
 
 template<typename T,
          typename Hash = std::hash<T>,
          typename KeyEqual = std::equal_to<T>>
 class HashSet
 {
-  using underlying_t = std::unordered_set<T, Hash>;
+public:
+  using key_type = T;
+  using value_type = T;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using pointer = value_type *;
+  using const_pointer = const value_type *;
+  
+private:
+  class KeyOf
+  {
+  public:
+    const T &operator()(const T &v) const { return v; }
+  };
   
-  underlying_t s;
+  using table_t = HashTable<T, T, KeyOf, Hash, KeyEqual>;
   
-public:
-  using key_type = typename underlying_t::key_type;
-  using value_type = typename underlying_t::value_type;
-  using size_type = typename underlying_t::size_type;
-  using difference_type = typename underlying_t::difference_type;
-  using hasher = typename underlying_t::hasher;
-  using key_equal = typename underlying_t::key_equal;
-  using allocator_type = typename underlying_t::allocator_type;
-  using reference = typename underlying_t::reference;
-  using const_reference = typename underlying_t::const_reference;
-  using pointer = typename underlying_t::pointer;
-  using const_pointer = typename underlying_t::const_pointer;
+  table_t s;
   
+public:
   class const_iterator
   {
     friend class HashSet;
-    typename underlying_t::const_iterator i;
+    // null for end
+    const T *p;
+    size_type i;
+    
+    const_iterator(const T *p_, size_type i_) : p(p_), i(i_) {}
     
 public:
-    const_iterator() {}
-    const_iterator(typename underlying_t::const_iterator i_) : i(i_) {}
+    const_iterator() : p(nullptr), i(0) {}
     
-    bool operator==(const const_iterator &that) { return i == that.i; }
-    bool operator!=(const const_iterator &that) { return i != that.i; }
+    bool operator==(const const_iterator &that) const { return p == that.p; }
+    bool operator!=(const const_iterator &that) const { return p != that.p; }
     
-    // hash table: cannot modify keys
-    const value_type &operator*() { return *i; }
-    const value_type &operator*() const { return *i; }
-    const value_type *operator->() { return operator->(i); }
-    const value_type *operator->() const { return operator->(i); }
+    const T &operator*() const { return *p; }
+    const T *operator->() const { return p; }
     
     // not incrementable
   };
   
   using iterator = const_iterator;
   
+private:
+  const_iterator iter(size_type i) const
+  {
+    if (i == s.end_index())
+      return const_iterator();
+    return const_iterator(&s.at_index(i), i);
+  }
+  
 public:
   HashSet() {}
+  HashSet(std::initializer_list<value_type> ilist) { insert(ilist); }
   
-  iterator begin() { return iterator(s.begin()); }
-  const_iterator begin() const { return const_iterator(s.begin()); }
-  const_iterator cbegin() const { return const_iterator(s.cbegin()); }
+  const_iterator begin() const { return iter(s.begin_index()); }
+  const_iterator cbegin() const { return begin(); }
   
-  iterator end() { return iterator(s.end()); }
-  const_iterator end() const { return const_iterator(s.end()); }
-  const_iterator cend() const { return const_iterator(s.cend()); }
+  const_iterator end() const { return const_iterator(); }
+  const_iterator cend() const { return end(); }
   
   bool empty() const { return s.empty(); }
   
   size_type size() const { return s.size(); }
   size_type max_size() const { return s.max_size(); }
   
-  iterator erase(const_iterator pos) { return iterator(s.erase(pos.i)); }
-  // no first, last: can't iterate
+  void reserve(size_type count) { s.reserve(count); }
+  
+  // returns end(): can't iterate
+  iterator erase(const_iterator pos)
+  {
+    s.erase_index(pos.i);
+    return end();
+  }
   size_type erase(const key_type &key) { return s.erase(key); }
   
-  void clear() { return s.clear(); }
+  void clear() { s.clear(); }
   
-  std::pair<iterator,bool> insert(const value_type &value) 
+  std::pair<iterator,bool> insert(const value_type &value)
   {
-    const auto &p = s.insert(value);
-    return std::make_pair(iterator(p.first), p.second);
+    auto p = s.emplace(value, value);
+    return std::make_pair(iter(p.first), p.second);
   }
-  std::pair<iterator,bool> insert(value_type &&value) 
+  std::pair<iterator,bool> insert(value_type &&value)
   {
-    const auto &p = s.insert(value);
-    return std::make_pair(iterator(p.first), p.second);
+    auto p = s.emplace(value, std::move(value));
+    return std::make_pair(iter(p.first), p.second);
   }
-  iterator insert(const_iterator hint, const value_type &value)
+  iterator insert(const_iterator, const value_type &value)
   {
-    return iterator(s.insert(hint, value));
+    return insert(value).first;
   }
-  iterator insert(const_iterator hint, value_type &&value)
+  iterator insert(const_iterator, value_type &&value)
   {
-    return iterator(s.insert(hint, value));
+    return insert(std::move(value)).first;
   }
   template<class InputIt>
-  void insert(InputIt first, InputIt last) { s.insert(first, last); }
-  void insert(std::initializer_list<value_type> ilist) { return s.insert(ilist); }
+  void insert(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+  void insert(std::initializer_list<value_type> ilist) { insert(ilist.begin(), ilist.end()); }
   
-  size_type count(const key_type &key) const { return s.key(); }
+  iterator find(const key_type &key) const { return iter(s.find_index(key)); }
   
-  bool operator ==(const HashSet &hs) { return s == hs.s; }
-  bool operator !=(const HashSet &hs) { return s != hs.s; }
+  size_type count(const key_type &key) const { return s.find_index(key) != s.end_index(); }
   
-  underlying_t &underlying() { return s; }
-  const underlying_t &underlying() const { return s; }
+  bool operator==(const HashSet &that) const
+  {
+    if (size() != that.size())
+      return false;
+    for (size_type i = 0; i < s.end_index(); ++i)
+      if (s.occupied(i)
+          && that.s.find_index(s.at_index(i)) == that.s.end_index())
+        return false;
+    return true;
+  }
+  bool operator!=(const HashSet &that) const { return !(*this == that); }
 };
 
 #endif
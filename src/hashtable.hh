@@ -0,0 +1,287 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_HASHTABLE_HH
+#define PNR_HASHTABLE_HH
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Open addressing hash table with Robin Hood probing and backward
+// shift deletion, behind HashMap and HashSet.  Elements live in one
+// flat array; dist[i] is 0 for an empty slot, otherwise one more than
+// the distance of slot i's element from its home slot.  Keeping the
+// table in probe distance order bounds the probe length, and a lookup
+// for a missing key stops as soon as it passes where the key would
+// have to be.
+//
+// Like the wrappers it replaces, iterators are not incrementable:
+// iteration order would depend on hash values, and we want runs to be
+// reproducible.
+template<typename Value,
+         typename Key,
+         typename KeyOf,
+         typename Hash,
+         typename KeyEqual>
+class HashTable
+{
+public:
+  using size_type = size_t;
+  
+private:
+  using storage_t = typename std::aligned_storage<sizeof(Value), alignof(Value)>::type;
+  
+  std::vector<storage_t> slots;
+  std::vector<uint32_t> dist;
+  unsigned shift;
+  size_type n;
+  Hash hash;
+  KeyEqual eq;
+  
+  Value &slot(size_type i) { return *reinterpret_cast<Value *>(&slots[i]); }
+  const Value &slot(size_type i) const { return *reinterpret_cast<const Value *>(&slots[i]); }
+  
+  size_type capacity() const { return dist.size(); }
+  
+  size_type home(const Key &key) const
+  {
+    // Fibonacci hashing: std::hash of integers and pointers is often
+    // the identity, so spread the bits before taking the top ones
+    uint64_t h = (uint64_t)hash(key) * 0x9e3779b97f4a7c15ull;
+    return (size_type)(h >> shift);
+  }
+  
+  void destroy_all()
+  {
+    for (size_type i = 0; i < capacity(); ++i)
+      if (dist[i])
+        {
+          slot(i).~Value();
+          dist[i] = 0;
+        }
+    n = 0;
+  }
+  
+  // v's key must not be present; v is moved from and destroyed
+  void place(Value *v)
+  {
+    size_type mask = capacity() - 1;
+    size_type i = home(KeyOf()(*v));
+    uint32_t d = 1;
+    for (;;)
+      {
+        if (!dist[i])
+          {
+            new (&slots[i]) Value(std::move(*v));
+            v->~Value();
+            dist[i] = d;
+            ++n;
+            return;
+          }
+        if (dist[i] < d)
+          {
+            // take from the rich
+            Value tmp(std::move(slot(i)));
+            slot(i).~Value();
+            new (&slots[i]) Value(std::move(*v));
+            v->~Value();
+            new (v) Value(std::move(tmp));
+            uint32_t di = dist[i];
+            dist[i] = d;
+            d = di;
+          }
+        i = (i + 1) & mask;
+        ++d;
+      }
+  }
+  
+  void rehash(size_type new_capacity)
+  {
+    assert(new_capacity >= 8
+           && (new_capacity & (new_capacity - 1)) == 0);
+    std::vector<storage_t> old_slots(new_capacity);
+    std::vector<uint32_t> old_dist(new_capacity, 0);
+    old_slots.swap(slots);
+    old_dist.swap(dist);
+    shift = 64;
+    for (size_type c = new_capacity; c > 1; c >>= 1)
+      --shift;
+    n = 0;
+    
+    for (size_type i = 0; i < old_dist.size(); ++i)
+      if (old_dist[i])
+        {
+          Value *v = reinterpret_cast<Value *>(&old_slots[i]);
+          place(v);
+        }
+  }
+  
+  // grows past 7/8 full
+  void insert_new(Value *v)
+  {
+    if (!capacity()
+        || (n + 1) * 8 > capacity() * 7)
+      rehash(capacity() ? capacity() * 2 : 8);
+    place(v);
+  }
+  
+public:
+  HashTable()
+    : shift(64),
+      n(0)
+  {}
+  
+  HashTable(const HashTable &that)
+    : HashTable()
+  {
+    *this = that;
+  }
+  
+  HashTable(HashTable &&that)
+    : HashTable()
+  {
+    swap(that);
+  }
+  
+  ~HashTable() { destroy_all(); }
+  
+  HashTable &operator=(const HashTable &that)
+  {
+    if (this == &that)
+      return *this;
+    clear();
+    if (that.n)
+      {
+        rehash(that.capacity());
+        for (size_type i = 0; i < that.capacity(); ++i)
+          if (that.dist[i])
+            {
+              storage_t tmp;
+              Value *v = new (&tmp) Value(that.slot(i));
+              insert_new(v);
+            }
+      }
+    return *this;
+  }
+  
+  HashTable &operator=(HashTable &&that)
+  {
+    swap(that);
+    return *this;
+  }
+  
+  void swap(HashTable &that)
+  {
+    slots.swap(that.slots);
+    dist.swap(that.dist);
+    std::swap(shift, that.shift);
+    std::swap(n, that.n);
+    std::swap(hash, that.hash);
+    std::swap(eq, that.eq);
+  }
+  
+  bool empty() const { return n == 0; }
+  size_type size() const { return n; }
+  size_type max_size() const { return (size_type)1 << (sizeof(size_type) * 8 - 2); }
+  
+  void clear() { destroy_all(); }
+  
+  void reserve(size_type count)
+  {
+    size_type c = 8;
+    while (c * 7 < count * 8)
+      c *= 2;
+    if (c > capacity())
+      rehash(c);
+  }
+  
+  // slot index of key, or capacity() if absent
+  size_type find_index(const Key &key) const
+  {
+    if (!n)
+      return capacity();
+    size_type mask = capacity() - 1;
+    size_type i = home(key);
+    for (size_type d = 1; dist[i] >= d; ++d)
+      {
+        if (eq(KeyOf()(slot(i)), key))
+          return i;
+        i = (i + 1) & mask;
+      }
+    return capacity();
+  }
+  
+  size_type end_index() const { return capacity(); }
+  size_type begin_index() const
+  {
+    size_type i = 0;
+    while (i < capacity() && !dist[i])
+      ++i;
+    return i;
+  }
+  
+  bool occupied(size_type i) const { return dist[i] != 0; }
+  const Value &at_index(size_type i) const { return slot(i); }
+  Value &at_index(size_type i) { return slot(i); }
+  
+  // returns (index, inserted)
+  template<typename... Args>
+  std::pair<size_type, bool> emplace(const Key &key, Args &&... args)
+  {
+    size_type i = find_index(key);
+    if (i != capacity())
+      return std::make_pair(i, false);
+    storage_t tmp;
+    Value *v = new (&tmp) Value(std::forward<Args>(args)...);
+    insert_new(v);
+    return std::make_pair(find_index(key), true);
+  }
+  
+  void erase_index(size_type i)
+  {
+    assert(i < capacity() && dist[i]);
+    size_type mask = capacity() - 1;
+    slot(i).~Value();
+    dist[i] = 0;
+    --n;
+    // shift the rest of the run back, closer to home
+    size_type j = (i + 1) & mask;
+    while (dist[j] > 1)
+      {
+        new (&slots[i]) Value(std::move(slot(j)));
+        slot(j).~Value();
+        dist[i] = dist[j] - 1;
+        dist[j] = 0;
+        i = j;
+        j = (j + 1) & mask;
+      }
+  }
+  
+  size_type erase(const Key &key)
+  {
+    size_type i = find_index(key);
+    if (i == capacity())
+      return 0;
+    erase_index(i);
+    return 1;
+  }
+};
+
+#endif
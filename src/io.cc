@@ -56,9 +56,8 @@ instantiate_io(Design *d)
     }
 
   // Replace top-level ports using SB_IOs
-  for (auto i : top->ports())
+  for (Port *p : top->ports())
     {
-      Port *p = i.second;
       Port *q = p->connection_other_port();
       if (q
           && isa<Instance>(q->node())
@@ -16,6 +16,9 @@
 #include "line_parser.hh"
 #include "util.hh"
 
+#include <cassert>
+#include <cctype>
+
 std::ostream &
 operator<<(std::ostream &s, const LexicalPosition &lp)
 {
@@ -29,6 +32,8 @@ operator<<(std::ostream &s, const LexicalPosition &lp)
 void
 LexicalPosition::fatal(const std::string &msg) const
 {
+  if (FatalThrows::active())
+    throw FatalError(fmt(*this << ": " << msg));
   std::cerr << *this << ": fatal error: " << msg << "\n";
   exit(EXIT_FAILURE);
 }
@@ -124,3 +129,158 @@ LineParser::read_line()
     split_line();
   } while (words.empty());
 }
+
+BufferedLineParser::BufferedLineParser(const std::string &f, std::istream &s)
+  : at_eof(false), lp(f)
+{
+  const size_t chunk = 1 << 20;
+  for (;;)
+    {
+      size_t n = buf.size();
+      buf.resize(n + chunk);
+      s.read(&buf[n], chunk);
+      buf.resize(n + s.gcount());
+      if (!s)
+        break;
+    }
+  input_b = next_b = buf.data();
+  input_e = next_e = buf.data() + buf.size();
+}
+
+BufferedLineParser::BufferedLineParser(const std::string &f,
+                                       const char *b, const char *e,
+                                       int first_line)
+  : input_b(b), input_e(e), next_b(b), next_e(e), at_eof(false),
+    lp(f, first_line - 1)
+{
+}
+
+void
+BufferedLineParser::seek(const char *b, const char *e, int first_line)
+{
+  assert(input_b <= b && b <= e && e <= input_e);
+  next_b = b;
+  next_e = e;
+  at_eof = false;
+  lp.line = first_line - 1;
+}
+
+// like std::getline: sets eof if the line isn't terminated by a
+// newline
+void
+BufferedLineParser::get_line(const char *&b, const char *&e)
+{
+  const char *nl = (const char *)memchr(next_b, '\n', next_e - next_b);
+  b = next_b;
+  if (nl)
+    {
+      e = nl;
+      next_b = nl + 1;
+    }
+  else
+    {
+      e = next_e;
+      next_b = next_e;
+      at_eof = true;
+    }
+}
+
+void
+BufferedLineParser::split_line(const char *b, const char *e)
+{
+  words.clear();
+  strings.clear();
+  
+  const char *t = nullptr;
+  bool instr = false,
+    quote = false,
+    escaped = false;
+  
+  for (const char *p = b; p != e; ++p)
+    {
+      char ch = *p;
+      if (instr)
+        {
+          if (quote)
+            quote = false;
+          else if (ch == '\\')
+            quote = escaped = true;
+          else if (ch == '"')
+            {
+              StringRef w(t, p + 1 - t);
+              if (escaped)
+                {
+                  strings.push_back(unescape(w.str()));
+                  w = StringRef(strings.back());
+                }
+              words.push_back(w);
+              t = nullptr;
+              instr = false;
+            }
+        }
+      else if (isspace((unsigned char)ch))
+        {
+          if (t)
+            {
+              words.push_back(StringRef(t, p - t));
+              t = nullptr;
+            }
+        }
+      else
+        {
+          if (!t)
+            {
+              t = p;
+              escaped = false;
+            }
+          if (ch == '"')
+            instr = true;
+        }
+    }
+  if (instr)
+    fatal("unterminated string constant");
+  else if (t)
+    words.push_back(StringRef(t, e - t));
+}
+
+void
+BufferedLineParser::read_line()
+{
+  words.clear();
+  do {
+    line = StringRef();
+    if (at_eof)
+      return;
+    
+    lp.next_line();
+    const char *b, *e;
+    get_line(b, e);
+    
+  L:
+    const char *p = (const char *)memchr(b, '#', e - b);
+    if (p)
+      e = p;
+    else if (e != b
+             && e[-1] == '\\')
+      {
+        if (at_eof)
+          fatal("unexpected backslash before eof");
+        
+        // drop backslash
+        std::string line2(b, e - 1 - b);
+        
+        const char *b2, *e2;
+        lp.next_line();
+        get_line(b2, e2);
+        
+        line2.append(b2, e2);
+        joined.swap(line2);
+        b = joined.data();
+        e = b + joined.size();
+        goto L;
+      }
+    
+    line = StringRef(b, e - b);
+    split_line(b, e);
+  } while (words.empty());
+}
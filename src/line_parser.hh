@@ -16,6 +16,9 @@
 #ifndef PNR_LINE_PARSER_HH
 #define PNR_LINE_PARSER_HH
 
+#include "stringref.hh"
+
+#include <deque>
 #include <ostream>
 #include <iostream>
 #include <vector>
@@ -70,4 +73,46 @@ protected:
   {}
 };
 
+// Same lines and words as LineParser, but the input is read in one
+// go and words refer into the buffer instead of being copied.  Words
+// are valid until the next read_line().
+class BufferedLineParser
+{
+  std::string buf;
+  // the input, and the rest of the lines being read
+  const char *input_b, *input_e, *next_b, *next_e;
+  bool at_eof;
+  
+  // line continued with a backslash
+  std::string joined;
+  // unescaped string constants
+  std::deque<std::string> strings;
+  
+  void get_line(const char *&b, const char *&e);
+  void split_line(const char *b, const char *e);
+  
+protected:
+  LexicalPosition lp;
+  
+  StringRef line;
+  std::vector<StringRef> words;
+  
+  void fatal(const std::string &msg) const { lp.fatal(msg); }
+  void warning(const std::string &msg) const { lp.warning(msg); }
+  
+  bool eof() const { return at_eof; }
+  size_t input_size() const { return input_e - input_b; }
+  StringRef input() const { return StringRef(input_b, input_e - input_b); }
+  
+  void read_line();
+  // continue with the lines of [b, e), part of the input, the first
+  // of which is line number first_line
+  void seek(const char *b, const char *e, int first_line);
+  
+  BufferedLineParser(const std::string &f, std::istream &s);
+  // the lines of [b, e), part of a buffer that outlives the parser
+  BufferedLineParser(const std::string &f,
+                     const char *b, const char *e, int first_line);
+};
+
 #endif
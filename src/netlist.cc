@@ -16,15 +16,38 @@
 #include "netlist.hh"
 #include "util.hh"
 #include "casting.hh"
+#include "pool.hh"
+#include "stringref.hh"
+#include "textwriter.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
 
-static void
-write_string_escaped(std::ostream &s, const std::string &str)
+template<typename S> static void
+write_string_escaped(S &s, const std::string &str)
 {
+  bool plain = true;
+  for (char ch : str)
+    {
+      if (ch == '"'
+          || ch == '\\'
+          || !(isprint(ch)
+               || ch == '\n'
+               || ch == '\t'))
+        {
+          plain = false;
+          break;
+        }
+    }
+  if (plain)
+    {
+      s << '"' << str << '"';
+      return;
+    }
+  
   s << '"';
   for (char ch : str)
     {
@@ -76,32 +99,96 @@ opposite_direction(Direction d)
 int Identified::id_counter = 0;
 
 void
-Const::write_verilog(std::ostream &s) const
+Const::write_blif(TextWriter &s) const
 {
   if (m_is_bits)
     {
-      s << m_bitval.size()
+      for (int i = m_bitval.size() - 1; i >= 0; --i)
+        s.put(m_bitval[i] ? '1' : '0');
+    }
+  else
+    write_string_escaped(s, m_strval);
+}
+
+void
+Const::write_verilog(TextWriter &s) const
+{
+  if (m_is_bits)
+    {
+      s << (int)m_bitval.size()
         << "'b";
       for (int i = m_bitval.size() - 1; i >= 0; --i)
-        s << (m_bitval[i] ? '1' : '0');
+        s.put(m_bitval[i] ? '1' : '0');
     }
   else
     write_string_escaped(s, m_strval);
 }
 
+void *
+Net::operator new(size_t size, Design *d)
+{
+  assert(size == sizeof(Net));
+  return d->net_pool.allocate();
+}
+
+void
+Net::operator delete(void *p)
+{
+  FixedPool::deallocate(p);
+}
+
+void
+Net::operator delete(void *p, Design *)
+{
+  FixedPool::deallocate(p);
+}
+
+void *
+Port::operator new(size_t size, Design *d)
+{
+  assert(size == sizeof(Port));
+  return d->port_pool.allocate();
+}
+
+void
+Port::operator delete(void *p)
+{
+  FixedPool::deallocate(p);
+}
+
+void
+Port::operator delete(void *p, Design *)
+{
+  FixedPool::deallocate(p);
+}
+
+void *
+Instance::operator new(size_t size, Design *d)
+{
+  assert(size == sizeof(Instance));
+  return d->instance_pool.allocate();
+}
+
+void
+Instance::operator delete(void *p)
+{
+  FixedPool::deallocate(p);
+}
+
+void
+Instance::operator delete(void *p, Design *)
+{
+  FixedPool::deallocate(p);
+}
+
 void
 Net::replace(Net *new_n)
 {
   assert(new_n != this);
   
-  for (auto i = m_connections.begin();
-       i != m_connections.end();)
-    {
-      Port *p = *i;
-      ++i;
-      p->connect(new_n);
-    }
-  assert(m_connections.empty());
+  // disconnecting from the back doesn't shift m_connections
+  while (!m_connections.empty())
+    m_connections.back()->connect(new_n);
 }
 
 void
@@ -109,7 +196,10 @@ Port::disconnect()
 {
   if (m_connection)
     {
-      m_connection->m_connections.erase(this);
+      std::vector<Port *> &v = m_connection->m_connections;
+      auto i = std::lower_bound(v.begin(), v.end(), this, IdLess());
+      assert(i != v.end() && *i == this);
+      v.erase(i);
       m_connection = nullptr;
     }
 }
@@ -123,7 +213,10 @@ Port::connect(Net *n)
   assert(!m_connection);
   m_connection = n;
   if (n)
-    n->m_connections.insert(this);
+    {
+      std::vector<Port *> &v = n->m_connections;
+      v.insert(std::upper_bound(v.begin(), v.end(), this, IdLess()), this);
+    }
 }
 
 Port *
@@ -162,6 +255,14 @@ Port::is_input() const
           : m_dir == Direction::OUT); // model
 }
 
+Design *
+Node::design() const
+{
+  if (const Model *m = dyn_cast<Model>(this))
+    return m->design();
+  return cast<Instance>(this)->parent()->design();
+}
+
 Node::~Node()
 {
   for (Port *p : m_ordered_ports)
@@ -173,37 +274,72 @@ Node::~Node()
   m_ordered_ports.clear();
 }
 
+static bool
+port_name_less(const Port *p, const std::string &n)
+{
+  return p->name() < n;
+}
+
+void
+Node::insert_port(Port *new_port)
+{
+  auto i = std::lower_bound(m_ports.begin(), m_ports.end(),
+                            new_port->name(), port_name_less);
+  assert(i == m_ports.end()
+         || (*i)->name() != new_port->name());
+  m_ports.insert(i, new_port);
+  m_ordered_ports.push_back(new_port);
+}
+
 Port *
 Node::add_port(Port *t)
 {
-  Port *new_port = new Port(this, t->name(), t->direction(), t->undriven());
-  extend(m_ports, new_port->name(), new_port);
-  m_ordered_ports.push_back(new_port);
+  Port *new_port = new (design()) Port(this, t->symbol(), t->direction(),
+                                       t->undriven());
+  insert_port(new_port);
   return new_port;
 }
 
 Port *
 Node::add_port(const std::string &n, Direction dir)
 {
-  Port *new_port = new Port(this, n, dir);
-  extend(m_ports, new_port->name(), new_port);
-  m_ordered_ports.push_back(new_port);
+  Port *new_port = new (design()) Port(this, Symbol(n), dir);
+  insert_port(new_port);
   return new_port;
 }
 
 Port *
 Node::add_port(const std::string &n, Direction dir, Value u)
 {
-  Port *new_port = new Port(this, n, dir, u);
-  extend(m_ports, new_port->name(), new_port);
-  m_ordered_ports.push_back(new_port);
+  Port *new_port = new (design()) Port(this, Symbol(n), dir, u);
+  insert_port(new_port);
   return new_port;
 }
 
 Port *
 Node::find_port(const std::string &n)
 {
-  return lookup_or_default(m_ports, n, nullptr);
+  auto i = std::lower_bound(m_ports.begin(), m_ports.end(),
+                            n, port_name_less);
+  if (i != m_ports.end()
+      && (*i)->name() == n)
+    return *i;
+  return nullptr;
+}
+
+Port *
+Node::find_port(Symbol n)
+{
+  // instances have a dozen ports or so, where comparing ids beats
+  // comparing names
+  if (m_ports.size() <= 16)
+    {
+      for (Port *p : m_ports)
+        if (p->symbol() == n)
+          return p;
+      return nullptr;
+    }
+  return find_port(n.name());
 }
 
 Instance::Instance(Model *parent_, Model *inst_of)
@@ -215,6 +351,18 @@ Instance::Instance(Model *parent_, Model *inst_of)
     add_port(p);
 }
 
+void
+Instance::drop_attrs(const std::set<std::string> &names)
+{
+  for (auto i = m_attrs.begin(); i != m_attrs.end();)
+    {
+      if (contains(names, i->first))
+        i = m_attrs.erase(i);
+      else
+        ++i;
+    }
+}
+
 void
 Instance::merge_attrs(const Instance *inst)
 {
@@ -250,27 +398,34 @@ void
 Instance::remove()
 {
   m_parent->m_instances.erase(this);
-  for (const auto &p : ports())
-    p.second->disconnect();
+  for (Port *p : ports())
+    p->disconnect();
 }
 
 void
-Instance::write_blif(std::ostream &s,
-                     const std::map<Net *, std::string, IdLess> &net_name) const
+Instance::write_blif(TextWriter &s, const SharedNames &names) const
 {
   s << ".gate " << m_instance_of->name();
   for (Port *p : m_ordered_ports)
     {
-      s << " " << p->name() << "=";
+      s << ' ' << p->name() << '=';
       if (p->connected())
-        s << net_name.at(p->connection());
+        s << names.name(p->connection());
     }
-  s << "\n";
+  s << '\n';
   
   for (const auto &p : m_attrs)
-    s << ".attr " << p.first << " " << p.second << "\n";
+    {
+      s << ".attr " << p.first << ' ';
+      p.second.write_blif(s);
+      s << '\n';
+    }
   for (const auto &p : m_params)
-    s << ".param " << p.first << " " << p.second << "\n";
+    {
+      s << ".param " << p.first << ' ';
+      p.second.write_blif(s);
+      s << '\n';
+    }
 }
 
 void
@@ -292,7 +447,7 @@ Instance::dump() const
 }
 
 static void
-write_verilog_name(std::ostream &s, const std::string &name)
+write_verilog_name(TextWriter &s, const std::string &name)
 {
   bool quote = false;
   for (char ch : name)
@@ -313,9 +468,7 @@ write_verilog_name(std::ostream &s, const std::string &name)
 }
 
 void
-Instance::write_verilog(std::ostream &s,
-                        const std::map<Net *, std::string, IdLess> &net_name,
-                        const std::string &inst_name) const
+Instance::write_verilog(TextWriter &s, const std::string &inst_name) const
 {
   if (!m_attrs.empty())
     {
@@ -382,6 +535,7 @@ int Model::counter = 0;
 
 Model::Model(Design *d, const std::string &n)
   : Node(Node::Kind::model),
+    m_design(d),
     m_name(n)
 {
   if (contains(d->m_models, n)) {
@@ -417,7 +571,7 @@ Net *
 Model::find_or_add_net(const std::string &n)
 {
   assert(!n.empty());
-  return lookup_or_create(m_nets, n, [&n]() { return new Net(n); });
+  return lookup_or_create(m_nets, n, [this, &n]() { return new (m_design) Net(n); });
 }
 
 Net *
@@ -429,7 +583,7 @@ Model::add_net()
   if (contains_key(m_nets, net_name))
     goto L;
   
-  Net *new_n = new Net(net_name);
+  Net *new_n = new (m_design) Net(net_name);
   extend(m_nets, net_name, new_n);
   return new_n;
 }
@@ -447,7 +601,7 @@ Model::add_net(const std::string &orig)
       goto L;
     }
   
-  Net *new_n = new Net(net_name);
+  Net *new_n = new (m_design) Net(net_name);
   extend(m_nets, net_name, new_n);
   return new_n;
 }
@@ -462,11 +616,47 @@ Model::remove_net(Net *n)
 Instance *
 Model::add_instance(Model *inst_of)
 {
-  Instance *new_inst = new Instance(this, inst_of);
+  Instance *new_inst = new (m_design) Instance(this, inst_of);
   m_instances.insert(new_inst);
   return new_inst;
 }
 
+// Removing instances one at a time costs, for each port, a search and
+// an erase in the connections of its net, which is quadratic when many
+// instances share a net like a constant or a clock.  Instead, detach
+// all the ports first and then compact each net they were on once.
+void
+Model::remove_instances(const std::vector<Instance *> &v)
+{
+  std::vector<Net *> nets;
+  for (Instance *inst : v)
+    {
+      assert(inst->parent() == this);
+      m_instances.erase(inst);
+      for (Port *p : inst->ordered_ports())
+        {
+          if (p->m_connection)
+            {
+              nets.push_back(p->m_connection);
+              p->m_connection = nullptr;
+            }
+        }
+    }
+  
+  std::sort(nets.begin(), nets.end(), IdLess());
+  nets.erase(std::unique(nets.begin(), nets.end()), nets.end());
+  for (Net *n : nets)
+    {
+      std::vector<Port *> &conns = n->m_connections;
+      conns.erase(std::remove_if(conns.begin(), conns.end(),
+                                 [n](Port *p) { return p->connection() != n; }),
+                  conns.end());
+    }
+  
+  for (Instance *inst : v)
+    delete inst;
+}
+
 bool Model::is_physical_port(Models &models, const Port *p) const
 {
   bool is_phys_port = p
@@ -542,12 +732,13 @@ Model::boundary_nets(const Design *d) const
   return bnets;
 }
 
-std::pair<std::vector<Net *>, std::map<Net *, int, IdLess>>
+std::pair<std::vector<Net *>, HashMap<Net *, int>>
 Model::index_nets() const
 {
   int n_nets = 0;
   std::vector<Net *> vnets;
-  std::map<Net *, int, IdLess> net_idx;
+  HashMap<Net *, int> net_idx;
+  net_idx.reserve(m_nets.size());
   vnets.push_back(nullptr);
   ++n_nets;
   for (const auto &p : m_nets)
@@ -560,13 +751,14 @@ Model::index_nets() const
   return std::make_pair(vnets, net_idx);
 }
 
-std::pair<std::vector<Net *>, std::map<Net *, int, IdLess>>
+std::pair<std::vector<Net *>, HashMap<Net *, int>>
 Model::index_internal_nets(const Design *d) const
 {
   std::set<Net *, IdLess> bnets = boundary_nets(d);
   
   std::vector<Net *> vnets;
-  std::map<Net *, int, IdLess> net_idx;
+  HashMap<Net *, int> net_idx;
+  net_idx.reserve(m_nets.size());
   
   int n_nets = 0;
   for (const auto &p : m_nets)
@@ -582,11 +774,12 @@ Model::index_internal_nets(const Design *d) const
   return std::make_pair(vnets, net_idx);
 }
 
-std::pair<BasedVector<Instance *, 1>, std::map<Instance *, int, IdLess>>
+std::pair<BasedVector<Instance *, 1>, HashMap<Instance *, int>>
 Model::index_instances() const
 {
   BasedVector<Instance *, 1> gates;
-  std::map<Instance *, int, IdLess> gate_idx;
+  HashMap<Instance *, int> gate_idx;
+  gate_idx.reserve(m_instances.size());
   
   int n_gates = 0;
   for (Instance *inst : m_instances)
@@ -631,13 +824,8 @@ Model::prune()
         continue;
       
       // remove n
-      for (auto j = n->connections().begin();
-           j != n->connections().end();)
-        {
-          Port *p = *j;
-          ++j;
-          p->disconnect();
-        }
+      while (!n->connections().empty())
+        n->connections().back()->disconnect();
       m_nets.erase(t);
       delete n;
     }
@@ -713,82 +901,105 @@ Model::check(const Design *d) const
 }
 #endif
 
-std::pair<std::map<Net *, std::string, IdLess>,
-          std::set<Net *, IdLess>>
-Model::shared_names() const
+namespace {
+
+class StringRefHash
+{
+public:
+  size_t operator()(const StringRef &r) const { return r.hash(); }
+};
+
+}
+
+void
+Model::shared_names(SharedNames &names) const
 {
-  std::set<std::string> names;
-  std::map<Net *, std::string, IdLess> net_name;
-  std::set<Net *, IdLess> is_port;
+  // views of port names, net names and names.m_suffixed, all of
+  // which outlive it
+  HashSet<StringRef, StringRefHash> taken;
+  taken.reserve(m_ordered_ports.size() + m_nets.size());
+  names.m_name.reserve(m_nets.size());
   for (Port *p : m_ordered_ports)
     {
       Net *n = p->connection();
-      extend(names, p->name());
+      taken.insert(p->name());
       if (n
           && n->name() == p->name())
         {
-          extend(net_name, n, p->name());
-          extend(is_port, n);
+          names.m_name.insert(std::make_pair(n, &p->name()));
+          names.m_is_port.insert(n);
         }
     }
   for (const auto &p : m_nets)
     {
-      if (contains(is_port, p.second))
+      Net *n = p.second;
+      if (names.is_port(n))
         continue;
       
+      if (taken.insert(p.first).second)
+        {
+          names.m_name.insert(std::make_pair(n, &p.first));
+          continue;
+        }
+      
       int i = 2;
-      std::string shared_net_name = p.first;
-    L:
-      if (contains(names, shared_net_name))
+      std::string suffixed;
+      do
         {
-          shared_net_name = fmt(p.first << "$" << i);
+          suffixed = p.first + "$" + std::to_string(i);
           ++i;
-          goto L;
         }
-      extend(names, shared_net_name);
-      extend(net_name, p.second, shared_net_name);
+      while (taken.count(suffixed));
+      names.m_suffixed.push_back(std::move(suffixed));
+      const std::string &name = names.m_suffixed.back();
+      taken.insert(name);
+      names.m_name.insert(std::make_pair(n, &name));
+      names.m_renamed.push_back(n);
     }
-  return std::make_pair(net_name, is_port);
+  std::sort(names.m_renamed.begin(), names.m_renamed.end(), IdLess());
 }
 
 void
 Model::write_blif(std::ostream &s) const
 {
-  s << ".model " << m_name << "\n";
+  TextWriter w(s);
+  write_blif(w);
+}
+
+void
+Model::write_blif(TextWriter &s) const
+{
+  s << ".model " << m_name << '\n';
   
   s << ".inputs";
   for (Port *p : m_ordered_ports)
     {
       if (p->direction() == Direction::IN
           || p->direction() == Direction::INOUT)
-        s << " " << p->name();
+        s << ' ' << p->name();
     }
-  s << "\n";
+  s << '\n';
   
   s << ".outputs";
   for (Port *p : m_ordered_ports)
     {
       if (p->direction() == Direction::OUT
           || p->direction() == Direction::INOUT)
-        s << " " << p->name();
+        s << ' ' << p->name();
     }
-  s << "\n";
+  s << '\n';
   
-  std::map<Net *, std::string, IdLess> net_name;
-  std::set<Net *, IdLess> is_port;
-  std::tie(net_name, is_port) = shared_names();
+  SharedNames names;
+  shared_names(names);
   
-  for (const auto &p : net_name)
-    {
-      if (p.second != p.first->name())
-        s << "# " << p.first->name() << " -> " << p.second << "\n";
-    }
+  for (Net *n : names.renamed())
+    s << "# " << n->name() << " -> " << names.name(n) << '\n';
   
   for (const auto &p : m_nets)
     {
       if (p.second->is_constant())
         {
-          s << ".names " << p.first << "\n";
+          s << ".names " << p.first << '\n';
           if (p.second->constant() == Value::ONE)
             s << "1\n";
           else
@@ -797,7 +1008,7 @@ Model::write_blif(std::ostream &s) const
     }
   
   for (auto i : m_instances)
-    i->write_blif(s, net_name);
+    i->write_blif(s, names);
   
   for (Port *p : m_ordered_ports)
     {
@@ -806,11 +1017,11 @@ Model::write_blif(std::ostream &s) const
           && n->name() != p->name())
         {
           if (p->is_input())
-            s << ".names " << net_name.at(n) << " " << p->name() << "\n";
+            s << ".names " << names.name(n) << ' ' << p->name() << '\n';
           else
             {
               assert(p->is_output());
-              s << ".names " << p->name() << " " << net_name.at(n) << "\n";
+              s << ".names " << p->name() << ' ' << names.name(n) << '\n';
             }
           s << "1 1\n";
         }
@@ -821,10 +1032,17 @@ Model::write_blif(std::ostream &s) const
 
 void
 Model::write_verilog(std::ostream &s) const
+{
+  TextWriter w(s);
+  write_verilog(w);
+}
+
+void
+Model::write_verilog(TextWriter &s) const
 {
   s << "module ";
   write_verilog_name(s, m_name);
-  s << "(";
+  s << '(';
   bool first = true;
   for (Port *p : m_ordered_ports)
     {
@@ -848,32 +1066,28 @@ Model::write_verilog(std::ostream &s) const
     }
   s << ");\n";
   
-  std::map<Net *, std::string, IdLess> net_name;
-  std::set<Net *, IdLess> is_port;
-  std::tie(net_name, is_port) = shared_names();
+  SharedNames names;
+  shared_names(names);
   
-  for (const auto &p : net_name)
-    {
-      if (p.second != p.first->name())
-        s << "  // " << p.first->name() << " -> " << p.second << "\n";
-    }
+  for (Net *n : names.renamed())
+    s << "  // " << n->name() << " -> " << names.name(n) << '\n';
   
   for (const auto &p : m_nets)
     {
-      if (contains(is_port, p.second))
+      if (names.is_port(p.second))
         continue;
       
       s << "  wire ";
-      write_verilog_name(s, net_name.at(p.second));
+      write_verilog_name(s, names.name(p.second));
       if (p.second->is_constant())
         {
           s << " = ";
           if (p.second->constant() == Value::ONE)
-            s << "1";
+            s << '1';
           else
             {
               assert(p.second->constant() == Value::ZERO);
-              s << "0";
+              s << '0';
             }
         }
       s << ";\n";
@@ -888,25 +1102,27 @@ Model::write_verilog(std::ostream &s) const
           if (p->is_input())
             {
               s << "  assign ";
-              write_verilog_name(s, net_name.at(n));
+              write_verilog_name(s, names.name(n));
               s << " = " << p->name() << ";\n";
             }
           else
             {
               assert(p->is_output());
               s << "  assign " << p->name() << " = ";
-              write_verilog_name(s, net_name.at(n));
+              write_verilog_name(s, names.name(n));
               s << ";\n";
             }
         }
       else
-        assert(contains(is_port, n));
+        assert(names.is_port(n));
     }
   
   int k = 0;
+  std::string inst_name;
   for (Instance *inst : m_instances)
     {
-      inst->write_verilog(s, net_name, fmt("$inst" << k));
+      inst_name = "$inst" + std::to_string(k);
+      inst->write_verilog(s, inst_name);
       ++k;
     }
   
@@ -921,7 +1137,10 @@ Design::set_top(Model *t)
 }
 
 Design::Design()
-  : m_top(nullptr)
+  : net_pool(sizeof(Net)),
+    port_pool(sizeof(Port)),
+    instance_pool(sizeof(Instance)),
+    m_top(nullptr)
 {
 }
 
@@ -17,9 +17,15 @@
 #define PNR_NETLIST_HH
 
 #include "bitvector.hh"
+#include "hashmap.hh"
+#include "hashset.hh"
 #include "line_parser.hh"
+#include "pool.hh"
+#include "symbol.hh"
 #include "vector.hh"
 
+#include <algorithm>
+#include <deque>
 #include <string>
 #include <vector>
 #include <set>
@@ -32,6 +38,7 @@ class Instance;
 class Model;
 class Models;
 class Design;
+class TextWriter;
 
 class Identified
 {
@@ -119,6 +126,8 @@ public:
     : m_lp(lp), m_is_bits(true), m_bitval(bv)
   {}
   
+  bool is_bits() const { return m_is_bits; }
+  
   const std::string &as_string() const
   {
     if (m_is_bits)
@@ -143,7 +152,8 @@ public:
       return m_bitval[i];
   }
   
-  void write_verilog(std::ostream &s) const;
+  void write_blif(TextWriter &s) const;
+  void write_verilog(TextWriter &s) const;
 };
 
 
@@ -156,9 +166,16 @@ class Net : public Identified
   bool m_is_constant;
   Value m_constant;
   
-  std::set<Port *, IdLess> m_connections;
+  // sorted by IdLess, so connecting or disconnecting a port is linear
+  // in the fanout; see Model::remove_instances for removing many
+  std::vector<Port *> m_connections;
   
 public:
+  // from the pools of d, see Design
+  static void *operator new(size_t size, Design *d);
+  static void operator delete(void *p);
+  static void operator delete(void *p, Design *d);
+  
   const std::string &name() const { return m_name; }
   
   bool is_constant() const { return m_is_constant; }
@@ -166,7 +183,13 @@ public:
   Value constant() const { return m_constant; }
   void set_constant(Value c) { m_constant = c; }
   
-  const std::set<Port *, IdLess> &connections() const { return m_connections; }
+  const std::vector<Port *> &connections() const { return m_connections; }
+  
+  // Call f on each connection in order, like iterating over
+  // connections() with the iterator advanced before the body.  f may
+  // connect and disconnect ports, other than the one after the port
+  // it was called on.
+  template<typename F> void for_each_connection(F f);
   
   Net(const std::string &n)
     : m_name(n), m_is_constant(false), m_constant(Value::X)
@@ -181,29 +204,55 @@ public:
   void replace(Net *new_n);
 };
 
+template<typename F> void
+Net::for_each_connection(F f)
+{
+  if (m_connections.empty())
+    return;
+  
+  Port *p = m_connections.front();
+  for (;;)
+    {
+      auto i = std::upper_bound(m_connections.begin(), m_connections.end(),
+                                p, IdLess());
+      Port *next = i == m_connections.end() ? nullptr : *i;
+      f(p);
+      if (!next)
+        break;
+      p = next;
+    }
+}
+
 class Port : public Identified
 {
+  friend class Model;
+  
   Node *m_node;
-  std::string m_name;
+  Symbol m_name;
   Direction m_dir;
   Value m_undriven;
   Net *m_connection;
   
 public:
+  static void *operator new(size_t size, Design *d);
+  static void operator delete(void *p);
+  static void operator delete(void *p, Design *d);
+  
   Node *node() const { return m_node; }
-  const std::string &name() const { return m_name; }
+  const std::string &name() const { return m_name.name(); }
+  Symbol symbol() const { return m_name; }
   Direction direction() const { return m_dir; }
   void set_direction(Direction dir) { m_dir = dir; }
   Value undriven() const { return m_undriven; }
   void set_undriven(Value u) { m_undriven = u; }
   
-  Port(Node *node_, const std::string &name_)
+  Port(Node *node_, Symbol name_)
     : m_node(node_), m_name(name_), m_dir(Direction::IN), m_undriven(Value::X), m_connection(nullptr)
   {}
-  Port(Node *node_, const std::string &name_, Direction dir)
+  Port(Node *node_, Symbol name_, Direction dir)
     : m_node(node_), m_name(name_), m_dir(dir), m_undriven(Value::X), m_connection(nullptr)
   {}
-  Port(Node *node_, const std::string &name_, Direction dir, Value u)
+  Port(Node *node_, Symbol name_, Direction dir, Value u)
     : m_node(node_), m_name(name_), m_dir(dir), m_undriven(u), m_connection(nullptr)
   {}
   ~Port()
@@ -227,7 +276,9 @@ public:
 class Node : public Identified
 {
 protected:
-  std::map<std::string, Port *> m_ports;
+  // sorted by name; a vector rather than a map because there are a
+  // dozen ports on each of hundreds of thousands of instances
+  std::vector<Port *> m_ports;
   std::vector<Port *> m_ordered_ports;
   
 public:
@@ -240,11 +291,16 @@ public:
 private:
   Kind m_kind;
   
+  void insert_port(Port *new_port);
+  
 public:
-  const std::map<std::string, Port *> &ports() const { return m_ports; }
+  // sorted by name
+  const std::vector<Port *> &ports() const { return m_ports; }
   const std::vector<Port *> &ordered_ports() const { return m_ordered_ports; }
   
   Kind kind() const { return m_kind; }
+  // the design of the model this is or is an instance in
+  Design *design() const;
   
   Node(Kind k) : m_kind(k) {}
   ~Node();
@@ -253,6 +309,29 @@ public:
   Port *add_port(const std::string &n, Direction dir);
   Port *add_port(const std::string &n, Direction dir, Value u);
   Port *find_port(const std::string &n);
+  // for names looked up often; see Symbol
+  Port *find_port(Symbol n);
+};
+
+// The names the nets of a model are written with.  A net connected
+// to a port of the same name is the port, and the others keep their
+// name, suffixed with $2, $3, ... if a port already has it.
+class SharedNames
+{
+  friend class Model;
+  
+  HashMap<Net *, const std::string *> m_name;
+  HashSet<Net *> m_is_port;
+  // the suffixed names
+  std::deque<std::string> m_suffixed;
+  // in IdLess order
+  std::vector<Net *> m_renamed;
+  
+public:
+  const std::string &name(Net *n) const { return *m_name.at(n); }
+  bool is_port(Net *n) const { return m_is_port.count(n) > 0; }
+  // the nets whose name is suffixed
+  const std::vector<Net *> &renamed() const { return m_renamed; }
 };
 
 class Instance : public Node
@@ -266,6 +345,10 @@ class Instance : public Node
 public:
   static const Kind kindof = Kind::instance;
   
+  static void *operator new(size_t size, Design *d);
+  static void operator delete(void *p);
+  static void operator delete(void *p, Design *d);
+  
   Model *parent() const { return m_parent; }
   Model *instance_of() const { return m_instance_of; }
   const std::map<std::string, Const> &attrs() const { return m_attrs; }
@@ -274,6 +357,8 @@ public:
   Instance(Model *p, Model *inst_of);
   
   void set_attr(const std::string &an, const Const &val) { m_attrs[an] = val; }
+  // remove the attributes named in names
+  void drop_attrs(const std::set<std::string> &names);
   
   bool has_attr(const std::string &an) const
   {
@@ -311,11 +396,8 @@ public:
   void remove();
   
   void dump() const;
-  void write_blif(std::ostream &s,
-                  const std::map<Net *, std::string, IdLess> &net_name) const;
-  void write_verilog(std::ostream &s,
-                     const std::map<Net *, std::string, IdLess> &net_name,
-                     const std::string &inst_name) const;
+  void write_blif(TextWriter &s, const SharedNames &names) const;
+  void write_verilog(TextWriter &s, const std::string &inst_name) const;
 };
 
 class Model : public Node
@@ -324,6 +406,7 @@ class Model : public Node
   
   static int counter;
   
+  Design *m_design;
   std::string m_name;
   std::map<std::string, Net *> m_nets;
   std::set<Instance *, IdLess> m_instances;
@@ -333,6 +416,7 @@ class Model : public Node
 public:
   static const Kind kindof = Kind::model;
   
+  Design *design() const { return m_design; }
   const std::string &name() const { return m_name; }
   
   const std::set<Instance *, IdLess> &instances() const { return m_instances; }
@@ -349,6 +433,8 @@ public:
   Net *add_net(Net *orig) { return add_net(orig->name()); }
   void remove_net(Net *n);
   Instance *add_instance(Model *inst_of);
+  // remove and delete the instances in v
+  void remove_instances(const std::vector<Instance *> &v);
   
   void
   set_param(const std::string &pn, const std::string &val)
@@ -373,21 +459,21 @@ public:
   bool is_physical_port(Models &models, const Port *p) const;
   void check_boundary_nets(const Design *d) const;
   std::set<Net *, IdLess> boundary_nets(const Design *d) const;
-  std::pair<std::vector<Net *>, std::map<Net *, int, IdLess>>
+  std::pair<std::vector<Net *>, HashMap<Net *, int>>
     index_nets() const;
-  std::pair<std::vector<Net *>, std::map<Net *, int, IdLess>>
+  std::pair<std::vector<Net *>, HashMap<Net *, int>>
     index_internal_nets(const Design *d) const;
   
-  std::pair<BasedVector<Instance *, 1>, std::map<Instance *, int, IdLess>>
+  std::pair<BasedVector<Instance *, 1>, HashMap<Instance *, int>>
     index_instances() const;
   
   void prune();
 
-  std::pair<std::map<Net *, std::string, IdLess>,
-            std::set<Net *, IdLess>>
-    shared_names() const;
+  void shared_names(SharedNames &names) const;
   void write_verilog(std::ostream &s) const;
   void write_blif(std::ostream &s) const;
+  void write_verilog(TextWriter &s) const;
+  void write_blif(TextWriter &s) const;
   void rename_net(Net *n, const std::string &new_name);
 #ifndef NDEBUG
   void check(const Design *d) const;
@@ -397,6 +483,14 @@ public:
 class Design
 {
   friend class Model;
+  friend class Net;
+  friend class Port;
+  friend class Instance;
+  
+  // The netlist objects of the design's models.  Declared first so they
+  // are destroyed last, after ~Design has deleted the models, and their
+  // memory goes back to the system with the design.
+  FixedPool net_pool, port_pool, instance_pool;
   
   Model *m_top;
   std::map<std::string, Model *> m_models;
@@ -0,0 +1,77 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "netlistindex.hh"
+#include "casting.hh"
+
+NetlistIndex::NetlistIndex(const Design *d)
+{
+  const Model *top = d->top();
+  
+  std::tie(nets, net_idx) = top->index_nets();
+  std::tie(gates, gate_idx) = top->index_instances();
+  int n_nets = nets.size(),
+    n_gates = gates.size();
+  
+  net_boundary.resize(n_nets);
+  for (Net *n : top->boundary_nets(d))
+    net_boundary[net_idx.at(n)] = true;
+  
+  net_constant.resize(n_nets);
+  net_pin_offset.resize(n_nets + 1, 0);
+  for (int w = 1; w < n_nets; ++w)
+    {
+      Net *n = nets[w];
+      net_constant[w] = n->is_constant();
+      net_pin_offset[w] = pins.size();
+      for (Port *p : n->connections())
+        {
+          Pin pin;
+          pin.net = w;
+          if (Instance *inst = dyn_cast<Instance>(p->node()))
+            pin.gate = gate_idx.at(inst);
+          else
+            pin.gate = 0;
+          if (p->is_bidir())
+            pin.role = PinRole::INOUT;
+          else if (p->is_output())
+            pin.role = PinRole::OUTPUT;
+          else
+            pin.role = PinRole::INPUT;
+          pin.port = p;
+          pins.push_back(pin);
+        }
+    }
+  net_pin_offset[n_nets] = pins.size();
+  
+  // pin index by port, to lay out the gate pin lists
+  HashMap<const Port *, int> port_pin;
+  port_pin.reserve(pins.size());
+  for (int i = 0; i < (int)pins.size(); ++i)
+    extend(port_pin, pins[i].port, i);
+  
+  gate_pin.reserve(pins.size());
+  gate_pin_offset.resize(n_gates + 2, 0);
+  for (int g = 1; g <= n_gates; ++g)
+    {
+      gate_pin_offset[g] = gate_pin.size();
+      for (Port *p : gates[g]->ports())
+        {
+          if (p->connected())
+            gate_pin.push_back(port_pin.at(p));
+        }
+    }
+  gate_pin_offset[n_gates + 1] = gate_pin.size();
+}
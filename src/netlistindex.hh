@@ -0,0 +1,85 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_NETLISTINDEX_HH
+#define PNR_NETLISTINDEX_HH
+
+#include "netlist.hh"
+#include "hashmap.hh"
+#include "bitvector.hh"
+#include "vector.hh"
+#include "flatarray.hh"
+
+#include <cstdint>
+#include <vector>
+
+enum class PinRole : uint8_t
+{
+  INPUT, OUTPUT, INOUT,
+};
+
+class Pin
+{
+public:
+  int net;
+  // 0 for a port of the top model
+  int gate;
+  PinRole role;
+  Port *port;
+};
+
+// Dense integer view of the final netlist, built once and shared by
+// the placer and the router.  Net 0 is nullptr and gates are numbered
+// from 1.  The netlist must not change while an index is in use.
+class NetlistIndex
+{
+public:
+  std::vector<Net *> nets;
+  HashMap<Net *, int> net_idx;
+  
+  BasedVector<Instance *, 1> gates;
+  HashMap<Instance *, int> gate_idx;
+  
+  BitVector net_boundary,
+    net_constant;
+  
+  // net w's pins, in connection order, are pins[net_pin_offset[w]]
+  // to pins[net_pin_offset[w + 1] - 1]
+  std::vector<Pin> pins;
+  std::vector<int> net_pin_offset;
+  
+  // gate g's pins in port name order, as indices into pins
+  std::vector<int> gate_pin;
+  std::vector<int> gate_pin_offset;
+  
+public:
+  NetlistIndex(const Design *d);
+  
+  int n_nets() const { return nets.size(); }
+  int n_gates() const { return gates.size(); }
+  
+  Range<Pin> net_pins(int w) const
+  {
+    return Range<Pin>(pins.data() + net_pin_offset[w],
+                      pins.data() + net_pin_offset[w + 1]);
+  }
+  Range<int> gate_pins(int g) const
+  {
+    return Range<int>(gate_pin.data() + gate_pin_offset[g],
+                      gate_pin.data() + gate_pin_offset[g + 1]);
+  }
+};
+
+#endif
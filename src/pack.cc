@@ -19,6 +19,7 @@
 #include "chipdb.hh"
 #include "carry.hh"
 #include "designstate.hh"
+#include "hashset.hh"
 
 #include <cstring>
 
@@ -38,6 +39,8 @@ class Packer
   Net *const1;
   
   std::set<Instance *, IdLess> ready;
+  // instances packed into LCs, removed together by remove_dead
+  std::vector<Instance *> dead;
   
   void lc_from_dff(Instance *lc_inst, Instance *dff_inst);
   void lc_from_lut(Instance *lc_inst, Instance *lut_inst);
@@ -45,7 +48,7 @@ class Packer
   void carry_pass_through_lc(Instance *lc_inst, Port *cout);
   void lc_from_carry(Instance *lc_inst, Instance *carry_inst);
   
-  Port *driver(Net *n);
+  void remove_dead();
   Instance *find_carry_lc(Instance *c);
 
   void pack_dffs();
@@ -292,15 +295,19 @@ Packer::lc_from_carry(Instance *lc_inst,
   lc_inst->set_param("CARRY_ENABLE", BitVector(1, 1));
 }
 
+void
+Packer::remove_dead()
+{
+  top->remove_instances(dead);
+  dead.clear();
+}
+
 void
 Packer::pack_dffs()
 {
   const auto &instances = top->instances();
-  for (auto i = instances.begin(); i != instances.end();)
+  for (Instance *inst : instances)
     {
-      Instance *inst = *i;
-      ++i;
-      
       if (models.is_dff(inst))
         {
           Instance *lc_inst = top->add_instance(models.lc);
@@ -326,30 +333,22 @@ Packer::pack_dffs()
           else
             pass_through_lc(lc_inst, d_port);
           
-          inst->remove();
-          delete inst;
-          
+          // the D net of inst and the O net of lut_inst have only
+          // these two ports, so no later DFF sees them
+          dead.push_back(inst);
           if (lut_inst)
-            {
-              if (i != instances.end()
-                  && *i == lut_inst)
-                ++i;
-              
-              lut_inst->remove();
-              delete lut_inst;
-            }
+            dead.push_back(lut_inst);
         }
     }
+  remove_dead();
 }
 
 void
 Packer::pack_luts()
 {
   const auto &instances = top->instances();
-  for (auto i = instances.begin(); i != instances.end();)
+  for (Instance *inst : instances)
     {
-      Instance *inst = *i;
-      ++i;
       if (models.is_lut4(inst))
         {
           Instance *lc_inst = top->add_instance(models.lc);
@@ -358,24 +357,10 @@ Packer::pack_luts()
           
           lc_inst->find_port("O")->connect(inst->find_port("O")->connection());
           
-          inst->remove();
-          delete inst;
+          dead.push_back(inst);
         }
-    }      
-}
-
-Port *
-Packer::driver(Net *n)
-{
-  if (!n)
-    return nullptr;
-  for (Port *p : n->connections())
-    {
-      if (p->is_output()
-          || p->is_bidir())
-        return p;
     }
-  return nullptr;
+  remove_dead();
 }
 
 Instance *
@@ -546,8 +531,10 @@ Packer::pack_carries_from(Instance *f)
             }
         }
       
-      c->remove();
-      delete c;
+      // below, out_conn must no longer count c; its other nets can
+      // wait for remove_dead
+      out->disconnect();
+      dead.push_back(c);
       
       if (!next_c
           && out_conn)
@@ -634,16 +621,24 @@ Packer::pack_carries()
 {
   const auto &instances = top->instances();
   
+  // chains start at carries whose CI isn't driven by a CO
+  HashSet<Net *> carry_out;
+  for (Instance *inst : instances)
+    {
+      if (models.is_carry(inst))
+        {
+          Net *out_conn = inst->find_port("CO")->connection();
+          if (out_conn)
+            carry_out.insert(out_conn);
+        }
+    }
   for (Instance *inst : instances)
     {
       if (models.is_carry(inst))
         {
-          Port *in = inst->find_port("CI");
-          Net *in_conn = in->connection();
-          Port *p = driver(in_conn);
-          if (!p
-              || !isa<Instance>(p->node())
-              || !models.is_carry(cast<Instance>(p->node())))
+          Net *in_conn = inst->find_port("CI")->connection();
+          if (!in_conn
+              || !carry_out.count(in_conn))
             extend(ready, inst);
         }
     }
@@ -654,6 +649,7 @@ Packer::pack_carries()
       ready.erase(inst);
       pack_carries_from(inst);
     }
+  remove_dead();
   
   std::set<Instance *, IdLess> done;
   for (const auto &ch : chains.chains)
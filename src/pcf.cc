@@ -28,6 +28,7 @@
 
 class PCFParser : public LineParser
 {
+  const ChipDB *chipdb;
   const Package &package;
   Model *top;
   Constraints &constraints;
@@ -35,14 +36,50 @@ class PCFParser : public LineParser
 public:
   PCFParser(const std::string &f, std::istream &s_, DesignState &ds)
     : LineParser(f, s_),
+      chipdb(ds.chipdb),
       package(ds.package),
       top(ds.top),
       constraints(ds.constraints)
   {}
   
+  int parse_coord(const std::string &word, int size);
   void parse();
 };
 
+bool
+Region::matches(const std::string &name) const
+{
+  // backtrack to the last * only, which is enough for globs
+  const char *p = pattern.c_str(),
+    *s = name.c_str(),
+    *star = nullptr,
+    *star_s = nullptr;
+  while (*s)
+    {
+      if (*p == '*')
+        {
+          star = p++;
+          star_s = s;
+        }
+      else if (*p == '?'
+               || *p == *s)
+        {
+          ++p;
+          ++s;
+        }
+      else if (star)
+        {
+          p = star + 1;
+          s = ++star_s;
+        }
+      else
+        return false;
+    }
+  while (*p == '*')
+    ++p;
+  return !*p;
+}
+
 namespace
 {
 // Extract integer ranges that don't have holes.
@@ -87,6 +124,21 @@ void print_coalesced_field_range(std::string *last_prefix,
 
 }  // namespace
 
+int
+PCFParser::parse_coord(const std::string &word, int size)
+{
+  char *end;
+  long x = strtol(word.c_str(), &end, 10);
+  if (word.empty()
+      || *end)
+    fatal(fmt("set_region: expected tile coordinate, got `" << word << "'"));
+  if (x < 0
+      || x >= size)
+    fatal(fmt("set_region: tile coordinate " << x << " out of range 0.."
+              << size - 1));
+  return (int)x;
+}
+
 void
 PCFParser::parse()
 {
@@ -94,6 +146,7 @@ PCFParser::parse()
   std::map<Location, std::string> pin_loc_net;
   std::map<std::string, bool> net_pin_pull_up;
   std::set<std::string> extra_ports;
+  std::vector<Region> regions;
 
   for (auto p : top->ordered_ports())
     extra_ports.insert(p->name());
@@ -188,6 +241,21 @@ PCFParser::parse()
           if (pull_up_set)
             extend(net_pin_pull_up, net_name, pull_up);
         }
+      else if (cmd == "set_region")
+        {
+          if (words.size() != 6)
+            fatal("set_region: expected <pattern> <xmin> <ymin> <xmax> <ymax>");
+          
+          int xmin = parse_coord(words[2], chipdb->width),
+            ymin = parse_coord(words[3], chipdb->height),
+            xmax = parse_coord(words[4], chipdb->width),
+            ymax = parse_coord(words[5], chipdb->height);
+          if (xmin > xmax
+              || ymin > ymax)
+            fatal("set_region: empty region");
+          
+          regions.push_back(Region(words[1], xmin, ymin, xmax, ymax));
+        }
       else
         fatal(fmt("unknown command `" << cmd << "'"));
     }
@@ -222,6 +290,7 @@ PCFParser::parse()
   
   constraints.net_pin_loc = net_pin_loc;
   constraints.net_pin_pull_up = net_pin_pull_up;
+  constraints.regions = regions;
 }
 
 void
@@ -18,14 +18,44 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 class DesignState;
 
+// A box of tiles the placer keeps some gates in, from set_region.  A
+// gate is in the region if the name of a net it drives matches
+// pattern, a glob with * and ?.  In a netlist flattened by yosys the
+// names carry the hierarchy, like cpu.alu.*.
+class Region
+{
+public:
+  std::string pattern;
+  int xmin, ymin, xmax, ymax;
+  
+  Region()
+    : xmin(0), ymin(0), xmax(0), ymax(0)
+  {}
+  Region(const std::string &pattern_,
+         int xmin_, int ymin_, int xmax_, int ymax_)
+    : pattern(pattern_),
+      xmin(xmin_), ymin(ymin_), xmax(xmax_), ymax(ymax_)
+  {}
+  
+  bool matches(const std::string &name) const;
+  bool contains(int x, int y) const
+  {
+    return (x >= xmin && x <= xmax
+            && y >= ymin && y <= ymax);
+  }
+};
+
 class Constraints
 {
 public:
   std::map<std::string, Location> net_pin_loc;
   std::map<std::string, bool> net_pin_pull_up;
+  // a gate matched by several regions is kept in the first
+  std::vector<Region> regions;
   
 public:
   Constraints() {}
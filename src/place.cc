@@ -26,22 +26,106 @@
 #include "ullmanset.hh"
 #include "hashmap.hh"
 #include "designstate.hh"
+#include "eco.hh"
 #include "global.hh"
+#include "threadpool.hh"
+#include "stats.hh"
+#include "timing.hh"
 
 #include <iomanip>
+#include <memory>
 #include <vector>
 #include <set>
+#include <tuple>
+#include <limits>
 #include <random>
 #include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <cmath>
 #include <ctime>
+#include <chrono>
+
+// port names the placer looks up for each gate or move
+static const Symbol sym_I[4] = {
+  Symbol("I0"), Symbol("I1"), Symbol("I2"), Symbol("I3"),
+};
+static const Symbol sym_CEN("CEN");
+static const Symbol sym_CIN("CIN");
+static const Symbol sym_CLK("CLK");
+static const Symbol sym_CLKHF("CLKHF");
+static const Symbol sym_CLKLF("CLKLF");
+static const Symbol sym_CLOCK_ENABLE("CLOCK_ENABLE");
+static const Symbol sym_D_IN_0("D_IN_0");
+static const Symbol sym_D_IN_1("D_IN_1");
+static const Symbol sym_GLOBAL_BUFFER_OUTPUT("GLOBAL_BUFFER_OUTPUT");
+static const Symbol sym_INPUT_CLK("INPUT_CLK");
+static const Symbol sym_LATCH_INPUT_VALUE("LATCH_INPUT_VALUE");
+static const Symbol sym_OUTPUT_CLK("OUTPUT_CLK");
+static const Symbol sym_PLLOUTGLOBAL("PLLOUTGLOBAL");
+static const Symbol sym_PLLOUTGLOBALA("PLLOUTGLOBALA");
+static const Symbol sym_PLLOUTGLOBALB("PLLOUTGLOBALB");
+static const Symbol sym_SR("SR");
+
+// nets with fewer pins are rescanned rather than updated
+static const int min_incremental_pins = 8;
+
+// an ECO starts cold with short moves, so the gates kept from the
+// previous placement pull the others into their old neighbourhoods
+static const double eco_temp = 1.0;
+static const int eco_diameter = 3;
+
+// an analytic start only needs local refinement
+static const double analytic_temp = 2.0;
+static const int analytic_diameter = 3;
+// larger nets are left out of the quadratic model
+static const int analytic_max_pins = 64;
+// rounds of spreading, and the initial weight of the springs to the
+// spread placement, doubled each round
+static const int analytic_rounds = 4;
+static const double analytic_anchor_weight = 0.2;
+
+// a multilevel start also only needs local refinement
+static const double multilevel_temp = 2.0;
+static const int multilevel_diameter = 3;
+// gates per cluster, a logic tile's worth
+static const int multilevel_cluster_size = 8;
+// larger nets are left out of clustering and the coarse wire length
+static const int multilevel_max_pins = 64;
+// coarse moves per cluster per temperature
+static const int multilevel_moves = 10;
+
+// gate_random_cell picks from a table of the logic tiles in range
+// at up to this diameter, where retrying random tiles can miss often
+static const int window_max_diameter = 8;
+// accept_or_restore looks up exp(-delta/temp) for whole deltas below
+// this
+static const int accept_table_size = 64;
+// gate_random_cell tries this many random tiles of the part of a
+// region in range before leaving the gate where it is
+static const int region_tries = 8;
+
+class NetBox
+{
+public:
+  int x_min, x_max, y_min, y_max;
+  // number of pins on each edge
+  int n_x_min, n_x_max, n_y_min, n_y_max;
+  
+  NetBox()
+    : x_min(0), x_max(0), y_min(0), y_max(0),
+      n_x_min(0), n_x_max(0), n_y_min(0), n_y_max(0)
+  {}
+  
+  int length() const { return (x_max - x_min) + (y_max - y_min); }
+};
 
 class Placer
 {
 public:
-  random_generator &rg;
+  // by value, so copies for parallel annealing get their own streams
+  random_generator rg;
+  PlaceOptions opts;
   
   DesignState &ds;
   const ChipDB *chipdb;
@@ -54,6 +138,7 @@ public:
   const std::map<Instance *, uint8_t, IdLess> &gb_inst_gc;
   std::map<Instance *, int, IdLess> &placement;
   Configuration &conf;
+  const NetlistIndex &index;
   
   std::vector<int> logic_columns;
   std::vector<int> logic_tiles,
@@ -61,32 +146,104 @@ public:
   
   std::vector<std::vector<int>> related_tiles;
   
-  std::vector<Net *> nets;
-  std::map<Net *, int, IdLess> net_idx;
+  const std::vector<Net *> &nets;
+  const HashMap<Net *, int> &net_idx;
   
   int n_gates;
-  BasedVector<Instance *, 1> gates;
-  std::map<Instance *, int, IdLess> gate_idx;
+  const BasedVector<Instance *, 1> &gates;
+  const HashMap<Instance *, int> &gate_idx;
   
   std::map<int, std::vector<int>> global_cells;
   
   BasedBitVector<1> locked;
   BasedBitVector<1> chained;
+  // chains an ECO left where they were
+  BitVector chain_locked;
   
   BasedVector<int, 1> gate_clk, gate_sr, gate_cen, gate_latch;
   
+  // per-gate values for valid(), so legality checks don't look up
+  // ports and params by name
+  BasedVector<CellType, 1> gate_type;
+  BasedBitVector<1> gate_neg_clk;
+  BasedBitVector<1> gate_lvds_input,
+    gate_neg_trigger,
+    gate_gb_io_global;
+  BasedVector<int, 1> gate_io_cen, gate_io_inclk, gate_io_outclk;
+  
   BasedVector<std::vector<int>, 1> gate_local_np;
   UllmanSet tmp_local_np;
   
+  // legality summary of each tile, kept in step with cell_gate by
+  // set_cell_gate(): clk/sr/cen of the gate at each logic position,
+  // masks of the occupied and neg_clk positions, and the local net
+  // pairs of the gates counted with repeats, an upper bound on the
+  // distinct pairs
+  std::vector<int> tile_q_clk, tile_q_sr, tile_q_cen;
+  std::vector<uint8_t> tile_occupied, tile_neg_clk;
+  std::vector<int> tile_n_local_np;
+  // io bank of each cell, -1 if none, and the number of placed gates
+  // in each bank with a latch net
+  std::vector<int> cell_bank;
+  std::vector<int> bank_n_latch;
+  
   BitVector net_global;
   
   std::vector<int> free_gates;
   
   BasedVector<int, 1> gate_chain;
   
-  CellType gate_cell_type(int g);
+  // index in constraints.regions of the region each gate is kept in,
+  // else -1.  The gates of a chain share the region of the chain.
+  BasedVector<int, 1> gate_region;
+  std::vector<int> chain_region;
+  bool has_regions;
+  // per region, the logic columns and the cells of each cell type in
+  // it
+  std::vector<std::vector<int>> region_columns;
+  std::vector<std::vector<std::vector<int>>> region_cells;
+  
+  CellType inst_cell_type(Instance *inst);
+  CellType gate_cell_type(int g) const { return gate_type[g]; }
+  void build_windows();
   int gate_random_cell(int g);
+  double accept_probability(double delta);
   std::pair<Location, bool> chain_random_loc(int c);
+  int chain_tiles(int c) const { return (chains.chains[c].size() + 7) / 8; }
+  void set_chain_pos(int c, int x, int start);
+  int chain_meeting(int x, int start, int nt,
+                    int except1, int except2) const;
+  bool move_chains(const std::vector<std::tuple<int, int, int>> &moves);
+  void move_free_chain(int c);
+  void init_regions();
+  bool in_region(int g, int cell) const;
+  bool eco_place_chain(int c);
+  void eco_place_gates(std::vector<int> &cell_type_n_placed);
+  void eco_sort_cells(int g, std::vector<int> &cells);
+  
+  void analytic_solve(const std::vector<int> &movable,
+                      double anchor_weight,
+                      const BasedVector<int, 1> &target,
+                      BasedVector<double, 1> &px,
+                      BasedVector<double, 1> &py);
+  void analytic_spread(const std::vector<int> &tile_cap,
+                       const BasedVector<double, 1> &px,
+                       const BasedVector<double, 1> &py,
+                       std::vector<int> &order,
+                       int begin, int end,
+                       int x0, int x1, int y0, int y1,
+                       BasedVector<int, 1> &target);
+  bool analytic_legalize(int g, int x, int y);
+  bool place_analytic();
+  
+  bool cluster_accepts(int clk, int sr, int cen, bool neg_clk,
+                       bool seq, bool comb, int g) const;
+  void multilevel_cluster(const std::vector<int> &logic,
+                          std::vector<std::vector<int>> &clusters);
+  void multilevel_anneal(const std::vector<std::vector<int>> &clusters,
+                         const std::vector<int> &slots,
+                         std::vector<int> &cluster_tile);
+  bool place_multilevel();
   
   void move_gate(int g, int cell);
   void move_chain(int c, const Location &new_loc);
@@ -97,32 +254,86 @@ public:
   BasedVector<std::vector<int>, 1> gate_nets;
   
   int diameter;
+  // logic moves stay in these columns
+  int region_xmin, region_xmax;
+  // the logic tiles in range of tile t for window_diameter and
+  // window_xmin, window_xmax are window_tiles[window_offset[t]] to
+  // window_tiles[window_offset[t + 1] - 1]
+  std::vector<int> window_tiles, window_offset;
+  int window_diameter, window_xmin, window_xmax;
   double temp;
+  // exp(-delta/temp) for delta 0 .. accept_table_size - 1 at
+  // accept_temp
+  std::vector<double> accept_prob;
+  double accept_temp;
   bool improved;
   int n_move;
   int n_accept;
+  // wire length changes of the evaluated moves, for the adaptive
+  // schedule's initial temperature
+  int n_delta;
+  double delta_sum, delta_sq_sum;
   
   bool move_failed;
   UllmanSet changed_tiles;
   std::vector<std::pair<int, int>> restore_cell;
   std::vector<std::tuple<int, int, int>> restore_chain;
-  std::vector<std::pair<int, int>> restore_net_length;
+  std::vector<std::tuple<int, int, int>> restore_gate_xy;
+  std::vector<std::pair<int, NetBox>> restore_net_box;
+  // nets touched by the current move
   UllmanSet recompute;
+  // nets whose box lost an edge and must be rescanned
+  UllmanSet rescan;
   
+  void move_pins(int g, int x, int y);
+  
+  void set_cell_gate(int cell, int g);
   void save_set(int cell, int g);
   
   void save_set_chain(int c, int x, int start);
   int save_recompute_wire_length();
+  double save_recompute_congestion();
   void restore();
   void discard();
   void accept_or_restore();
   
+  void move_free_gate(int g);
+  void anneal_region(const std::vector<int> &region_gates);
+  void anneal_regions(ThreadPool &pool,
+                      std::vector<Placer> &workers,
+                      const std::vector<int> &logic_free_gates,
+                      int sweep);
+  
   std::vector<int> chain_x, chain_start;
+  // the chains in each column by start row, kept in step with
+  // chain_x and chain_start by set_chain_pos.  The chains of a column
+  // never overlap, so the one before a row is the only one that can
+  // reach it.
+  std::vector<std::set<std::pair<int, int>>> column_chains;
   
   BasedVector<int, 1> gate_cell;
   BasedVector<int, 1> cell_gate;
   
   std::vector<int> net_length;
+  std::vector<NetBox> net_box;
+  
+  // routing demand for opts.congestion_weight: each net box spreads
+  // its horizontal and vertical length evenly over its tiles (RUDY),
+  // against the target use of the span wires crossing each tile
+  std::vector<double> tile_demand_h, tile_demand_v;
+  std::vector<double> tile_capacity_h, tile_capacity_v;
+  // tiles whose demand the current move changed, with the old values
+  UllmanSet demand_tiles;
+  std::vector<std::tuple<int, double, double>> restore_demand;
+  
+  // for opts.timing_weight: the extra weight on the length of each
+  // net from its criticality, updated once per temperature.  Copies
+  // for parallel annealing share the analysis.
+  std::shared_ptr<Timing> timing;
+  std::vector<double> net_timing_weight;
+  
+  // tile position of each gate, kept in step with gate_cell
+  BasedVector<int, 1> gate_x, gate_y;
   
   bool inst_drives_global(Instance *inst, int c, int glb);
   bool valid_global(int glb);
@@ -130,6 +341,14 @@ public:
   
   int wire_length() const;
   int compute_net_length(int w);
+  NetBox compute_net_box(int w) const;
+  void compute_wire_length();
+  void init_congestion();
+  void add_net_demand(const NetBox &box, double sign);
+  void compute_congestion();
+  double congestion() const;
+  void update_timing();
+  double timing_delta() const;
   unsigned top_port_io_gate(const std::string &net_name);
   
   void place_initial();
@@ -156,15 +375,14 @@ public:
 #endif
   
 public:
-  Placer(random_generator &rg_, DesignState &ds_);
+  Placer(random_generator &rg_, DesignState &ds_, const PlaceOptions &opts_);
   
   void place();
 };
 
 CellType
-Placer::gate_cell_type(int g)
+Placer::inst_cell_type(Instance *inst)
 {
-  Instance *inst = gates[g];
   if (models.is_lc(inst))
     return CellType::LOGIC;
   else if (models.is_ioX(inst))
@@ -198,6 +416,38 @@ Placer::gate_cell_type(int g)
     }
 }
 
+void
+Placer::build_windows()
+{
+  window_diameter = diameter;
+  window_xmin = region_xmin;
+  window_xmax = region_xmax;
+  
+  window_tiles.clear();
+  window_offset.resize(chipdb->n_tiles + 1);
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    {
+      window_offset[t] = window_tiles.size();
+      if (chipdb->tile_type[t] != TileType::LOGIC)
+        continue;
+      
+      int x = chipdb->tile_x(t),
+        y = chipdb->tile_y(t);
+      for (int x2 = std::max(region_xmin, x - diameter);
+           x2 <= std::min(region_xmax, x + diameter);
+           ++x2)
+        for (int y2 = std::max(0, y - diameter);
+             y2 <= std::min(chipdb->height-1, y + diameter);
+             ++y2)
+          {
+            int t2 = chipdb->tile(x2, y2);
+            if (chipdb->tile_type[t2] == TileType::LOGIC)
+              window_tiles.push_back(t2);
+          }
+    }
+  window_offset[chipdb->n_tiles] = window_tiles.size();
+}
+
 int
 Placer::gate_random_cell(int g)
 {
@@ -206,12 +456,56 @@ Placer::gate_random_cell(int g)
     {
       int cell = gate_cell[g];
       int t = chipdb->cell_location[cell].tile();
+      
+      int r = gate_region[g];
+      if (r >= 0)
+        {
+          // the part of the region in range, which may have no
+          // logic tiles, e.g. a RAM column
+          const Region &region = constraints.regions[r];
+          int x = chipdb->tile_x(t),
+            y = chipdb->tile_y(t);
+          int xmin = std::max(std::max(region_xmin, region.xmin),
+                              x - diameter),
+            xmax = std::min(std::min(region_xmax, region.xmax),
+                            x + diameter),
+            ymin = std::max(region.ymin, y - diameter),
+            ymax = std::min(region.ymax, y + diameter);
+          if (xmin > xmax)
+            return cell;
+          for (int i = 0; i < region_tries; ++i)
+            {
+              int new_t = chipdb->tile(rg.random_int(xmin, xmax),
+                                       rg.random_int(ymin, ymax));
+              if (chipdb->tile_type[new_t] == TileType::LOGIC)
+                return chipdb->loc_cell(Location(new_t, rg.random_int(0, 7)));
+            }
+          return cell;
+        }
+      
+      if (diameter <= window_max_diameter)
+        {
+          if (diameter != window_diameter
+              || region_xmin != window_xmin
+              || region_xmax != window_xmax)
+            build_windows();
+          
+          int begin = window_offset[t],
+            end = window_offset[t + 1];
+          if (begin < end)
+            {
+              int new_t = window_tiles[rg.random_int(begin, end - 1)];
+              Location loc(new_t, rg.random_int(0, 7));
+              return chipdb->loc_cell(loc);
+            }
+        }
+      
       int x = chipdb->tile_x(t),
         y = chipdb->tile_y(t);
       
     L:
-      int new_x = rg.random_int(std::max(0, x - diameter),
-                                std::min(chipdb->width-1, x + diameter)),
+      int new_x = rg.random_int(std::max(region_xmin, x - diameter),
+                                std::min(region_xmax, x + diameter)),
         new_y = rg.random_int(std::max(0, y - diameter),
                               std::min(chipdb->height-1, y + diameter));
       int new_t = chipdb->tile(new_x, new_y);
@@ -224,6 +518,9 @@ Placer::gate_random_cell(int g)
   else
     {
       int ct_idx = cell_type_idx(ct);
+      int r = gate_region[g];
+      if (r >= 0)
+        return random_element(region_cells[r][ct_idx], rg);
       return random_element(chipdb->cell_type_cells[ct_idx], rg);
     }
 }
@@ -234,32 +531,283 @@ Placer::chain_random_loc(int c)
   const auto &v = chains.chains[c];
   int nt = (v.size() + 7) / 8;
   
-  int new_x = random_element(logic_columns, rg);
-  int new_start = random_int(1, chipdb->height - 2 - (nt - 1), rg);
+  int new_x, new_start;
+  int r = chain_region[c];
+  if (r >= 0)
+    {
+      const Region &region = constraints.regions[r];
+      int first = std::max(1, region.ymin),
+        last = std::min(chipdb->height - 2, region.ymax) - (nt - 1);
+      new_x = random_element(region_columns[r], rg);
+      new_start = random_int(first, last, rg);
+    }
+  else
+    {
+      new_x = random_element(logic_columns, rg);
+      new_start = random_int(1, chipdb->height - 2 - (nt - 1), rg);
+    }
   int new_end = new_start + nt - 1;
   
-  for (unsigned e = 0; e < chains.chains.size(); ++e)
+  // move_chain can take whole chains along, but not cut one,
+  // including c: no chain may start before new_start and reach it,
+  // or reach past new_end
+  int e = chain_meeting(new_x, new_start, 1, -1, -1);
+  if (e >= 0
+      && chain_start[e] < new_start)
+    return std::make_pair(Location(), false);
+  e = chain_meeting(new_x, new_end, 1, -1, -1);
+  if (e >= 0
+      && chain_start[e] + chain_tiles(e) - 1 > new_end)
+    return std::make_pair(Location(), false);
+  
+  int t = chipdb->tile(new_x, new_start);
+  return std::make_pair(Location(t, 0), true);
+}
+
+void
+Placer::set_chain_pos(int c, int x, int start)
+{
+  if (chain_x[c] >= 0)
+    column_chains[chain_x[c]].erase(std::make_pair(chain_start[c], c));
+  chain_x[c] = x;
+  chain_start[c] = start;
+  column_chains[x].insert(std::make_pair(start, c));
+}
+
+// A chain other than except1 and except2 that meets rows [start,
+// start + nt) of column x, else -1.  The chains before start + nt
+// reach further the later they start, so the search stops at the
+// first that ends before start.
+int
+Placer::chain_meeting(int x, int start, int nt,
+                      int except1, int except2) const
+{
+  const auto &col = column_chains[x];
+  auto i = col.upper_bound(std::make_pair(start + nt - 1,
+                                          std::numeric_limits<int>::max()));
+  while (i != col.begin())
+    {
+      --i;
+      int e = i->second;
+      if (chain_start[e] + chain_tiles(e) - 1 < start)
+        break;
+      if (e != except1
+          && e != except2)
+        return e;
+    }
+  return -1;
+}
+
+// Move each chain c of moves (c, x, start) to rows [start, start +
+// nt) of column x, whole tiles at a time.  The tiles the chains move
+// onto may only hold free gates, which take the tiles the chains
+// left.  Each cell is set once, so restore() undoes it.  Returns
+// false, having changed nothing, if the move is not possible.
+bool
+Placer::move_chains(const std::vector<std::tuple<int, int, int>> &moves)
+{
+  assert(moves.size() <= 2);
+  int c0 = std::get<0>(moves[0]),
+    c1 = moves.size() > 1 ? std::get<0>(moves[1]) : -1;
+  
+  std::vector<int> from, to;
+  for (int i = 0; i < (int)moves.size(); ++i)
     {
-      if (chain_x[e] != new_x)  // including self
-        continue;
+      int c, x, start;
+      std::tie(c, x, start) = moves[i];
+      int nt = chain_tiles(c);
+      if (chain_locked[c]
+          || start < 1
+          || start + nt - 1 > chipdb->height - 2
+          || chain_meeting(x, start, nt, c0, c1) >= 0)
+        return false;
       
-      int e_nt = (chains.chains[e].size() + 7) / 8;
-      int e_start = chain_start[e],
-        e_end = e_start + e_nt - 1;
-      if ((new_start > e_start && new_start <= e_end)
-          || (new_end >= e_start && new_end < e_end))
-        return std::make_pair(Location(), false);
+      int r = chain_region[c];
+      if (r >= 0
+          && !(constraints.regions[r].contains(x, start)
+               && constraints.regions[r].contains(x, start + nt - 1)))
+        return false;
+      
+      for (int j = 0; j < i; ++j)
+        {
+          int c2, x2, start2;
+          std::tie(c2, x2, start2) = moves[j];
+          if (x == x2
+              && start <= start2 + chain_tiles(c2) - 1
+              && start2 <= start + nt - 1)
+            return false;
+        }
+      
+      for (int k = 0; k < nt; ++k)
+        {
+          from.push_back(chipdb->tile(chain_x[c], chain_start[c] + k));
+          to.push_back(chipdb->tile(x, start + k));
+        }
     }
   
-  int t = chipdb->tile(new_x, new_start);
-  return std::make_pair(Location(t, 0), true);
+  // (to, from) tile pairs: the chains' tiles, then the tiles they
+  // move onto to the tiles they leave
+  std::vector<std::pair<int, int>> tile_moves;
+  for (int i = 0; i < (int)from.size(); ++i)
+    tile_moves.push_back(std::make_pair(to[i], from[i]));
+  std::vector<int> sorted_from = from,
+    sorted_to = to,
+    left, taken;
+  std::sort(sorted_from.begin(), sorted_from.end());
+  std::sort(sorted_to.begin(), sorted_to.end());
+  std::set_difference(sorted_from.begin(), sorted_from.end(),
+                      sorted_to.begin(), sorted_to.end(),
+                      std::back_inserter(left));
+  std::set_difference(sorted_to.begin(), sorted_to.end(),
+                      sorted_from.begin(), sorted_from.end(),
+                      std::back_inserter(taken));
+  assert(left.size() == taken.size());
+  for (int i = 0; i < (int)left.size(); ++i)
+    tile_moves.push_back(std::make_pair(left[i], taken[i]));
+  
+  // (cell, gate) to set
+  std::vector<std::pair<int, int>> sets;
+  for (const auto &p : tile_moves)
+    for (int q = 0; q < 8; ++q)
+      {
+        int cell = chipdb->loc_cell(Location(p.first, q)),
+          g = cell_gate[chipdb->loc_cell(Location(p.second, q))];
+        if (g
+            && (locked[g]
+                || !in_region(g, cell)))
+          return false;
+        sets.push_back(std::make_pair(cell, g));
+      }
+  
+  for (const auto &p : sets)
+    save_set(p.first, p.second);
+  return true;
+}
+
+// Without opts.chain_moves, jump the chain to a random place as
+// before.  Otherwise also slide it along its column, swap it with
+// another chain, or move it into a gap between the chains of a
+// nearby column, with the free gates there taking its place.
+void
+Placer::move_free_chain(int c)
+{
+  if (!opts.chain_moves)
+    {
+      std::pair<Location, bool> new_loc = chain_random_loc(c);
+      if (new_loc.second)
+        {
+          assert(!move_failed);
+          move_chain(c, new_loc.first);
+          accept_or_restore();
+        }
+      return;
+    }
+  
+  int nt = chain_tiles(c);
+  int x = chain_x[c],
+    start = chain_start[c];
+  std::vector<std::tuple<int, int, int>> moves;
+  switch (rg.random_int(0, 3))
+    {
+    case 0:
+      {
+        std::pair<Location, bool> new_loc = chain_random_loc(c);
+        if (new_loc.second)
+          {
+            assert(!move_failed);
+            move_chain(c, new_loc.first);
+            accept_or_restore();
+          }
+        return;
+      }
+      
+    case 1:
+      {
+        int step = rg.random_int(-diameter, diameter);
+        if (!step)
+          return;
+        moves.push_back(std::make_tuple(c, x, start + step));
+      }
+      break;
+      
+    case 2:
+      {
+        int e = rg.random_int(0, (int)chains.chains.size() - 1);
+        if (e == c)
+          return;
+        moves.push_back(std::make_tuple(c, chain_x[e], chain_start[e]));
+        moves.push_back(std::make_tuple(e, x, start));
+      }
+      break;
+      
+    case 3:
+      {
+        int r = chain_region[c];
+        const std::vector<int> &columns = (r >= 0
+                                           ? region_columns[r]
+                                           : logic_columns);
+        std::vector<int> near;
+        for (int x2 : columns)
+          {
+            if (std::abs(x2 - x) <= diameter)
+              near.push_back(x2);
+          }
+        if (near.empty())
+          return;
+        int new_x = random_element(near, rg);
+        int row = rg.random_int(std::max(1, start - diameter),
+                                std::min(chipdb->height - 2, start + diameter));
+        
+        // the gap around row, not counting c
+        int first = 1,
+          last = chipdb->height - 2;
+        const auto &col = column_chains[new_x];
+        auto i = col.upper_bound(std::make_pair(row,
+                                                std::numeric_limits<int>::max()));
+        for (auto j = i; j != col.begin();)
+          {
+            --j;
+            int e = j->second;
+            if (e == c)
+              continue;
+            int e_end = chain_start[e] + chain_tiles(e) - 1;
+            if (e_end >= row)
+              return;
+            first = e_end + 1;
+            break;
+          }
+        for (auto j = i; j != col.end(); ++j)
+          {
+            int e = j->second;
+            if (e == c)
+              continue;
+            last = chain_start[e] - 1;
+            break;
+          }
+        if (last - first + 1 < nt)
+          return;
+        
+        int new_start = rg.random_int(std::max(first, row - nt + 1),
+                                      std::min(last - nt + 1, row));
+        if (new_x == x
+            && new_start == start)
+          return;
+        moves.push_back(std::make_tuple(c, new_x, new_start));
+      }
+      break;
+    }
+  
+  assert(!move_failed);
+  if (move_chains(moves))
+    accept_or_restore();
 }
 
 void
 Placer::move_gate(int g, int new_cell)
 {
   assert(g);
-  if (locked[g])
+  if (locked[g]
+      || !in_region(g, new_cell))
     move_failed = true;
   
   int cell = gate_cell[g]; // copy
@@ -267,7 +815,9 @@ Placer::move_gate(int g, int new_cell)
     return;
   
   int new_g = cell_gate[new_cell];
-  if (new_g && locked[new_g])
+  if (new_g
+      && (locked[new_g]
+          || !in_region(new_g, cell)))
     move_failed = true;
   
   save_set(new_cell, g);
@@ -326,6 +876,56 @@ Placer::tile_n_pos(int t)
     }
 }
 
+// All writes to cell_gate go through here so the tile summaries used
+// by valid() stay current.
+void
+Placer::set_cell_gate(int cell, int g)
+{
+  int old_g = cell_gate[cell];
+  if (old_g == g)
+    return;
+  
+  const Location &loc = chipdb->cell_location[cell];
+  int t = loc.tile();
+  if (chipdb->tile_type[t] == TileType::LOGIC)
+    {
+      int q = loc.pos();
+      int i = t * 8 + q;
+      uint8_t bit = 1 << q;
+      if (old_g)
+        tile_n_local_np[t] -= gate_local_np[old_g].size();
+      if (g)
+        {
+          tile_q_clk[i] = gate_clk[g];
+          tile_q_sr[i] = gate_sr[g];
+          tile_q_cen[i] = gate_cen[g];
+          tile_occupied[t] |= bit;
+          if (gate_neg_clk[g])
+            tile_neg_clk[t] |= bit;
+          else
+            tile_neg_clk[t] &= ~bit;
+          tile_n_local_np[t] += gate_local_np[g].size();
+        }
+      else
+        {
+          tile_q_clk[i] = tile_q_sr[i] = tile_q_cen[i] = 0;
+          tile_occupied[t] &= ~bit;
+          tile_neg_clk[t] &= ~bit;
+        }
+    }
+  
+  int b = cell_bank[cell];
+  if (b != -1)
+    {
+      if (old_g && gate_latch[old_g])
+        --bank_n_latch[b];
+      if (g && gate_latch[g])
+        ++bank_n_latch[b];
+    }
+  
+  cell_gate[cell] = g;
+}
+
 void
 Placer::save_set(int cell, int g)
 {
@@ -335,20 +935,17 @@ Placer::save_set(int cell, int g)
   restore_cell.push_back(std::make_pair(cell, cell_gate[cell]));
   if (g)
     {
-      for (int w : gate_nets[g])
-        recompute.insert(w);
+      int x = chipdb->tile_x(t),
+        y = chipdb->tile_y(t);
+      move_pins(g, x, y);
       gate_cell[g] = cell;
       
       int c = gate_chain[g];
       if (c != -1)
-        {
-          int x = chipdb->tile_x(t),
-            y = chipdb->tile_y(t);
-          save_set_chain(c, x, y);
-        }
+        save_set_chain(c, x, y);
     }
   
-  cell_gate[cell] = g;
+  set_cell_gate(cell, g);
   
   changed_tiles.insert(t);
   for (int t2 : related_tiles[t])
@@ -359,8 +956,78 @@ void
 Placer::save_set_chain(int c, int x, int start)
 {
   restore_chain.push_back(std::make_tuple(c, chain_x[c], chain_start[c]));
-  chain_x[c] = x;
-  chain_start[c] = start;
+  set_chain_pos(c, x, start);
+}
+
+// Move one edge of a box for a pin moving from u0 to u1.  Returns
+// false if the pin was the last one on the edge it left.
+static bool
+move_edge(int u0, int u1, int &lo, int &n_lo, int &hi, int &n_hi)
+{
+  if (u1 < u0)
+    {
+      if (u0 == hi)
+        {
+          if (n_hi == 1)
+            return false;
+          --n_hi;
+        }
+      if (u1 < lo)
+        {
+          lo = u1;
+          n_lo = 1;
+        }
+      else if (u1 == lo)
+        ++n_lo;
+    }
+  else if (u1 > u0)
+    {
+      if (u0 == lo)
+        {
+          if (n_lo == 1)
+            return false;
+          --n_lo;
+        }
+      if (u1 > hi)
+        {
+          hi = u1;
+          n_hi = 1;
+        }
+      else if (u1 == hi)
+        ++n_hi;
+    }
+  return true;
+}
+
+// Update the boxes of the nets on g for g moving to (x, y).
+void
+Placer::move_pins(int g, int x, int y)
+{
+  int x0 = gate_x[g],
+    y0 = gate_y[g];
+  restore_gate_xy.push_back(std::make_tuple(g, x0, y0));
+  gate_x[g] = x;
+  gate_y[g] = y;
+  
+  for (int w : gate_nets[g])
+    {
+      if (net_global[w])
+        continue;
+      
+      NetBox &box = net_box[w];
+      if (!recompute.contains(w))
+        {
+          recompute.insert(w);
+          restore_net_box.push_back(std::make_pair(w, box));
+        }
+      if (rescan.contains(w))
+        continue;
+      
+      if ((int)net_gates[w].size() < min_incremental_pins
+          || !move_edge(x0, x, box.x_min, box.n_x_min, box.x_max, box.n_x_max)
+          || !move_edge(y0, y, box.y_min, box.n_y_min, box.y_max, box.n_y_max))
+        rescan.insert(w);
+    }
 }
 
 int
@@ -370,9 +1037,10 @@ Placer::save_recompute_wire_length()
   for (int i = 0; i < (int)recompute.size(); ++i)
     {
       int w = recompute.ith(i);
-      int new_length = compute_net_length(w),
-        old_length = net_length.at(w);
-      restore_net_length.push_back(std::make_pair(w, old_length));
+      if (rescan.contains(w))
+        net_box[w] = compute_net_box(w);
+      int new_length = net_box[w].length(),
+        old_length = net_length[w];
       net_length[w] = new_length;
       delta += (new_length - old_length);
     }
@@ -385,18 +1053,36 @@ Placer::restore()
   move_failed = false;
   for (const auto &p : restore_cell)
     {
-      cell_gate[p.first] = p.second;
+      set_cell_gate(p.first, p.second);
       if (p.second)
         gate_cell[p.second] = p.first;
     }
-  for (const auto &p : restore_net_length)
-    net_length[p.first] = p.second;
-  for (const auto &t : restore_chain)
+  for (int i = restore_gate_xy.size(); i-- > 0;)
+    {
+      int g, x, y;
+      std::tie(g, x, y) = restore_gate_xy[i];
+      gate_x[g] = x;
+      gate_y[g] = y;
+    }
+  for (const auto &p : restore_net_box)
+    {
+      net_box[p.first] = p.second;
+      net_length[p.first] = p.second.length();
+    }
+  for (const auto &r : restore_demand)
+    {
+      int t;
+      double h, v;
+      std::tie(t, h, v) = r;
+      tile_demand_h[t] = h;
+      tile_demand_v[t] = v;
+    }
+  // backwards, so a chain moved twice goes back to the first place
+  for (int i = restore_chain.size(); i-- > 0;)
     {
       int e, x, start;
-      std::tie(e, x, start) = t;
-      chain_x[e] = x;
-      chain_start[e] = start;
+      std::tie(e, x, start) = restore_chain[i];
+      set_chain_pos(e, x, start);
     }
 }
 
@@ -406,8 +1092,12 @@ Placer::discard()
   changed_tiles.clear();
   restore_cell.clear();
   restore_chain.clear();
-  restore_net_length.clear();
+  restore_gate_xy.clear();
+  restore_net_box.clear();
   recompute.clear();
+  rescan.clear();
+  demand_tiles.clear();
+  restore_demand.clear();
 }
 
 bool
@@ -420,21 +1110,21 @@ Placer::inst_drives_global(Instance *inst, int c, int glb)
     y = chipdb->tile_y(t);
 #endif
   if (models.is_gb_io(inst)
-      && inst->find_port("GLOBAL_BUFFER_OUTPUT")->connected())
+      && inst->find_port(sym_GLOBAL_BUFFER_OUTPUT)->connected())
     {
       assert(chipdb->loc_pin_glb_num.at(loc) == glb);
       return true;
     }
   
   if (models.is_gb(inst)
-      && inst->find_port("GLOBAL_BUFFER_OUTPUT")->connected())
+      && inst->find_port(sym_GLOBAL_BUFFER_OUTPUT)->connected())
     {
       assert(chipdb->gbufin.at(std::make_pair(x, y)) == glb);
       return true;
     }
   
   if (models.is_hfosc(inst)
-    && inst->find_port("CLKHF")->connected()) {
+    && inst->find_port(sym_CLKHF)->connected()) {
       if(!inst->is_attr_set("ROUTE_THROUGH_FABRIC")) {
           int driven_glb = chipdb->get_oscillator_glb(c, "CLKHF");
           if(glb == driven_glb)
@@ -443,7 +1133,7 @@ Placer::inst_drives_global(Instance *inst, int c, int glb)
   }
   
   if (models.is_lfosc(inst)
-    && inst->find_port("CLKLF")->connected()) {
+    && inst->find_port(sym_CLKLF)->connected()) {
       if(!inst->is_attr_set("ROUTE_THROUGH_FABRIC")) {
           int driven_glb = chipdb->get_oscillator_glb(c, "CLKLF");
           if(glb == driven_glb)
@@ -453,9 +1143,9 @@ Placer::inst_drives_global(Instance *inst, int c, int glb)
   
   if (models.is_pllX(inst))
     {
-      Port *a = inst->find_port("PLLOUTGLOBAL");
+      Port *a = inst->find_port(sym_PLLOUTGLOBAL);
       if (!a)
-        a = inst->find_port("PLLOUTGLOBALA");
+        a = inst->find_port(sym_PLLOUTGLOBALA);
       assert(a);
       if (a->connected())
         {
@@ -465,7 +1155,7 @@ Placer::inst_drives_global(Instance *inst, int c, int glb)
             return true;
         }
       
-      Port *b = inst->find_port("PLLOUTGLOBALB");
+      Port *b = inst->find_port(sym_PLLOUTGLOBALB);
       if (b && b->connected())
         {
           const auto &p2 = chipdb->cell_mfvs.at(c).at("PLLOUT_B");
@@ -508,20 +1198,17 @@ Placer::valid(int t)
       int global_clk = 0,
         global_sr = 0,
         global_cen = 0;
-      int neg_clk = -1;
-      tmp_local_np.clear();
+      unsigned occupied = tile_occupied[t];
+      const int *q_clk = &tile_q_clk[t * 8],
+        *q_sr = &tile_q_sr[t * 8],
+        *q_cen = &tile_q_cen[t * 8];
       for (int q = 0; q < 8; q ++)
         {
-          Location loc(t, q);
-          int cell = chipdb->loc_cell(loc);
-          int g = cell_gate[cell];
-          if (g)
+          if (occupied & (1 << q))
             {
-              Instance *inst = gates[g];
-              
-              int clk = gate_clk[g],
-                sr = gate_sr[g],
-                cen = gate_cen[g];
+              int clk = q_clk[q],
+                sr = q_sr[q],
+                cen = q_cen[q];
               
               if (!global_clk)
                 global_clk = clk;
@@ -537,49 +1224,63 @@ Placer::valid(int t)
                 global_cen = cen;
               else if (global_cen != cen)
                 return false;
-              
-              int g_neg_clk = (int)inst->get_param("NEG_CLK").get_bit(0);
-              if (neg_clk == -1)
-                neg_clk = g_neg_clk;
-              else if (neg_clk != g_neg_clk)
-                return false;
-              
-              for (int np : gate_local_np[g])
-                tmp_local_np.insert(np ^ (q & 1));
             }
         }
       
-      if (global_clk
-          && !net_global[global_clk])
-        tmp_local_np.insert(global_clk << 1);
-      if (global_sr
-          && !net_global[global_sr])
-        tmp_local_np.insert(global_sr << 1);
-      if (global_cen
-          && !net_global[global_cen])
-        tmp_local_np.insert(global_cen << 1);
-      
-      if (tmp_local_np.size() > 29)
+      unsigned neg_clk = tile_neg_clk[t];
+      if (neg_clk
+          && neg_clk != occupied)
         return false;
+      
+      // most tiles can't reach the limit even if no pairs are shared
+      if (tile_n_local_np[t] + 3 > 29)
+        {
+          tmp_local_np.clear();
+          for (int q = 0; q < 8; q ++)
+            {
+              if (!(occupied & (1 << q)))
+                continue;
+              int g = cell_gate[chipdb->loc_cell(Location(t, q))];
+              for (int np : gate_local_np[g])
+                tmp_local_np.insert(np ^ (q & 1));
+            }
+          
+          if (global_clk
+              && !net_global[global_clk])
+            tmp_local_np.insert(global_clk << 1);
+          if (global_sr
+              && !net_global[global_sr])
+            tmp_local_np.insert(global_sr << 1);
+          if (global_cen
+              && !net_global[global_cen])
+            tmp_local_np.insert(global_cen << 1);
+          
+          if (tmp_local_np.size() > 29)
+            return false;
+        }
     }
   else if (chipdb->tile_type[t] == TileType::IO)
     {
       int b = chipdb->tile_bank(t);
       
-      int latch = 0;
-      for (int cell : chipdb->bank_cells[b])
+      // only banks with a latch net need the scan
+      if (bank_n_latch[b])
         {
-          int g = cell_gate[cell];
-          if (g)
+          int latch = 0;
+          for (int cell : chipdb->bank_cells[b])
             {
-              int n = gate_latch[g];
-              if (latch)
+              int g = cell_gate[cell];
+              if (g)
                 {
-                  if (latch != n)
-                    return false;
+                  int n = gate_latch[g];
+                  if (latch)
+                    {
+                      if (latch != n)
+                        return false;
+                    }
+                  else
+                    latch = n;
                 }
-              else
-                latch = n;
             }
         }
       
@@ -594,16 +1295,14 @@ Placer::valid(int t)
           if (!contains(package.loc_pin, loc0))
             return false;
           
-          Instance *inst0 = gates[g0];
-          if (inst0->get_param("IO_STANDARD").as_string() == "SB_LVDS_INPUT")
+          if (gate_lvds_input[g0])
             {
               if (b != 3 && chipdb->device != "5k")
                 return false;
               if (g1)
                 return false;
             }
-          if (models.is_gb_io(inst0)
-              && inst0->find_port("GLOBAL_BUFFER_OUTPUT")->connected())
+          if (gate_gb_io_global[g0])
             {
               int glb = chipdb->loc_pin_glb_num.at(loc0);
               if (!valid_global(glb))
@@ -615,11 +1314,9 @@ Placer::valid(int t)
           if (!contains(package.loc_pin, loc1))
             return false;
           
-          Instance *inst1 = gates[g1];
-          if (inst1->get_param("IO_STANDARD").as_string() == "SB_LVDS_INPUT")
+          if (gate_lvds_input[g1])
             return false;
-          if (models.is_gb_io(inst1)
-              && inst1->find_port("GLOBAL_BUFFER_OUTPUT")->connected())
+          if (gate_gb_io_global[g1])
             {
               int glb = chipdb->loc_pin_glb_num.at(loc1);
               if (!valid_global(glb))
@@ -629,24 +1326,21 @@ Placer::valid(int t)
       
       if (g0 && g1)
         {
-          Instance *inst0 = gates[g0],
-            *inst1 = gates[g1];
-          if (inst0->get_param("NEG_TRIGGER").get_bit(0)
-              != inst1->get_param("NEG_TRIGGER").get_bit(0))
+          if (gate_neg_trigger[g0] != gate_neg_trigger[g1])
             return false;
           
-          Net *cen0 = inst0->find_port("CLOCK_ENABLE")->connection(),
-            *cen1 = inst1->find_port("CLOCK_ENABLE")->connection();
+          int cen0 = gate_io_cen[g0],
+            cen1 = gate_io_cen[g1];
           if (cen0 && cen1 && cen0 != cen1)
             return false;
           
-          Net *inclk0 = inst0->find_port("INPUT_CLK")->connection(),
-            *inclk1 = inst1->find_port("INPUT_CLK")->connection();
+          int inclk0 = gate_io_inclk[g0],
+            inclk1 = gate_io_inclk[g1];
           if (inclk0 && inclk1 && inclk0 != inclk1)
             return false;
           
-          Net *outclk0 = inst0->find_port("OUTPUT_CLK")->connection(),
-            *outclk1 = inst1->find_port("OUTPUT_CLK")->connection();
+          int outclk0 = gate_io_outclk[g0],
+            outclk1 = gate_io_outclk[g1];
           if (outclk0 && outclk1 && outclk0 != outclk1)
             return false;
         }
@@ -678,9 +1372,9 @@ Placer::valid(int t)
           if (contains(chipdb->cell_locked_pkgs.at(cell3), package.name))
             return false;
           
-          Port *pa = inst3->find_port("PLLOUTGLOBAL");
+          Port *pa = inst3->find_port(sym_PLLOUTGLOBAL);
           if (!pa)
-            pa = inst3->find_port("PLLOUTGLOBALA");
+            pa = inst3->find_port(sym_PLLOUTGLOBALA);
           assert(pa);
           if (pa->connected())
             {
@@ -691,7 +1385,7 @@ Placer::valid(int t)
                 return false;
             }
           
-          Port *pb = inst3->find_port("PLLOUTGLOBALB");
+          Port *pb = inst3->find_port(sym_PLLOUTGLOBALB);
           if (pb && pb->connected())
             {
               const auto &p2 = chipdb->cell_mfvs.at(cell3).at("PLLOUT_B");
@@ -709,7 +1403,7 @@ Placer::valid(int t)
           int gA = cell_gate[cA];
           Instance *instA = gA ? gates[gA] : nullptr;
           
-          if (instA && instA->find_port("D_IN_0")->connection())
+          if (instA && instA->find_port(sym_D_IN_0)->connection())
             return false;
           
           if (inst3->instance_of()->name() == "SB_PLL40_2F_CORE"
@@ -724,7 +1418,7 @@ Placer::valid(int t)
               int gB = cell_gate[cB];
               Instance *instB = gB ? gates[gB] : nullptr;
           
-              if (instB && instB->find_port("D_IN_0")->connection())
+              if (instB && instB->find_port(sym_D_IN_0)->connection())
                 return false;
             }
         }
@@ -788,10 +1482,27 @@ Placer::valid(int t)
   return true;
 }
 
+double
+Placer::accept_probability(double delta)
+{
+  int k = (int)delta;
+  if (k != delta
+      || k >= accept_table_size)
+    return exp(-delta/temp);
+  
+  if (temp != accept_temp)
+    {
+      accept_temp = temp;
+      for (int i = 0; i < accept_table_size; ++i)
+        accept_prob[i] = exp(-i/temp);
+    }
+  return accept_prob[k];
+}
+
 void
 Placer::accept_or_restore()
 {
-  int delta;
+  double delta;
 
   if (move_failed)
     goto L;
@@ -803,13 +1514,20 @@ Placer::accept_or_restore()
     }
   
   delta = save_recompute_wire_length();
+  if (opts.congestion_weight > 0)
+    delta += opts.congestion_weight * save_recompute_congestion();
+  if (timing)
+    delta += timing_delta();
   
   // check();
   
   ++n_move;
+  ++n_delta;
+  delta_sum += delta;
+  delta_sq_sum += (double)delta * delta;
   if (delta < 0
       || (temp > 1e-6
-          && rg.random_real(0.0, 1.0) <= exp(-delta/temp)))
+          && rg.random_real(0.0, 1.0) <= accept_probability(delta)))
     {
       if (delta < 0)
         {
@@ -875,26 +1593,113 @@ Placer::check()
       int nt = (v.size() + 7) / 8;
       int start = chain_start[c];
       assert(start + nt - 1 <= chipdb->height - 2);
+      assert(contains(column_chains[chain_x[c]],
+                      std::make_pair(start, (int)c)));
     }
-  for (int w = 1; w < (int)nets.size(); ++w) // skip 0, nullptr
-    assert(net_length[w] == compute_net_length(w));
-}
-#endif
-
-int
-Placer::compute_net_length(int w)
-{
-  if (net_global[w]
-      || net_gates[w].empty())
-    return 0;
-  
-  const std::vector<int> &w_gates = net_gates[w];
-  
-  int g0 = w_gates[0];
-  int cell0 = gate_cell[g0];
-  const Location &loc0 = chipdb->cell_location[cell0];
-  int t0 = loc0.tile();
-  int x_min = chipdb->tile_x(t0),
+  for (int g = 1; g <= n_gates; ++g)
+    {
+      int t = chipdb->cell_location[gate_cell[g]].tile();
+      assert(gate_x[g] == chipdb->tile_x(t)
+             && gate_y[g] == chipdb->tile_y(t));
+      assert(locked[g]
+             || in_region(g, gate_cell[g]));
+    }
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    {
+      if (chipdb->tile_type[t] != TileType::LOGIC)
+        continue;
+      unsigned occupied = 0,
+        neg_clk = 0;
+      int n_local_np = 0;
+      for (int q = 0; q < 8; ++q)
+        {
+          int g = cell_gate[chipdb->loc_cell(Location(t, q))];
+          int i = t * 8 + q;
+          assert(tile_q_clk[i] == (g ? gate_clk[g] : 0)
+                 && tile_q_sr[i] == (g ? gate_sr[g] : 0)
+                 && tile_q_cen[i] == (g ? gate_cen[g] : 0));
+          if (g)
+            {
+              occupied |= 1 << q;
+              if (gate_neg_clk[g])
+                neg_clk |= 1 << q;
+              n_local_np += gate_local_np[g].size();
+            }
+        }
+      assert(tile_occupied[t] == occupied
+             && tile_neg_clk[t] == neg_clk
+             && tile_n_local_np[t] == n_local_np);
+    }
+  for (int b = 0; b < (int)chipdb->bank_cells.size(); ++b)
+    {
+      int n = 0;
+      for (int cell : chipdb->bank_cells[b])
+        {
+          int g = cell_gate[cell];
+          if (g && gate_latch[g])
+            ++n;
+        }
+      assert(bank_n_latch[b] == n);
+    }
+  for (int w = 1; w < (int)nets.size(); ++w) // skip 0, nullptr
+    {
+      assert(net_length[w] == compute_net_length(w));
+      
+      const NetBox &box = net_box[w],
+        box2 = compute_net_box(w);
+      assert(box.x_min == box2.x_min
+             && box.x_max == box2.x_max
+             && box.y_min == box2.y_min
+             && box.y_max == box2.y_max
+             && box.n_x_min == box2.n_x_min
+             && box.n_x_max == box2.n_x_max
+             && box.n_y_min == box2.n_y_min
+             && box.n_y_max == box2.n_y_max);
+    }
+}
+#endif
+
+// Analyze timing at the current gate positions and weight each net by
+// its criticality, sharpened so that only the nets near the critical
+// path carry much weight, as in VPR.
+void
+Placer::update_timing()
+{
+  static const double crit_exponent = 8;
+  
+  timing->estimate_wires(gate_x, gate_y);
+  timing->analyze();
+  for (int w = 0; w < (int)nets.size(); ++w)
+    net_timing_weight[w] = (opts.timing_weight
+                            * std::pow(timing->net_crit(w), crit_exponent));
+}
+
+// the change in the weighted length of the nets the current move
+// changed
+double
+Placer::timing_delta() const
+{
+  double delta = 0;
+  for (const auto &p : restore_net_box)
+    delta += (net_timing_weight[p.first]
+              * (net_length[p.first] - p.second.length()));
+  return delta;
+}
+
+int
+Placer::compute_net_length(int w)
+{
+  if (net_global[w]
+      || net_gates[w].empty())
+    return 0;
+  
+  const std::vector<int> &w_gates = net_gates[w];
+  
+  int g0 = w_gates[0];
+  int cell0 = gate_cell[g0];
+  const Location &loc0 = chipdb->cell_location[cell0];
+  int t0 = loc0.tile();
+  int x_min = chipdb->tile_x(t0),
     x_max = chipdb->tile_x(t0),
     y_min = chipdb->tile_y(t0),
     y_max = chipdb->tile_y(t0);
@@ -917,6 +1722,189 @@ Placer::compute_net_length(int w)
   return (x_max - x_min) + (y_max - y_min);
 }
 
+NetBox
+Placer::compute_net_box(int w) const
+{
+  NetBox box;
+  if (net_global[w]
+      || net_gates[w].empty())
+    return box;
+  
+  const std::vector<int> &w_gates = net_gates[w];
+  int g0 = w_gates[0];
+  box.x_min = box.x_max = gate_x[g0];
+  box.y_min = box.y_max = gate_y[g0];
+  for (int g : w_gates)
+    {
+      int x = gate_x[g],
+        y = gate_y[g];
+      box.x_min = std::min(box.x_min, x);
+      box.x_max = std::max(box.x_max, x);
+      box.y_min = std::min(box.y_min, y);
+      box.y_max = std::max(box.y_max, y);
+    }
+  
+  // edge counts are only kept for nets updated incrementally
+  if ((int)w_gates.size() >= min_incremental_pins)
+    {
+      for (int g : w_gates)
+        {
+          int x = gate_x[g],
+            y = gate_y[g];
+          box.n_x_min += (x == box.x_min);
+          box.n_x_max += (x == box.x_max);
+          box.n_y_min += (y == box.y_min);
+          box.n_y_max += (y == box.y_max);
+        }
+    }
+  return box;
+}
+
+// Set gate positions and net boxes from scratch after gate_cell has
+// been changed outside of a move.
+void
+Placer::compute_wire_length()
+{
+  for (int g = 1; g <= n_gates; ++g)
+    {
+      int t = chipdb->cell_location[gate_cell[g]].tile();
+      gate_x[g] = chipdb->tile_x(t);
+      gate_y[g] = chipdb->tile_y(t);
+    }
+  for (int w = 0; w < (int)nets.size(); ++w)
+    {
+      net_box[w] = compute_net_box(w);
+      net_length[w] = net_box[w].length();
+    }
+  if (opts.congestion_weight > 0)
+    compute_congestion();
+}
+
+static double
+tile_overflow(double demand, double capacity)
+{
+  // tiles without span wires, like the corners, are not counted
+  if (!capacity
+      || demand <= capacity)
+    return 0;
+  return (demand - capacity) * (demand - capacity);
+}
+
+void
+Placer::init_congestion()
+{
+  // of the span wires, leaving room for detours and for nets that
+  // need more than their box
+  static const double target_use = 0.5;
+  
+  tile_capacity_h.assign(chipdb->n_tiles, 0);
+  tile_capacity_v.assign(chipdb->n_tiles, 0);
+  for (int n = 0; n < chipdb->n_nets; ++n)
+    {
+      NetClass c = chipdb->net_class[n];
+      if (c != NetClass::SPAN4
+          && c != NetClass::SPAN12)
+        continue;
+      const NetBBox &b = chipdb->net_bbox[n];
+      bool horizontal = b.xmax > b.xmin,
+        vertical = b.ymax > b.ymin;
+      if (horizontal == vertical)
+        continue;
+      std::vector<double> &capacity = (horizontal
+                                       ? tile_capacity_h
+                                       : tile_capacity_v);
+      for (int x = b.xmin; x <= b.xmax; ++x)
+        for (int y = b.ymin; y <= b.ymax; ++y)
+          capacity[chipdb->tile(x, y)] += target_use;
+    }
+  
+  tile_demand_h.assign(chipdb->n_tiles, 0);
+  tile_demand_v.assign(chipdb->n_tiles, 0);
+  demand_tiles.resize(chipdb->n_tiles);
+}
+
+void
+Placer::add_net_demand(const NetBox &box, double sign)
+{
+  int width = box.x_max - box.x_min + 1,
+    height = box.y_max - box.y_min + 1;
+  if (width == 1
+      && height == 1)
+    return;
+  
+  double area = width * height,
+    dh = sign * (width - 1) / area,
+    dv = sign * (height - 1) / area;
+  for (int x = box.x_min; x <= box.x_max; ++x)
+    for (int y = box.y_min; y <= box.y_max; ++y)
+      {
+        int t = chipdb->tile(x, y);
+        if (!demand_tiles.contains(t))
+          {
+            demand_tiles.insert(t);
+            restore_demand.push_back(std::make_tuple(t,
+                                                     tile_demand_h[t],
+                                                     tile_demand_v[t]));
+          }
+        tile_demand_h[t] += dh;
+        tile_demand_v[t] += dv;
+      }
+}
+
+// Move the demand of the nets the current move changed and return the
+// change in congestion.
+double
+Placer::save_recompute_congestion()
+{
+  for (const auto &p : restore_net_box)
+    {
+      const NetBox &old_box = p.second,
+        &new_box = net_box[p.first];
+      if (old_box.x_min == new_box.x_min
+          && old_box.x_max == new_box.x_max
+          && old_box.y_min == new_box.y_min
+          && old_box.y_max == new_box.y_max)
+        continue;
+      add_net_demand(old_box, -1);
+      add_net_demand(new_box, 1);
+    }
+  
+  double delta = 0;
+  for (const auto &r : restore_demand)
+    {
+      int t;
+      double h, v;
+      std::tie(t, h, v) = r;
+      delta += (tile_overflow(tile_demand_h[t], tile_capacity_h[t])
+                + tile_overflow(tile_demand_v[t], tile_capacity_v[t])
+                - tile_overflow(h, tile_capacity_h[t])
+                - tile_overflow(v, tile_capacity_v[t]));
+    }
+  return delta;
+}
+
+void
+Placer::compute_congestion()
+{
+  std::fill(tile_demand_h.begin(), tile_demand_h.end(), 0);
+  std::fill(tile_demand_v.begin(), tile_demand_v.end(), 0);
+  for (int w = 0; w < (int)nets.size(); ++w)
+    if (!net_global[w])
+      add_net_demand(net_box[w], 1);
+  demand_tiles.clear();
+  restore_demand.clear();
+}
+
+double
+Placer::congestion() const
+{
+  double c = 0;
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    c += (tile_overflow(tile_demand_h[t], tile_capacity_h[t])
+          + tile_overflow(tile_demand_v[t], tile_capacity_v[t]));
+  return c;
+}
+
 int
 Placer::wire_length() const
 {
@@ -926,8 +1914,10 @@ Placer::wire_length() const
   return length;
 }
 
-Placer::Placer(random_generator &rg_, DesignState &ds_)
+Placer::Placer(random_generator &rg_, DesignState &ds_,
+               const PlaceOptions &opts_)
   : rg(rg_),
+    opts(opts_),
     ds(ds_),
     chipdb(ds.chipdb),
     package(ds.package),
@@ -939,14 +1929,45 @@ Placer::Placer(random_generator &rg_, DesignState &ds_)
     gb_inst_gc(ds.gb_inst_gc),
     placement(ds.placement),
     conf(ds.conf),
+    index(ds.netlist_index()),
     related_tiles(chipdb->n_tiles),
+    nets(index.nets),
+    net_idx(index.net_idx),
+    n_gates(index.n_gates()),
+    gates(index.gates),
+    gate_idx(index.gate_idx),
+    has_regions(false),
     diameter(std::max(chipdb->width,
                       chipdb->height)),
+    region_xmin(0),
+    region_xmax(chipdb->width - 1),
+    window_diameter(-1),
+    window_xmin(-1),
+    window_xmax(-1),
     temp(10000.0),
+    accept_prob(accept_table_size),
+    accept_temp(-1),
+    n_delta(0),
+    delta_sum(0),
+    delta_sq_sum(0),
     move_failed(false),
     changed_tiles(chipdb->n_tiles),
     cell_gate(chipdb->n_cells, 0)
 {
+  tile_q_clk.resize(chipdb->n_tiles * 8, 0);
+  tile_q_sr.resize(chipdb->n_tiles * 8, 0);
+  tile_q_cen.resize(chipdb->n_tiles * 8, 0);
+  tile_occupied.resize(chipdb->n_tiles, 0);
+  if (opts.congestion_weight > 0)
+    init_congestion();
+  tile_neg_clk.resize(chipdb->n_tiles, 0);
+  tile_n_local_np.resize(chipdb->n_tiles, 0);
+  cell_bank.resize(chipdb->n_cells + 1, -1);
+  bank_n_latch.resize(chipdb->bank_cells.size(), 0);
+  for (int b = 0; b < (int)chipdb->bank_cells.size(); ++b)
+    for (int cell : chipdb->bank_cells[b])
+      cell_bank[cell] = b;
+  
   for (const auto &p : chipdb->loc_pin_glb_num)
     {
       const Location &loc = p.first;
@@ -1004,108 +2025,1242 @@ Placer::Placer(random_generator &rg_, DesignState &ds_)
         }
       else if(chipdb->cell_type[i] == CellType::LFOSC)
         {
-          global_cells[chipdb->get_oscillator_glb(i, "CLKLF")].push_back(i);
+          global_cells[chipdb->get_oscillator_glb(i, "CLKLF")].push_back(i);
+        }
+    }
+  
+  for (int i = 0; i < chipdb->width; ++i)
+    {
+      int t = chipdb->tile(i, 1);
+      if (chipdb->tile_type[t] == TileType::LOGIC)
+        logic_columns.push_back(i);
+    }
+  for (int i = 0; i < chipdb->n_tiles; ++i)
+    {
+      switch(chipdb->tile_type[i])
+        {
+        case TileType::LOGIC:
+          logic_tiles.push_back(i);
+          break;
+        case TileType::RAMT:
+          ramt_tiles.push_back(i);
+          break;
+        default:
+          break;
+        }
+    }
+
+  int n_nets = nets.size();
+  
+  net_global.resize(n_nets);
+  
+  net_length.resize(n_nets);
+  net_box.resize(n_nets);
+  net_gates.resize(n_nets);
+  recompute.resize(n_nets);
+  rescan.resize(n_nets);
+  if (opts.timing_weight > 0)
+    {
+      timing.reset(new Timing(ds));
+      net_timing_weight.resize(n_nets, 0);
+    }
+  
+  gate_clk.resize(n_gates, 0);
+  gate_sr.resize(n_gates, 0);
+  gate_cen.resize(n_gates, 0);
+  gate_latch.resize(n_gates, 0);
+  gate_type.resize(n_gates);
+  gate_neg_clk.resize(n_gates);
+  gate_lvds_input.resize(n_gates);
+  gate_neg_trigger.resize(n_gates);
+  gate_gb_io_global.resize(n_gates);
+  gate_io_cen.resize(n_gates, 0);
+  gate_io_inclk.resize(n_gates, 0);
+  gate_io_outclk.resize(n_gates, 0);
+  gate_local_np.resize(n_gates);
+  tmp_local_np.resize(n_nets * 2);
+  gate_chain.resize(n_gates, -1);
+  
+  gate_cell.resize(n_gates);
+  gate_x.resize(n_gates);
+  gate_y.resize(n_gates);
+  gate_nets.resize(n_gates);
+  
+  for (int i = 1; i <= n_gates; ++i)
+    {
+      Instance *inst = gates[i];
+      gate_type[i] = inst_cell_type(inst);
+      if (models.is_ioX(inst))
+        {
+          gate_lvds_input[i] = (inst->get_param("IO_STANDARD").as_string()
+                                == "SB_LVDS_INPUT");
+          gate_neg_trigger[i] = inst->get_param("NEG_TRIGGER").get_bit(0);
+          gate_gb_io_global[i] = (models.is_gb_io(inst)
+                                  && inst->find_port(sym_GLOBAL_BUFFER_OUTPUT)->connected());
+          
+          Net *cen = inst->find_port(sym_CLOCK_ENABLE)->connection();
+          if (cen)
+            gate_io_cen[i] = net_idx.at(cen);
+          Net *inclk = inst->find_port(sym_INPUT_CLK)->connection();
+          if (inclk)
+            gate_io_inclk[i] = net_idx.at(inclk);
+          Net *outclk = inst->find_port(sym_OUTPUT_CLK)->connection();
+          if (outclk)
+            gate_io_outclk[i] = net_idx.at(outclk);
+        }
+      
+      if (models.is_lc(inst))
+        {
+          gate_neg_clk[i] = inst->get_param("NEG_CLK").get_bit(0);
+          
+          Net *clk = inst->find_port(sym_CLK)->connection();
+          if (clk)
+            gate_clk[i] = net_idx.at(clk);
+          
+          Net *sr = inst->find_port(sym_SR)->connection();
+          if (sr)
+            gate_sr[i] = net_idx.at(sr);
+          
+          Net *cen = inst->find_port(sym_CEN)->connection();
+          if (cen)
+            gate_cen[i] = net_idx.at(cen);
+          
+          tmp_local_np.clear();
+          for (int j = 0; j < 4; ++j)
+            {
+              Net *n = inst->find_port(sym_I[j])->connection();
+              if (n
+                  && !n->is_constant())
+                tmp_local_np.insert((net_idx.at(n) << 1) | (j & 1));
+            }
+          
+          for (int j = 0; j < (int)tmp_local_np.size(); ++j)
+            gate_local_np[i].push_back(tmp_local_np.ith(j));
+        }
+      else if (models.is_io(inst))
+        {
+          Net *latch = inst->find_port(sym_LATCH_INPUT_VALUE)->connection();
+          if (latch)
+            gate_cen[i] = net_idx.at(latch);
+        }
+      else if (models.is_gb(inst))
+        {
+          Net *n = inst->find_port(sym_GLOBAL_BUFFER_OUTPUT)->connection();
+          if (n)
+            net_global[net_idx.at(n)] = true;
+        }
+      else if (models.is_hfosc(inst))
+        {
+          Net *n = inst->find_port(sym_CLKHF)->connection();
+          if (n && !inst->is_attr_set("ROUTE_THROUGH_FABRIC"))
+            net_global[net_idx.at(n)] = true;
+        }
+      else if (models.is_lfosc(inst))
+        {
+          Net *n = inst->find_port(sym_CLKLF)->connection();
+          if (n && !inst->is_attr_set("ROUTE_THROUGH_FABRIC"))
+            net_global[net_idx.at(n)] = true;
+        }
+    }
+  
+  init_regions();
+}
+
+void
+Placer::init_regions()
+{
+  const std::vector<Region> &regions = constraints.regions;
+  gate_region.resize(n_gates, -1);
+  chain_region.resize(chains.chains.size(), -1);
+  if (regions.empty())
+    return;
+  
+  std::vector<int> n_matched(regions.size(), 0);
+  for (int g = 1; g <= n_gates; ++g)
+    {
+      for (Port *p : gates[g]->ports())
+        {
+          if (!p->is_output()
+              || !p->connected())
+            continue;
+          const std::string &name = p->connection()->name();
+          for (int r = 0; r < (int)regions.size(); ++r)
+            {
+              if (gate_region[g] >= 0
+                  && r >= gate_region[g])
+                break;
+              if (regions[r].matches(name))
+                gate_region[g] = r;
+            }
+        }
+      if (gate_region[g] >= 0)
+        {
+          ++n_matched[gate_region[g]];
+          has_regions = true;
+        }
+    }
+  
+  for (int c = 0; c < (int)chains.chains.size(); ++c)
+    {
+      int r = -1;
+      for (Instance *inst : chains.chains[c])
+        {
+          int g = gate_idx.at(inst);
+          if (gate_region[g] >= 0
+              && (r < 0 || gate_region[g] < r))
+            r = gate_region[g];
+        }
+      chain_region[c] = r;
+      for (Instance *inst : chains.chains[c])
+        gate_region[gate_idx.at(inst)] = r;
+    }
+  
+  for (int r = 0; r < (int)regions.size(); ++r)
+    {
+      if (!n_matched[r])
+        warning(fmt("set_region: no gates match `"
+                    << regions[r].pattern << "'"));
+    }
+  
+  region_columns.resize(regions.size());
+  region_cells.resize(regions.size(),
+                      std::vector<std::vector<int>>(n_cell_types));
+  for (int r = 0; r < (int)regions.size(); ++r)
+    {
+      for (int x : logic_columns)
+        {
+          if (x >= regions[r].xmin
+              && x <= regions[r].xmax)
+            region_columns[r].push_back(x);
+        }
+    }
+  for (int i = 1; i <= chipdb->n_cells; ++i)
+    {
+      int t = chipdb->cell_location[i].tile();
+      int x = chipdb->tile_x(t),
+        y = chipdb->tile_y(t);
+      for (int r = 0; r < (int)regions.size(); ++r)
+        {
+          if (regions[r].contains(x, y))
+            region_cells[r][cell_type_idx(chipdb->cell_type[i])].push_back(i);
+        }
+    }
+}
+
+bool
+Placer::in_region(int g, int cell) const
+{
+  int r = gate_region[g];
+  if (r < 0)
+    return true;
+  int t = chipdb->cell_location[cell].tile();
+  return constraints.regions[r].contains(chipdb->tile_x(t),
+                                         chipdb->tile_y(t));
+}
+
+// Put chain c back where it was if all its gates were matched and
+// still form the same chain.  Chains that are unchanged stay there.
+bool
+Placer::eco_place_chain(int c)
+{
+  const auto &v = chains.chains[c];
+  int nt = (v.size() + 7) / 8;
+  
+  int cell0 = lookup_or_default(opts.eco->cell, v[0], 0);
+  if (!cell0)
+    return false;
+  const Location &loc0 = chipdb->cell_location[cell0];
+  if (loc0.pos() != 0)
+    return false;
+  int x = chipdb->tile_x(loc0.tile()),
+    y = chipdb->tile_y(loc0.tile());
+  if (y + nt - 1 > chipdb->height - 2
+      || chain_meeting(x, y, nt, -1, -1) >= 0)
+    return false;
+  
+  bool unchanged = true;
+  for (unsigned j = 0; j < v.size(); ++j)
+    {
+      int t = chipdb->tile(x, y + j / 8);
+      if (chipdb->tile_type[t] != TileType::LOGIC)
+        return false;
+      int cell = chipdb->loc_cell(Location(t, j % 8));
+      if (lookup_or_default(opts.eco->cell, v[j], 0) != cell
+          || cell_gate[cell] != 0
+          || !in_region(gate_idx.at(v[j]), cell))
+        return false;
+      if (!contains(opts.eco->unchanged, v[j]))
+        unchanged = false;
+    }
+  
+  for (unsigned j = 0; j < v.size(); ++j)
+    {
+      int g = gate_idx.at(v[j]);
+      int cell = opts.eco->cell.at(v[j]);
+      set_cell_gate(cell, g);
+      gate_cell[g] = cell;
+      chained[g] = true;
+    }
+  set_chain_pos(c, x, y);
+  chain_locked[c] = unchanged;
+  return true;
+}
+
+// Put the matched gates back at their previous cells where that is
+// still legal.  Unchanged gates go first and are locked, so a changed
+// gate that no longer fits its old tile is the one that moves.
+void
+Placer::eco_place_gates(std::vector<int> &cell_type_n_placed)
+{
+  int n_kept = 0;
+  for (int pass = 0; pass < 2; ++pass)
+    for (int g = 1; g <= n_gates; ++g)
+      {
+        if (locked[g]
+            || chained[g]
+            || gate_cell[g])
+          continue;
+        
+        Instance *inst = gates[g];
+        bool unchanged = contains(opts.eco->unchanged, inst);
+        if (unchanged != (pass == 0))
+          continue;
+        
+        int c = lookup_or_default(opts.eco->cell, inst, 0);
+        CellType ct = gate_cell_type(g);
+        if (!c
+            || cell_gate[c] != 0
+            || chipdb->cell_type[c] != ct
+            || !in_region(g, c))
+          continue;
+        
+        set_cell_gate(c, g);
+        gate_cell[g] = c;
+        if (ct != CellType::WARMBOOT
+            && !valid(chipdb->cell_location[c].tile()))
+          {
+            set_cell_gate(c, 0);
+            gate_cell[g] = 0;
+            continue;
+          }
+        
+        ++cell_type_n_placed[cell_type_idx(ct)];
+        if (unchanged)
+          {
+            locked[g] = true;
+            ++n_kept;
+          }
+      }
+  for (int c = 0; c < (int)chains.chains.size(); ++c)
+    if (chain_locked[c])
+      n_kept += chains.chains[c].size();
+  
+  *logs << "  eco: kept " << n_kept << " of " << n_gates << " gates\n";
+}
+
+// Order cells by distance from the gates already placed on g's nets,
+// so a new gate starts next to its neighbours.
+void
+Placer::eco_sort_cells(int g, std::vector<int> &cells)
+{
+  static const int max_pins = 64;
+  
+  long x_sum = 0,
+    y_sum = 0;
+  int n = 0;
+  for (int i : index.gate_pins(g))
+    {
+      int w = index.pins[i].net;
+      if (index.net_constant[w]
+          || index.net_pins(w).size() > max_pins)
+        continue;
+      for (const Pin &pin : index.net_pins(w))
+        {
+          int g2 = pin.gate;
+          if (!g2
+              || g2 == g
+              || !gate_cell[g2])
+            continue;
+          int t = chipdb->cell_location[gate_cell[g2]].tile();
+          x_sum += chipdb->tile_x(t);
+          y_sum += chipdb->tile_y(t);
+          ++n;
+        }
+    }
+  if (!n)
+    return;
+  
+  int x = x_sum / n,
+    y = y_sum / n;
+  std::vector<std::pair<int, int>> dist_cell;
+  dist_cell.reserve(cells.size());
+  for (int c : cells)
+    {
+      int t = chipdb->cell_location[c].tile();
+      int dist = std::abs(chipdb->tile_x(t) - x) + std::abs(chipdb->tile_y(t) - y);
+      dist_cell.push_back(std::make_pair(dist, c));
+    }
+  std::sort(dist_cell.begin(), dist_cell.end());
+  for (unsigned i = 0; i < cells.size(); ++i)
+    cells[i] = dist_cell[i].second;
+}
+
+// Minimize the quadratic wire length of the clique net model over the
+// positions of the movable gates, with every other gate fixed at its
+// px, py, plus springs of anchor_weight pulling each movable gate to
+// its target tile.  Solved by conjugate gradient from the current px,
+// py.
+void
+Placer::analytic_solve(const std::vector<int> &movable,
+                       double anchor_weight,
+                       const BasedVector<int, 1> &target,
+                       BasedVector<double, 1> &px,
+                       BasedVector<double, 1> &py)
+{
+  static const int max_iterations = 100;
+  // a weak pull to the centre keeps the system nonsingular when a
+  // group of gates has no fixed neighbour
+  static const double centre_weight = 1e-3;
+  
+  int n = movable.size();
+  BasedVector<int, 1> gate_i(n_gates, -1);
+  for (int i = 0; i < n; ++i)
+    gate_i[movable[i]] = i;
+  
+  std::vector<std::vector<std::pair<int, double>>> adj(n);
+  std::vector<double> diag(n, centre_weight),
+    bx(n, centre_weight * 0.5 * (chipdb->width - 1)),
+    by(n, centre_weight * 0.5 * (chipdb->height - 1));
+  if (anchor_weight > 0)
+    for (int i = 0; i < n; ++i)
+      {
+        int t = target[movable[i]];
+        diag[i] += anchor_weight;
+        bx[i] += anchor_weight * chipdb->tile_x(t);
+        by[i] += anchor_weight * chipdb->tile_y(t);
+      }
+  std::vector<int> pins;
+  for (int w = 0; w < (int)nets.size(); ++w)
+    {
+      if (net_global[w])
+        continue;
+      pins = net_gates[w];
+      std::sort(pins.begin(), pins.end());
+      pins.erase(std::unique(pins.begin(), pins.end()), pins.end());
+      int k = pins.size();
+      if (k < 2
+          || k > analytic_max_pins)
+        continue;
+      
+      double wt = 1.0 / (k - 1);
+      for (int a = 0; a < k; ++a)
+        {
+          int ia = gate_i[pins[a]];
+          if (ia < 0)
+            continue;
+          for (int b = 0; b < k; ++b)
+            {
+              if (b == a)
+                continue;
+              int gb = pins[b],
+                ib = gate_i[gb];
+              diag[ia] += wt;
+              if (ib >= 0)
+                adj[ia].push_back(std::make_pair(ib, wt));
+              else
+                {
+                  bx[ia] += wt * px[gb];
+                  by[ia] += wt * py[gb];
+                }
+            }
+        }
+    }
+  
+  std::vector<double> x(n), r(n), p(n), q(n);
+  auto mul = [&](const std::vector<double> &v, std::vector<double> &out)
+    {
+      for (int i = 0; i < n; ++i)
+        {
+          double s = diag[i] * v[i];
+          for (const auto &e : adj[i])
+            s -= e.second * v[e.first];
+          out[i] = s;
+        }
+    };
+  
+  for (int dim = 0; dim < 2; ++dim)
+    {
+      BasedVector<double, 1> &pos = dim ? py : px;
+      const std::vector<double> &b = dim ? by : bx;
+      
+      for (int i = 0; i < n; ++i)
+        x[i] = pos[movable[i]];
+      mul(x, q);
+      double rr = 0,
+        bb = 0;
+      for (int i = 0; i < n; ++i)
+        {
+          r[i] = b[i] - q[i];
+          p[i] = r[i];
+          rr += r[i] * r[i];
+          bb += b[i] * b[i];
+        }
+      
+      for (int iter = 0;
+           iter < max_iterations
+             && rr > 1e-10 * bb;
+           ++iter)
+        {
+          mul(p, q);
+          double pq = 0;
+          for (int i = 0; i < n; ++i)
+            pq += p[i] * q[i];
+          double alpha = rr / pq;
+          double rr2 = 0;
+          for (int i = 0; i < n; ++i)
+            {
+              x[i] += alpha * p[i];
+              r[i] -= alpha * q[i];
+              rr2 += r[i] * r[i];
+            }
+          double beta = rr2 / rr;
+          for (int i = 0; i < n; ++i)
+            p[i] = r[i] + beta * p[i];
+          rr = rr2;
+        }
+      
+      for (int i = 0; i < n; ++i)
+        pos[movable[i]] = x[i];
+    }
+}
+
+// Assign the gates order[begin, end) to tiles of [x0, x1] x [y0, y1].
+// The longer side is cut in half and the gates are split where the
+// solution puts them, moving the fewest gates needed to fit the free
+// cells tile_cap of each half.
+void
+Placer::analytic_spread(const std::vector<int> &tile_cap,
+                        const BasedVector<double, 1> &px,
+                        const BasedVector<double, 1> &py,
+                        std::vector<int> &order,
+                        int begin, int end,
+                        int x0, int x1, int y0, int y1,
+                        BasedVector<int, 1> &target)
+{
+  if (begin == end)
+    return;
+  if (x0 == x1
+      && y0 == y1)
+    {
+      int t = chipdb->tile(x0, y0);
+      for (int i = begin; i < end; ++i)
+        target[order[i]] = t;
+      return;
+    }
+  
+  auto cap = [&](int xa, int xb, int ya, int yb)
+    {
+      int c = 0;
+      for (int x = xa; x <= xb; ++x)
+        for (int y = ya; y <= yb; ++y)
+          c += tile_cap[chipdb->tile(x, y)];
+      return c;
+    };
+  
+  bool cut_x = (x1 - x0 >= y1 - y0);
+  int lo_x1 = x1, hi_x0 = x0,
+    lo_y1 = y1, hi_y0 = y0;
+  if (cut_x)
+    {
+      lo_x1 = (x0 + x1) / 2;
+      hi_x0 = lo_x1 + 1;
+    }
+  else
+    {
+      lo_y1 = (y0 + y1) / 2;
+      hi_y0 = lo_y1 + 1;
+    }
+  int cap_lo = cap(x0, lo_x1, y0, lo_y1),
+    cap_hi = cap(hi_x0, x1, hi_y0, y1);
+  
+  const BasedVector<double, 1> &pos = cut_x ? px : py;
+  std::sort(order.begin() + begin, order.begin() + end,
+            [&pos](int a, int b)
+            {
+              return pos[a] < pos[b]
+                || (pos[a] == pos[b] && a < b);
+            });
+  double cut = (cut_x ? lo_x1 : lo_y1) + 0.5;
+  int mid = begin;
+  while (mid < end
+         && pos[order[mid]] < cut)
+    ++mid;
+  
+  int n = end - begin;
+  assert(n <= cap_lo + cap_hi);
+  mid = std::min(mid, begin + cap_lo);
+  mid = std::max(mid, end - cap_hi);
+  
+  analytic_spread(tile_cap, px, py, order, begin, mid,
+                  x0, lo_x1, y0, lo_y1, target);
+  analytic_spread(tile_cap, px, py, order, mid, end,
+                  hi_x0, x1, hi_y0, y1, target);
+}
+
+// Put g in the free cell of its type nearest tile (x, y) that valid()
+// accepts, searching outward by Manhattan distance.
+bool
+Placer::analytic_legalize(int g, int x, int y)
+{
+  CellType ct = gate_cell_type(g);
+  int max_r = chipdb->width + chipdb->height;
+  for (int r = 0; r <= max_r; ++r)
+    for (int dx = -r; dx <= r; ++dx)
+      {
+        int x2 = x + dx;
+        if (x2 < 0
+            || x2 >= chipdb->width)
+          continue;
+        int dy = r - std::abs(dx);
+        for (int s = 0; s < (dy ? 2 : 1); ++s)
+          {
+            int y2 = s ? y - dy : y + dy;
+            if (y2 < 0
+                || y2 >= chipdb->height)
+              continue;
+            int t = chipdb->tile(x2, y2);
+            for (int cell : chipdb->tile_pos_cell[t])
+              {
+                if (!cell
+                    || chipdb->cell_type[cell] != ct
+                    || cell_gate[cell])
+                  continue;
+                
+                set_cell_gate(cell, g);
+                gate_cell[g] = cell;
+                if (valid(t))
+                  {
+                    gate_x[g] = x2;
+                    gate_y[g] = y2;
+                    return true;
+                  }
+                set_cell_gate(cell, 0);
+                gate_cell[g] = 0;
+              }
+          }
+      }
+  return false;
+}
+
+// Replace the first-fit start of place_initial() with one that
+// minimizes quadratic wire length: solve for the free logic gates with
+// everything else fixed, spread the solution over the free logic cells
+// and legalize each gate at the nearest cell valid() accepts.  Free IOs
+// are first spread over the IO cells, then moved next to their logic
+// and the logic solved again, so there are anchors without a pcf.
+// Carry chains stay where place_initial() put them.  Returns false,
+// leaving the initial placement, if some gate can't be legalized.
+bool
+Placer::place_analytic()
+{
+  std::vector<int> logic, io;
+  for (int g : free_gates)
+    {
+      CellType ct = gate_cell_type(g);
+      if (ct == CellType::LOGIC)
+        logic.push_back(g);
+      else if (ct == CellType::IO)
+        io.push_back(g);
+    }
+  if (logic.empty())
+    return false;
+  
+  std::vector<int> moved = logic;
+  moved.insert(moved.end(), io.begin(), io.end());
+  BasedVector<int, 1> initial_cell = gate_cell;
+  auto unplace = [this](const std::vector<int> &v)
+    {
+      for (int g : v)
+        if (gate_cell[g])
+          {
+            set_cell_gate(gate_cell[g], 0);
+            gate_cell[g] = 0;
+          }
+    };
+  auto fail = [&]()
+    {
+      unplace(moved);
+      for (int g : moved)
+        {
+          set_cell_gate(initial_cell[g], g);
+          gate_cell[g] = initial_cell[g];
+        }
+      compute_wire_length();
+      *logs << "  analytic placement failed, using the initial placement\n";
+      return false;
+    };
+  
+  unplace(io);
+  const auto &io_cells = chipdb->cell_type_cells[cell_type_idx(CellType::IO)];
+  for (unsigned i = 0; i < io.size(); ++i)
+    {
+      int t = chipdb->cell_location[io_cells[i * io_cells.size() / io.size()]].tile();
+      if (!analytic_legalize(io[i], chipdb->tile_x(t), chipdb->tile_y(t)))
+        return fail();
+    }
+  
+  BasedVector<double, 1> px(n_gates),
+    py(n_gates);
+  for (int g = 1; g <= n_gates; ++g)
+    {
+      px[g] = gate_x[g];
+      py[g] = gate_y[g];
+    }
+  BasedVector<int, 1> target(n_gates, 0);
+  analytic_solve(logic, 0, target, px, py);
+  
+  if (!io.empty())
+    {
+      unplace(io);
+      for (int g : io)
+        {
+          double x = 0,
+            y = 0;
+          int n = 0;
+          for (int w : gate_nets[g])
+            {
+              if (net_global[w]
+                  || (int)net_gates[w].size() > analytic_max_pins)
+                continue;
+              for (int g2 : net_gates[w])
+                if (g2 != g)
+                  {
+                    x += px[g2];
+                    y += py[g2];
+                    ++n;
+                  }
+            }
+          int tx = n ? (int)(x / n + 0.5) : gate_x[g],
+            ty = n ? (int)(y / n + 0.5) : gate_y[g];
+          if (!analytic_legalize(g, tx, ty))
+            return fail();
+          px[g] = gate_x[g];
+          py[g] = gate_y[g];
+        }
+      analytic_solve(logic, 0, target, px, py);
+    }
+  
+  unplace(logic);
+  std::vector<int> tile_cap(chipdb->n_tiles, 0);
+  for (int t : logic_tiles)
+    for (int cell : chipdb->tile_pos_cell[t])
+      if (cell
+          && chipdb->cell_type[cell] == CellType::LOGIC
+          && !cell_gate[cell])
+        ++tile_cap[t];
+  
+  // spread, then pull the solution towards the spread placement with
+  // growing weight and spread again
+  std::vector<int> order = logic;
+  double anchor_weight = analytic_anchor_weight;
+  for (int k = 0;; ++k)
+    {
+      analytic_spread(tile_cap, px, py, order, 0, order.size(),
+                      0, chipdb->width - 1, 0, chipdb->height - 1,
+                      target);
+      if (k + 1 == analytic_rounds)
+        break;
+      analytic_solve(logic, anchor_weight, target, px, py);
+      anchor_weight *= 2;
+    }
+  for (int g : order)
+    {
+      int t = target[g];
+      if (!analytic_legalize(g, chipdb->tile_x(t), chipdb->tile_y(t)))
+        return fail();
+    }
+  
+  compute_wire_length();
+  return true;
+}
+
+// Whether gate g can join a cluster whose sequential gates all have
+// clk, sr, cen and neg_clk, given whether it has sequential (seq) and
+// combinational (comb) gates.  valid() lets a tile mix them only if
+// the nonzero clk, sr and cen agree and the combinational gates come
+// first, and neg_clk needs every gate of the tile to be negative.
+bool
+Placer::cluster_accepts(int clk, int sr, int cen, bool neg_clk,
+                        bool seq, bool comb, int g) const
+{
+  if (!gate_clk[g]
+      && !gate_sr[g]
+      && !gate_cen[g])
+    return !neg_clk;
+  
+  if (seq)
+    return (gate_clk[g] == clk
+            && gate_sr[g] == sr
+            && gate_cen[g] == cen
+            && gate_neg_clk[g] == neg_clk);
+  return !(gate_neg_clk[g] && comb);
+}
+
+// Coarsen the logic gates into clusters of up to a tile of compatible
+// gates.  Each cluster starts from the first gate left and grows by the
+// gate most strongly connected to it, with a net of k gates counting
+// 1 / (k - 1), while its local net pairs stay under the limit valid()
+// checks.
+void
+Placer::multilevel_cluster(const std::vector<int> &logic,
+                           std::vector<std::vector<int>> &clusters)
+{
+  static const int max_local_np = 29 - 3;
+  
+  BasedBitVector<1> candidate(n_gates);
+  for (int g : logic)
+    candidate[g] = true;
+  BasedVector<int, 1> gate_cluster(n_gates, -1);
+  BasedVector<double, 1> score(n_gates, 0);
+  std::vector<int> touched;
+  
+  for (int seed : logic)
+    {
+      if (gate_cluster[seed] >= 0)
+        continue;
+      
+      int c = clusters.size();
+      clusters.push_back(std::vector<int>());
+      std::vector<int> &cluster = clusters.back();
+      int clk = 0,
+        sr = 0,
+        cen = 0;
+      bool neg_clk = false,
+        seq = false,
+        comb = false;
+      tmp_local_np.clear();
+      touched.clear();
+      
+      int g = seed;
+      for (;;)
+        {
+          gate_cluster[g] = c;
+          cluster.push_back(g);
+          if (gate_clk[g]
+              || gate_sr[g]
+              || gate_cen[g])
+            {
+              seq = true;
+              clk = gate_clk[g];
+              sr = gate_sr[g];
+              cen = gate_cen[g];
+              neg_clk = gate_neg_clk[g];
+            }
+          else
+            comb = true;
+          for (int np : gate_local_np[g])
+            tmp_local_np.insert(np);
+          if ((int)cluster.size() == multilevel_cluster_size)
+            break;
+          
+          for (int w : gate_nets[g])
+            {
+              int k = net_gates[w].size();
+              if (net_global[w]
+                  || k < 2
+                  || k > multilevel_max_pins)
+                continue;
+              for (int g2 : net_gates[w])
+                {
+                  if (!candidate[g2]
+                      || gate_cluster[g2] >= 0)
+                    continue;
+                  if (!score[g2])
+                    touched.push_back(g2);
+                  score[g2] += 1.0 / (k - 1);
+                }
+            }
+          
+          int best = 0;
+          double best_score = 0;
+          for (int g2 : touched)
+            {
+              if (gate_cluster[g2] >= 0
+                  || score[g2] <= best_score
+                  || !cluster_accepts(clk, sr, cen, neg_clk, seq, comb, g2))
+                continue;
+              
+              int n_np = tmp_local_np.size();
+              for (int np : gate_local_np[g2])
+                if (!tmp_local_np.contains(np))
+                  ++n_np;
+              if (n_np > max_local_np)
+                continue;
+              
+              best = g2;
+              best_score = score[g2];
+            }
+          if (!best)
+            break;
+          g = best;
+        }
+      
+      for (int g2 : touched)
+        score[g2] = 0;
+    }
+}
+
+// Anneal the clusters over the slots, the logic tiles free of fixed
+// gates, with the adaptive schedule.  Clusters move to a random slot
+// within the range limit or swap with the cluster there.  The cost is
+// the wire length of the nets between clusters and the fixed gates,
+// with every gate of a cluster at its tile.
+void
+Placer::multilevel_anneal(const std::vector<std::vector<int>> &clusters,
+                          const std::vector<int> &slots,
+                          std::vector<int> &cluster_tile)
+{
+  static const int max_iterations = 1000;
+  
+  int n_clusters = clusters.size();
+  BasedVector<int, 1> gate_cluster(n_gates, -1);
+  for (int c = 0; c < n_clusters; ++c)
+    for (int g : clusters[c])
+      gate_cluster[g] = c;
+  
+  // the coarse netlist: the clusters of each net and the box of its
+  // other gates, which stay put
+  std::vector<std::vector<int>> cnet_clusters;
+  std::vector<NetBox> cnet_fixed;
+  std::vector<bool> cnet_has_fixed;
+  std::vector<std::vector<int>> cluster_cnets(n_clusters);
+  UllmanSet seen(n_clusters);
+  for (int w = 0; w < (int)nets.size(); ++w)
+    {
+      int k = net_gates[w].size();
+      if (net_global[w]
+          || k < 2
+          || k > multilevel_max_pins)
+        continue;
+      
+      seen.clear();
+      NetBox box;
+      bool has_fixed = false;
+      for (int g : net_gates[w])
+        {
+          int c = gate_cluster[g];
+          if (c >= 0)
+            seen.insert(c);
+          else if (!has_fixed)
+            {
+              box.x_min = box.x_max = gate_x[g];
+              box.y_min = box.y_max = gate_y[g];
+              has_fixed = true;
+            }
+          else
+            {
+              box.x_min = std::min(box.x_min, gate_x[g]);
+              box.x_max = std::max(box.x_max, gate_x[g]);
+              box.y_min = std::min(box.y_min, gate_y[g]);
+              box.y_max = std::max(box.y_max, gate_y[g]);
+            }
+        }
+      if (!seen.size()
+          || seen.size() + has_fixed < 2)
+        continue;
+      
+      int n = cnet_clusters.size();
+      cnet_clusters.push_back(std::vector<int>());
+      for (int i = 0; i < (int)seen.size(); ++i)
+        {
+          int c = seen.ith(i);
+          cnet_clusters.back().push_back(c);
+          cluster_cnets[c].push_back(n);
         }
+      cnet_fixed.push_back(box);
+      cnet_has_fixed.push_back(has_fixed);
     }
+  int n_cnets = cnet_clusters.size();
   
-  for (int i = 0; i < chipdb->width; ++i)
+  std::vector<int> cx(n_clusters), cy(n_clusters);
+  std::vector<int> tile_cluster(chipdb->n_tiles, -2);
+  for (int t : slots)
+    tile_cluster[t] = -1;
+  for (int c = 0; c < n_clusters; ++c)
     {
-      int t = chipdb->tile(i, 1);
-      if (chipdb->tile_type[t] == TileType::LOGIC)
-        logic_columns.push_back(i);
+      int t = cluster_tile[c];
+      tile_cluster[t] = c;
+      cx[c] = chipdb->tile_x(t);
+      cy[c] = chipdb->tile_y(t);
     }
-  for (int i = 0; i < chipdb->n_tiles; ++i)
+  
+  auto cnet_length = [&](int n)
     {
-      switch(chipdb->tile_type[i])
+      const std::vector<int> &v = cnet_clusters[n];
+      NetBox box = cnet_fixed[n];
+      int i = 0;
+      if (!cnet_has_fixed[n])
         {
-        case TileType::LOGIC:
-          logic_tiles.push_back(i);
-          break;
-        case TileType::RAMT:
-          ramt_tiles.push_back(i);
-          break;
-        default:
-          break;
+          box.x_min = box.x_max = cx[v[0]];
+          box.y_min = box.y_max = cy[v[0]];
+          i = 1;
         }
-    }
-
-  std::tie(nets, net_idx) = top->index_nets();
-  int n_nets = nets.size();
-  
-  net_global.resize(n_nets);
-  
-  net_length.resize(n_nets);
-  net_gates.resize(n_nets);
-  recompute.resize(n_nets);
-  
-  std::tie(gates, gate_idx) = top->index_instances();
-  n_gates = gates.size();
-  
-  gate_clk.resize(n_gates, 0);
-  gate_sr.resize(n_gates, 0);
-  gate_cen.resize(n_gates, 0);
-  gate_latch.resize(n_gates, 0);
-  gate_local_np.resize(n_gates);
-  tmp_local_np.resize(n_nets * 2);
-  gate_chain.resize(n_gates, -1);
+      for (; i < (int)v.size(); ++i)
+        {
+          box.x_min = std::min(box.x_min, cx[v[i]]);
+          box.x_max = std::max(box.x_max, cx[v[i]]);
+          box.y_min = std::min(box.y_min, cy[v[i]]);
+          box.y_max = std::max(box.y_max, cy[v[i]]);
+        }
+      return box.length();
+    };
   
-  gate_cell.resize(n_gates);
-  gate_nets.resize(n_gates);
+  std::vector<int> cnet_length_v(n_cnets);
+  int length = 0;
+  for (int n = 0; n < n_cnets; ++n)
+    {
+      cnet_length_v[n] = cnet_length(n);
+      length += cnet_length_v[n];
+    }
   
-  for (int i = 1; i <= n_gates; ++i)
+  UllmanSet changed(n_cnets);
+  std::vector<std::pair<int, int>> restore_length;
+  auto place_cluster = [&](int c, int t)
     {
-      Instance *inst = gates[i];
-      if (models.is_lc(inst))
+      tile_cluster[t] = c;
+      cluster_tile[c] = t;
+      cx[c] = chipdb->tile_x(t);
+      cy[c] = chipdb->tile_y(t);
+      for (int n : cluster_cnets[c])
         {
-          Net *clk = inst->find_port("CLK")->connection();
-          if (clk)
-            gate_clk[i] = net_idx.at(clk);
-          
-          Net *sr = inst->find_port("SR")->connection();
-          if (sr)
-            gate_sr[i] = net_idx.at(sr);
-          
-          Net *cen = inst->find_port("CEN")->connection();
-          if (cen)
-            gate_cen[i] = net_idx.at(cen);
-          
-          tmp_local_np.clear();
-          for (int j = 0; j < 4; ++j)
+          if (!changed.contains(n))
             {
-              Net *n = inst->find_port(fmt("I" << j))->connection();
-              if (n
-                  && !n->is_constant())
-                tmp_local_np.insert((net_idx.at(n) << 1) | (j & 1));
+              changed.insert(n);
+              restore_length.push_back(std::make_pair(n, cnet_length_v[n]));
             }
-          
-          for (int j = 0; j < (int)tmp_local_np.size(); ++j)
-            gate_local_np[i].push_back(tmp_local_np.ith(j));
         }
-      else if (models.is_io(inst))
+    };
+  
+  int M = std::max(chipdb->width,
+                   chipdb->height);
+  double rlim = M,
+    coarse_temp = 0;
+  int n_tried = 0,
+    n_taken = 0;
+  // returns false if there was no move to make
+  auto try_move = [&](bool measure, double &delta)
+    {
+      int c = rg.random_int(0, n_clusters - 1);
+      int t = cluster_tile[c];
+      int r = std::max(1, (int)(rlim + 0.5));
+      int x2 = rg.random_int(std::max(0, cx[c] - r),
+                             std::min(chipdb->width - 1, cx[c] + r)),
+        y2 = rg.random_int(std::max(0, cy[c] - r),
+                           std::min(chipdb->height - 1, cy[c] + r));
+      int t2 = chipdb->tile(x2, y2);
+      if (t2 == t
+          || tile_cluster[t2] == -2)
+        return false;
+      
+      int c2 = tile_cluster[t2];
+      changed.clear();
+      restore_length.clear();
+      place_cluster(c, t2);
+      if (c2 >= 0)
+        place_cluster(c2, t);
+      else
+        tile_cluster[t] = -1;
+      
+      delta = 0;
+      for (const auto &p : restore_length)
         {
-          Net *latch = inst->find_port("LATCH_INPUT_VALUE")->connection();
-          if (latch)
-            gate_cen[i] = net_idx.at(latch);
+          cnet_length_v[p.first] = cnet_length(p.first);
+          delta += cnet_length_v[p.first] - p.second;
         }
-      else if (models.is_gb(inst))
+      
+      ++n_tried;
+      if (measure
+          || delta <= 0
+          || (coarse_temp > 1e-6
+              && rg.random_real(0.0, 1.0) <= exp(-delta/coarse_temp)))
         {
-          Net *n = inst->find_port("GLOBAL_BUFFER_OUTPUT")->connection();
-          if (n)
-            net_global[net_idx.at(n)] = true;
+          ++n_taken;
+          length += (int)delta;
         }
-      else if (models.is_hfosc(inst))
+      else
         {
-          Net *n = inst->find_port("CLKHF")->connection();
-          if (n && !inst->is_attr_set("ROUTE_THROUGH_FABRIC"))
-            net_global[net_idx.at(n)] = true;
+          for (const auto &p : restore_length)
+            cnet_length_v[p.first] = p.second;
+          place_cluster(c, t);
+          if (c2 >= 0)
+            place_cluster(c2, t2);
+          else
+            tile_cluster[t2] = -1;
         }
-      else if (models.is_lfosc(inst))
+      return true;
+    };
+  
+  int n_moves = multilevel_moves * n_clusters;
+  
+  // the first temperature randomizes the placement and sets the
+  // temperature from the spread of the move costs
+  double sum = 0,
+    sq_sum = 0;
+  int n_sample = 0;
+  for (int i = 0; i < n_clusters; ++i)
+    {
+      double delta;
+      if (try_move(true, delta))
         {
-          Net *n = inst->find_port("CLKLF")->connection();
-          if (n && !inst->is_attr_set("ROUTE_THROUGH_FABRIC"))
-            net_global[net_idx.at(n)] = true;
+          sum += delta;
+          sq_sum += delta * delta;
+          ++n_sample;
+        }
+    }
+  double mean = n_sample ? sum / n_sample : 0,
+    var = n_sample ? sq_sum / n_sample - mean * mean : 0;
+  coarse_temp = 20 * std::sqrt(std::max(0.0, var));
+  
+  for (int iter = 0; iter < max_iterations; ++iter)
+    {
+      bool quench = (coarse_temp <= 0.005 * length / std::max(1, n_cnets));
+      if (quench)
+        coarse_temp = 0;
+      
+      n_tried = n_taken = 0;
+      for (int i = 0; i < n_moves; ++i)
+        {
+          double delta;
+          try_move(false, delta);
+        }
+      if (quench
+          || n_tried == 0)
+        break;
+      
+      double Raccept = (double)n_taken / (double)n_tried;
+      if (Raccept > 0.96)
+        coarse_temp *= 0.5;
+      else if (Raccept > 0.8)
+        coarse_temp *= 0.9;
+      else if (Raccept > 0.15)
+        coarse_temp *= 0.95;
+      else
+        coarse_temp *= 0.8;
+      rlim = std::min((double)M,
+                      std::max(1.0, rlim * (1 - 0.44 + Raccept)));
+    }
+  
+  *logs << "  multilevel: " << n_clusters << " clusters, coarse wire length = "
+        << length << "\n";
+}
+
+// Replace the first-fit start of place_initial() with a multilevel
+// one: coarsen the free logic gates into clusters, anneal the clusters
+// over the logic tiles no fixed gate uses, then put the gates of each
+// cluster in its tile, combinational gates first.  Gates valid()
+// rejects there go to the nearest cell it accepts.  Returns false,
+// leaving the initial placement, if there are more clusters than free
+// tiles or some gate can't be placed.
+bool
+Placer::place_multilevel()
+{
+  std::vector<int> logic;
+  for (int g : free_gates)
+    {
+      if (gate_cell_type(g) == CellType::LOGIC)
+        logic.push_back(g);
+    }
+  if (logic.empty())
+    return false;
+  
+  BasedVector<int, 1> initial_cell = gate_cell;
+  auto unplace = [this](const std::vector<int> &v)
+    {
+      for (int g : v)
+        if (gate_cell[g])
+          {
+            set_cell_gate(gate_cell[g], 0);
+            gate_cell[g] = 0;
+          }
+    };
+  auto fail = [&](const char *why)
+    {
+      unplace(logic);
+      for (int g : logic)
+        {
+          set_cell_gate(initial_cell[g], g);
+          gate_cell[g] = initial_cell[g];
         }
+      compute_wire_length();
+      *logs << "  multilevel placement failed (" << why
+            << "), using the initial placement\n";
+      return false;
+    };
+  
+  unplace(logic);
+  std::vector<int> slots;
+  for (int t : logic_tiles)
+    {
+      if (!tile_occupied[t])
+        slots.push_back(t);
+    }
+  
+  std::vector<std::vector<int>> clusters;
+  multilevel_cluster(logic, clusters);
+  if (clusters.size() > slots.size())
+    return fail("not enough free tiles");
+  stats.count("place_clusters", clusters.size());
+  
+  std::vector<int> cluster_tile(clusters.size());
+  for (int c = 0; c < (int)clusters.size(); ++c)
+    cluster_tile[c] = slots[c];
+  multilevel_anneal(clusters, slots, cluster_tile);
+  
+  std::vector<int> leftover;
+  for (int c = 0; c < (int)clusters.size(); ++c)
+    {
+      int t = cluster_tile[c];
+      std::vector<int> v = clusters[c];
+      std::stable_partition(v.begin(), v.end(),
+                            [this](int g)
+                            {
+                              return (!gate_clk[g]
+                                      && !gate_sr[g]
+                                      && !gate_cen[g]);
+                            });
+      int q = 0;
+      for (int g : v)
+        {
+          int cell = chipdb->loc_cell(Location(t, q));
+          set_cell_gate(cell, g);
+          gate_cell[g] = cell;
+          if (valid(t))
+            {
+              gate_x[g] = chipdb->tile_x(t);
+              gate_y[g] = chipdb->tile_y(t);
+              ++q;
+            }
+          else
+            {
+              set_cell_gate(cell, 0);
+              gate_cell[g] = 0;
+              leftover.push_back(g);
+            }
+        }
+    }
+  for (int g : leftover)
+    {
+      int c = 0;
+      while (std::find(clusters[c].begin(), clusters[c].end(), g)
+             == clusters[c].end())
+        ++c;
+      int t = cluster_tile[c];
+      if (!analytic_legalize(g, chipdb->tile_x(t), chipdb->tile_y(t)))
+        return fail("no cell for a gate");
     }
+  
+  compute_wire_length();
+  return true;
 }
 
 void
@@ -1113,6 +3268,7 @@ Placer::place_initial()
 {
   locked.resize(n_gates);
   chained.resize(n_gates);
+  chain_locked.resize(chains.chains.size());
   
   // place chains
   std::vector<int> logic_column_free(logic_columns.size(), 1);
@@ -1142,22 +3298,58 @@ Placer::place_initial()
       }
     }
   
-  for (unsigned i = 0; i < chains.chains.size(); ++i)
+  chain_x.resize(chains.chains.size(), -1);
+  chain_start.resize(chains.chains.size(), -1);
+  column_chains.resize(chipdb->width);
+  
+  // chains in a region first, while there is room in it.  The tiles
+  // of a column below a region chain are left to the other gates.
+  std::vector<int> chain_order;
+  for (int pass = 0; pass < 2; ++pass)
+    for (int c = 0; c < (int)chains.chains.size(); ++c)
+      {
+        if ((chain_region[c] >= 0) == (pass == 0))
+          chain_order.push_back(c);
+      }
+  
+  int n_placed_chains = 0;
+  for (int i : chain_order)
     {
+      int r = chain_region[i];
       const auto &v = chains.chains[i];
       
       int gate0 = gate_idx.at(v[0]);
       assert(gate_chain[gate0] == -1);
       gate_chain[gate0] = i;
       
+      if (opts.eco
+          && eco_place_chain(i))
+        {
+          ++n_placed_chains;
+          continue;
+        }
+      
       int nt = (v.size() + 7) / 8;
       for (unsigned k = 0; k < logic_columns.size(); ++k)
         {
-          if (logic_column_free[k] + nt - 1 <= logic_column_last[k])
+          int x = logic_columns[k];
+          int y = logic_column_free[k],
+            last = logic_column_last[k];
+          if (r >= 0)
+            {
+              const Region &region = constraints.regions[r];
+              if (x < region.xmin
+                  || x > region.xmax)
+                continue;
+              y = std::max(y, region.ymin);
+              last = std::min(last, region.ymax);
+            }
+          // step over chains an ECO kept in this column
+          while (y + nt - 1 <= last
+                 && chain_meeting(x, y, nt, -1, -1) >= 0)
+            ++y;
+          if (y + nt - 1 <= last)
             {
-              int x = logic_columns[k];
-              int y = logic_column_free[k];
-              
               for (unsigned j = 0; j < v.size(); ++j)
                 {
                   Instance *inst = v[j];
@@ -1167,20 +3359,24 @@ Placer::place_initial()
                   int cell = chipdb->loc_cell(loc);
                   
                   assert(cell_gate[cell] == 0);
-                  cell_gate[cell] = g;
+                  set_cell_gate(cell, g);
                   gate_cell[g] = cell;
                   chained[g] = true;
                 }
               
-              chain_x.push_back(x);
-              chain_start.push_back(y);
+              set_chain_pos(i, x, y);
               
-              logic_column_free[k] += nt;
+              logic_column_free[k] = y + nt;
+              ++n_placed_chains;
               goto placed_chain;
             }
         }
+      if (r >= 0)
+        fatal(fmt("failed to place: no room for a carry chain of "
+                  << nt << " tiles in region `"
+                  << constraints.regions[r].pattern << "'"));
       fatal(fmt("failed to place: placed " 
-                << i
+                << n_placed_chains
                 << " of " << chains.chains.size()
                 << " carry chains"));
       
@@ -1196,7 +3392,7 @@ Placer::place_initial()
       int c = p.second;
       
       assert(cell_gate[c] == 0);
-      cell_gate[c] = g;
+      set_cell_gate(c, g);
       gate_cell[g] = c;
       
       locked[g] = true;
@@ -1208,6 +3404,9 @@ Placer::place_initial()
       assert(valid(chipdb->cell_location[c].tile()));
     }
   
+  if (opts.eco)
+    eco_place_gates(cell_type_n_placed);
+  
   std::vector<std::vector<int>> cell_type_empty_cells = chipdb->cell_type_cells;
   for (int i = 0; i < n_cell_types; ++i)
     for (int j = 0; j < (int)cell_type_empty_cells[i].size();)
@@ -1225,13 +3424,26 @@ Placer::place_initial()
   
   std::set<std::pair<uint8_t, int>> io_q;
   
-  for (int i = 1; i <= n_gates; ++i)
+  // gates in a region first, while there is room in it
+  std::vector<int> gate_order;
+  for (int pass = 0; pass < 2; ++pass)
+    for (int g = 1; g <= n_gates; ++g)
+      {
+        if ((gate_region[g] >= 0) == (pass == 0))
+          gate_order.push_back(g);
+      }
+  
+  for (int i : gate_order)
     {
       if (locked[i] 
           || chained[i])
         continue;
       
       free_gates.push_back(i);
+      // kept at its previous cell by an ECO
+      if (gate_cell[i])
+        continue;
+      
       CellType ct = gate_cell_type(i);
       if (ct == CellType::GB)
         {
@@ -1242,18 +3454,22 @@ Placer::place_initial()
         {
           int ct_idx = cell_type_idx(ct);
           auto &v = cell_type_empty_cells[ct_idx];
+          if (opts.eco)
+            eco_sort_cells(i, v);
           
           for (int j = 0; j < (int)v.size(); ++j)
             {
               int c = v[j];
+              if (!in_region(i, c))
+                continue;
               
               assert(cell_gate[c] == 0);
-              cell_gate[c] = i;
+              set_cell_gate(c, i);
               gate_cell[i] = c;
               
               if (ct != CellType::WARMBOOT &&
                   !valid(chipdb->cell_location[c].tile()))
-                cell_gate[c] = 0;
+                set_cell_gate(c, 0);
               else
                 {
                   ++cell_type_n_placed[ct_idx];
@@ -1262,6 +3478,10 @@ Placer::place_initial()
                 }
             }
           
+          if (gate_region[i] >= 0)
+            fatal(fmt("failed to place: no room for a "
+                      << cell_type_name(ct) << " in region `"
+                      << constraints.regions[gate_region[i]].pattern << "'"));
           fatal(fmt("failed to place: placed "
                     << cell_type_n_placed[ct_idx]
                     << " " << cell_type_name(ct) << "s of " << cell_type_n_gates[ct_idx]
@@ -1283,13 +3503,15 @@ Placer::place_initial()
       for (unsigned j = 0; j < v.size(); ++j)
         {
           int c = v[j];
+          if (!in_region(i, c))
+            continue;
           
           assert(cell_gate[c] == 0);
-          cell_gate[c] = i;
+          set_cell_gate(c, i);
           gate_cell[i] = c;
           
           if (!valid(chipdb->cell_location[c].tile()))
-            cell_gate[c] = 0;
+            set_cell_gate(c, 0);
           else
             {
               ++cell_type_n_placed[gb_idx];
@@ -1305,23 +3527,17 @@ Placer::place_initial()
     }
   
   for (int g = 1; g <= n_gates; ++g)
-    {
-      Instance *inst = gates[g];
-      for (const auto &p : inst->ports())
-        {
-          Net *n = p.second->connection();
-          if (n
-              && !n->is_constant())  // constants are not routed
-            {
-              int w = net_idx.at(n);
-              net_gates[w].push_back(g);
-              gate_nets[g].push_back(w);
-            }
-        }
-    }
+    for (int i : index.gate_pins(g))
+      {
+        int w = index.pins[i].net;
+        if (!index.net_constant[w])  // constants are not routed
+          {
+            net_gates[w].push_back(g);
+            gate_nets[g].push_back(w);
+          }
+      }
   
-  for (int w = 0; w < (int)nets.size(); ++w)
-    net_length[w] = compute_net_length(w);
+  compute_wire_length();
 }
 
 void
@@ -1504,7 +3720,7 @@ Placer::configure()
           {{"CLKHF_DIV", 2}};
         configure_extra_cell(cell, inst, hfosc_params, true);
 
-        if(inst->find_port("CLKHF")->connected() && !inst->is_attr_set("ROUTE_THROUGH_FABRIC")) {
+        if(inst->find_port(sym_CLKHF)->connected() && !inst->is_attr_set("ROUTE_THROUGH_FABRIC")) {
           int driven_glb = chipdb->get_oscillator_glb(cell, "CLKHF");
           
           const auto &ecb = chipdb->extra_bits.at(fmt("padin_glb_netwk." << driven_glb));
@@ -1518,7 +3734,7 @@ Placer::configure()
         continue;      
       } else if(models.is_lfosc(inst)) {
         placement[inst] = cell;
-        if(inst->find_port("CLKLF")->connected() && !inst->is_attr_set("ROUTE_THROUGH_FABRIC")) {
+        if(inst->find_port(sym_CLKLF)->connected() && !inst->is_attr_set("ROUTE_THROUGH_FABRIC")) {
           int driven_glb = chipdb->get_oscillator_glb(cell, "CLKLF");
           
           const auto &ecb = chipdb->extra_bits.at(fmt("padin_glb_netwk." << driven_glb));
@@ -1589,7 +3805,7 @@ Placer::configure()
                                  cbits[8].col), (bool)carry_enable);
               if (loc.pos() == 0)
                 {
-                  Net *n = inst->find_port("CIN")->connection();
+                  Net *n = inst->find_port(sym_CIN)->connection();
                   if (n && n->is_constant())
                     {
                       const CBit &carryinset_cbit = func_cbits.at("CarryInSet")[0];
@@ -1653,7 +3869,7 @@ Placer::configure()
                           neg_trigger);
           
           if (models.is_gb_io(inst)
-              && inst->find_port("GLOBAL_BUFFER_OUTPUT")->connected())
+              && inst->find_port(sym_GLOBAL_BUFFER_OUTPUT)->connected())
             {
               int glb = chipdb->loc_pin_glb_num.at(loc);
               
@@ -1956,9 +4172,9 @@ Placer::configure()
           CBit shiftreg_div_mode_cb = chipdb->extra_cell_cbit(cell, "SHIFTREG_DIV_MODE");
           conf.set_cbit(shiftreg_div_mode_cb, shiftreg_div_mode[0]);
           
-          Port *a = inst->find_port("PLLOUTGLOBAL");
+          Port *a = inst->find_port(sym_PLLOUTGLOBAL);
           if (!a)
-            a = inst->find_port("PLLOUTGLOBALA");
+            a = inst->find_port(sym_PLLOUTGLOBALA);
           assert(a);
           if (a->connected())
             {
@@ -1970,7 +4186,7 @@ Placer::configure()
               conf.set_extra_cbit(ecb);
             }
           
-          Port *b = inst->find_port("PLLOUTGLOBALB");
+          Port *b = inst->find_port(sym_PLLOUTGLOBALB);
           if (b && b->connected())
             {
               const auto &p2 = chipdb->cell_mfvs.at(cell).at("PLLOUT_B");
@@ -2055,10 +4271,10 @@ Placer::configure()
               {
                 Instance *inst = gates[g];
                 
-                if (inst->find_port("D_IN_0")->connected()
-                    || inst->find_port("D_IN_1")->connected()
+                if (inst->find_port(sym_D_IN_0)->connected()
+                    || inst->find_port(sym_D_IN_1)->connected()
                     || (models.is_gb_io(inst)
-                        && inst->find_port("GLOBAL_BUFFER_OUTPUT")->connected()))
+                        && inst->find_port(sym_GLOBAL_BUFFER_OUTPUT)->connected()))
                   enable_input = true;
                 const Const &pin_type = inst->get_param("PIN_TYPE");
                 enable_output = pin_type.get_bit(5) || pin_type.get_bit(4) || 
@@ -2177,57 +4393,278 @@ Placer::configure()
     }
 }
 
+void
+Placer::move_free_gate(int g)
+{
+  int new_cell = gate_random_cell(g);
+  
+  int new_g = cell_gate[new_cell];
+  if (new_g 
+      && chained[new_g])
+    return;
+  
+  assert(!move_failed);
+  move_gate(g, new_cell);
+  accept_or_restore();
+}
+
+// Sweep over the free logic gates in [region_xmin, region_xmax].  The
+// worker sees gates outside its region where they were at the start
+// of the sweep.
+void
+Placer::anneal_region(const std::vector<int> &region_gates)
+{
+  for (int g : region_gates)
+    {
+      int x = chipdb->tile_x(chipdb->cell_location[gate_cell[g]].tile());
+      if (x < region_xmin
+          || x > region_xmax)
+        continue;
+      
+      move_free_gate(g);
+    }
+}
+
+// One sweep over the free logic gates, with the chip split by columns
+// into one region per worker.  Each worker anneals its region on a
+// copy of the placement with its own random stream.  The regions are
+// merged back in order, so the result only depends on the seed and the
+// number of regions.  The region boundaries shift on odd sweeps so
+// gates can cross them.
+void
+Placer::anneal_regions(ThreadPool &pool,
+                       std::vector<Placer> &workers,
+                       const std::vector<int> &logic_free_gates,
+                       int sweep)
+{
+  int n_regions = workers.size();
+  int n_columns = logic_columns.size();
+  int offset = (sweep & 1) ? n_columns / (2 * n_regions) : 0;
+  
+  std::vector<int> first_column(n_regions + 1);
+  for (int i = 0; i < n_regions; ++i)
+    first_column[i] = i ? (i * n_columns) / n_regions + offset : 0;
+  first_column[n_regions] = n_columns;
+  
+  for (int i = 0; i < n_regions; ++i)
+    {
+      Placer &w = workers[i];
+      w.gate_cell = gate_cell;
+      w.cell_gate = cell_gate;
+      w.tile_q_clk = tile_q_clk;
+      w.tile_q_sr = tile_q_sr;
+      w.tile_q_cen = tile_q_cen;
+      w.tile_occupied = tile_occupied;
+      w.tile_neg_clk = tile_neg_clk;
+      w.tile_n_local_np = tile_n_local_np;
+      w.bank_n_latch = bank_n_latch;
+      w.gate_x = gate_x;
+      w.gate_y = gate_y;
+      w.net_length = net_length;
+      w.net_box = net_box;
+      w.tile_demand_h = tile_demand_h;
+      w.tile_demand_v = tile_demand_v;
+      w.net_timing_weight = net_timing_weight;
+      w.chain_x = chain_x;
+      w.chain_start = chain_start;
+      w.column_chains = column_chains;
+      w.diameter = diameter;
+      w.temp = temp;
+      w.n_move = w.n_accept = 0;
+      w.n_delta = 0;
+      w.delta_sum = w.delta_sq_sum = 0;
+      w.improved = false;
+      w.rg = random_generator(rg.random_int(1, 2147483646));
+      
+      w.region_xmin = i ? logic_columns[first_column[i]] : 0;
+      w.region_xmax = (i + 1 < n_regions
+                       ? logic_columns[first_column[i + 1]] - 1
+                       : chipdb->width - 1);
+    }
+  
+  pool.run(n_regions,
+           [&](int i, int) { workers[i].anneal_region(logic_free_gates); });
+  
+  for (int i = 0; i < n_regions; ++i)
+    {
+      const Placer &w = workers[i];
+      for (int t : logic_tiles)
+        {
+          int x = chipdb->tile_x(t);
+          if (x < w.region_xmin
+              || x > w.region_xmax)
+            continue;
+          for (int q = 0; q < 8; ++q)
+            {
+              int cell = chipdb->loc_cell(Location(t, q));
+              int g = w.cell_gate[cell];
+              set_cell_gate(cell, g);
+              if (g)
+                gate_cell[g] = cell;
+            }
+        }
+      n_move += w.n_move;
+      n_accept += w.n_accept;
+      n_delta += w.n_delta;
+      delta_sum += w.delta_sum;
+      delta_sq_sum += w.delta_sq_sum;
+      if (w.improved)
+        improved = true;
+    }
+  
+  compute_wire_length();
+}
+
 void
 Placer::place()
 {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  
   place_initial();
   // check();
   
+  // neither start keeps gates in their regions
+  if (has_regions
+      && (opts.analytic || opts.multilevel))
+    note("set_region: skipping the analytic and multilevel starts");
+  bool analytic = (!has_regions
+                   && opts.analytic
+                   && place_analytic());
+  bool multilevel = (!has_regions
+                     && !analytic
+                     && opts.multilevel
+                     && place_multilevel());
+  
   *logs << "  initial wire length = " << wire_length() << "\n";
+  if (opts.congestion_weight > 0)
+    *logs << "  initial congestion = "
+          << fmt(std::fixed << std::setprecision(1) << congestion()) << "\n";
+  if (timing)
+    {
+      update_timing();
+      *logs << "  initial max delay = "
+            << fmt(std::fixed << std::setprecision(2)
+                   << timing->max_delay() / 1000.0) << " ns\n";
+    }
+  
+  bool anneal = true;
+  if (analytic)
+    {
+      temp = analytic_temp;
+      diameter = analytic_diameter;
+    }
+  else if (multilevel)
+    {
+      temp = multilevel_temp;
+      diameter = multilevel_diameter;
+    }
+  if (opts.eco)
+    {
+      temp = eco_temp;
+      diameter = eco_diameter;
+      // nothing to do if the ECO kept everything
+      anneal = !free_gates.empty();
+      for (int c = 0; c < (int)chains.chains.size(); ++c)
+        if (!chain_locked[c])
+          anneal = true;
+    }
   
   int n_no_progress = 0;
   double avg_wire_length = wire_length();
   
-  for (int iter=1;; iter++)
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<Placer> workers;
+  std::vector<int> logic_free_gates;
+  if (opts.threads > 1)
+    {
+      pool.reset(new ThreadPool(opts.threads));
+      
+      int n_regions = std::min(opts.threads,
+                               std::max(1, (int)logic_columns.size() / 4));
+      workers.reserve(n_regions);
+      for (int i = 0; i < n_regions; ++i)
+        workers.push_back(*this);
+      
+      for (int g : free_gates)
+        {
+          if (gate_cell_type(g) == CellType::LOGIC)
+            logic_free_gates.push_back(g);
+        }
+    }
+  
+  // The adaptive schedule follows VPR: moves per temperature grow as
+  // the 4/3 power of the movable gates and chains, the temperature
+  // and diameter follow the acceptance rate, and annealing stops once
+  // the temperature is small against the average net length, followed
+  // by a greedy pass.  Without an analytic or ECO start, the first
+  // temperature randomizes the placement and sets the temperature
+  // from the spread of the move costs.
+  bool adaptive = (opts.schedule == PlaceSchedule::ADAPTIVE);
+  int n_sweeps = 15;
+  bool measure_temp = false;
+  bool quench = false;
+  double rlim = diameter;
+  if (adaptive)
+    {
+      int n_movable = free_gates.size() + chains.chains.size();
+      n_sweeps = std::max(1, (int)std::ceil(2 * std::cbrt((double)n_movable)));
+      measure_temp = !analytic && !multilevel && !opts.eco;
+    }
+  
+  std::chrono::steady_clock::time_point anneal_start = std::chrono::steady_clock::now();
+  
+  for (int iter=1; anneal; iter++)
     {
       n_move = n_accept = 0;
+      n_delta = 0;
+      delta_sum = delta_sq_sum = 0;
       improved = false;
+      
+      if (timing
+          && iter > 1)
+        update_timing();
 
       if (iter % 50 == 0)
         *logs << "  at iteration #" << iter << ": temp = " << temp << ", wire length = " << wire_length() << "\n";
       
-      for (int m = 0; m < 15; ++m)
+      for (int m = 0; m < n_sweeps; ++m)
         {
           for (int g : free_gates)
             {
-              int new_cell = gate_random_cell(g);             
-              
-              int new_g = cell_gate[new_cell];
-              if (new_g 
-                  && chained[new_g])
+              // logic gates are moved by anneal_regions
+              if (pool
+                  && gate_cell_type(g) == CellType::LOGIC)
                 continue;
               
-              assert(!move_failed);
-              move_gate(g, new_cell);
-              accept_or_restore();
+              move_free_gate(g);
               
               // check();
             }
           
           for (int c = 0; c < (int)chains.chains.size(); ++c)
             {
-              std::pair<Location, bool> new_loc = chain_random_loc(c);
-              if (new_loc.second)
-                {
-                  assert(!move_failed);
-                  move_chain(c, new_loc.first);
-                  accept_or_restore();
-                }
+              if (chain_locked[c])
+                continue;
+              
+              move_free_chain(c);
               
               // check();
             }
+          
+          if (pool)
+            anneal_regions(*pool, workers, logic_free_gates, m);
         }
       
+      stats.add("place_iterations",
+                { { "iteration", iter },
+                  { "temp", temp },
+                  { "diameter", diameter },
+                  { "moves", n_move },
+                  { "accepted", n_accept },
+                  { "wire_length", wire_length() } });
+      stats.count("place_moves", n_move);
+      stats.count("place_accepted", n_accept);
+      
       if (improved)
         {
           n_no_progress = 0;
@@ -2236,10 +4673,47 @@ Placer::place()
       else
         ++n_no_progress;
       
-      if (temp <= 1e-3
-          && n_no_progress >= 5)
+      if (quench)
+        break;
+      
+      double stop_temp = 1e-3;
+      if (adaptive)
+        {
+          stop_temp = 0.005 * wire_length() / std::max(1, (int)nets.size());
+          if (!measure_temp
+              && (temp <= stop_temp
+                  || n_move == 0))
+            {
+              quench = true;
+              temp = 0;
+              continue;
+            }
+        }
+      else if (temp <= 1e-3
+               && n_no_progress >= 5)
         break;
       
+      double elapsed = 0;
+      if (opts.time_budget > 0)
+        {
+          elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+          if (elapsed >= opts.time_budget)
+            {
+              *logs << "  place time budget reached at iteration #" << iter << "\n";
+              break;
+            }
+        }
+      
+      if (measure_temp)
+        {
+          measure_temp = false;
+          double mean = n_delta ? delta_sum / n_delta : 0,
+            var = n_delta ? delta_sq_sum / n_delta - mean * mean : 0;
+          temp = 20 * std::sqrt(std::max(0.0, var));
+          continue;
+        }
+      
+      double old_temp = temp;
       double Raccept = (double)n_accept / (double)n_move;
 #if 0
       std::cout << "Raccept " << Raccept
@@ -2253,7 +4727,22 @@ Placer::place()
       double upper = 0.6,
         lower = 0.4;
       
-      if (wire_length() < 0.95 * avg_wire_length)
+      if (adaptive)
+        {
+          if (Raccept > 0.96)
+            temp *= 0.5;
+          else if (Raccept > 0.8)
+            temp *= 0.9;
+          else if (Raccept > 0.15)
+            temp *= 0.95;
+          else
+            temp *= 0.8;
+          
+          rlim = std::min((double)M,
+                          std::max(1.0, rlim * (1 - 0.44 + Raccept)));
+          diameter = (int)(rlim + 0.5);
+        }
+      else if (wire_length() < 0.95 * avg_wire_length)
         avg_wire_length = 0.8*avg_wire_length + 0.2*wire_length();
       else
         {
@@ -2281,9 +4770,33 @@ Placer::place()
                 temp *= 0.8;
             }
         }
+      
+      // cool at least fast enough to reach stop_temp with a tenth of
+      // the budget left for the last iterations
+      if (opts.time_budget > 0
+          && temp > stop_temp)
+        {
+          double per_iter = std::chrono::duration<double>(std::chrono::steady_clock::now() - anneal_start).count() / iter;
+          double iters_left = std::max(1.0, (0.9 * opts.time_budget - elapsed) / std::max(per_iter, 1e-9));
+          temp = std::min(temp, old_temp * std::pow(stop_temp / old_temp, 1.0 / iters_left));
+        }
     }
   
   *logs << "  final wire length = " << wire_length() << "\n";
+  stats.count("place_wire_length", wire_length());
+  if (opts.congestion_weight > 0)
+    {
+      compute_congestion();
+      *logs << "  final congestion = "
+            << fmt(std::fixed << std::setprecision(1) << congestion()) << "\n";
+    }
+  if (timing)
+    {
+      update_timing();
+      *logs << "  final max delay = "
+            << fmt(std::fixed << std::setprecision(2)
+                   << timing->max_delay() / 1000.0) << " ns\n";
+    }
   
   configure();
   
@@ -2306,7 +4819,7 @@ Placer::place()
               
               for (int i = 0; i < 4; ++i)
                 {
-                  Net *n = inst->find_port(fmt("I" << i))->connection();
+                  Net *n = inst->find_port(sym_I[i])->connection();
                   if (n
                       && !n->is_constant())
                     {
@@ -2315,7 +4828,7 @@ Placer::place()
                     }
                 }
               
-              Net *clk = inst->find_port("CLK")->connection();
+              Net *clk = inst->find_port(sym_CLK)->connection();
               if (clk
                   && !clk->is_constant())
                 {
@@ -2324,7 +4837,7 @@ Placer::place()
                     demand.insert(std::make_pair(clk, 0));
                 }
 
-              Net *cen = inst->find_port("CEN")->connection();
+              Net *cen = inst->find_port(sym_CEN)->connection();
               if (cen
                   && !cen->is_constant())
                 {
@@ -2333,7 +4846,7 @@ Placer::place()
                     demand.insert(std::make_pair(cen, 0));
                 }
               
-              Net *sr = inst->find_port("SR")->connection();
+              Net *sr = inst->find_port(sym_SR)->connection();
               if (sr
                   && !sr->is_constant())
                 {
@@ -2364,18 +4877,18 @@ Placer::place()
           {
             Instance *inst = p.first;
             *logs << "LC " << inst << " " << loc.pos() << "\n";
-            *logs << "  I0 " << inst->find_port("I0")->connection()->name() << "\n";
-            *logs << "  I1 " << inst->find_port("I1")->connection()->name() << "\n";
-            *logs << "  I2 " << inst->find_port("I2")->connection()->name() << "\n";
-            *logs << "  I3 " << inst->find_port("I3")->connection()->name() << "\n";
-            if (inst->find_port("CIN")->connected())
-              *logs << "  CIN " << inst->find_port("CIN")->connection()->name() << "\n";
-            if (inst->find_port("CLK")->connected())
-              *logs << "  CLK " << inst->find_port("CLK")->connection()->name() << "\n";
-            if (inst->find_port("SR")->connected())
-              *logs << "  SR " << inst->find_port("SR")->connection()->name() << "\n";
-            if (inst->find_port("CEN")->connected())
-              *logs << "  CEN " << inst->find_port("CEN")->connection()->name() << "\n";
+            *logs << "  I0 " << inst->find_port(sym_I[0])->connection()->name() << "\n";
+            *logs << "  I1 " << inst->find_port(sym_I[1])->connection()->name() << "\n";
+            *logs << "  I2 " << inst->find_port(sym_I[2])->connection()->name() << "\n";
+            *logs << "  I3 " << inst->find_port(sym_I[3])->connection()->name() << "\n";
+            if (inst->find_port(sym_CIN)->connected())
+              *logs << "  CIN " << inst->find_port(sym_CIN)->connection()->name() << "\n";
+            if (inst->find_port(sym_CLK)->connected())
+              *logs << "  CLK " << inst->find_port(sym_CLK)->connection()->name() << "\n";
+            if (inst->find_port(sym_SR)->connected())
+              *logs << "  SR " << inst->find_port(sym_SR)->connection()->name() << "\n";
+            if (inst->find_port(sym_CEN)->connected())
+              *logs << "  CEN " << inst->find_port(sym_CEN)->connection()->name() << "\n";
           }
       }
   }
@@ -2408,16 +4921,19 @@ Placer::place()
         << "\n";
 }
 
-void
-place(random_generator &rg, DesignState &ds)
+int
+place(random_generator &rg, DesignState &ds, const PlaceOptions &opts)
 {
-  Placer placer(rg, ds);
+  Placer placer(rg, ds, opts);
   
   clock_t start = clock();
   placer.place();
   clock_t end = clock();
+  rg = placer.rg;
   
   *logs << "  place time "
-        << std::fixed << std::setprecision(2)
-        << (double)(end - start) / (double)CLOCKS_PER_SEC << "s\n";
+        << fmt(std::fixed << std::setprecision(2)
+               << (double)(end - start) / (double)CLOCKS_PER_SEC) << "s\n";
+  
+  return placer.wire_length();
 }
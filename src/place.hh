@@ -18,7 +18,57 @@
 
 class random_generator;
 class DesignState;
+class Eco;
 
-void place(random_generator &rg, DesignState &ds);
+enum class PlaceSchedule
+{
+  // 15 sweeps per temperature, cooled by acceptance rate and progress
+  DEFAULT,
+  // VPR-style, scaled by design size and driven by the acceptance rate
+  ADAPTIVE,
+};
+
+class PlaceOptions
+{
+public:
+  // 0 or 1 for the serial placer
+  int threads;
+  // if set, keep the unchanged instances where they were and only
+  // anneal the rest locally
+  const Eco *eco;
+  // start from a quadratic wire length solution instead of first-fit
+  bool analytic;
+  // start from an annealing of tile-sized clusters of connected gates
+  // instead of first-fit
+  bool multilevel;
+  // also slide carry chains along their columns, swap them, and move
+  // them into gaps between other chains
+  bool chain_moves;
+  PlaceSchedule schedule;
+  // if positive, cool fast enough to finish in about this many
+  // seconds, and stop then regardless
+  double time_budget;
+  // if positive, add this times an estimate of routing congestion
+  // from the net bounding boxes to the wire length being minimized
+  double congestion_weight;
+  // if positive, add this times the length of each net scaled by its
+  // timing criticality, from a delay estimate, to the wire length
+  double timing_weight;
+  
+  PlaceOptions()
+    : threads(0),
+      eco(nullptr),
+      analytic(false),
+      multilevel(false),
+      chain_moves(false),
+      schedule(PlaceSchedule::DEFAULT),
+      time_budget(0),
+      congestion_weight(0),
+      timing_weight(0)
+  {}
+};
+
+// returns the final wire length
+int place(random_generator &rg, DesignState &ds, const PlaceOptions &opts);
 
 #endif
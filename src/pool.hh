@@ -0,0 +1,100 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_POOL_HH
+#define PNR_POOL_HH
+
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+// Allocator for objects of one size.  Objects are carved out of large
+// chunks and freed objects are recycled, so allocation and teardown
+// don't go through malloc for each object.  Chunks are only released
+// when the pool is destroyed.
+//
+// Each object is preceded by a pointer to its pool, so deallocate
+// doesn't need to be told the pool.  There is no locking: a pool
+// belongs to one owner, like a Design, which is only changed on one
+// thread at a time.
+class FixedPool
+{
+  // keeps objects pointer aligned, which is all the netlist needs
+  static const size_t header = sizeof(void *);
+  
+  size_t obj_size;
+  size_t chunk_objs;
+  
+  std::vector<char *> chunks;
+  void *free_list;
+  char *next, *end;
+  
+public:
+  FixedPool(size_t obj_size_, size_t chunk_bytes = 64 * 1024)
+    : obj_size(header
+               + ((obj_size_ + sizeof(void *) - 1) / sizeof(void *))
+               * sizeof(void *)),
+      chunk_objs(std::max((size_t)1, chunk_bytes / obj_size)),
+      free_list(nullptr),
+      next(nullptr),
+      end(nullptr)
+  {}
+  FixedPool(const FixedPool &) = delete;
+  FixedPool &operator=(const FixedPool &) = delete;
+  
+  ~FixedPool()
+  {
+    for (char *c : chunks)
+      delete[] c;
+  }
+  
+  void *allocate()
+  {
+    char *slot;
+    if (free_list)
+      {
+        slot = (char *)free_list;
+        free_list = *(void **)slot;
+      }
+    else
+      {
+        if (next == end)
+          {
+            // new[] storage is suitably aligned for any object size
+            next = new char[chunk_objs * obj_size];
+            end = next + chunk_objs * obj_size;
+            chunks.push_back(next);
+          }
+        slot = next;
+        next += obj_size;
+      }
+    *(FixedPool **)slot = this;
+    return slot + header;
+  }
+  
+  // p from allocate on any pool
+  static void deallocate(void *p)
+  {
+    if (!p)
+      return;
+    char *slot = (char *)p - header;
+    FixedPool *pool = *(FixedPool **)slot;
+    *(void **)slot = pool->free_list;
+    pool->free_list = slot;
+  }
+};
+
+#endif
@@ -17,7 +17,9 @@
 #define PNR_PRIORITYQQ_HH
 
 #include <functional>
+#include <algorithm>
 #include <vector>
+#include <cassert>
 
 template<typename T, typename Comp = std::less<T>>
 class PriorityQ
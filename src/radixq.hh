@@ -0,0 +1,166 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_RADIXQ_HH
+#define PNR_RADIXQ_HH
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cassert>
+
+// Monotone radix heap over ids [0, capacity) with unsigned keys.  A
+// key pushed (or decreased to) must not be smaller than the last key
+// popped, as in Dijkstra's algorithm with non-negative costs.  Each
+// id is in the queue at most once and decrease() moves it, so there
+// are no stale entries.
+class RadixQ
+{
+  // bucket b > 0 holds keys whose highest bit differing from last is
+  // bit b - 1; bucket 0 holds keys equal to last
+  static const int n_buckets = 33;
+
+  std::vector<int> bucket[n_buckets];
+  std::vector<unsigned> key;
+  // bucket of id, -1 if not in the queue
+  std::vector<int> where;
+  // index of id in its bucket
+  std::vector<int> pos;
+  unsigned last;
+  size_t n;
+
+  int bucket_of(unsigned k) const
+  {
+    unsigned x = k ^ last;
+    if (!x)
+      return 0;
+#ifdef __GNUC__
+    return 32 - __builtin_clz(x);
+#else
+    int b = 0;
+    for (; x; x >>= 1)
+      ++b;
+    return b;
+#endif
+  }
+
+  void place(int id)
+  {
+    int b = bucket_of(key[id]);
+    where[id] = b;
+    pos[id] = bucket[b].size();
+    bucket[b].push_back(id);
+  }
+
+  void unplace(int id)
+  {
+    std::vector<int> &v = bucket[where[id]];
+    int p = pos[id];
+    int ell = v.back();
+    v[p] = ell;
+    pos[ell] = p;
+    v.pop_back();
+    where[id] = -1;
+  }
+
+public:
+  RadixQ() : last(0), n(0) {}
+  RadixQ(size_t cap)
+    : key(cap), where(cap, -1), pos(cap), last(0), n(0)
+  {}
+
+  size_t capacity() const { return key.size(); }
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+
+  void clear()
+  {
+    for (int b = 0; b < n_buckets; ++b)
+      {
+        for (int id : bucket[b])
+          where[id] = -1;
+        bucket[b].clear();
+      }
+    last = 0;
+    n = 0;
+  }
+
+  bool contains(int id) const { return where[id] >= 0; }
+  unsigned key_of(int id) const { assert(contains(id)); return key[id]; }
+
+  void push(int id, unsigned k)
+  {
+    assert(!contains(id));
+    assert(k >= last);
+    key[id] = k;
+    place(id);
+    ++n;
+  }
+
+  void decrease(int id, unsigned k)
+  {
+    assert(contains(id));
+    assert(k >= last && k <= key[id]);
+    key[id] = k;
+    if (bucket_of(k) != where[id])
+      {
+        unplace(id);
+        place(id);
+      }
+  }
+
+  void erase(int id)
+  {
+    if (!contains(id))
+      return;
+    unplace(id);
+    --n;
+  }
+
+  // id, key
+  std::pair<int, unsigned> pop()
+  {
+    assert(n > 0);
+    if (bucket[0].empty())
+      {
+        int b = 1;
+        while (bucket[b].empty())
+          ++b;
+
+        std::vector<int> v;
+        v.swap(bucket[b]);
+        unsigned m = key[v[0]];
+        for (int id : v)
+          {
+            if (key[id] < m)
+              m = key[id];
+          }
+        last = m;
+        // everything in v now lands in a lower bucket
+        for (int id : v)
+          place(id);
+        v.clear();
+        v.swap(bucket[b]);
+      }
+
+    int id = bucket[0].back();
+    bucket[0].pop_back();
+    where[id] = -1;
+    --n;
+    return std::make_pair(id, key[id]);
+  }
+};
+
+#endif
@@ -22,9 +22,18 @@
 #include "bitvector.hh"
 #include "ullmanset.hh"
 #include "priorityq.hh"
+#include "radixq.hh"
 #include "designstate.hh"
+#include "eco.hh"
+#include "stats.hh"
+#include "threadpool.hh"
+#include "timing.hh"
+#include "route.hh"
 
 #include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <ostream>
 #include <iostream>
 #include <iomanip>
@@ -32,7 +41,10 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <memory>
+#include <limits>
 #include <ctime>
+#include <chrono>
 
 class Router;
 
@@ -50,60 +62,333 @@ public:
   }
 };
 
+// one switch used by a routed net: prev -> cn through
+// chipdb->fanout_edges[edge]
+class RouteStep
+{
+public:
+  int prev;
+  int cn;
+  int edge;
+  
+  RouteStep(int prev_, int cn_, int edge_)
+    : prev(prev_), cn(cn_), edge(edge_)
+  {}
+};
+
+// the search state of one cnet, together so that expand touches one
+// record per fanout
+class SearchNode
+{
+public:
+  int cost;
+  // A* lower bound on the cost from the cnet to an unrouted target,
+  // valid for frontier cnets
+  int estimate;
+  int backptr;
+  int backedge;
+  // the cnet is visited (on the frontier) in the current search if
+  // this equals RouteSearch::stamp
+  unsigned visited, frontier;
+  
+  SearchNode()
+    : cost(0), estimate(0), backptr(-1), backedge(-1),
+      visited(0), frontier(0)
+  {}
+};
+
+// the congestion of a cnet: the nets using it, and the sum of its
+// overuse after each pass
+class CnetDemand
+{
+public:
+  int nets;
+  int historical;
+  
+  CnetDemand() : nets(0), historical(0) {}
+};
+
+// search state, one per routing thread
+class RouteSearch
+{
+public:
+  UllmanSet unrouted;
+  
+  std::vector<SearchNode> node;
+  // bumped to clear visited and frontier at the start of a search
+  unsigned stamp;
+  int n_frontier;
+  
+  // cn, cost + estimate, with lazy deletion
+  PriorityQ<std::pair<int, int>, Comp> frontierq;
+  // holds exactly the frontier if the router uses it
+  RadixQ frontier_rq;
+  
+  // bboxes of the unrouted targets (or their union if there are
+  // many) for the estimate
+  std::vector<int> goal_xmin,
+    goal_xmax,
+    goal_ymin,
+    goal_ymax;
+  
+  // if set, a visited cnet that can be reached more cheaply goes
+  // back on the frontier, as after grow_tree
+  bool reopen;
+  
+  // if bounded, skip cnets whose bbox doesn't meet the region
+  bool bounded;
+  int xmin, xmax, ymin, ymax;
+  // if set, only the cnets of the tree that meet the region start
+  // the search, for the edges of a Steiner tree
+  bool corridor;
+  
+  // cost per ps of cnet delay for the net being routed
+  double delay_weight;
+  
+  // for stats
+  long long n_expanded, n_pushed, n_popped;
+  int n_routed;
+  
+  RouteSearch(int n_cnets)
+    : unrouted(n_cnets),
+      node(n_cnets),
+      stamp(1),
+      n_frontier(0),
+      frontier_rq(n_cnets),
+      reopen(false),
+      bounded(false),
+      xmin(0), xmax(0), ymin(0), ymax(0),
+      corridor(false),
+      delay_weight(0),
+      n_expanded(0), n_pushed(0), n_popped(0),
+      n_routed(0)
+  {}
+  
+  void clear()
+  {
+    ++stamp;
+    if (!stamp)
+      {
+        for (SearchNode &sn : node)
+          sn.visited = sn.frontier = 0;
+        stamp = 1;
+      }
+    n_frontier = 0;
+  }
+  
+  bool meets(const NetBBox &b) const
+  {
+    return (b.xmax >= xmin
+            && b.xmin <= xmax
+            && b.ymax >= ymin
+            && b.ymin <= ymax);
+  }
+  
+  bool visited(int cn) const { return node[cn].visited == stamp; }
+  void set_visited(int cn) { node[cn].visited = stamp; }
+  void unset_visited(int cn) { node[cn].visited = 0; }
+  
+  bool on_frontier(int cn) const { return node[cn].frontier == stamp; }
+  void push_frontier(int cn)
+  {
+    assert(!on_frontier(cn));
+    node[cn].frontier = stamp;
+    ++n_frontier;
+  }
+  void erase_frontier(int cn)
+  {
+    if (on_frontier(cn))
+      {
+        node[cn].frontier = 0;
+        --n_frontier;
+      }
+  }
+};
+
+// the LC and IO ports port_cnet looks up by symbol, and the tile nets
+// they connect to
+static const Symbol sym_CIN("CIN");
+static const Symbol lc_ports[] = {
+  Symbol("I0"), Symbol("I1"), Symbol("I2"), Symbol("I3"), sym_CIN,
+  Symbol("CLK"), Symbol("CEN"), Symbol("SR"),
+  Symbol("LO"), Symbol("O"), Symbol("COUT"),
+};
+static const int n_lc_ports = sizeof(lc_ports) / sizeof(lc_ports[0]);
+
+static const Symbol io_ports[] = {
+  Symbol("LATCH_INPUT_VALUE"), Symbol("CLOCK_ENABLE"),
+  Symbol("INPUT_CLK"), Symbol("OUTPUT_CLK"), Symbol("OUTPUT_ENABLE"),
+  Symbol("D_OUT_0"), Symbol("D_OUT_1"), Symbol("D_IN_0"), Symbol("D_IN_1"),
+};
+static const int n_io_ports = sizeof(io_ports) / sizeof(io_ports[0]);
+
+// cells per tile
+static const int n_tile_positions = 8;
+
+static int
+port_index(const Symbol *ports, int n, Symbol name)
+{
+  for (int k = 0; k < n; ++k)
+    if (ports[k] == name)
+      return k;
+  return -1;
+}
+
+static std::string
+lc_tile_net_name(int k, int pos)
+{
+  switch (k)
+    {
+    case 0: case 1: case 2: case 3:
+      return fmt("lutff_" << pos << "/in_" << k);
+    case 4:
+      return "carry_in_mux";
+    case 5:
+      return "lutff_global/clk";
+    case 6:
+      return "lutff_global/cen";
+    case 7:
+      return "lutff_global/s_r";
+    case 8:
+      return fmt("lutff_" << pos << "/lout");
+    case 9:
+      return fmt("lutff_" << pos << "/out");
+    default:
+      assert(k == 10);
+      return fmt("lutff_" << pos << "/cout");
+    }
+}
+
+static std::string
+io_tile_net_name(int k, int pos)
+{
+  switch (k)
+    {
+    case 0:
+      return "io_global/latch";
+    case 1:
+      return "io_global/cen";
+    case 2:
+      return "io_global/inclk";
+    case 3:
+      return "io_global/outclk";
+    case 4:
+      return fmt("io_" << pos << "/OUT_ENB");
+    default:
+      return fmt("io_" << pos << "/" << io_ports[k].name());
+    }
+}
+
 class Router
 {
   const ChipDB *chipdb;
   Design *d;
   Models &models;
   const std::map<Instance *, int, IdLess> &placement;
+  const NetlistIndex &index;
   std::vector<Net *> &cnet_net;
   Configuration &conf;
   
-  BitVector cnet_global,
-    cnet_local;
-  std::vector<std::vector<int>> cnet_outs;
-  
   std::map<std::string, std::pair<std::string, bool>> ram_gate_chip;
   std::map<std::string, std::string> pll_gate_chip;
   
-  std::vector<std::vector<int>> cnet_tiles;
-  // cnet_bbox
-  std::vector<int> cnet_xmin,
-    cnet_xmax,
-    cnet_ymin,
-    cnet_ymax;
+  // net name table indices of lc_tile_net_name(k, pos) and
+  // io_tile_net_name(k, pos), at [pos * n_lc_ports + k] and
+  // [pos * n_io_ports + k], or -1 if the chip has no such net
+  std::vector<int> lc_port_net_name,
+    io_port_net_name;
+  
+  const FlatArray<NetBBox> &cnet_bbox;
   
   int n_nets;  // to route
   std::vector<int> net_source;
   std::vector<std::vector<int>> net_targets;
   std::vector<Net *> net_net;
+  // union of the cnet bboxes of the net's source and targets
+  std::vector<int> net_xmin,
+    net_xmax,
+    net_ymin,
+    net_ymax;
   
   int max_passes;
   int passes;
   
-  int n_shared;
-  std::vector<int> demand;
-  std::vector<int> historical_demand;
-  std::vector<std::vector<std::pair<int, int>>> net_route;
+  RouteSchedule schedule;
+  int stall_passes;
+  // congestion cost of one more net on a cnet, grown per pass by the
+  // adaptive schedule; present_cost is its integer part, for visit
+  double present_factor;
+  int present_cost;
+  // least number of shared cnets after each pass so far
+  std::vector<int> best_shared;
   
-  // per net
-  int current_net;
-  UllmanSet unrouted;
+  // 0 for the serial router
+  int route_threads;
+  std::vector<RouteSearch> searches;
   
-  UllmanSet visited;
+  bool astar;
+  bool radix_queue;
+  bool multi_sink;
+  int bbox_margin;
+  int steiner_fanout;
+  // per net, -1 if unbounded
+  std::vector<int> net_margin;
+  // max extent of a cnet a switch can drive, in x and y, for the
+  // A* estimate
+  int hop_dx, hop_dy;
   
-  UllmanSet frontier;
-  // cn, cost[cn]
-  PriorityQ<std::pair<int, int>, Comp> frontierq;
+  int n_shared;
+  std::vector<CnetDemand> demand;
+  std::vector<std::vector<RouteStep>> net_route;
+  // the first net_counted[net] steps of net_route[net] are included
+  // in demand
+  std::vector<int> net_counted;
+  // index in net_route[net] of the step driving cn, for ripup_congested
+  std::vector<int> step_of;
+  
+  // set if timing_weight or report_timing
+  std::unique_ptr<Timing> timing;
+  double timing_weight;
+  // per net: the index net, the target cnets with their sink pins,
+  // and the cost per ps of delay from its criticality
+  std::vector<int> net_index_net;
+  std::vector<std::vector<std::pair<int, int>>> net_sink_pins;
+  std::vector<double> net_delay_weight;
+  
+  const Eco *eco;
+  // nets that start the first pass from their route in the ECO
+  // reference
+  BitVector net_seeded;
   
-  std::vector<int> backptr;
-  std::vector<int> cost;
+  std::ostream *trace;
   
-  void start(int net);
-  int pop();
-  void visit(int cn);
+  void set_goals(RouteSearch &rs);
+  int estimate(RouteSearch &rs, int cn) const;
+  void start(RouteSearch &rs, int net);
+  int pop(RouteSearch &rs);
+  void visit(RouteSearch &rs, int cn);
+  void expand(RouteSearch &rs, int cn);
+  void grow_tree(RouteSearch &rs, int net, int k);
+  bool search(RouteSearch &rs, int net);
+  bool route_steiner(RouteSearch &rs, int net);
   void ripup(int net);
-  void traceback(int net, int target);
+  void ripup_congested(int net);
+  void ripup_pass(int net);
+  bool seed_route(RouteSearch &rs, int net);
+  void traceback(RouteSearch &rs, int net, int target);
+  void add_demand(int net);
+  bool route_net(RouteSearch &rs, int net);
+  void report_unrouted(int net);
+  bool congested(int net) const;
+  void route_pass();
+  void route_pass_batched(ThreadPool &pool);
+  void reset_schedule();
+  void update_schedule();
+  bool stalled();
+  void route_delays();
+  void update_timing();
+  void write_trace(double wall, int n_routed, long long n_expanded,
+                   long long n_pushed, long long n_popped);
   
   int port_cnet(Instance *inst, Port *p);
 
@@ -112,9 +397,10 @@ class Router
 #endif
   
 public:
-  Router(DesignState &ds, int max_passes_v);
+  Router(DesignState &ds, const RouteOptions &opts);
   
   void route();
+  int n_passes() const { return passes; }
 };
 
 int
@@ -128,62 +414,34 @@ Router::port_cnet(Instance *inst, Port *p)
   std::string tile_net_name;
   if (models.is_lc(inst))
     {
-      if (p_name == "CLK")
-        tile_net_name = fmt("lutff_global/clk");
-      else if (p_name == "CEN")
-        tile_net_name = fmt("lutff_global/cen");
-      else if (p_name == "SR")
-        tile_net_name = fmt("lutff_global/s_r");
-      else if (p_name == "I0")
-        tile_net_name = fmt("lutff_" << loc.pos() << "/in_0");
-      else if (p_name == "I1")
-        tile_net_name = fmt("lutff_" << loc.pos() << "/in_1");
-      else if (p_name == "I2")
-        tile_net_name = fmt("lutff_" << loc.pos() << "/in_2");
-      else if (p_name == "I3")
-        tile_net_name = fmt("lutff_" << loc.pos() << "/in_3");
-      else if (p_name == "CIN")
-        {
-          if (loc.pos() == 0)
-            tile_net_name = "carry_in_mux";
-          else
-            return -1;
-        }
-      else if (p_name == "COUT")
-        tile_net_name = fmt("lutff_" << loc.pos() << "/cout");
-      else if (p_name == "LO")
-        tile_net_name = fmt("lutff_" << loc.pos() << "/lout");
-      else
-        {
-          assert(p_name == "O");
-          tile_net_name = fmt("lutff_" << loc.pos() << "/out");
-        }
-      if (chipdb->tile_nets[t].find(tile_net_name) == chipdb->tile_nets[t].end())
+      int k = port_index(lc_ports, n_lc_ports, p->symbol());
+      assert(k >= 0);
+      if (p->symbol() == sym_CIN
+          && loc.pos() != 0)
+        return -1;
+      
+      assert(loc.pos() < n_tile_positions);
+      int ni = lc_port_net_name[loc.pos() * n_lc_ports + k];
+      int n = ni >= 0 ? chipdb->tile_net(t, ni) : -1;
+      if (n < 0)
       {
-        fatal(fmt("failed to rote:  " << p->name() << " to " << tile_net_name));
+        fatal(fmt("failed to rote:  " << p->name() << " to " << lc_tile_net_name(k, loc.pos())));
       }
+      return n;
     }
   else if (models.is_ioX(inst))
     {
-      if (p_name == "LATCH_INPUT_VALUE")
-        tile_net_name = fmt("io_global/latch");
-      else if (p_name == "CLOCK_ENABLE")
-        tile_net_name = fmt("io_global/cen");
-      else if (p_name == "INPUT_CLK")
-        tile_net_name = fmt("io_global/inclk");
-      else if (p_name == "OUTPUT_CLK")
-        tile_net_name = fmt("io_global/outclk");
-      else if (p_name == "OUTPUT_ENABLE")
-        tile_net_name = fmt("io_" << loc.pos() << "/OUT_ENB");
-      else if (p_name == "D_OUT_0")
-        tile_net_name = fmt("io_" << loc.pos() << "/D_OUT_0");
-      else if (p_name == "D_OUT_1")
-        tile_net_name = fmt("io_" << loc.pos() << "/D_OUT_1");
-      else if (p_name == "D_IN_0")
-        tile_net_name = fmt("io_" << loc.pos() << "/D_IN_0");
-      else if (p_name == "D_IN_1")
-        tile_net_name = fmt("io_" << loc.pos() << "/D_IN_1");
-      else if (models.is_io_i3c(inst))
+      int k = port_index(io_ports, n_io_ports, p->symbol());
+      if (k >= 0)
+        {
+          assert(loc.pos() < n_tile_positions);
+          int ni = io_port_net_name[loc.pos() * n_io_ports + k];
+          int n = ni >= 0 ? chipdb->tile_net(t, ni) : -1;
+          assert(n >= 0);
+          return n;
+        }
+      
+      if (models.is_io_i3c(inst))
         {
           assert(p_name == "PU_ENB" || p_name == "WEAK_PU_ENB");
           bool found = false;
@@ -235,7 +493,7 @@ Router::port_cnet(Instance *inst, Port *p)
       tile_net_name = r.first;
       
       // FIXME if (r.second)
-      if (!contains(chipdb->tile_nets[t], tile_net_name))
+      if (chipdb->tile_net(t, tile_net_name) < 0)
         t = chipdb->tile(chipdb->tile_x(loc.tile()),
                          chipdb->tile_y(loc.tile()) - 1);
     }
@@ -313,7 +571,8 @@ Router::port_cnet(Instance *inst, Port *p)
 #endif
     }
   
-  int n = chipdb->tile_nets[t].at(tile_net_name);
+  int n = chipdb->tile_net(t, tile_net_name);
+  assert(n >= 0);
   return n;
 }
 
@@ -324,13 +583,13 @@ Router::check()
   std::vector<int> demand2 (chipdb->n_nets, 0);
   for (int i = 0; i < n_nets; ++i)
     {
-      for (const auto &p : net_route[i])
-        ++demand2[p.second];
+      for (const RouteStep &st : net_route[i])
+        ++demand2[st.cn];
     }
   int n_shared2 = 0;
   for (int i = 0; i < chipdb->n_nets; ++i)  
     {
-      assert(demand2[i] == demand[i]);
+      assert(demand2[i] == demand[i].nets);
       if (demand2[i] > 1)
         ++n_shared2;
     }
@@ -338,67 +597,49 @@ Router::check()
 }
 #endif
 
-Router::Router(DesignState &ds, int max_passes_v)
+Router::Router(DesignState &ds, const RouteOptions &opts)
   : chipdb(ds.chipdb),
     d(ds.d),
     models(ds.models),
     placement(ds.placement),
+    index(ds.netlist_index()),
     cnet_net(ds.cnet_net),
     conf(ds.conf),
-    cnet_global(chipdb->n_nets),
-    cnet_local(chipdb->n_nets),
-    cnet_outs(chipdb->n_nets),
-    cnet_tiles(chipdb->n_nets),
-    cnet_xmin(chipdb->n_nets),
-    cnet_xmax(chipdb->n_nets),
-    cnet_ymin(chipdb->n_nets),
-    cnet_ymax(chipdb->n_nets),
+    cnet_bbox(chipdb->net_bbox),
     n_nets(0),
-    max_passes(max_passes_v),
+    max_passes(opts.max_passes),
+    schedule(opts.schedule),
+    stall_passes(opts.stall_passes),
+    route_threads(opts.threads),
+    astar(opts.astar),
+    radix_queue(opts.radix_queue),
+    multi_sink(opts.multi_sink),
+    bbox_margin(opts.bbox_margin),
+    steiner_fanout(opts.steiner_fanout),
+    hop_dx(1),
+    hop_dy(1),
     n_shared(0),
-    demand(chipdb->n_nets, 0),
-    historical_demand(chipdb->n_nets, 0),
-    unrouted(chipdb->n_nets),
-    visited(chipdb->n_nets),
-    frontier(chipdb->n_nets),
-    backptr(chipdb->n_nets),
-    cost(chipdb->n_nets)
+    demand(chipdb->n_nets),
+    step_of(chipdb->n_nets, -1),
+    timing_weight(opts.timing_weight),
+    eco(opts.eco),
+    trace(opts.trace)
 {
-  cnet_net = std::vector<Net *>(chipdb->n_nets, nullptr);
+  if (timing_weight > 0
+      || opts.report_timing)
+    timing.reset(new Timing(ds));
   
-  for (int t = 0; t < chipdb->n_tiles; ++t)
-    {
-      for (const auto &p : chipdb->tile_nets[t])
-        {
-          if (is_prefix("local_", p.first))
-            {
-              if (!cnet_local[p.second])
-                {
-                  cnet_local[p.second] = true;
-                  break;
-                }
-            }
-          else if (is_prefix("glb_netwk_", p.first))
-            {
-              if (!cnet_global[p.second])
-                {
-                  cnet_global[p.second] = true;
-                  break;
-                }
-            }
-        }
-    }
+  for (int i = 0; i < std::max(route_threads, 1); ++i)
+    searches.push_back(RouteSearch(chipdb->n_nets));
   
-  for (int i = 0; i < chipdb->n_nets; ++i)
+  cnet_net = std::vector<Net *>(chipdb->n_nets, nullptr);
+  
+  for (int pos = 0; pos < n_tile_positions; ++pos)
     {
-      for (int s : chipdb->in_switches[i])
-        {
-          assert(contains_key(chipdb->switches[s].in_val, i));
-          int j = chipdb->switches[s].out;
-          assert(j != i);
-          
-          cnet_outs[i].push_back(j);
-        }
+      for (int k = 0; k < n_lc_ports; ++k)
+        lc_port_net_name.push_back(chipdb->net_name_index(lc_tile_net_name(k, pos)));
+      for (int k = 0; k < n_io_ports; ++k)
+        io_port_net_name.push_back(chipdb->net_name_index(io_tile_net_name(k, pos)));
     }
   
   for (int i = 0; i <= 7; ++i)
@@ -501,124 +742,263 @@ Router::Router(DesignState &ds, int max_passes_v)
   extend(pll_gate_chip, "PLLOUTCOREA", "PLLOUT_A");
   extend(pll_gate_chip, "PLLOUTCOREB", "PLLOUT_B");
   
-  for (int t = 0; t < chipdb->n_tiles; ++t)
-    for (const auto &p : chipdb->tile_nets[t])
-      cnet_tiles[p.second].push_back(t);
+  for (const FanoutEdge &fe : chipdb->fanout_edges)
+    {
+      const NetBBox &b = cnet_bbox[fe.out];
+      hop_dx = std::max(hop_dx, b.xmax - b.xmin);
+      hop_dy = std::max(hop_dy, b.ymax - b.ymin);
+    }
+}
+
+void
+Router::set_goals(RouteSearch &rs)
+{
+  static const int max_goals = 8;
   
-  for (int i = 0; i < chipdb->n_nets; ++i)
+  rs.goal_xmin.clear();
+  rs.goal_xmax.clear();
+  rs.goal_ymin.clear();
+  rs.goal_ymax.clear();
+  for (int i = 0; i < (int)rs.unrouted.size(); ++i)
     {
-      assert(!cnet_tiles[i].empty());
-      int t0 = cnet_tiles[i][0];
-      int xmin, xmax, ymin, ymax;
-      xmin = xmax = chipdb->tile_x(t0);
-      ymin = ymax = chipdb->tile_y(t0);
-      for (int j = 1; j < (int)cnet_tiles[i].size(); ++j)
+      int cn = rs.unrouted.ith(i);
+      if (i < max_goals)
         {
-          int t = cnet_tiles[i][j];
-          xmin = std::min(xmin, chipdb->tile_x(t));
-          xmax = std::max(xmax, chipdb->tile_x(t));
-          ymin = std::min(ymin, chipdb->tile_y(t));
-          ymax = std::max(ymax, chipdb->tile_y(t));
+          rs.goal_xmin.push_back(cnet_bbox[cn].xmin);
+          rs.goal_xmax.push_back(cnet_bbox[cn].xmax);
+          rs.goal_ymin.push_back(cnet_bbox[cn].ymin);
+          rs.goal_ymax.push_back(cnet_bbox[cn].ymax);
+        }
+      else
+        {
+          if (i == max_goals)
+            {
+              for (int j = 1; j < max_goals; ++j)
+                {
+                  rs.goal_xmin[0] = std::min(rs.goal_xmin[0], rs.goal_xmin[j]);
+                  rs.goal_xmax[0] = std::max(rs.goal_xmax[0], rs.goal_xmax[j]);
+                  rs.goal_ymin[0] = std::min(rs.goal_ymin[0], rs.goal_ymin[j]);
+                  rs.goal_ymax[0] = std::max(rs.goal_ymax[0], rs.goal_ymax[j]);
+                }
+              rs.goal_xmin.resize(1);
+              rs.goal_xmax.resize(1);
+              rs.goal_ymin.resize(1);
+              rs.goal_ymax.resize(1);
+            }
+          rs.goal_xmin[0] = std::min(rs.goal_xmin[0], cnet_bbox[cn].xmin);
+          rs.goal_xmax[0] = std::max(rs.goal_xmax[0], cnet_bbox[cn].xmax);
+          rs.goal_ymin[0] = std::min(rs.goal_ymin[0], cnet_bbox[cn].ymin);
+          rs.goal_ymax[0] = std::max(rs.goal_ymax[0], cnet_bbox[cn].ymax);
         }
-      cnet_xmin[i] = xmin;
-      cnet_xmax[i] = xmax;
-      cnet_ymin[i] = ymin;
-      cnet_ymax[i] = ymax;
     }
 }
 
+// Every switch costs at least 1 and the cnets of consecutive switches
+// share a tile, so reaching a target whose bbox is dx tiles away in x
+// takes at least 1 + ceil(dx / hop_dx) more switches (and similarly
+// in y).  The estimate changes by at most 1 per switch, so it is
+// consistent and cnets are still final when popped.
+int
+Router::estimate(RouteSearch &rs, int cn) const
+{
+  if (rs.unrouted.contains(cn))
+    return 0;
+  
+  const NetBBox &b = cnet_bbox[cn];
+  int best = std::numeric_limits<int>::max();
+  for (int i = 0; i < (int)rs.goal_xmin.size(); ++i)
+    {
+      int dx = std::max(0, std::max(rs.goal_xmin[i] - b.xmax,
+                                    b.xmin - rs.goal_xmax[i])),
+        dy = std::max(0, std::max(rs.goal_ymin[i] - b.ymax,
+                                  b.ymin - rs.goal_ymax[i]));
+      int h = 1 + std::max((dx + hop_dx - 1) / hop_dx,
+                           (dy + hop_dy - 1) / hop_dy);
+      best = std::min(best, h);
+    }
+  return best;
+}
+
 void
-Router::start(int net)
+Router::start(RouteSearch &rs, int net)
 {
-  visited.clear();
+  rs.clear();
+  rs.reopen = false;
+  
+  rs.frontierq.clear();
+  rs.frontier_rq.clear();
   
-  frontier.clear();
-  frontierq.clear();
+  if (astar)
+    set_goals(rs);
   
   int source = net_source[net];
-  cost[source] = 0;
-  backptr[source] = -1;
-  visit(source);
+  if (rs.corridor)
+    {
+      // the whole tree is reached, so no path runs back into it, but
+      // only the part near the corridor is expanded
+      rs.node[source].cost = 0;
+      rs.node[source].backptr = -1;
+      rs.set_visited(source);
+      for (const RouteStep &st : net_route[net])
+        {
+          rs.node[st.cn].cost = 0;
+          rs.node[st.cn].backptr = -1;
+          rs.set_visited(st.cn);
+        }
+      
+      if (rs.meets(cnet_bbox[source]))
+        expand(rs, source);
+      for (const RouteStep &st : net_route[net])
+        {
+          if (rs.meets(cnet_bbox[st.cn]))
+            expand(rs, st.cn);
+        }
+      return;
+    }
+  
+  rs.node[source].cost = 0;
+  rs.node[source].backptr = -1;
+  visit(rs, source);
   
-  for (const auto &p : net_route[net])
+  for (const RouteStep &st : net_route[net])
     {
-      frontier.erase(p.second);
+      rs.erase_frontier(st.cn);
+      rs.frontier_rq.erase(st.cn);
       
-      cost[p.second] = 0;
-      backptr[p.second] = -1;
-      visit(p.second);
+      rs.node[st.cn].cost = 0;
+      rs.node[st.cn].backptr = -1;
+      visit(rs, st.cn);
     }
 }
 
 void
-Router::visit(int cn)
+Router::visit(RouteSearch &rs, int cn)
 {
-  assert(!frontier.contains(cn));
-  visited.extend(cn);
+  assert(!rs.visited(cn));
+  rs.set_visited(cn);
+  expand(rs, cn);
+}
+
+void
+Router::expand(RouteSearch &rs, int cn)
+{
+  assert(!rs.on_frontier(cn));
+  ++rs.n_expanded;
   
-  for (int cn2 : cnet_outs[cn])
+  const FanoutEdge *edges = chipdb->fanout_edges.data();
+  int cn_cost = rs.node[cn].cost;
+  for (const FanoutEdge &fe : chipdb->fanout(cn))
     {
-      if (visited.contains(cn2))
+      int cn2 = fe.out;
+      SearchNode &sn = rs.node[cn2];
+      bool reopen = false;
+      if (sn.visited == rs.stamp)
+        {
+          if (!rs.reopen)
+            continue;
+          reopen = true;
+        }
+      if (rs.bounded
+          && (cnet_bbox[cn2].xmax < rs.xmin
+              || cnet_bbox[cn2].xmin > rs.xmax
+              || cnet_bbox[cn2].ymax < rs.ymin
+              || cnet_bbox[cn2].ymin > rs.ymax))
         continue;
       
+      const CnetDemand &dm = demand[cn2];
       int cn2_cost = 1;  // base
       if (passes == max_passes)
         {
-          if (demand[cn2])
+          if (dm.nets)
             cn2_cost = 1000000;
         }
       else // if (passes > 1)
         {
-          cn2_cost += historical_demand[cn2];
-          cn2_cost *= (1 + 3 * demand[cn2]);
+          cn2_cost += dm.historical;
+          cn2_cost *= (1 + present_cost * dm.nets);
         }
+      if (rs.delay_weight > 0)
+        cn2_cost += (int)(rs.delay_weight * timing->cnet_delay(cn2) + 0.5);
       
-      int new_cost = cost[cn] + cn2_cost;
+      int new_cost = cn_cost + cn2_cost;
+      
+      if (reopen)
+        {
+          if (new_cost >= sn.cost)
+            continue;
+          rs.unset_visited(cn2);
+        }
       
-      if (frontier.contains(cn2))
+      if (sn.frontier == rs.stamp)
         {
-          if (new_cost < cost[cn2])
+          if (new_cost < sn.cost)
             {
 #if 0
               std::cout << "update cn " << cn2
-                        << " old_cost " << cost[cn2]
+                        << " old_cost " << sn.cost
                         << " new_cost " << new_cost << "\n";
 #endif
-              cost[cn2] = new_cost;
-              backptr[cn2] = cn;
-              frontierq.push(std::make_pair(cn2, new_cost));
+              sn.cost = new_cost;
+              sn.backptr = cn;
+              sn.backedge = &fe - edges;
+              ++rs.n_pushed;
+              if (radix_queue)
+                rs.frontier_rq.decrease(cn2, new_cost + sn.estimate);
+              else
+                rs.frontierq.push(std::make_pair(cn2,
+                                                 new_cost + sn.estimate));
             }
         }
       else
         {
-          cost[cn2] = new_cost;
-          backptr[cn2] = cn;
+          sn.cost = new_cost;
+          sn.backptr = cn;
+          sn.backedge = &fe - edges;
+          sn.estimate = astar ? estimate(rs, cn2) : 0;
 #if 0
           std::cout << "add cn " << cn2
                     << " cost " << new_cost << "\n";
 #endif
-          frontier.insert(cn2);
-          frontierq.push(std::make_pair(cn2, new_cost));
+          rs.push_frontier(cn2);
+          ++rs.n_pushed;
+          if (radix_queue)
+            rs.frontier_rq.push(cn2, new_cost + sn.estimate);
+          else
+            rs.frontierq.push(std::make_pair(cn2,
+                                             new_cost + sn.estimate));
         }
     }
 }
 
 int
-Router::pop()
+Router::pop(RouteSearch &rs)
 {
+  if (radix_queue)
+    {
+      int cn;
+      unsigned cn_key;
+      std::tie(cn, cn_key) = rs.frontier_rq.pop();
+      ++rs.n_popped;
+      assert(rs.on_frontier(cn));
+      assert((int)cn_key == rs.node[cn].cost + rs.node[cn].estimate);
+      rs.erase_frontier(cn);
+      return cn;
+    }
+  
  L:
-  assert(!frontierq.empty());
-  int cn, cn_cost;
-  std::tie(cn, cn_cost) = frontierq.pop();
-  if (!frontier.contains(cn))
+  assert(!rs.frontierq.empty());
+  int cn, cn_key;
+  std::tie(cn, cn_key) = rs.frontierq.pop();
+  ++rs.n_popped;
+  if (!rs.on_frontier(cn))
     goto L;
   
   // *logs << "pop " << cn << "\n";
-  assert(cn_cost == cost[cn]);
-  assert(frontierq.empty()
-         || cn_cost <= frontierq.top().second);
+  assert(cn_key == rs.node[cn].cost + rs.node[cn].estimate);
+  assert(rs.frontierq.empty()
+         || cn_key <= rs.frontierq.top().second);
   
-  frontier.erase(cn);
+  rs.erase_frontier(cn);
   
   return cn;
 }
@@ -626,57 +1006,855 @@ Router::pop()
 void
 Router::ripup(int net)
 {
-  for (const auto &p : net_route[net])
+  assert(net_counted[net] == (int)net_route[net].size());
+  for (const RouteStep &st : net_route[net])
     {
-      int cn = p.second;
-      --demand[cn];
-      if (demand[cn] == 1)
+      int cn = st.cn;
+      --demand[cn].nets;
+      if (demand[cn].nets == 1)
         --n_shared;
     }
   net_route[net].clear();
+  net_counted[net] = 0;
+}
+
+// Rip up the part of the route cut off from the source by congested
+// cnets, and the branches that then lead to no target.  The rest
+// stays in place (and in demand) and route_net only has to reconnect
+// the targets that were cut off.
+void
+Router::ripup_congested(int net)
+{
+  std::vector<RouteStep> &route = net_route[net];
+  int n = route.size();
+  assert(net_counted[net] == n);
+  for (int i = 0; i < n; ++i)
+    step_of[route[i].cn] = i;
+  
+  // 0 unknown, 1 keep, 2 drop
+  std::vector<char> state(n, 0);
+  std::vector<int> chain;
+  for (int i = 0; i < n; ++i)
+    {
+      int j = i;
+      char s = 0;
+      while (!state[j])
+        {
+          chain.push_back(j);
+          const RouteStep &st = route[j];
+          if (demand[st.cn].nets > 1)
+            {
+              s = 2;
+              break;
+            }
+          if (st.prev == net_source[net])
+            {
+              s = 1;
+              break;
+            }
+          j = step_of[st.prev];
+          assert(j >= 0 && j < n && route[j].cn == st.prev);
+        }
+      if (!s)
+        s = state[j];
+      for (int k : chain)
+        state[k] = s;
+      chain.clear();
+    }
+  
+  // Drop the kept steps that no longer lead to a target, so branches
+  // cut off below don't stay behind as stubs: kids[i] counts the kept
+  // steps step i drives.
+  std::vector<int> kids(n, 0);
+  std::vector<char> is_target(n, 0);
+  for (int i = 0; i < n; ++i)
+    {
+      if (state[i] == 1
+          && route[i].prev != net_source[net])
+        ++kids[step_of[route[i].prev]];
+    }
+  for (int cn : net_targets[net])
+    {
+      int j = step_of[cn];
+      if (j >= 0
+          && j < n
+          && route[j].cn == cn)
+        is_target[j] = 1;
+    }
+  for (int i = n; i-- > 0;)
+    {
+      int j = i;
+      while (state[j] == 1
+             && !kids[j]
+             && !is_target[j])
+        {
+          state[j] = 2;
+          if (route[j].prev == net_source[net])
+            break;
+          j = step_of[route[j].prev];
+          --kids[j];
+        }
+    }
+  
+  int k = 0;
+  for (int i = 0; i < n; ++i)
+    {
+      if (state[i] == 1)
+        route[k++] = route[i];
+      else
+        {
+          int cn = route[i].cn;
+          --demand[cn].nets;
+          if (demand[cn].nets == 1)
+            --n_shared;
+        }
+    }
+  route.erase(route.begin() + k, route.end());
+  net_counted[net] = k;
 }
 
+// Rebuilding the whole tree of a high-fanout net each pass is slow,
+// but keeping partial routes hurts convergence on small nets, which
+// are cheap to reroute anyway.
 void
-Router::traceback(int net, int target)
+Router::ripup_pass(int net)
+{
+  static const int min_partial_targets = 8;
+  
+  // a net that is still congested gets a bit more room, once a pass
+  // even if route_pass_batched has to route it twice
+  if (passes > 1
+      && net_margin[net] >= 0)
+    ++net_margin[net];
+  
+  if (passes == 1
+      && net_seeded[net])
+    return;
+  
+  if (passes > 1
+      && (int)net_targets[net].size() >= min_partial_targets)
+    ripup_congested(net);
+  else
+    ripup(net);
+}
+
+// Start net from its route in the ECO reference if its source drove
+// the same net there: the cnets reachable from the source through the
+// switches that were on.  Branches that no longer lead to a target
+// are dropped; route_net connects the targets that moved.
+bool
+Router::seed_route(RouteSearch &rs, int net)
+{
+  int source = net_source[net];
+  const Net *ref_n = eco->ref_cnet_net(source);
+  if (!ref_n
+      || ref_n->name() != net_net[net]->name())
+    return false;
+  
+  const Configuration &ref_conf = eco->ref_conf();
+  const FanoutEdge *edges = chipdb->fanout_edges.data();
+  
+  rs.clear();
+  std::vector<int> queue;
+  queue.push_back(source);
+  rs.set_visited(source);
+  rs.node[source].backptr = -1;
+  for (int i = 0; i < (int)queue.size(); ++i)
+    {
+      int cn = queue[i];
+      for (const FanoutEdge &fe : chipdb->fanout(cn))
+        {
+          if (!fe.val
+              || rs.visited(fe.out)
+              || ref_conf.get_cbits(chipdb->switch_cbits_of(fe.sw)) != fe.val)
+            continue;
+          queue.push_back(fe.out);
+          rs.set_visited(fe.out);
+          rs.node[fe.out].backptr = cn;
+          rs.node[fe.out].backedge = &fe - edges;
+        }
+    }
+  
+  for (int cn : net_targets[net])
+    {
+      if (!rs.visited(cn))
+        continue;
+      while (rs.node[cn].backptr >= 0)
+        {
+          int prev = rs.node[cn].backptr;
+          net_route[net].push_back(RouteStep(prev, cn, rs.node[cn].backedge));
+          // the rest of the path is shared with an earlier target
+          rs.node[cn].backptr = -1;
+          cn = prev;
+        }
+    }
+  return !net_route[net].empty();
+}
+
+void
+Router::traceback(RouteSearch &rs, int net, int target)
 {
   int cn = target;
   while (cn >= 0)
     {
-      int prev = backptr[cn];
+      int prev = rs.node[cn].backptr;
       if (prev >= 0)
+        net_route[net].push_back(RouteStep(prev, cn, rs.node[cn].backedge));
+      cn = prev;
+    }
+}
+
+// the search only reads demand, so this can be left until after
+// several nets have been routed concurrently
+void
+Router::add_demand(int net)
+{
+  const std::vector<RouteStep> &route = net_route[net];
+  for (int i = net_counted[net]; i < (int)route.size(); ++i)
+    {
+      int cn = route[i].cn;
+      if (demand[cn].nets == 1)
+        ++n_shared;
+      ++demand[cn].nets;
+    }
+  net_counted[net] = route.size();
+}
+
+// Add the steps net_route[net][k..] that traceback just found to the
+// search tree without restarting: the new cnets cost nothing to reach
+// and are expanded again, and the rest of the wavefront is kept.
+// Visited cnets the new branch reaches more cheaply are reopened, so
+// the costs stay distances from the whole tree, as after a restart.
+// The radix heap needs monotone keys, so there the new cnets cost what
+// the target did instead and nothing is reopened; that search is
+// cheaper but finds worse routes.
+void
+Router::grow_tree(RouteSearch &rs, int net, int k)
+{
+  const std::vector<RouteStep> &route = net_route[net];
+  assert(k < (int)route.size());
+  
+  // traceback pushed the target first
+  int base = radix_queue ? rs.node[route[k].cn].cost : 0;
+  rs.reopen = !radix_queue;
+  rs.set_visited(route[k].cn);
+  for (int i = k; i < (int)route.size(); ++i)
+    {
+      int cn = route[i].cn;
+      rs.node[cn].cost = base;
+      rs.node[cn].backptr = -1;
+    }
+  
+  // new frontier cnets head for the targets still unrouted
+  if (astar)
+    set_goals(rs);
+  
+  for (int i = k; i < (int)route.size(); ++i)
+    expand(rs, route[i].cn);
+}
+
+// Route rs.unrouted from the route of net so far within the bounds
+// set in rs.  Returns true if every target was reached.
+bool
+Router::search(RouteSearch &rs, int net)
+{
+ L:
+  // *logs << "start:";
+  
+  start(rs, net);
+  while (rs.n_frontier)
+    {
+      int cn = pop(rs);
+      
+      if (rs.unrouted.contains(cn))
         {
-          if (demand[cn] == 1)
-            ++n_shared;
-          ++demand[cn];
-          net_route[net].push_back(std::make_pair(prev, cn));
+          rs.unrouted.erase(cn);
+          int k = net_route[net].size();
+          traceback(rs, net, cn);
+          
+          if (rs.unrouted.empty())
+            break;
+          else if (multi_sink)
+            grow_tree(rs, net, k);
+          else
+            goto L;
+        }
+      else
+        visit(rs, cn);
+    }
+  
+  return rs.unrouted.empty();
+}
+
+// Connect the points into a rectilinear tree from points[0], adding
+// at each step the point nearest the tree so far by an L from the
+// nearest point of the tree.  That may be in the middle of an edge,
+// which makes it a Steiner point.  Fills order with the points in
+// the order they were added and join with where each joined the
+// tree.
+static void
+steiner_tree(const std::vector<std::pair<int, int>> &points,
+             std::vector<int> &order,
+             std::vector<std::pair<int, int>> &join)
+{
+  int n = points.size();
+  
+  // the nearest point of the tree to each point not in it yet
+  std::vector<std::pair<int, int>> nearest(n, points[0]);
+  std::vector<int> dist(n);
+  std::vector<bool> added(n, false);
+  for (int i = 0; i < n; ++i)
+    dist[i] = (std::abs(points[i].first - points[0].first)
+               + std::abs(points[i].second - points[0].second));
+  
+  order.clear();
+  join.clear();
+  order.push_back(0);
+  join.push_back(points[0]);
+  added[0] = true;
+  for (int k = 1; k < n; ++k)
+    {
+      int p = -1;
+      for (int i = 0; i < n; ++i)
+        {
+          if (!added[i]
+              && (p < 0 || dist[i] < dist[p]))
+            p = i;
+        }
+      added[p] = true;
+      order.push_back(p);
+      join.push_back(nearest[p]);
+      
+      // horizontal from the tree, then vertical to p
+      int x0 = nearest[p].first,
+        y0 = nearest[p].second,
+        x1 = points[p].first,
+        y1 = points[p].second;
+      int edges[2][4] = {
+        { std::min(x0, x1), std::max(x0, x1), y0, y0 },
+        { x1, x1, std::min(y0, y1), std::max(y0, y1) },
+      };
+      for (int i = 0; i < n; ++i)
+        {
+          if (added[i])
+            continue;
+          for (const int *e : edges)
+            {
+              int x = std::min(std::max(points[i].first, e[0]), e[1]),
+                y = std::min(std::max(points[i].second, e[2]), e[3]);
+              int d = (std::abs(points[i].first - x)
+                       + std::abs(points[i].second - y));
+              if (d < dist[i])
+                {
+                  dist[i] = d;
+                  nearest[i] = std::make_pair(x, y);
+                }
+            }
         }
-      cn = prev;
     }
 }
 
+// Route a high-fanout net from scratch along a rectilinear Steiner
+// tree over the tiles of its source and targets.  Reaching whichever
+// target is nearest the route so far, as route_net does, ignores the
+// targets still to come, so the route wanders and takes more wire.
+// Here the tiles are routed in the order they joined the tree, each
+// searched from the part of the route near its tree edge and within
+// the box of that edge, grown if the search fails.  Returns false if
+// the targets of some tile could not be reached; route_net then
+// finishes the net as usual.
+bool
+Router::route_steiner(RouteSearch &rs, int net)
+{
+  static const int corridor_margin = 1;
+  
+  auto tile_of = [&](int cn)
+    {
+      const NetBBox &b = cnet_bbox[cn];
+      return std::make_pair((b.xmin + b.xmax) / 2,
+                            (b.ymin + b.ymax) / 2);
+    };
+  
+  // the targets grouped by tile, after the source tile
+  std::vector<std::pair<std::pair<int, int>, int>> tile_targets;
+  for (int cn : net_targets[net])
+    tile_targets.push_back(std::make_pair(tile_of(cn), cn));
+  std::sort(tile_targets.begin(), tile_targets.end());
+  
+  std::vector<std::pair<int, int>> points;
+  std::vector<std::vector<int>> point_targets;
+  points.push_back(tile_of(net_source[net]));
+  point_targets.push_back(std::vector<int>());
+  for (const auto &p : tile_targets)
+    {
+      if (p.first == points[0])
+        point_targets[0].push_back(p.second);
+      else
+        {
+          if (points.size() == 1
+              || points.back() != p.first)
+            {
+              points.push_back(p.first);
+              point_targets.push_back(std::vector<int>());
+            }
+          point_targets.back().push_back(p.second);
+        }
+    }
+  
+  std::vector<int> order;
+  std::vector<std::pair<int, int>> join;
+  steiner_tree(points, order, join);
+  
+  bool ok = true;
+  for (int i = 0; ok && i < (int)order.size(); ++i)
+    {
+      int p = order[i];
+      rs.unrouted.clear();
+      for (int cn : point_targets[p])
+        rs.unrouted.insert(cn);
+      for (const RouteStep &st : net_route[net])
+        rs.unrouted.erase(st.cn);
+      if (rs.unrouted.empty())
+        continue;
+      
+      int xmin = std::min(points[p].first, join[i].first),
+        xmax = std::max(points[p].first, join[i].first),
+        ymin = std::min(points[p].second, join[i].second),
+        ymax = std::max(points[p].second, join[i].second);
+      for (int margin = corridor_margin;; margin = 2 * margin + 1)
+        {
+          rs.xmin = xmin - margin;
+          rs.xmax = xmax + margin;
+          rs.ymin = ymin - margin;
+          rs.ymax = ymax + margin;
+          rs.bounded = (rs.xmin > 0
+                        || rs.xmax < chipdb->width - 1
+                        || rs.ymin > 0
+                        || rs.ymax < chipdb->height - 1);
+          rs.corridor = rs.bounded;
+          if (search(rs, net))
+            break;
+          if (!rs.bounded)
+            {
+              ok = false;
+              break;
+            }
+        }
+    }
+  
+  rs.bounded = false;
+  rs.corridor = false;
+  return ok;
+}
+
+// false if a target could not be reached, which callers report
+// with report_unrouted: this may run on a worker thread
+bool
+Router::route_net(RouteSearch &rs, int net)
+{
+  const auto &targets = net_targets[net];
+  
+  rs.delay_weight = timing_weight > 0 ? net_delay_weight[net] : 0;
+  
+  const NetBBox &source_bbox = cnet_bbox[net_source[net]];
+  // not from a global, which has no tile to start the tree at
+  bool steiner = (steiner_fanout > 0
+                  && (int)targets.size() >= steiner_fanout
+                  && net_route[net].empty()
+                  && source_bbox.xmax - source_bbox.xmin <= 2
+                  && source_bbox.ymax - source_bbox.ymin <= 2);
+  if (steiner)
+    {
+      ++rs.n_routed;
+      if (route_steiner(rs, net))
+        return true;
+    }
+  
+  int &margin = net_margin[net];
+ M:
+  rs.bounded = false;
+  if (margin >= 0)
+    {
+      rs.xmin = net_xmin[net] - margin;
+      rs.xmax = net_xmax[net] + margin;
+      rs.ymin = net_ymin[net] - margin;
+      rs.ymax = net_ymax[net] + margin;
+      rs.bounded = (rs.xmin > 0
+                    || rs.xmax < chipdb->width - 1
+                    || rs.ymin > 0
+                    || rs.ymax < chipdb->height - 1);
+    }
+  
+  rs.unrouted.clear();
+  for (int i : targets)
+    // not extend, e.g., lutff_global/clk
+    rs.unrouted.insert(i);
+  // kept by ripup_congested, or by a failed bounded search
+  for (const RouteStep &st : net_route[net])
+    rs.unrouted.erase(st.cn);
+  if (rs.unrouted.empty())
+    return true;
+  if (!steiner)
+    ++rs.n_routed;
+  
+  if (!search(rs, net)
+      && rs.bounded)
+    {
+      margin = 2 * margin + 1;
+      goto M;
+    }
+  
+  return rs.unrouted.empty();
+}
+
+// an unbounded search covers the whole chip, so this is a router bug
+void
+Router::report_unrouted(int net)
+{
+  *logs << net_source[net] << " ->";
+  for (int t : net_targets[net])
+    *logs << " " << t;
+  *logs << "\n";
+  assert(false);
+}
+
+void
+Router::reset_schedule()
+{
+  present_factor = schedule == RouteSchedule::ADAPTIVE ? 1 : 3;
+  present_cost = (int)present_factor;
+  best_shared.clear();
+}
+
+void
+Router::update_schedule()
+{
+  // much higher and nets are pushed off each other's cnets before
+  // history can steer them, which converges worse
+  static const double max_present_factor = 10;
+  static const double present_growth = 1.5;
+  
+  if (passes > 1
+      || schedule == RouteSchedule::ADAPTIVE)
+    {
+      for (int i = 0; i < chipdb->n_nets; ++i)
+        {
+          if (demand[i].nets > 1)
+            demand[i].historical += demand[i].nets;
+        }
+    }
+  
+  if (schedule == RouteSchedule::ADAPTIVE)
+    {
+      present_factor = std::min(present_factor * present_growth,
+                                max_present_factor);
+      present_cost = (int)present_factor;
+    }
+}
+
+// Whether the shared count has stopped falling: no new low in the
+// last stall_passes passes, or new lows coming too slowly, going by
+// that window, to reach 0 within max_passes.
+bool
+Router::stalled()
+{
+  best_shared.push_back(best_shared.empty()
+                        ? n_shared
+                        : std::min(best_shared.back(), n_shared));
+  if (stall_passes <= 0
+      || (int)best_shared.size() <= stall_passes
+      || passes >= max_passes)
+    return false;
+  
+  int best = best_shared.back(),
+    before = best_shared[best_shared.size() - 1 - stall_passes];
+  if (best >= before)
+    {
+      *logs << "  no progress in " << stall_passes << " passes\n";
+      return true;
+    }
+  
+  double rate = (double)(before - best) / stall_passes;
+  double predicted = passes + best / rate;
+  if (predicted > max_passes)
+    {
+      *logs << "  at " << fmt(std::fixed << std::setprecision(1) << rate)
+            << " fewer shared per pass, would need "
+            << (int)std::ceil(predicted) << " passes\n";
+      return true;
+    }
+  return false;
+}
+
+// Set the wire delay of each sink pin from the routes.
+void
+Router::route_delays()
+{
+  for (int n = 0; n < n_nets; ++n)
+    {
+      const std::vector<RouteStep> &route = net_route[n];
+      for (int i = 0; i < (int)route.size(); ++i)
+        step_of[route[i].cn] = i;
+      
+      int source = net_source[n];
+      for (const auto &sp : net_sink_pins[n])
+        {
+          int delay = timing->source_delay(source);
+          int cn = sp.first;
+          while (cn != source)
+            {
+              int i = step_of[cn];
+              assert(i >= 0 && i < (int)route.size() && route[i].cn == cn);
+              delay += timing->cnet_delay(cn);
+              cn = route[i].prev;
+            }
+          timing->set_wire_delay(sp.second, delay);
+        }
+    }
+}
+
+// One switch costs 1 and a typical wire takes about timing_delay_unit
+// ps, so a critical net pays about timing_weight more per wire.
+void
+Router::update_timing()
+{
+  static const double timing_delay_unit = 300;
+  
+  timing->analyze();
+  for (int n = 0; n < n_nets; ++n)
+    net_delay_weight[n] = (timing_weight
+                           * timing->net_crit(net_index_net[n])
+                           / timing_delay_unit);
+}
+
+bool
+Router::congested(int net) const
+{
+  assert(net_route[net].size() > 0);
+  for (const RouteStep &st : net_route[net])
+    {
+      if (demand[st.cn].nets > 1)
+        return true;
+    }
+  return false;
+}
+
+void
+Router::route_pass()
+{
+  for (int n = 0; n < n_nets; ++n)
+    {
+      if (passes > 1
+          && !congested(n))
+        continue;
+      
+      ripup_pass(n);
+      if (!route_net(searches[0], n))
+        report_unrouted(n);
+      add_demand(n);
+      
+      // check();
+    }
+}
+
+// Route the nets in batches whose bounding boxes (plus a margin) are
+// disjoint.  The nets in a batch are routed concurrently against the
+// demand left by the previous batches.  The new parts of their routes
+// are then accepted in net order; a net whose new part uses a cnet
+// already taken by an earlier net of the batch is rerouted against
+// the updated demand.  The result does not depend on the number of
+// threads.
+void
+Router::route_pass_batched(ThreadPool &pool)
+{
+  static const int margin = 1,
+    max_batch = 256,
+    window = 1024;
+  
+  std::vector<int> pending;
+  for (int n = 0; n < n_nets; ++n)
+    pending.push_back(n);
+  
+  BitVector occupied(chipdb->n_tiles);
+  UllmanSet claimed(chipdb->n_nets);
+  std::vector<int> batch,
+    deferred;
+  // per net of the batch, set by the workers
+  std::vector<char> routed;
+  while (!pending.empty())
+    {
+      batch.clear();
+      deferred.clear();
+      occupied.zero();
+      
+      // as in route_pass, a net is only skipped if it isn't congested
+      // once all the nets before it are done
+      bool front = true;
+      int scanned = 0;
+      for (int n : pending)
+        {
+          if ((int)batch.size() >= max_batch
+              || scanned >= window)
+            {
+              deferred.push_back(n);
+              continue;
+            }
+          ++scanned;
+          
+          if (passes > 1
+              && !congested(n))
+            {
+              if (!front)
+                deferred.push_back(n);
+              continue;
+            }
+          front = false;
+          
+          int xmin = std::max(net_xmin[n] - margin, 0),
+            xmax = std::min(net_xmax[n] + margin, chipdb->width - 1),
+            ymin = std::max(net_ymin[n] - margin, 0),
+            ymax = std::min(net_ymax[n] + margin, chipdb->height - 1);
+          bool fits = true;
+          for (int y = ymin; fits && y <= ymax; ++y)
+            for (int x = xmin; x <= xmax; ++x)
+              {
+                if (occupied[chipdb->tile(x, y)])
+                  {
+                    fits = false;
+                    break;
+                  }
+              }
+          if (!fits)
+            {
+              deferred.push_back(n);
+              continue;
+            }
+          
+          for (int y = ymin; y <= ymax; ++y)
+            for (int x = xmin; x <= xmax; ++x)
+              occupied[chipdb->tile(x, y)] = true;
+          batch.push_back(n);
+        }
+      std::swap(pending, deferred);
+      
+      for (int n : batch)
+        ripup_pass(n);
+      routed.assign(batch.size(), 0);
+      pool.run(batch.size(),
+               [&](int i, int w) {
+                 routed[i] = route_net(searches[w], batch[i]);
+               });
+      
+      claimed.clear();
+      for (int j = 0; j < (int)batch.size(); ++j)
+        {
+          int n = batch[j];
+          if (!routed[j])
+            report_unrouted(n);
+          
+          std::vector<RouteStep> &route = net_route[n];
+          int k = net_counted[n];
+          for (int i = k; i < (int)route.size(); ++i)
+            {
+              if (claimed.contains(route[i].cn))
+                {
+                  route.erase(route.begin() + k, route.end());
+                  if (!route_net(searches[0], n))
+                    report_unrouted(n);
+                  break;
+                }
+            }
+          // a rerouted net may still share cnets, at a cost
+          for (int i = k; i < (int)route.size(); ++i)
+            claimed.insert(route[i].cn);
+          add_demand(n);
+        }
+    }
+}
+
+// One line of JSON per pass.  Only tiles with overuse are listed, each
+// with its wire with the most, so the lines shrink as routing
+// converges.
+void
+Router::write_trace(double wall, int n_routed, long long n_expanded,
+                    long long n_pushed, long long n_popped)
+{
+  // tile -> overuse, worst cnet
+  std::map<int, std::pair<int, int>> tile_overuse;
+  for (int cn = 0; cn < chipdb->n_nets; ++cn)
+    {
+      int over = demand[cn].nets - 1;
+      if (over <= 0)
+        continue;
+      
+      int t = (chipdb->net_tile_name.empty()
+               ? chipdb->tile(cnet_bbox[cn].xmin, cnet_bbox[cn].ymin)
+               : chipdb->net_tile_name[cn].first);
+      auto i = tile_overuse.find(t);
+      if (i == tile_overuse.end())
+        tile_overuse[t] = std::make_pair(over, cn);
+      else
+        {
+          if (over > demand[i->second.second].nets - 1)
+            i->second.second = cn;
+          i->second.first += over;
+        }
+    }
+  
+  std::ostream &s = *trace;
+  s << "{\"pass\": " << passes
+    << ", \"wall\": " << wall
+    << ", \"shared\": " << n_shared
+    << ", \"routed\": " << n_routed
+    << ", \"expanded\": " << n_expanded
+    << ", \"pushes\": " << n_pushed
+    << ", \"pops\": " << n_popped
+    << ", \"present_factor\": " << present_factor
+    << ", \"overuse\": [";
+  bool first = true;
+  for (const auto &p : tile_overuse)
+    {
+      int t = p.first,
+        cn = p.second.second;
+      s << (first ? "" : ", ")
+        << "{\"x\": " << chipdb->tile_x(t)
+        << ", \"y\": " << chipdb->tile_y(t)
+        << ", \"overuse\": " << p.second.first
+        << ", \"cnet\": " << cn;
+      if (!chipdb->net_tile_name.empty())
+        {
+          s << ", \"wire\": ";
+          write_json_string(s, chipdb->net_tile_name[cn].second);
+        }
+      s << "}";
+      first = false;
+    }
+  s << "]}\n";
+}
+
 void
 Router::route()
 {
-  // d->dump();
+  static const int max_eco_passes = 10;
   
-  Model *top = d->top();
+  // d->dump();
   
-  std::set<Net *, IdLess> boundary_nets = top->boundary_nets(d);
-  for (const auto &p : top->nets())
+  for (int w = 1; w < index.n_nets(); ++w)
     {
-      Net *n = p.second;
-      if (contains(boundary_nets, n))
+      if (index.net_boundary[w])
         continue;
+      Net *n = index.nets[w];
       
 #ifndef NDEBUG
-      if (n->is_constant())
+      if (index.net_constant[w])
         {
           Value v = n->constant();
           assert(v == Value::ZERO || v == Value::ONE);
           
-          for (auto p2 : n->connections())
+          for (const Pin &pin : index.net_pins(w))
             {
-              Instance *inst = cast<Instance>(p2->node());
+              Port *p2 = pin.port;
+              Instance *inst = index.gates[pin.gate];
               
               if (models.is_lc(inst)
                   && p2->name() == "CIN")
@@ -696,15 +1874,17 @@ Router::route()
       
       int source = -1;
       std::vector<int> targets;
+      std::vector<std::pair<int, int>> sink_pins;
       
       // *logs << n->name() << "\n";
       
-      for (auto p2 : n->connections())
+      for (const Pin &pin : index.net_pins(w))
         {
+          Port *p2 = pin.port;
           assert(p2->connection() == n);
-          assert(isa<Instance>(p2->node()));
+          assert(pin.gate);
           
-          Instance *inst = cast<Instance>(p2->node());
+          Instance *inst = index.gates[pin.gate];
           int cn = port_cnet(inst, p2);
           
           // like lutff_i/cin
@@ -725,16 +1905,16 @@ Router::route()
                  || cnet_net[cn] == n);
           cnet_net[cn] = n;
           
-          assert(!p2->is_bidir());
-          if (p2->is_output())
+          assert(pin.role != PinRole::INOUT);
+          if (pin.role == PinRole::OUTPUT)
             {
               assert(source < 0);
               source = cn;
             }
           else
             {
-              assert(p2->is_input());
               targets.push_back(cn);
+              sink_pins.push_back(std::make_pair(cn, &pin - index.pins.data()));
             }
         }
       
@@ -752,90 +1932,137 @@ Router::route()
           *logs << "\n";
 #endif
           
+          int xmin = cnet_bbox[source].xmin,
+            xmax = cnet_bbox[source].xmax,
+            ymin = cnet_bbox[source].ymin,
+            ymax = cnet_bbox[source].ymax;
+          for (int cn : targets)
+            {
+              xmin = std::min(xmin, cnet_bbox[cn].xmin);
+              xmax = std::max(xmax, cnet_bbox[cn].xmax);
+              ymin = std::min(ymin, cnet_bbox[cn].ymin);
+              ymax = std::max(ymax, cnet_bbox[cn].ymax);
+            }
+          net_xmin.push_back(xmin);
+          net_xmax.push_back(xmax);
+          net_ymin.push_back(ymin);
+          net_ymax.push_back(ymax);
+          
           net_source.push_back(source);
           net_targets.push_back(std::move(targets));
           net_net.push_back(n);
+          net_index_net.push_back(w);
+          net_sink_pins.push_back(std::move(sink_pins));
         }
     }
   
   net_route.resize(n_nets);
+  net_counted.resize(n_nets, 0);
+  net_margin.resize(n_nets, bbox_margin);
+  net_seeded.resize(n_nets);
   
-  for (passes = 1; passes <= max_passes; ++passes)
+  // until there are routes, from the placement
+  if (timing_weight > 0)
+    {
+      net_delay_weight.resize(n_nets, 0);
+      timing->estimate_wires();
+      update_timing();
+    }
+  
+  int n_seeded = 0;
+  if (eco
+      && eco->routed())
     {
       for (int n = 0; n < n_nets; ++n)
         {
-          current_net = n;
-          
-          const auto &targets = net_targets[n];
-          
-          if (passes > 1)
+          if (seed_route(searches[0], n))
             {
-              assert(net_route[n].size() > 0);
-              for (const auto &p : net_route[n])
-                {
-                  if (demand[p.second] > 1)
-                    goto M;
-                }
-              continue;
+              net_seeded[n] = true;
+              add_demand(n);
+              ++n_seeded;
             }
-          
-        M:
-          unrouted.clear();
-          for (int i : targets)
-            // not extend, e.g., lutff_global/clk
-            unrouted.insert(i);
-          
-          ripup(n);
-          
-        L:
-          // *logs << "start:";
-          
-          start(n);
-          while (!frontier.empty())
-            {
-              int cn = pop();
-              
-              if (unrouted.contains(cn))
-                {
-                  unrouted.erase(cn);
-                  traceback(n, cn);
-                  
-                  if (unrouted.empty())
-                    break;
-                  else
-                    goto L;
-                }
-              else
-                visit(cn);
-            }
-          
-          if (!unrouted.empty())
-            {
-              *logs << net_source[n] << " ->";
-              for (int t : targets)
-                *logs << " " << t;
-              *logs << "\n";
-            }
-          
-          assert(unrouted.empty());
-          
-          // *logs << "\n";
-          
-          // check();
         }
+      *logs << "  eco: reused the routes of " << n_seeded
+            << " of " << n_nets << " nets\n";
+    }
+  
+  std::unique_ptr<ThreadPool> pool;
+  if (route_threads)
+    pool.reset(new ThreadPool(route_threads));
+  
+  reset_schedule();
+  for (passes = 1; passes <= max_passes; ++passes)
+    {
+      auto pass_start = std::chrono::steady_clock::now();
+      if (pool)
+        route_pass_batched(*pool);
+      else
+        route_pass();
+      
+      double wall = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                  - pass_start).count();
       
       *logs << "  pass " << passes << ", " << n_shared << " shared.\n";
+      
+      long long n_expanded = 0,
+        n_pushed = 0,
+        n_popped = 0;
+      int n_routed = 0;
+      for (RouteSearch &rs : searches)
+        {
+          n_expanded += rs.n_expanded;
+          n_pushed += rs.n_pushed;
+          n_popped += rs.n_popped;
+          n_routed += rs.n_routed;
+          rs.n_expanded = rs.n_pushed = rs.n_popped = 0;
+          rs.n_routed = 0;
+        }
+      stats.add("route_passes",
+                { { "pass", passes },
+                  { "wall", wall },
+                  { "shared", n_shared },
+                  { "routed", n_routed },
+                  { "expanded", (double)n_expanded },
+                  { "pushes", (double)n_pushed },
+                  { "pops", (double)n_popped } });
+      stats.count("route_expanded", n_expanded);
+      stats.count("route_pushes", n_pushed);
+      stats.count("route_pops", n_popped);
+      if (trace)
+        write_trace(wall, n_routed, n_expanded, n_pushed, n_popped);
+      
       if (!n_shared)
         break;
       
-      if (passes > 1)
+      // previous routes that don't settle quickly are more trouble
+      // than they save: start over as if there were none
+      if (n_seeded
+          && passes == max_eco_passes)
         {
-          for (int i = 0; i < chipdb->n_nets; ++i)
-            {
-              if (demand[i] > 1)
-                historical_demand[i] += demand[i];
-            }
+          *logs << "  eco: rerouting all nets\n";
+          for (int n = 0; n < n_nets; ++n)
+            ripup(n);
+          net_seeded.zero();
+          for (CnetDemand &dm : demand)
+            dm.historical = 0;
+          reset_schedule();
+          n_seeded = 0;
+          passes = 0;
+          continue;
         }
+      
+      if (!n_seeded
+          && stalled())
+        fatal(fmt("failed to route: unroutable, " << n_shared
+                  << " shared after " << passes << " passes"));
+      
+      if (timing_weight > 0)
+        {
+          route_delays();
+          update_timing();
+        }
+      
+      update_schedule();
 
 #if 0
       if (n_shared < 5)
@@ -843,20 +2070,20 @@ Router::route()
           std::map<int, std::set<int>> net_route_reverse;
 
           for (int i = 0; i < n_nets; ++i)
-              for (const auto &p : net_route[i])
-                  if (demand[p.second] > 1)
-                    net_route_reverse[p.second].insert(i);
+              for (const RouteStep &st : net_route[i])
+                  if (demand[st.cn].nets > 1)
+                    net_route_reverse[st.cn].insert(i);
 
           for (int i = 0; i < chipdb->n_nets; ++i)
-            if (demand[i] > 1)
+            if (demand[i].nets > 1)
               {
                 if (chipdb->net_tile_name.empty())
-                  *logs << "    shared net #" << i << " (demand = " << demand[i] << ").\n";
+                  *logs << "    shared net #" << i << " (demand = " << demand[i].nets << ").\n";
                 else
                   {
                     auto &net_tile_name = chipdb->net_tile_name.at(i);
                     int tile_x = chipdb->tile_x(net_tile_name.first), tile_y = chipdb->tile_y(net_tile_name.first);
-                    *logs << "    shared net #" << i << " (demand = " << demand[i] << ") in tile " << tile_x << "," << tile_y << ": " << net_tile_name.second << "\n";
+                    *logs << "    shared net #" << i << " (demand = " << demand[i].nets << ") in tile " << tile_x << "," << tile_y << ": " << net_tile_name.second << "\n";
                   }
                 for (auto j : net_route_reverse.at(i))
                   *logs << "      used by wire " << net_net[j]->name() << "\n";
@@ -867,13 +2094,13 @@ Router::route()
 #if 0
       for (int i = 0; i < n_nets; ++i)
         {
-          for (const auto &p : net_route[i])
+          for (const RouteStep &st : net_route[i])
             {
               bool print = false;
-              if (demand[p.second] > 1)
+              if (demand[st.cn].nets > 1)
                 {
                   print = true;
-                  *logs << "demand " << i << " " << p.second << "\n";
+                  *logs << "demand " << i << " " << st.cn << "\n";
                 }
               if (print)
                 {
@@ -883,8 +2110,8 @@ Router::route()
                     *logs << " " << cn;
                   *logs << "\n";
                   *logs << "route\n";
-                  for (const auto &p2 : net_route[i])
-                    *logs << "  " << p2.first << " -> " << p2.second << "\n";
+                  for (const RouteStep &st2 : net_route[i])
+                    *logs << "  " << st2.prev << " -> " << st2.cn << "\n";
                 }
             }
         }
@@ -896,50 +2123,33 @@ Router::route()
   
   int n_span4 = 0,
     n_span12 = 0;
-  BitVector is_span4(chipdb->n_nets),
-    is_span12(chipdb->n_nets);
-  for (int i = 0; i < chipdb->n_tiles; ++i)
+  for (NetClass c : chipdb->net_class)
     {
-      for (const auto &p : chipdb->tile_nets[i])
-        {
-          const std::string &name = p.first;
-          int cn = p.second;
-          
-          if (is_span4[cn] || is_span12[cn])
-            continue;
-          
-          if (is_prefix("span4_", name)
-              || is_prefix("sp4_", name))      
-            {
-              is_span4[cn] = true;
-              ++n_span4;
-            }
-          else if (is_prefix("span12_", name)
-                   || is_prefix("sp12_", name))
-            {
-              is_span12[cn] = true;
-              ++n_span12;
-            }
-        }
+      if (c == NetClass::SPAN4)
+        ++n_span4;
+      else if (c == NetClass::SPAN12)
+        ++n_span12;
     }
   
   int n_span4_used = 0,
     n_span12_used = 0;
   for (const auto &v : net_route)
-    for (const auto &p : v)
+    for (const RouteStep &st : v)
       {
-        if (is_span4[p.second])
+        NetClass c = chipdb->net_class[st.cn];
+        if (c == NetClass::SPAN4)
           ++n_span4_used;
-        else if (is_span12[p.second])
+        else if (c == NetClass::SPAN12)
           ++n_span12_used;
         
-        int s = chipdb->find_switch(p.first, p.second);
-        const Switch &sw = chipdb->switches[s];
+        const FanoutEdge &fe = chipdb->fanout_edges[st.edge];
+        assert(fe.out == st.cn);
+        const Switch &sw = chipdb->switches[fe.sw];
         
-        assert(!contains(chipdb->net_global, p.second));
-        if (contains(chipdb->net_global, p.first) && (chipdb->device != "384"))
+        assert(!contains(chipdb->net_global, st.cn));
+        if (contains(chipdb->net_global, st.prev) && (chipdb->device != "384"))
           {
-            int g = chipdb->net_global.at(p.first);
+            int g = chipdb->net_global.at(st.prev);
             
             int cb_t = chipdb->tile_colbuf_tile.at(sw.tile);
             
@@ -961,26 +2171,36 @@ Router::route()
                           1);
           }
         
-        conf.set_cbits(sw.cbits,
-                       sw.in_val.at(p.first));
+        conf.set_cbits(chipdb->switch_cbits_of(fe.sw),
+                       fe.val);
       }
   
   *logs << "\n"
         << "After routing:\n"
         << "span_4     " << n_span4_used << " / " << n_span4 << "\n"
         << "span_12    " << n_span12_used << " / " << n_span12 << "\n\n";
+  
+  if (timing)
+    {
+      route_delays();
+      timing->analyze();
+      timing->report(*logs);
+      stats.count("route_max_delay_ps", timing->max_delay());
+    }
 }
 
-void
-route(DesignState &ds, int max_passes)
+int
+route(DesignState &ds, const RouteOptions &opts)
 {
-  Router router(ds, max_passes);
+  Router router(ds, opts);
   
   clock_t start = clock();
   router.route();
   clock_t end = clock();
   
   *logs << "  route time "
-        << std::fixed << std::setprecision(2)
-        << (double)(end - start) / (double)CLOCKS_PER_SEC << "s\n";
+        << fmt(std::fixed << std::setprecision(2)
+               << (double)(end - start) / (double)CLOCKS_PER_SEC) << "s\n";
+  
+  return router.n_passes();
 }
@@ -16,8 +16,79 @@
 #ifndef PNR_ROUTE_HH
 #define PNR_ROUTE_HH
 
+#include <iosfwd>
+
 class DesignState;
+class Eco;
+
+enum class RouteSchedule
+{
+  // congestion cost (1 + history) * (1 + 3 * demand), history from
+  // the second pass
+  DEFAULT,
+  // VPR-style: the present-congestion factor starts at 1 and grows by
+  // half each pass up to 10, and history accumulates from the first
+  // pass
+  ADAPTIVE,
+};
+
+class RouteOptions
+{
+public:
+  int max_passes;
+  RouteSchedule schedule;
+  // if > 0, give up when the least number of shared cnets so far has
+  // not improved in stall_passes passes, or is not falling fast
+  // enough to reach 0 by max_passes
+  int stall_passes;
+  // 0 for the serial router
+  int threads;
+  // order the search by cost plus a lower bound on the cost to the
+  // nearest unrouted target
+  bool astar;
+  // use a radix heap with decrease-key for the search frontier
+  // instead of a binary heap
+  bool radix_queue;
+  // route all the targets of a net in one search, growing the tree
+  // from each target reached, instead of restarting per target
+  bool multi_sink;
+  // if >= 0, only expand cnets whose bbox meets the net bbox grown
+  // by bbox_margin tiles; the margin is grown when a net fails
+  int bbox_margin;
+  // if positive, nets with at least this many targets are routed
+  // from scratch along a rectilinear Steiner tree over their tiles,
+  // each edge of the tree searched within its own box
+  int steiner_fanout;
+  // if positive, add this times the timing criticality of a net
+  // times the delay of each cnet, about 1 per wire, to its cost
+  double timing_weight;
+  // analyze timing from the routes and report the critical path,
+  // also done if timing_weight is set
+  bool report_timing;
+  // if set and routed, start each net from its previous route
+  const Eco *eco;
+  // if set, write a line of JSON per pass with its wall time and
+  // search counters and the overuse of each congested tile
+  std::ostream *trace;
+  
+  RouteOptions()
+    : max_passes(200),
+      schedule(RouteSchedule::DEFAULT),
+      stall_passes(0),
+      threads(0),
+      astar(false),
+      radix_queue(false),
+      multi_sink(false),
+      bbox_margin(-1),
+      steiner_fanout(0),
+      timing_weight(0),
+      report_timing(false),
+      eco(nullptr),
+      trace(nullptr)
+  {}
+};
 
-void route(DesignState &ds, int max_passes);
+// returns the number of passes
+int route(DesignState &ds, const RouteOptions &opts);
 
 #endif
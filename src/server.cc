@@ -0,0 +1,375 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "server.hh"
+#include "util.hh"
+
+#ifdef HAVE_SERVER
+
+#include <iostream>
+#include <map>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// A request is a uint32_t length followed by that many bytes of
+// NUL-terminated strings: the version, the client's working directory
+// and the arguments.  The client's stdin, stdout and stderr are passed
+// with the length.  The reply is the job's exit status as an int32_t.
+
+static const uint32_t max_request_size = 1 << 20;
+
+static int sig_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t stop_signal = 0;
+
+static void
+on_signal(int sig)
+{
+  int saved_errno = errno;
+  if (sig != SIGCHLD)
+    stop_signal = sig;
+  char c = 0;
+  ssize_t n = write(sig_pipe[1], &c, 1);
+  (void)n;
+  errno = saved_errno;
+}
+
+static bool
+read_all(int fd, char *p, size_t n)
+{
+  while (n)
+    {
+      ssize_t r = read(fd, p, n);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+        return false;
+      p += r;
+      n -= r;
+    }
+  return true;
+}
+
+static bool
+write_all(int fd, const char *p, size_t n)
+{
+  while (n)
+    {
+      ssize_t r = write(fd, p, n);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+        return false;
+      p += r;
+      n -= r;
+    }
+  return true;
+}
+
+static sockaddr_un
+socket_address(const std::string &socket_path)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.empty()
+      || socket_path.size() >= sizeof(addr.sun_path))
+    fatal(fmt("invalid server socket path `" << socket_path << "'"));
+  memcpy(addr.sun_path, socket_path.data(), socket_path.size());
+  return addr;
+}
+
+// In the forked child: read the request on conn, take over the
+// client's streams and working directory and run the job.
+static void
+run_job(int conn, int (*run)(int argc, const char **argv))
+{
+  uint32_t size;
+  int fds[3];
+  
+  char control[CMSG_SPACE(sizeof(fds))];
+  iovec iov;
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  
+  ssize_t r;
+  do {
+    r = recvmsg(conn, &msg, 0);
+  } while (r < 0 && errno == EINTR);
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (r != (ssize_t)sizeof(size)
+      || !cmsg
+      || cmsg->cmsg_level != SOL_SOCKET
+      || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))
+      || size > max_request_size)
+    _exit(EXIT_FAILURE);
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  
+  std::string request(size, '\0');
+  if (!read_all(conn, &request[0], size)
+      || request.empty()
+      || request.back() != '\0')
+    _exit(EXIT_FAILURE);
+  
+  for (int i = 0; i < 3; ++i)
+    {
+      dup2(fds[i], i);
+      close(fds[i]);
+    }
+  close(conn);
+  
+  std::vector<std::string> strs;
+  for (size_t b = 0; b < request.size();)
+    {
+      size_t e = request.find('\0', b);
+      strs.push_back(request.substr(b, e - b));
+      b = e + 1;
+    }
+  if (strs.size() < 2)
+    _exit(EXIT_FAILURE);
+  if (strs[0] != version_str)
+    fatal(fmt("client and server versions do not match (client: "
+              << strs[0] << ", server: " << version_str << ")"));
+  if (chdir(strs[1].c_str()) < 0)
+    fatal(fmt("chdir: failed to change to `" << strs[1] << "': "
+              << strerror(errno)));
+  
+  std::vector<const char *> argv;
+  argv.push_back("arachne-pnr");
+  for (size_t i = 2; i < strs.size(); ++i)
+    argv.push_back(strs[i].c_str());
+  int status = run((int)argv.size(), argv.data());
+  
+  std::cout.flush();
+  std::cerr.flush();
+  exit(status);
+}
+
+void
+serve(const std::string &socket_path,
+      int n_jobs,
+      int (*run)(int argc, const char **argv))
+{
+  sockaddr_un addr = socket_address(socket_path);
+  
+  // replace a socket left behind by an earlier server
+  struct stat st;
+  if (lstat(socket_path.c_str(), &st) == 0
+      && S_ISSOCK(st.st_mode))
+    unlink(socket_path.c_str());
+  
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    fatal(fmt("socket: " << strerror(errno)));
+  if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+    fatal(fmt("bind: failed to bind `" << socket_path << "': "
+              << strerror(errno)));
+  if (listen(listen_fd, 64) < 0)
+    fatal(fmt("listen: " << strerror(errno)));
+  
+  if (pipe(sig_pipe) < 0)
+    fatal(fmt("pipe: " << strerror(errno)));
+  for (int fd : sig_pipe)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigaction(SIGCHLD, &sa, nullptr);
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  // clients can go away before their job finishes
+  signal(SIGPIPE, SIG_IGN);
+  
+  *logs << "server: listening on " << socket_path
+        << ", " << n_jobs << " jobs at a time\n";
+  
+  // pid -> connection
+  std::map<pid_t, int> running;
+  long n_started = 0;
+  for (;;)
+    {
+      if (stop_signal
+          && running.empty())
+        break;
+      
+      pollfd pfds[2];
+      pfds[0].fd = sig_pipe[0];
+      pfds[0].events = POLLIN;
+      pfds[1].fd = listen_fd;
+      pfds[1].events = (!stop_signal && (int)running.size() < n_jobs) ? POLLIN : 0;
+      if (poll(pfds, 2, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          fatal(fmt("poll: " << strerror(errno)));
+        }
+      
+      if (pfds[0].revents)
+        {
+          char buf[64];
+          while (read(sig_pipe[0], buf, sizeof(buf)) > 0)
+            ;
+          
+          int status;
+          pid_t pid;
+          while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+            {
+              auto i = running.find(pid);
+              if (i == running.end())
+                continue;
+              int32_t code;
+              if (WIFEXITED(status))
+                code = WEXITSTATUS(status);
+              else if (WIFSIGNALED(status))
+                code = 128 + WTERMSIG(status);
+              else
+                code = EXIT_FAILURE;
+              write_all(i->second, reinterpret_cast<const char *>(&code), sizeof(code));
+              close(i->second);
+              running.erase(i);
+            }
+        }
+      
+      if (pfds[1].revents & POLLIN)
+        {
+          int conn = accept(listen_fd, nullptr, nullptr);
+          if (conn < 0)
+            {
+              if (errno == EINTR
+                  || errno == EAGAIN
+                  || errno == ECONNABORTED)
+                continue;
+              fatal(fmt("accept: " << strerror(errno)));
+            }
+          
+          std::cout.flush();
+          std::cerr.flush();
+          logs->flush();
+          pid_t pid = fork();
+          if (pid < 0)
+            {
+              *logs << "server: fork: " << strerror(errno) << "\n";
+              close(conn);
+              continue;
+            }
+          if (pid == 0)
+            {
+              close(listen_fd);
+              for (const auto &p : running)
+                close(p.second);
+              close(sig_pipe[0]);
+              close(sig_pipe[1]);
+              signal(SIGCHLD, SIG_DFL);
+              signal(SIGINT, SIG_DFL);
+              signal(SIGTERM, SIG_DFL);
+              signal(SIGPIPE, SIG_DFL);
+              run_job(conn, run);
+            }
+          running[pid] = conn;
+          ++n_started;
+        }
+    }
+  
+  *logs << "server: stopping after " << n_started << " jobs\n";
+  close(listen_fd);
+  unlink(socket_path.c_str());
+  close(sig_pipe[0]);
+  close(sig_pipe[1]);
+}
+
+int
+run_on_server(const std::string &socket_path,
+              const std::vector<std::string> &args)
+{
+  sockaddr_un addr = socket_address(socket_path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    fatal(fmt("socket: " << strerror(errno)));
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+    fatal(fmt("failed to connect to server `" << socket_path << "': "
+              << strerror(errno)));
+  
+  std::string request = version_str;
+  request.push_back('\0');
+  char *cwd = getcwd(nullptr, 0);
+  if (!cwd)
+    fatal(fmt("getcwd: " << strerror(errno)));
+  request += cwd;
+  request.push_back('\0');
+  free(cwd);
+  for (const std::string &a : args)
+    {
+      request += a;
+      request.push_back('\0');
+    }
+  if (request.size() > max_request_size)
+    fatal("command line too long for server");
+  
+  uint32_t size = request.size();
+  int fds[3] = { 0, 1, 2 };
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  iovec iov;
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  
+  ssize_t r;
+  do {
+    r = sendmsg(fd, &msg, 0);
+  } while (r < 0 && errno == EINTR);
+  if (r != (ssize_t)sizeof(size)
+      || !write_all(fd, request.data(), request.size()))
+    fatal(fmt("failed to send job to server `" << socket_path << "': "
+              << strerror(errno)));
+  
+  int32_t code;
+  if (!read_all(fd, reinterpret_cast<char *>(&code), sizeof(code)))
+    fatal(fmt("server `" << socket_path << "' closed the connection"));
+  close(fd);
+  return code;
+}
+
+#endif
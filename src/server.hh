@@ -0,0 +1,41 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_SERVER_HH
+#define PNR_SERVER_HH
+
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define HAVE_SERVER
+
+// Accept jobs from run_on_server on the Unix socket socket_path until
+// SIGINT or SIGTERM, at most n_jobs at a time.  Each job runs in a
+// forked copy of the server, so it sees everything the server loaded
+// before calling serve, with the client's standard streams and
+// working directory.  run is called there with the job's command
+// line and returns its exit status.
+void serve(const std::string &socket_path,
+           int n_jobs,
+           int (*run)(int argc, const char **argv));
+
+// Run args, a command line without the program name, on the server
+// listening on socket_path and return its exit status.
+int run_on_server(const std::string &socket_path,
+                  const std::vector<std::string> &args);
+#endif
+
+#endif
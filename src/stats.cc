@@ -0,0 +1,178 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "stats.hh"
+#include "util.hh"
+
+#include <cmath>
+#include <iomanip>
+#include <cassert>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+Stats stats;
+
+long
+max_rss_kib()
+{
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) < 0)
+    return 0;
+#ifdef __APPLE__
+  // bytes
+  return ru.ru_maxrss / 1024;
+#else
+  return ru.ru_maxrss;
+#endif
+#endif
+}
+
+void
+release_free_memory()
+{
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+}
+
+void
+Stats::begin_phase(const std::string &name)
+{
+  end_phase();
+  
+  Phase p;
+  p.name = name;
+  p.wall = p.cpu = 0;
+  p.max_rss = 0;
+  phases.push_back(p);
+  in_phase = true;
+  phase_wall = std::chrono::steady_clock::now();
+  phase_cpu = clock();
+}
+
+void
+Stats::end_phase()
+{
+  if (!in_phase)
+    return;
+  
+  Phase &p = phases.back();
+  p.wall = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - phase_wall).count();
+  p.cpu = (double)(clock() - phase_cpu) / (double)CLOCKS_PER_SEC;
+  p.max_rss = max_rss_kib();
+  in_phase = false;
+}
+
+void
+write_json_string(std::ostream &s, const std::string &str)
+{
+  s << '"';
+  for (char ch : str)
+    {
+      if (ch == '"' || ch == '\\')
+        s << '\\' << ch;
+      else if ((unsigned char)ch < 0x20)
+        s << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << (int)(unsigned char)ch << std::dec << std::setfill(' ');
+      else
+        s << ch;
+    }
+  s << '"';
+}
+
+static void
+write_json_number(std::ostream &s, double x)
+{
+  if (!std::isfinite(x))
+    s << "null";
+  else if (x == std::floor(x)
+           && std::fabs(x) < 9e15)
+    s << (long long)x;
+  else
+    s << std::setprecision(6) << x;
+}
+
+void
+Stats::write_json(std::ostream &s) const
+{
+  assert(!in_phase);
+  
+  s << "{\n"
+    << "  \"version\": ";
+  write_json_string(s, version_str);
+  s << ",\n"
+    << "  \"max_rss_kib\": " << max_rss_kib() << ",\n";
+  
+  s << "  \"phases\": [";
+  for (unsigned i = 0; i < phases.size(); ++i)
+    {
+      const Phase &p = phases[i];
+      s << (i ? ",\n" : "\n") << "    {\"name\": ";
+      write_json_string(s, p.name);
+      s << ", \"wall\": ";
+      write_json_number(s, p.wall);
+      s << ", \"cpu\": ";
+      write_json_number(s, p.cpu);
+      s << ", \"max_rss_kib\": " << p.max_rss << "}";
+    }
+  s << "\n  ],\n";
+  
+  s << "  \"counters\": {";
+  bool first = true;
+  for (const auto &p : counters)
+    {
+      s << (first ? "\n" : ",\n") << "    ";
+      write_json_string(s, p.first);
+      s << ": " << p.second;
+      first = false;
+    }
+  s << "\n  },\n";
+  
+  s << "  \"series\": {";
+  first = true;
+  for (const auto &p : series)
+    {
+      s << (first ? "\n" : ",\n") << "    ";
+      write_json_string(s, p.first);
+      s << ": [";
+      for (unsigned i = 0; i < p.second.size(); ++i)
+        {
+          s << (i ? ",\n" : "\n") << "      {";
+          const Record &r = p.second[i];
+          for (unsigned j = 0; j < r.size(); ++j)
+            {
+              if (j)
+                s << ", ";
+              write_json_string(s, r[j].first);
+              s << ": ";
+              write_json_number(s, r[j].second);
+            }
+          s << "}";
+        }
+      s << "\n    ]";
+      first = false;
+    }
+  s << "\n  }\n"
+    << "}\n";
+}
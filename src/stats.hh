@@ -0,0 +1,76 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_STATS_HH
+#define PNR_STATS_HH
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Per-phase timings and counters for --stats-json.
+class Stats
+{
+public:
+  typedef std::vector<std::pair<std::string, double>> Record;
+  
+private:
+  class Phase
+  {
+  public:
+    std::string name;
+    double wall, cpu;
+    // peak resident set size at the end of the phase, in KiB
+    long max_rss;
+  };
+  
+  std::vector<Phase> phases;
+  bool in_phase;
+  std::chrono::steady_clock::time_point phase_wall;
+  clock_t phase_cpu;
+  
+  std::map<std::string, long long> counters;
+  std::map<std::string, std::vector<Record>> series;
+  
+public:
+  Stats() : in_phase(false), phase_cpu(0) {}
+  
+  // ends the current phase, if any
+  void begin_phase(const std::string &name);
+  void end_phase();
+  
+  void count(const std::string &name, long long n) { counters[name] += n; }
+  // append a record to a series, e.g. one per routing pass
+  void add(const std::string &name, const Record &r) { series[name].push_back(r); }
+  
+  void write_json(std::ostream &s) const;
+};
+
+extern Stats stats;
+
+// write str as a quoted JSON string
+void write_json_string(std::ostream &s, const std::string &str);
+
+// peak resident set size of the process so far, in KiB, or 0
+long max_rss_kib();
+
+// hand free heap memory back to the system, where the allocator can
+void release_free_memory();
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+
+#ifndef PNR_STRINGREF_HH
+#define PNR_STRINGREF_HH
+
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <ostream>
+#include <string>
+
+// Non-owning view of a character range, e.g., a token in a parser's
+// input buffer.  The referenced characters must outlive the view.
+class StringRef
+{
+  const char *b;
+  size_t n;
+  
+public:
+  static const size_t npos = (size_t)-1;
+  
+  StringRef() : b(nullptr), n(0) {}
+  StringRef(const char *b_, size_t n_) : b(b_), n(n_) {}
+  StringRef(const char *s) : b(s), n(strlen(s)) {}
+  StringRef(const std::string &s) : b(s.data()), n(s.size()) {}
+  
+  const char *data() const { return b; }
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  
+  const char *begin() const { return b; }
+  const char *end() const { return b + n; }
+  
+  char operator[](size_t i) const
+  {
+    assert(i < n);
+    return b[i];
+  }
+  char back() const { assert(n > 0); return b[n - 1]; }
+  
+  size_t find(char ch) const
+  {
+    const void *p = memchr(b, ch, n);
+    return p ? (const char *)p - b : npos;
+  }
+  
+  StringRef substr(size_t p, size_t len = npos) const
+  {
+    assert(p <= n);
+    if (len > n - p)
+      len = n - p;
+    return StringRef(b + p, len);
+  }
+  
+  std::string str() const { return std::string(b, n); }
+  
+  bool operator==(const StringRef &rhs) const
+  {
+    return n == rhs.n && memcmp(b, rhs.b, n) == 0;
+  }
+  bool operator!=(const StringRef &rhs) const { return !(*this == rhs); }
+  
+  // FNV-1a
+  size_t hash() const
+  {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < n; ++i)
+      {
+        h ^= (unsigned char)b[i];
+        h *= 16777619u;
+      }
+    return h;
+  }
+};
+
+inline std::ostream &
+operator<<(std::ostream &s, const StringRef &r)
+{
+  return s.write(r.data(), r.size());
+}
+
+#endif
@@ -0,0 +1,38 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include "symbol.hh"
+
+#include <mutex>
+#include <unordered_map>
+
+// unordered_map nodes don't move when the table grows, so symbols can
+// point into it
+static std::unordered_map<std::string, int> &
+symbol_table()
+{
+  static std::unordered_map<std::string, int> table;
+  return table;
+}
+
+static std::mutex symbol_mtx;
+
+Symbol::Symbol(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(symbol_mtx);
+  auto &table = symbol_table();
+  e = &*table.insert(std::make_pair(name, (int)table.size())).first;
+}
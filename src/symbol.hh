@@ -0,0 +1,51 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+
+#ifndef PNR_SYMBOL_HH
+#define PNR_SYMBOL_HH
+
+#include <ostream>
+#include <string>
+#include <utility>
+
+// Interned name.  Each distinct name is stored once for the life of
+// the process and numbered, so symbols compare as pointers and can
+// index arrays by id().  Interning takes a lock; hot paths should
+// intern their names once, e.g., into a function-local static.
+class Symbol
+{
+  typedef std::pair<const std::string, int> Entry;
+  
+  const Entry *e;
+  
+public:
+  explicit Symbol(const std::string &name);
+  explicit Symbol(const char *name) : Symbol(std::string(name)) {}
+  
+  int id() const { return e->second; }
+  const std::string &name() const { return e->first; }
+  
+  bool operator==(Symbol rhs) const { return e == rhs.e; }
+  bool operator!=(Symbol rhs) const { return e != rhs.e; }
+};
+
+inline std::ostream &
+operator<<(std::ostream &s, Symbol sym)
+{
+  return s << sym.name();
+}
+
+#endif
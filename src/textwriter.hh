@@ -0,0 +1,138 @@
+/* Copyright (C) 2015 Cotton Seed
+   
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_TEXTWRITER_HH
+#define PNR_TEXTWRITER_HH
+
+#include "util.hh"
+#include "stringref.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Formats text into a large buffer and hands it to the stream a
+// buffer at a time, for the netlist and constraint writers.  Going
+// through std::ostream item by item costs a sentry and a virtual call
+// per <<.
+class TextWriter
+{
+  static const size_t buffer_size = 1 << 20;
+  
+  std::ostream &os;
+  std::vector<char> buf;
+  size_t n;
+
+public:
+  TextWriter(std::ostream &os_)
+    : os(os_), buf(buffer_size), n(0)
+  {}
+  ~TextWriter() { flush(); }
+  
+  void flush()
+  {
+    if (!n)
+      return;
+    os.write(buf.data(), n);
+    n = 0;
+    if (os.bad())
+      fatal(fmt("std::ostream::write: "
+                << strerror(errno)));
+  }
+  
+  void put(char ch)
+  {
+    if (n == buffer_size)
+      flush();
+    buf[n++] = ch;
+  }
+  
+  void put(const char *p, size_t len)
+  {
+    if (n + len > buffer_size)
+      {
+        flush();
+        if (len > buffer_size)
+          {
+            os.write(p, len);
+            return;
+          }
+      }
+    memcpy(buf.data() + n, p, len);
+    n += len;
+  }
+  
+  void put_int(long long x)
+  {
+    char digits[24];
+    int k = sizeof(digits);
+    unsigned long long u = x < 0 ? -(unsigned long long)x : x;
+    do
+      {
+        digits[--k] = (char)('0' + u % 10);
+        u /= 10;
+      }
+    while (u);
+    if (x < 0)
+      digits[--k] = '-';
+    put(digits + k, sizeof(digits) - k);
+  }
+};
+
+inline TextWriter &operator<<(TextWriter &w, char ch)
+{
+  w.put(ch);
+  return w;
+}
+
+inline TextWriter &operator<<(TextWriter &w, const char *s)
+{
+  w.put(s, strlen(s));
+  return w;
+}
+
+inline TextWriter &operator<<(TextWriter &w, const std::string &s)
+{
+  w.put(s.data(), s.size());
+  return w;
+}
+
+inline TextWriter &operator<<(TextWriter &w, const StringRef &s)
+{
+  w.put(s.data(), s.size());
+  return w;
+}
+
+inline TextWriter &operator<<(TextWriter &w, int x)
+{
+  w.put_int(x);
+  return w;
+}
+
+inline TextWriter &operator<<(TextWriter &w, unsigned x)
+{
+  w.put_int(x);
+  return w;
+}
+
+inline TextWriter &operator<<(TextWriter &w, long long x)
+{
+  w.put_int(x);
+  return w;
+}
+
+#endif
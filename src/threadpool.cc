@@ -0,0 +1,115 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "threadpool.hh"
+#include "util.hh"
+
+#include <cassert>
+
+ThreadPool::ThreadPool(int n_threads_)
+  : n_threads(n_threads_),
+    generation(0),
+    stopping(false),
+    n_running(0),
+    job(nullptr),
+    n_tasks(0),
+    next_task(0)
+{
+  assert(n_threads >= 1);
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  if (n_threads > 1)
+    {
+      warning("threads not supported, using 1 thread");
+      n_threads = 1;
+    }
+#endif
+  for (int w = 1; w < n_threads; ++w)
+    threads.push_back(std::thread(&ThreadPool::worker, this, w));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  start_cv.notify_all();
+  for (std::thread &t : threads)
+    t.join();
+}
+
+void
+ThreadPool::work(int w)
+{
+  for (;;)
+    {
+      int t = next_task++;
+      if (t >= n_tasks)
+        break;
+      (*job)(t, w);
+    }
+}
+
+void
+ThreadPool::worker(int w)
+{
+  unsigned seen = 0;
+  for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        start_cv.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping)
+          return;
+        seen = generation;
+      }
+
+      work(w);
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        --n_running;
+      }
+      done_cv.notify_one();
+    }
+}
+
+void
+ThreadPool::run(int n_tasks_, const std::function<void(int, int)> &f)
+{
+  if (n_threads == 1
+      || n_tasks_ <= 1)
+    {
+      for (int t = 0; t < n_tasks_; ++t)
+        f(t, 0);
+      return;
+    }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    job = &f;
+    n_tasks = n_tasks_;
+    next_task = 0;
+    n_running = n_threads - 1;
+    ++generation;
+  }
+  start_cv.notify_all();
+
+  work(0);
+
+  std::unique_lock<std::mutex> lock(mtx);
+  done_cv.wait(lock, [&]() { return n_running == 0; });
+  job = nullptr;
+}
@@ -0,0 +1,61 @@
+/* Copyright (C) 2015 Cotton Seed
+
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_THREADPOOL_HH
+#define PNR_THREADPOOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads.  run() hands out tasks dynamically, so
+// callers that need reproducible results must make each task's output
+// independent of the worker that runs it.
+class ThreadPool
+{
+  int n_threads;
+  std::vector<std::thread> threads;
+
+  std::mutex mtx;
+  std::condition_variable start_cv;
+  std::condition_variable done_cv;
+  unsigned generation;
+  bool stopping;
+  int n_running;
+
+  const std::function<void(int, int)> *job;
+  int n_tasks;
+  std::atomic<int> next_task;
+
+  void work(int w);
+  void worker(int w);
+
+public:
+  ThreadPool(int n_threads_);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  int size() const { return n_threads; }
+
+  // call f(task, worker) for each task in [0, n_tasks_) and wait for
+  // them to finish; the calling thread is worker 0
+  void run(int n_tasks_, const std::function<void(int, int)> &f);
+};
+
+#endif
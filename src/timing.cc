@@ -0,0 +1,427 @@
+/* Copyright (C) 2015 Cotton Seed
+   
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "timing.hh"
+#include "designstate.hh"
+#include "location.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+
+// iCE40 HX delays in ps, after icetime.  LP and UP parts are slower
+// throughout, which doesn't change which paths are critical.
+
+// I0 to I3 through the LUT to O or LO
+static const int lut_delay[4] = { 449, 400, 379, 316 };
+static const int carry_in_delay = 126,
+  carry_i1_delay = 259,
+  carry_i2_delay = 231;
+static const int dff_clk_to_q = 540,
+  dff_setup = 100;
+// pad to D_IN, and D_OUT or OUTPUT_ENABLE to pad
+static const int io_input_delay = 1100,
+  io_output_delay = 2200;
+static const int ram_clk_to_q = 2150,
+  ram_setup = 200;
+
+// driving a cnet of each class through its switch
+static const int local_delay = 330,
+  span4_delay = 300,
+  span12_delay = 380,
+  global_delay = 1000,
+  other_delay = 260;
+
+// a placed connection: local and input mux, then about a span4 per
+// four tiles
+static const int estimate_local_delay = 590,
+  estimate_tile_delay = 80;
+
+static bool
+is_clock_port(const std::string &name)
+{
+  return (is_suffix(name, "CLK")
+          || is_suffix(name, "CLKN")
+          || name == "CLOCK");
+}
+
+void
+Timing::add_arc(std::vector<std::vector<Arc>> &pin_arcs,
+                int from, int to, int delay)
+{
+  if (from < 0
+      || to < 0)
+    return;
+  Arc a;
+  a.to = to;
+  a.delay = delay;
+  pin_arcs[from].push_back(a);
+}
+
+Timing::Timing(DesignState &ds)
+  : chipdb(ds.chipdb),
+    models(ds.models),
+    index(ds.netlist_index()),
+    placement(ds.placement),
+    m_max_delay(0),
+    critical_end(-1)
+{
+  int n_pins = index.pins.size();
+  driver.resize(n_pins, -1);
+  launch.resize(n_pins, -1);
+  setup.resize(n_pins, -1);
+  fixed_wire.resize(n_pins, -1);
+  wire_delay.resize(n_pins, 0);
+  arrival.resize(n_pins, 0);
+  required.resize(n_pins, 0);
+  pred.resize(n_pins, -1);
+  m_net_crit.resize(index.n_nets(), 0);
+  
+  std::vector<std::vector<Arc>> pin_arcs(n_pins);
+  
+  for (int w = 1; w < index.n_nets(); ++w)
+    {
+      if (index.net_boundary[w]
+          || index.net_constant[w])
+        continue;
+      
+      int src = -1;
+      for (int p = index.net_pin_offset[w]; p < index.net_pin_offset[w + 1]; ++p)
+        {
+          if (index.pins[p].gate
+              && index.pins[p].role == PinRole::OUTPUT)
+            src = p;
+        }
+      if (src < 0)
+        continue;
+      
+      Instance *src_inst = index.gates[index.pins[src].gate];
+      bool global = (models.is_gbX(src_inst)
+                     && index.pins[src].port->name() == "GLOBAL_BUFFER_OUTPUT");
+      for (int p = index.net_pin_offset[w]; p < index.net_pin_offset[w + 1]; ++p)
+        {
+          const Pin &pin = index.pins[p];
+          if (!pin.gate
+              || pin.role != PinRole::INPUT
+              || is_clock_port(pin.port->name()))
+            continue;
+          
+          driver[p] = src;
+          add_arc(pin_arcs, src, p, -1);
+          
+          if (models.is_lc(index.gates[pin.gate])
+              && pin.port->name() == "CIN")
+            fixed_wire[p] = 0;
+          else if (global)
+            fixed_wire[p] = global_delay;
+        }
+    }
+  
+  for (int g = 1; g <= index.n_gates(); ++g)
+    {
+      Instance *inst = index.gates[g];
+      std::map<std::string, int> port_pin;
+      for (int p : index.gate_pins(g))
+        port_pin[index.pins[p].port->name()] = p;
+      auto pin_of = [&](const std::string &name) -> int {
+        auto i = port_pin.find(name);
+        return i == port_pin.end() ? -1 : i->second;
+      };
+      
+      if (models.is_lc(inst))
+        {
+          bool dff = inst->get_param("DFF_ENABLE").get_bit(0);
+          int o = pin_of("O"),
+            lo = pin_of("LO"),
+            cout = pin_of("COUT");
+          for (int i = 0; i < 4; ++i)
+            {
+              int in = pin_of(fmt("I" << i));
+              if (in < 0)
+                continue;
+              if (dff)
+                setup[in] = lut_delay[i] + dff_setup;
+              else
+                add_arc(pin_arcs, in, o, lut_delay[i]);
+              add_arc(pin_arcs, in, lo, lut_delay[i]);
+            }
+          if (dff)
+            {
+              if (o >= 0)
+                launch[o] = dff_clk_to_q;
+              for (const char *name : { "CEN", "SR" })
+                {
+                  int in = pin_of(name);
+                  if (in >= 0)
+                    setup[in] = dff_setup;
+                }
+            }
+          add_arc(pin_arcs, pin_of("CIN"), cout, carry_in_delay);
+          add_arc(pin_arcs, pin_of("I1"), cout, carry_i1_delay);
+          add_arc(pin_arcs, pin_of("I2"), cout, carry_i2_delay);
+        }
+      else if (models.is_gb(inst))
+        add_arc(pin_arcs,
+                pin_of("USER_SIGNAL_TO_GLOBAL_BUFFER"),
+                pin_of("GLOBAL_BUFFER_OUTPUT"),
+                0);
+      else
+        {
+          // registers at the boundary of the fabric
+          bool io = models.is_ioX(inst),
+            ram = models.is_ramX(inst);
+          for (int p : index.gate_pins(g))
+            {
+              const Pin &pin = index.pins[p];
+              const std::string &name = pin.port->name();
+              if (pin.role == PinRole::OUTPUT)
+                launch[p] = io ? io_input_delay : ram ? ram_clk_to_q : 0;
+              else if (pin.role == PinRole::INPUT
+                       && !is_clock_port(name))
+                {
+                  if (io)
+                    setup[p] = ((is_prefix("D_OUT_", name)
+                                 || name == "OUTPUT_ENABLE")
+                                ? io_output_delay
+                                : 0);
+                  else
+                    setup[p] = ram ? ram_setup : 0;
+                }
+            }
+        }
+    }
+  
+  arc_offset.resize(n_pins + 1, 0);
+  std::vector<int> n_in(n_pins, 0);
+  for (int p = 0; p < n_pins; ++p)
+    {
+      arc_offset[p] = arcs.size();
+      for (const Arc &a : pin_arcs[p])
+        {
+          arcs.push_back(a);
+          ++n_in[a.to];
+        }
+    }
+  arc_offset[n_pins] = arcs.size();
+  
+  for (int p = 0; p < n_pins; ++p)
+    {
+      if (!n_in[p])
+        order.push_back(p);
+    }
+  for (int i = 0; i < (int)order.size(); ++i)
+    {
+      int p = order[i];
+      for (int j = arc_offset[p]; j < arc_offset[p + 1]; ++j)
+        {
+          if (--n_in[arcs[j].to] == 0)
+            order.push_back(arcs[j].to);
+        }
+    }
+  if ((int)order.size() < n_pins)
+    *logs << "  timing: " << (n_pins - (int)order.size())
+          << " pins on combinational loops are not timed\n";
+}
+
+int
+Timing::cnet_delay(int cn) const
+{
+  switch (chipdb->net_class[cn])
+    {
+    case NetClass::LOCAL:
+      return local_delay;
+    case NetClass::SPAN4:
+      return span4_delay;
+    case NetClass::SPAN12:
+      return span12_delay;
+    case NetClass::GLOBAL:
+      return global_delay;
+    default:
+      return other_delay;
+    }
+}
+
+int
+Timing::source_delay(int cn) const
+{
+  return chipdb->net_class[cn] == NetClass::GLOBAL ? global_delay : 0;
+}
+
+void
+Timing::estimate_wires(const BasedVector<int, 1> &gate_x,
+                       const BasedVector<int, 1> &gate_y)
+{
+  for (int p = 0; p < (int)index.pins.size(); ++p)
+    {
+      if (driver[p] < 0)
+        continue;
+      if (fixed_wire[p] >= 0)
+        {
+          wire_delay[p] = fixed_wire[p];
+          continue;
+        }
+      int g = index.pins[p].gate,
+        g0 = index.pins[driver[p]].gate;
+      int dist = (std::abs(gate_x[g] - gate_x[g0])
+                  + std::abs(gate_y[g] - gate_y[g0]));
+      wire_delay[p] = estimate_local_delay + estimate_tile_delay * dist;
+    }
+}
+
+void
+Timing::estimate_wires()
+{
+  int n_gates = index.n_gates();
+  BasedVector<int, 1> gate_x(n_gates, 0),
+    gate_y(n_gates, 0);
+  for (int g = 1; g <= n_gates; ++g)
+    {
+      auto i = placement.find(index.gates[g]);
+      if (i == placement.end())
+        continue;
+      int t = chipdb->cell_location[i->second].tile();
+      gate_x[g] = chipdb->tile_x(t);
+      gate_y[g] = chipdb->tile_y(t);
+    }
+  estimate_wires(gate_x, gate_y);
+}
+
+void
+Timing::analyze()
+{
+  static const int unconstrained = std::numeric_limits<int>::max() / 2;
+  
+  for (int p = 0; p < (int)index.pins.size(); ++p)
+    {
+      arrival[p] = std::max(launch[p], 0);
+      required[p] = unconstrained;
+      pred[p] = -1;
+    }
+  
+  m_max_delay = 0;
+  critical_end = -1;
+  for (int p : order)
+    {
+      if (setup[p] >= 0
+          && (critical_end < 0
+              || arrival[p] + setup[p] > m_max_delay))
+        {
+          m_max_delay = arrival[p] + setup[p];
+          critical_end = p;
+        }
+      for (int j = arc_offset[p]; j < arc_offset[p + 1]; ++j)
+        {
+          const Arc &a = arcs[j];
+          int t = arrival[p] + (a.delay < 0 ? wire_delay[a.to] : a.delay);
+          if (t > arrival[a.to])
+            {
+              arrival[a.to] = t;
+              pred[a.to] = p;
+            }
+        }
+    }
+  
+  for (int i = order.size(); i-- > 0;)
+    {
+      int p = order[i];
+      int r = setup[p] >= 0 ? m_max_delay - setup[p] : unconstrained;
+      for (int j = arc_offset[p]; j < arc_offset[p + 1]; ++j)
+        {
+          const Arc &a = arcs[j];
+          if (required[a.to] < unconstrained)
+            r = std::min(r, (required[a.to]
+                             - (a.delay < 0 ? wire_delay[a.to] : a.delay)));
+        }
+      required[p] = r;
+    }
+  
+  std::fill(m_net_crit.begin(), m_net_crit.end(), 0);
+  for (int p = 0; p < (int)index.pins.size(); ++p)
+    {
+      if (driver[p] < 0)
+        continue;
+      int w = index.pins[p].net;
+      m_net_crit[w] = std::max(m_net_crit[w], pin_crit(p));
+    }
+}
+
+// A sink pin's only arc in is its wire, so its slack is the slack of
+// the connection.
+double
+Timing::pin_crit(int p) const
+{
+  static const int unconstrained = std::numeric_limits<int>::max() / 2;
+  
+  if (driver[p] < 0
+      || m_max_delay <= 0
+      || required[p] >= unconstrained)
+    return 0;
+  
+  int slack = required[p] - arrival[p];
+  return std::min(1.0, std::max(0.0, 1.0 - (double)slack / m_max_delay));
+}
+
+std::string
+Timing::describe_pin(int p) const
+{
+  const Pin &pin = index.pins[p];
+  Instance *inst = index.gates[pin.gate];
+  std::string loc;
+  auto i = placement.find(inst);
+  if (i != placement.end())
+    {
+      const Location &l = chipdb->cell_location[i->second];
+      loc = fmt(" " << chipdb->tile_x(l.tile())
+                << "," << chipdb->tile_y(l.tile())
+                << "/" << l.pos());
+    }
+  return fmt(inst->instance_of()->name() << loc
+             << " " << pin.port->name()
+             << " (" << index.nets[pin.net]->name() << ")");
+}
+
+void
+Timing::report(std::ostream &s) const
+{
+  s << "Timing:\n";
+  if (critical_end < 0
+      || m_max_delay <= 0)
+    {
+      s << "  no timed paths\n\n";
+      return;
+    }
+  
+  std::vector<int> path;
+  for (int p = critical_end; p >= 0; p = pred[p])
+    path.push_back(p);
+  std::reverse(path.begin(), path.end());
+  
+  // s is usually *logs, so leave its format as it was
+  std::ios::fmtflags flags = s.flags();
+  std::streamsize precision = s.precision();
+  s << std::fixed << std::setprecision(2)
+    << "  max delay " << m_max_delay / 1000.0 << " ns ("
+    << 1e6 / m_max_delay << " MHz)\n"
+    << "  critical path:\n";
+  for (int p : path)
+    s << "  " << std::setw(8) << arrival[p] / 1000.0 << " ns  "
+      << describe_pin(p) << "\n";
+  s << "  " << std::setw(8) << m_max_delay / 1000.0 << " ns  setup\n\n";
+  s.flags(flags);
+  s.precision(precision);
+}
@@ -0,0 +1,107 @@
+/* Copyright (C) 2015 Cotton Seed
+   
+   This file is part of arachne-pnr.  Arachne-pnr is free software;
+   you can redistribute it and/or modify it under the terms of the GNU
+   General Public License version 2 as published by the Free Software
+   Foundation.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program. If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef PNR_TIMING_HH
+#define PNR_TIMING_HH
+
+#include "netlist.hh"
+#include "netlistindex.hh"
+#include "chipdb.hh"
+#include "vector.hh"
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+class DesignState;
+
+// Static timing analysis of the packed netlist, in ps.  The nodes are
+// the pins of the NetlistIndex.  Cell arcs and the launch and setup
+// times of registers, IOs and RAMs come from a fixed table of iCE40
+// delays; the wire delay into each sink pin is set by the caller,
+// estimated from gate positions or summed over a route.  Clock pins
+// are not timed and the whole design is one clock domain, so the
+// delays are for ranking paths rather than signoff.
+class Timing
+{
+  class Arc
+  {
+  public:
+    int to;
+    // -1 for a wire, whose delay is wire_delay[to]
+    int delay;
+  };
+  
+  const ChipDB *chipdb;
+  const Models &models;
+  const NetlistIndex &index;
+  const std::map<Instance *, int, IdLess> &placement;
+  
+  // arcs out of pin p are arcs[arc_offset[p]] to
+  // arcs[arc_offset[p + 1] - 1]
+  std::vector<Arc> arcs;
+  std::vector<int> arc_offset;
+  // driver pin of each timed sink pin, else -1
+  std::vector<int> driver;
+  // clock-to-output of start points and setup of endpoints, else -1
+  std::vector<int> launch, setup;
+  // wire delay of sink pins that don't depend on the placement, like
+  // carry chains and globals, else -1
+  std::vector<int> fixed_wire;
+  // the pins not on combinational loops, in topological order
+  std::vector<int> order;
+  
+  std::vector<int> wire_delay;
+  std::vector<int> arrival, required;
+  // the pin arrival[p] came from, or -1
+  std::vector<int> pred;
+  std::vector<double> m_net_crit;
+  int m_max_delay;
+  // endpoint of the critical path, or -1
+  int critical_end;
+  
+  void add_arc(std::vector<std::vector<Arc>> &pin_arcs,
+               int from, int to, int delay);
+  std::string describe_pin(int p) const;
+
+public:
+  Timing(DesignState &ds);
+  
+  // ps to drive cnet cn from the cnet before it on a route
+  int cnet_delay(int cn) const;
+  // ps from the source cnet of a route, for routes leaving a global
+  int source_delay(int cn) const;
+  
+  void set_wire_delay(int p, int delay) { wire_delay[p] = delay; }
+  // wire delays from the distance between the driver and sink gates
+  void estimate_wires(const BasedVector<int, 1> &gate_x,
+                      const BasedVector<int, 1> &gate_y);
+  // as above, with the gate positions from ds.placement
+  void estimate_wires();
+  
+  void analyze();
+  
+  int max_delay() const { return m_max_delay; }
+  // 0 to 1: 1 for the connections into sink pin p on the critical
+  // path, falling to 0 with slack equal to the max delay
+  double pin_crit(int p) const;
+  // the largest pin_crit over the sinks of net w
+  double net_crit(int w) const { return m_net_crit[w]; }
+  
+  // max delay and the critical path
+  void report(std::ostream &s) const;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include "util.hh"
 
 #include <iostream>
+#include <fstream>
 #include <set>
 #include <cstring>
 
@@ -36,6 +37,12 @@
 #  include <unistd.h>
 #endif
 
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
 #include <limits.h>
 #if defined(__GNU__)
 #include <dlfcn.h>
@@ -43,8 +50,30 @@
 
 std::ostream *logs;
 
+// worker threads keep exiting
+static thread_local bool fatal_throws = false;
+
+FatalThrows::FatalThrows()
+  : saved(fatal_throws)
+{
+  fatal_throws = true;
+}
+
+FatalThrows::~FatalThrows()
+{
+  fatal_throws = saved;
+}
+
+bool
+FatalThrows::active()
+{
+  return fatal_throws;
+}
+
 void fatal(const std::string &msg)
 {
+  if (fatal_throws)
+    throw FatalError(msg);
   std::cerr << "fatal error: " << msg << "\n";
   exit(EXIT_FAILURE);
 }
@@ -234,3 +263,57 @@ expand_filename(const std::string &file)
   else
     return file;
 }
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &filename)
+  : p(nullptr), n(0)
+{
+  std::ifstream ifs(filename, std::ifstream::in | std::ifstream::binary);
+  if (ifs.fail())
+    fatal(fmt("failed to open `" << filename << "': "
+              << strerror(errno)));
+  ifs.seekg(0, std::ios::end);
+  n = ifs.tellg();
+  ifs.seekg(0, std::ios::beg);
+  char *buf = new char[n ? n : 1];
+  ifs.read(buf, n);
+  if ((size_t)ifs.gcount() != n)
+    fatal(fmt("failed to read `" << filename << "': "
+              << strerror(errno)));
+  p = buf;
+}
+
+MappedFile::~MappedFile()
+{
+  delete [] p;
+}
+#else
+MappedFile::MappedFile(const std::string &filename)
+  : p(nullptr), n(0)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    fatal(fmt("failed to open `" << filename << "': "
+              << strerror(errno)));
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    fatal(fmt("failed to stat `" << filename << "': "
+              << strerror(errno)));
+  n = st.st_size;
+  if (n)
+    {
+      void *m = mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m == MAP_FAILED)
+        fatal(fmt("failed to map `" << filename << "': "
+                  << strerror(errno)));
+      p = static_cast<const char *>(m);
+    }
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (n)
+    munmap(const_cast<char *>(p), n);
+}
+#endif
@@ -28,9 +28,11 @@
 #include <map>
 #include <vector>
 #include <random>
+#include <stdexcept>
 #include <type_traits>
 
 #include <cassert>
+#include <cstring>
 
 extern const char *version_str;
 
@@ -52,7 +54,13 @@ public:
   // uniformly random between 0 .. m
   unsigned random()
   {
-    state = (a * state) % m;
+    // (a * state) % m without a division: m = 2^31 - 1, so
+    // 2^31 = 1 (mod m) and the high bits fold onto the low ones
+    unsigned long long x = a * state;
+    x = (x & m) + (x >> 31);
+    if (x >= m)
+      x -= m;
+    state = x;
     return (unsigned)state;
   }
   unsigned operator()()
@@ -151,6 +159,27 @@ operator<<(std::ostream &s, const std::unordered_map<K, V> &M)
 
 #define fmt(x) (static_cast<const std::ostringstream&>(std::ostringstream() << x).str())
 
+// Thrown by fatal() in place of printing the message and exiting
+// while a FatalThrows is alive on the thread, for the library entry
+// points in arachne.hh.
+class FatalError : public std::runtime_error
+{
+public:
+  FatalError(const std::string &msg) : std::runtime_error(msg) {}
+};
+
+class FatalThrows
+{
+  bool saved;
+  
+public:
+  FatalThrows();
+  ~FatalThrows();
+  
+  // set if fatal() throws on this thread
+  static bool active();
+};
+
 void fatal(const std::string &msg);
 void warning(const std::string &msg);
 void note(const std::string &msg);
@@ -236,6 +265,12 @@ is_prefix(const std::string &prefix, const std::string &s)
   return r.first == prefix.end();
 }
 
+inline bool
+is_prefix(const std::string &prefix, const char *s)
+{
+  return strncmp(prefix.c_str(), s, prefix.size()) == 0;
+}
+
 inline bool
 is_suffix(const std::string &s, const std::string &suffix)
 {
@@ -298,6 +333,23 @@ public:
 
 std::string expand_filename(const std::string &file);
 
+// Read-only view of a whole file, mapped into memory where the
+// platform supports it.
+class MappedFile
+{
+  const char *p;
+  size_t n;
+  
+public:
+  MappedFile(const std::string &filename);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+  
+  const char *data() const { return p; }
+  size_t size() const { return n; }
+};
+
 template<typename T> void
 pop(std::vector<T> &v, int i)
 {
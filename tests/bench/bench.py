@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+
+# Performance benchmarks.  Runs arachne-pnr on the designs in
+# corpus.txt with a fixed seed, and bench_micro, writes the results to
+# results.json and compares them against baseline.json.  Exits with
+# status 1 if anything got slower, bigger or worse by more than the
+# tolerances, or if there is no baseline to compare against.  Timings
+# only compare on the machine the baseline was recorded on, so record
+# one there first with --update-baseline (make bench-baseline).
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import random
+import shlex
+import subprocess
+import sys
+import time
+
+
+def gen_blif(path, n_luts, seed):
+    """A random netlist of LUTs, flip-flops and carry chains."""
+    rg = random.Random(seed)
+    n_in, n_out = 12, 12
+    ins = ['clk', 'rst', 'en'] + ['i%d' % i for i in range(n_in)]
+    outs = ['o%d' % i for i in range(n_out)]
+    lines = ['.model top',
+             '.inputs ' + ' '.join(ins),
+             '.outputs ' + ' '.join(outs),
+             '.names $false',
+             '.names $true', '1']
+    sigs = ['i%d' % i for i in range(n_in)]
+    ffq = []
+    for i in range(n_luts):
+        srcs = sigs[-60:] + ffq[-20:]
+        a = [rg.choice(srcs) for _ in range(4)]
+        o = 'n%d' % i
+        lines.append('.gate SB_LUT4 I0=%s I1=%s I2=%s I3=%s O=%s' % tuple(a + [o]))
+        lines.append('.param LUT_INIT %s'
+                     % ''.join(rg.choice('01') for _ in range(16)))
+        sigs.append(o)
+        if rg.random() < 0.4:
+            q = 'q%d' % i
+            kind = rg.choice(['SB_DFF', 'SB_DFFE', 'SB_DFFR', 'SB_DFFER'])
+            extra = ''
+            if 'E' in kind[5:]:
+                extra += ' E=en'
+            if kind.endswith('R'):
+                extra += ' R=rst'
+            lines.append('.gate %s C=clk D=%s Q=%s%s' % (kind, o, q, extra))
+            ffq.append(q)
+        if rg.random() < 0.02:
+            ci = '$false'
+            for b in range(rg.randint(4, 20)):
+                x, y = rg.choice(sigs[-40:]), rg.choice(sigs[-40:])
+                co = 'c%d_%d' % (i, b)
+                s = 's%d_%d' % (i, b)
+                lines.append('.gate SB_LUT4 I0=$false I1=%s I2=%s I3=%s O=%s'
+                             % (x, y, ci, s))
+                lines.append('.param LUT_INIT 0110100110010110')
+                lines.append('.gate SB_CARRY CI=%s I0=%s I1=%s CO=%s'
+                             % (ci, x, y, co))
+                sigs.append(s)
+                ci = co
+    for j, o in enumerate(outs):
+        lines.append('.gate SB_LUT4 I0=%s I1=%s I2=%s I3=%s O=%s' % (
+            sigs[-1 - j], rg.choice(sigs), rg.choice(ffq or sigs),
+            rg.choice(sigs), o))
+        lines.append('.param LUT_INIT 0110100110010110')
+    lines.append('.end')
+    with open(path, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+def read_corpus(path):
+    corpus = []
+    with open(path) as f:
+        for line in f:
+            words = shlex.split(line, comments=True)
+            if words:
+                corpus.append((words[0], words[1], words[2], words[3:]))
+    return corpus
+
+
+def prepare(design, work):
+    """Returns the BLIF file for design, or None to skip it."""
+    if design.startswith('gen:'):
+        _, n_luts, seed = design.split(':')
+        path = os.path.join(work, 'gen%s_%s.blif' % (n_luts, seed))
+        if not os.path.exists(path):
+            gen_blif(path, int(n_luts), int(seed))
+        return path
+    if not os.path.exists(design):
+        d, f = os.path.split(design)
+        if (f == 'rot.blif'
+                and subprocess.call('command -v yosys >/dev/null', shell=True) == 0):
+            subprocess.check_call(['yosys', '-q', '-p', 'synth_ice40 -blif rot.blif',
+                                   'rot.v'], cwd=d)
+        else:
+            return None
+    return design
+
+
+def run_design(args, name, device, blif, options, work):
+    stats_file = os.path.join(work, name + '.json')
+    cmd = [args.arachne_pnr, '-q', '-d', device, '-s', '1',
+           '--stats-json', stats_file,
+           '-o', os.path.join(work, name + '.txt')]
+    if args.chipdb_dir:
+        cmd += ['-c', os.path.join(args.chipdb_dir, 'chipdb-%s.bin' % device)]
+    cmd += options + [blif]
+
+    wall = None
+    for _ in range(args.repeat):
+        start = time.time()
+        if subprocess.call(cmd) != 0:
+            return {'failed': True}
+        t = time.time() - start
+        if wall is None or t < wall:
+            wall = t
+
+    with open(stats_file) as f:
+        st = json.load(f)
+    r = {'wall': wall,
+         'max_rss_kib': st['max_rss_kib'],
+         'phases': dict((p['name'], p['wall']) for p in st['phases']),
+         'wire_length': st['counters'].get('place_wire_length'),
+         'route_passes': len(st['series'].get('route_passes', []))}
+    return r
+
+
+def run_micro(args):
+    cmd = [args.bench_micro]
+    chipdb = args.micro_chipdb
+    if chipdb and os.path.exists(chipdb):
+        cmd.append(chipdb)
+    micro = {}
+    for line in subprocess.check_output(cmd).decode().splitlines():
+        name, t = line.split()
+        micro[name] = float(t)
+    return micro
+
+
+def compare(results, baseline, args):
+    """Prints the changes from baseline and returns the regressions."""
+    regressions = []
+
+    def check(what, new, old, tolerance, fmt, timing=False):
+        if new is None or old is None:
+            return
+        ratio = new / old if old else (1.0 if new == old else float('inf'))
+        flag = ''
+        if timing and abs(new - old) < args.min_time:
+            # too short to measure
+            pass
+        elif ratio > 1 + tolerance:
+            flag = '  REGRESSION'
+            regressions.append(what)
+        elif ratio < 1 - tolerance:
+            flag = '  improved'
+        print(('  %-32s ' + fmt + ' -> ' + fmt + '  %5.2fx%s')
+              % (what, old, new, ratio, flag))
+
+    for name, r in sorted(results['designs'].items()):
+        b = baseline.get('designs', {}).get(name)
+        if not b:
+            continue
+        if r.get('failed') or b.get('failed'):
+            if r.get('failed') and not b.get('failed'):
+                regressions.append(name)
+                print('  %-32s now fails' % name)
+            continue
+        check(name + ' wall', r['wall'], b['wall'], args.time_tolerance, '%8.3f',
+              timing=True)
+        for phase in sorted(r['phases']):
+            if phase in ('place', 'route', 'read_chipdb', 'write_txt'):
+                check(name + ' ' + phase, r['phases'][phase],
+                      b['phases'].get(phase), args.time_tolerance, '%8.3f',
+                      timing=True)
+        check(name + ' max_rss_kib', r['max_rss_kib'], b['max_rss_kib'],
+              args.memory_tolerance, '%8d')
+        check(name + ' wire_length', r['wire_length'], b['wire_length'],
+              args.quality_tolerance, '%8d')
+        check(name + ' route_passes', r['route_passes'], b['route_passes'],
+              args.quality_tolerance, '%8d')
+
+    for name, t in sorted(results['micro'].items()):
+        check('micro ' + name, t, baseline.get('micro', {}).get(name),
+              args.time_tolerance, '%8.3f', timing=True)
+    return regressions
+
+
+def main():
+    p = argparse.ArgumentParser(description='arachne-pnr performance benchmarks')
+    p.add_argument('--arachne-pnr', default='../../bin/arachne-pnr')
+    p.add_argument('--bench-micro', default='../bench_micro')
+    p.add_argument('--micro-chipdb', default='../../share/arachne-pnr/chipdb-8k.bin',
+                   help='chipdb for the chipdb load and write_txt benchmarks')
+    p.add_argument('--chipdb-dir',
+                   help='directory of chipdb-<device>.bin, instead of the installed ones')
+    p.add_argument('--corpus', default='corpus.txt')
+    p.add_argument('--only',
+                   help='comma-separated designs to run, and micro for bench_micro')
+    p.add_argument('--repeat', type=int, default=3,
+                   help='runs per design; the fastest counts')
+    p.add_argument('--output', default='results.json')
+    p.add_argument('--baseline', default='baseline.json')
+    p.add_argument('--update-baseline', action='store_true',
+                   help='write the results as the new baseline')
+    p.add_argument('--time-tolerance', type=float, default=0.15)
+    p.add_argument('--min-time', type=float, default=0.01,
+                   help='time differences in seconds below this are noise')
+    p.add_argument('--memory-tolerance', type=float, default=0.10)
+    p.add_argument('--quality-tolerance', type=float, default=0.02)
+    args = p.parse_args()
+
+    # fail before the long runs rather than after them
+    if not args.update_baseline and not os.path.exists(args.baseline):
+        print('error: no %s; run make bench-baseline on this machine to record one'
+              % args.baseline, file=sys.stderr)
+        return 1
+
+    work = 'work'
+    if not os.path.isdir(work):
+        os.makedirs(work)
+
+    only = set(args.only.split(',')) if args.only else None
+    results = {'designs': {}, 'micro': {}}
+    for name, device, design, options in read_corpus(args.corpus):
+        if only is not None and name not in only:
+            continue
+        blif = prepare(design, work)
+        if blif is None:
+            print('%s: skipped, no %s' % (name, design))
+            continue
+        r = run_design(args, name, device, blif, options, work)
+        results['designs'][name] = r
+        if r.get('failed'):
+            print('%s: FAILED' % name)
+        else:
+            print('%s: %.3fs, %d KiB, wire length %s, %d routing passes'
+                  % (name, r['wall'], r['max_rss_kib'], r['wire_length'],
+                     r['route_passes']))
+    if only is None or 'micro' in only:
+        results['micro'] = run_micro(args)
+        for name, t in sorted(results['micro'].items()):
+            print('micro %s: %.6fs' % (name, t))
+
+    with open(args.output, 'w') as f:
+        json.dump(results, f, indent=2, sort_keys=True)
+        f.write('\n')
+
+    if args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+            f.write('\n')
+        print('wrote %s' % args.baseline)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    print('\nagainst %s:' % args.baseline)
+    regressions = compare(results, baseline, args)
+    if regressions:
+        print('\n%d regressions' % len(regressions))
+        return 1
+    print('\nno regressions')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,370 @@
+// Microbenchmarks for the data structures on the placer and router
+// hot paths, and for loading a chipdb, searching its routing graph and
+// writing a txt bitstream.
+// Prints one `<name> <seconds>' line per benchmark, the best of a few
+// runs, for tests/bench/bench.py.  The chipdb benchmarks only run when
+// a chipdb is given.
+//
+//   bench_micro [chipdb]
+
+#include "bitvector.hh"
+#include "ullmanset.hh"
+#include "priorityq.hh"
+#include "hashmap.hh"
+#include "chipdb.hh"
+#include "configuration.hh"
+#include "netlist.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cassert>
+
+static const int n_runs = 3;
+
+// side effects the compiler can't drop
+static long sink;
+
+void
+bench(const std::string &name, const std::function<void()> &f)
+{
+  double best = 0;
+  for (int r = 0; r < n_runs; ++r)
+    {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (!r || t < best)
+        best = t;
+    }
+  std::cout << name << " " << std::fixed << std::setprecision(6) << best << "\n";
+}
+
+void
+bench_bitvector(random_generator &rg)
+{
+  static const int n = 1 << 20,
+    n_ops = 1 << 24;
+  std::vector<int> idx(n_ops);
+  for (int &i : idx)
+    i = random_int(0, n - 1, rg);
+
+  bench("bitvector", [&]()
+        {
+          BitVector bv(n);
+          long c = 0;
+          for (int k = 0; k < n_ops; ++k)
+            {
+              int i = idx[k];
+              if (bv[i])
+                {
+                  bv[i] = false;
+                  ++c;
+                }
+              else
+                bv[i] = true;
+            }
+          sink += c;
+        });
+}
+
+void
+bench_ullmanset(random_generator &rg)
+{
+  static const int n = 1 << 16,
+    n_ops = 1 << 24;
+  std::vector<int> idx(n_ops);
+  for (int &i : idx)
+    i = random_int(0, n - 1, rg);
+
+  bench("ullmanset", [&]()
+        {
+          UllmanSet us(n);
+          long c = 0;
+          for (int k = 0; k < n_ops; ++k)
+            {
+              int i = idx[k];
+              if (us.contains(i))
+                us.erase(i);
+              else
+                us.insert(i);
+              // like the router's per-net scratch sets
+              if ((k & 0xfff) == 0)
+                {
+                  c += us.size();
+                  us.clear();
+                }
+            }
+          sink += c;
+        });
+}
+
+class Comp
+{
+public:
+  bool operator()(const std::pair<int, int> &lhs,
+                  const std::pair<int, int> &rhs) const
+  {
+    return (lhs.second > rhs.second
+            || (lhs.second == rhs.second
+                && lhs.first > rhs.first));
+  }
+};
+
+void
+bench_priorityq(random_generator &rg)
+{
+  static const int n_ops = 1 << 22;
+  std::vector<int> cost(n_ops);
+  for (int &c : cost)
+    c = random_int(0, 1 << 20, rg);
+
+  bench("priorityq", [&]()
+        {
+          PriorityQ<std::pair<int, int>, Comp> q;
+          long c = 0;
+          // a frontier that grows and shrinks, as in a search
+          for (int k = 0; k < n_ops; ++k)
+            {
+              q.push(std::make_pair(k, cost[k]));
+              if (k & 1)
+                c += q.pop().second;
+            }
+          while (!q.empty())
+            c += q.pop().second;
+          sink += c;
+        });
+}
+
+// index lookups keyed by pointer, like the placer's net and gate
+// indices
+template<typename M> void
+bench_index_map(const std::string &name,
+                const std::vector<int *> &keys,
+                const std::vector<int> &idx)
+{
+  M m;
+  for (int i = 0; i < (int)keys.size(); ++i)
+    m.insert(std::make_pair(keys[i], i));
+  
+  bench(name, [&]()
+        {
+          long c = 0;
+          for (int i : idx)
+            c += m.find(keys[i])->second;
+          sink += c;
+        });
+}
+
+void
+bench_index_maps(random_generator &rg)
+{
+  static const int n = 1 << 16,
+    n_ops = 1 << 22;
+  std::vector<int> storage(n);
+  std::vector<int *> keys(n);
+  for (int i = 0; i < n; ++i)
+    keys[i] = &storage[i];
+  std::vector<int> idx(n_ops);
+  for (int &i : idx)
+    i = random_int(0, n - 1, rg);
+  
+  bench_index_map<HashMap<int *, int>>("hashmap_find", keys, idx);
+  bench_index_map<std::unordered_map<int *, int>>("unordered_map_find", keys, idx);
+  bench_index_map<std::map<int *, int>>("map_find", keys, idx);
+}
+
+void
+bench_chipdb(const std::string &filename, random_generator &rg)
+{
+  bench("chipdb_load", [&]()
+        {
+          const ChipDB *chipdb = read_chipdb(filename);
+          sink += chipdb->n_nets;
+          delete chipdb;
+        });
+
+  const ChipDB *chipdb = read_chipdb(filename);
+
+  // a configuration with a few bits set in every tile, and no netlist
+  Configuration conf(chipdb);
+  for (int t = 0; t < chipdb->n_tiles; ++t)
+    {
+      auto i = chipdb->tile_nonrouting_cbits.find(chipdb->tile_type[t]);
+      if (i == chipdb->tile_nonrouting_cbits.end())
+        continue;
+      for (const auto &p : i->second)
+        for (const CBit &cbit : p.second)
+          if (random_int(0, 7, rg) == 0)
+            conf.set_cbit(cbit.with_tile(t), true);
+    }
+  Design d;
+  d.create_standard_models();
+  std::map<Instance *, int, IdLess> placement;
+  std::vector<Net *> cnet_net(chipdb->n_nets, nullptr);
+
+  bench("write_txt", [&]()
+        {
+          std::ostringstream s;
+          conf.write_txt(s, chipdb, &d, placement, cnet_net);
+          sink += s.str().size();
+        });
+  if (chipdb->device != "5k"
+      && chipdb->device != "lm4k")
+    bench("write_bin", [&]()
+          {
+            std::ostringstream s;
+            conf.write_bin(s, chipdb, &d, placement);
+            sink += s.str().size();
+          });
+
+
+  // the router's search over the real fanout graph, with its per-cnet
+  // state in parallel arrays and sets, and packed into one record
+  static const int n_searches = 200,
+    n_expand = 4000;
+  std::vector<int> sources(n_searches);
+  for (int &cn : sources)
+    cn = random_int(0, chipdb->n_nets - 1, rg);
+  std::vector<int> demand(chipdb->n_nets), historical(chipdb->n_nets);
+  for (int i = 0; i < chipdb->n_nets; ++i)
+    {
+      demand[i] = random_int(0, 1, rg);
+      historical[i] = random_int(0, 3, rg);
+    }
+
+  bench("search_arrays", [&]()
+        {
+          UllmanSet visited(chipdb->n_nets),
+            frontier(chipdb->n_nets);
+          std::vector<int> cost(chipdb->n_nets),
+            backptr(chipdb->n_nets),
+            backedge(chipdb->n_nets);
+          PriorityQ<std::pair<int, int>, Comp> q;
+          long c = 0;
+          for (int source : sources)
+            {
+              visited.clear();
+              frontier.clear();
+              q.clear();
+              cost[source] = 0;
+              frontier.insert(source);
+              q.push(std::make_pair(source, 0));
+              for (int k = 0; k < n_expand && !q.empty(); )
+                {
+                  int cn = q.pop().first;
+                  if (!frontier.contains(cn))
+                    continue;
+                  frontier.erase(cn);
+                  visited.insert(cn);
+                  ++k;
+                  for (const FanoutEdge &fe : chipdb->fanout(cn))
+                    {
+                      int cn2 = fe.out;
+                      if (visited.contains(cn2))
+                        continue;
+                      int new_cost = (cost[cn]
+                                      + (1 + historical[cn2]) * (1 + demand[cn2]));
+                      if (frontier.contains(cn2)
+                          && new_cost >= cost[cn2])
+                        continue;
+                      cost[cn2] = new_cost;
+                      backptr[cn2] = cn;
+                      backedge[cn2] = &fe - chipdb->fanout_edges.data();
+                      frontier.insert(cn2);
+                      q.push(std::make_pair(cn2, new_cost));
+                    }
+                }
+              c += cost[source] + visited.size();
+            }
+          sink += c;
+        });
+
+  class SearchNode
+  {
+  public:
+    int cost, backptr, backedge;
+    unsigned visited, frontier;
+  };
+  class CnetDemand
+  {
+  public:
+    int nets, historical;
+  };
+  std::vector<CnetDemand> packed_demand(chipdb->n_nets);
+  for (int i = 0; i < chipdb->n_nets; ++i)
+    {
+      packed_demand[i].nets = demand[i];
+      packed_demand[i].historical = historical[i];
+    }
+
+  bench("search_packed", [&]()
+        {
+          std::vector<SearchNode> node(chipdb->n_nets, SearchNode{0, 0, 0, 0, 0});
+          unsigned stamp = 0;
+          PriorityQ<std::pair<int, int>, Comp> q;
+          long c = 0;
+          for (int source : sources)
+            {
+              ++stamp;
+              q.clear();
+              int n_visited = 0;
+              node[source].cost = 0;
+              node[source].frontier = stamp;
+              q.push(std::make_pair(source, 0));
+              for (int k = 0; k < n_expand && !q.empty(); )
+                {
+                  int cn = q.pop().first;
+                  if (node[cn].frontier != stamp)
+                    continue;
+                  node[cn].frontier = 0;
+                  node[cn].visited = stamp;
+                  ++n_visited;
+                  ++k;
+                  int cn_cost = node[cn].cost;
+                  for (const FanoutEdge &fe : chipdb->fanout(cn))
+                    {
+                      SearchNode &n2 = node[fe.out];
+                      if (n2.visited == stamp)
+                        continue;
+                      const CnetDemand &dm = packed_demand[fe.out];
+                      int new_cost = (cn_cost
+                                      + (1 + dm.historical) * (1 + dm.nets));
+                      if (n2.frontier == stamp
+                          && new_cost >= n2.cost)
+                        continue;
+                      n2.cost = new_cost;
+                      n2.backptr = cn;
+                      n2.backedge = &fe - chipdb->fanout_edges.data();
+                      n2.frontier = stamp;
+                      q.push(std::make_pair(fe.out, new_cost));
+                    }
+                }
+              c += node[source].cost + n_visited;
+            }
+          sink += c;
+        });
+
+  delete chipdb;
+}
+
+int
+main(int argc, const char **argv)
+{
+  random_generator rg;
+
+  bench_bitvector(rg);
+  bench_ullmanset(rg);
+  bench_priorityq(rg);
+  bench_index_maps(rg);
+  if (argc > 1)
+    bench_chipdb(argv[1], rg);
+
+  return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+// Compare the router's frontier queues: PriorityQ with lazy deletion
+// and RadixQ with decrease-key, on Dijkstra searches over a grid with
+// router-like costs.  With costs on nodes, as in Router::visit, a
+// node's first cost is final and there is nothing to delete; costs on
+// edges (which is what the A* estimate looks like to the queue) leave
+// stale heap entries behind.
+
+#include "priorityq.hh"
+#include "radixq.hh"
+#include "util.hh"
+
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <ctime>
+
+class Comp
+{
+public:
+  bool operator()(const std::pair<int, int> &lhs,
+                  const std::pair<int, int> &rhs) const
+  {
+    return (lhs.second > rhs.second
+            || (lhs.second == rhs.second
+                && lhs.first > rhs.first));
+  }
+};
+
+static const int w = 400,
+  h = 400,
+  n_searches = 20;
+
+std::vector<int> node_cost;
+// cost of entering v from direction d
+std::vector<int> edge_cost;
+bool use_edge_cost;
+
+int
+step_cost(int u, int d)
+{
+  return use_edge_cost ? edge_cost[u * 4 + d] : node_cost[u];
+}
+
+int
+neighbor(int v, int d)
+{
+  int x = v % w,
+    y = v / w;
+  switch (d)
+    {
+    case 0: return x > 0 ? v - 1 : -1;
+    case 1: return x < w - 1 ? v + 1 : -1;
+    case 2: return y > 0 ? v - w : -1;
+    default: return y < h - 1 ? v + w : -1;
+    }
+}
+
+long
+search_heap(int source, std::vector<int> &cost, long &n_pops)
+{
+  PriorityQ<std::pair<int, int>, Comp> q;
+  std::vector<char> done(w * h, 0);
+  std::fill(cost.begin(), cost.end(), -1);
+  cost[source] = 0;
+  q.push(std::make_pair(source, 0));
+  long total = 0;
+  while (!q.empty())
+    {
+      int v, c;
+      std::tie(v, c) = q.pop();
+      ++n_pops;
+      if (done[v])
+        continue;
+      done[v] = 1;
+      total += c;
+      for (int d = 0; d < 4; ++d)
+        {
+          int u = neighbor(v, d);
+          if (u < 0 || done[u])
+            continue;
+          int c2 = c + step_cost(u, d);
+          if (cost[u] < 0 || c2 < cost[u])
+            {
+              cost[u] = c2;
+              q.push(std::make_pair(u, c2));
+            }
+        }
+    }
+  return total;
+}
+
+long
+search_radix(int source, RadixQ &q, std::vector<int> &cost, long &n_pops)
+{
+  std::vector<char> done(w * h, 0);
+  std::fill(cost.begin(), cost.end(), -1);
+  q.clear();
+  cost[source] = 0;
+  q.push(source, 0);
+  long total = 0;
+  while (!q.empty())
+    {
+      int v = q.pop().first;
+      ++n_pops;
+      int c = cost[v];
+      done[v] = 1;
+      total += c;
+      for (int d = 0; d < 4; ++d)
+        {
+          int u = neighbor(v, d);
+          if (u < 0 || done[u])
+            continue;
+          int c2 = c + step_cost(u, d);
+          if (cost[u] < 0)
+            {
+              cost[u] = c2;
+              q.push(u, c2);
+            }
+          else if (c2 < cost[u])
+            {
+              cost[u] = c2;
+              q.decrease(u, c2);
+            }
+        }
+    }
+  return total;
+}
+
+int
+main()
+{
+  random_generator rg;
+
+  // like Router::visit: base 1 plus history, scaled by demand, and
+  // the occasional final-pass penalty
+  node_cost.resize(w * h);
+  for (int &c : node_cost)
+    {
+      if (random_int(0, 99, rg) == 0)
+        c = 1000000;
+      else
+        c = (1 + random_int(0, 3, rg)) * (1 + 3 * random_int(0, 1, rg));
+    }
+  edge_cost.resize(w * h * 4);
+  for (int i = 0; i < w * h * 4; ++i)
+    edge_cost[i] = node_cost[i / 4] + random_int(0, 8, rg);
+
+  std::vector<int> sources;
+  for (int i = 0; i < n_searches; ++i)
+    sources.push_back(random_int(0, w * h - 1, rg));
+
+  std::vector<int> cost(w * h);
+  RadixQ rq(w * h);
+  for (int e = 0; e < 2; ++e)
+    {
+      use_edge_cost = e;
+      long heap_total = 0,
+        radix_total = 0,
+        heap_pops = 0,
+        radix_pops = 0;
+
+      clock_t start = clock();
+      for (int s : sources)
+        heap_total += search_heap(s, cost, heap_pops);
+      clock_t mid = clock();
+      for (int s : sources)
+        radix_total += search_radix(s, rq, cost, radix_pops);
+      clock_t end = clock();
+
+      assert(heap_total == radix_total);
+
+      std::cout << (use_edge_cost ? "edge costs:\n" : "node costs:\n")
+                << std::fixed << std::setprecision(3)
+                << "  heap   " << (double)(mid - start) / CLOCKS_PER_SEC
+                << "s " << heap_pops << " pops\n"
+                << "  radix  " << (double)(end - mid) / CLOCKS_PER_SEC
+                << "s " << radix_pops << " pops\n";
+    }
+  return 0;
+}
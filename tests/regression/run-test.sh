@@ -32,3 +32,11 @@ for d in 1k 8k; do
 done
 
 $arachne_pnr -d 8k -p pin_type_fail.pcf pin_type_fail.blif -o /dev/null
+
+# --low-memory only drops attributes the flow doesn't read
+rm -rf 5k
+mkdir 5k
+$arachne_pnr -d 5k hfosc_fabric.blif -o 5k/hfosc_fabric.txt
+$arachne_pnr -d 5k --low-memory hfosc_fabric.blif -o 5k/hfosc_fabric_low_memory.txt
+cmp 5k/hfosc_fabric.txt 5k/hfosc_fabric_low_memory.txt
+icepack 5k/hfosc_fabric.txt 5k/hfosc_fabric.bin
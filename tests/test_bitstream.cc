@@ -0,0 +1,324 @@
+
+#include "configuration.hh"
+#include "netlist.hh"
+#include "util.hh"
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+
+// a chip of logic tiles inside a ring of IO tiles, with RAM tiles in
+// columns ram_x1 and ram_x2 if they are given, and only what
+// Configuration looks at
+static void
+make_chipdb(ChipDB &chipdb, const std::string &device, int width, int height,
+            int ram_x1 = -1, int ram_x2 = -1)
+{
+  chipdb.device = device;
+  chipdb.width = width;
+  chipdb.height = height;
+  chipdb.n_tiles = width * height;
+  for (int t = 0; t < chipdb.n_tiles; ++t)
+    {
+      int x = t % width,
+        y = t / width;
+      bool io_x = x == 0 || x == width - 1,
+        io_y = y == 0 || y == height - 1;
+      if (io_x && io_y)
+        chipdb.tile_type.push_back(TileType::EMPTY);
+      else if (io_x || io_y)
+        chipdb.tile_type.push_back(TileType::IO);
+      else if (x == ram_x1 || x == ram_x2)
+        {
+          chipdb.tile_type.push_back(y % 2 ? TileType::RAMB : TileType::RAMT);
+          if (y % 2 == 0)
+            chipdb.add_cell(CellType::RAM, Location(t, 0));
+        }
+      else
+        chipdb.tile_type.push_back(TileType::LOGIC);
+    }
+  chipdb.tile_cbits_block_size[TileType::IO] = std::make_pair(18, 16);
+  chipdb.tile_cbits_block_size[TileType::LOGIC] = std::make_pair(54, 16);
+  chipdb.tile_cbits_block_size[TileType::RAMB] = std::make_pair(42, 16);
+  chipdb.tile_cbits_block_size[TileType::RAMT] = std::make_pair(42, 16);
+}
+
+static uint16_t
+crc16(uint16_t crc, uint8_t b)
+{
+  for (int i = 7; i >= 0; --i)
+    {
+      bool x = ((crc >> 15) ^ (b >> i)) & 1;
+      crc = (crc << 1) ^ (x ? 0x1021 : 0);
+    }
+  return crc;
+}
+
+static int
+ram_cell(const ChipDB &chipdb, int x, int y)
+{
+  for (int c = 1; c <= chipdb.n_cells; ++c)
+    if (chipdb.cell_location[c] == Location(chipdb.tile(x, y), 0))
+      return c;
+  abort();
+}
+
+// the CRAM and BRAM banks of a bitstream, checking the commands and
+// CRC
+class Bitstream
+{
+  std::string s;
+  size_t p;
+  uint16_t crc;
+  
+  uint8_t next()
+  {
+    assert(p < s.size());
+    uint8_t b = s[p++];
+    crc = crc16(crc, b);
+    return b;
+  }
+  
+public:
+  int width, height,
+    bram_width;
+  std::vector<std::vector<bool>> banks,
+    bram_banks;
+  
+  Bitstream(const std::string &s_);
+  
+  bool get(int bank, int x, int y) const
+  {
+    return banks.at(bank).at(y * width + x);
+  }
+  bool get_bram(int bank, int x, int y) const
+  {
+    return bram_banks.at(bank).at(y * bram_width + x);
+  }
+  int count() const
+  {
+    int n = 0;
+    for (const auto &bank : banks)
+      for (bool b : bank)
+        n += b;
+    for (const auto &bank : bram_banks)
+      for (bool b : bank)
+        n += b;
+    return n;
+  }
+};
+
+Bitstream::Bitstream(const std::string &s_)
+  : s(s_), p(0), crc(0), width(0), height(0), bram_width(0),
+    banks(4), bram_banks(4)
+{
+  // comment
+  assert((uint8_t)s[0] == 0xff && s[1] == 0);
+  p = s.find(std::string("\0\0\xff", 3));
+  assert(p != std::string::npos);
+  p += 3;
+  
+  assert(next() == 0x7e && next() == 0xaa && next() == 0x99 && next() == 0x7e);
+  
+  int bank = -1,
+    cur_width = 0,
+    cur_height = 0,
+    offset = -1;
+  bool woken = false;
+  while (!woken)
+    {
+      uint8_t op = next();
+      int n_bytes = op & 0xf;
+      unsigned arg = 0;
+      if ((op >> 4) == 2)
+        {
+          // CRC of everything after the reset, including the opcode
+          uint16_t expected = crc;
+          for (int i = 0; i < n_bytes; ++i)
+            arg = (arg << 8) | next();
+          assert(arg == expected);
+          assert(crc == 0);
+          continue;
+        }
+      for (int i = 0; i < n_bytes; ++i)
+        arg = (arg << 8) | next();
+      switch (op >> 4)
+        {
+        case 0:
+          if (arg == 0x05)
+            crc = 0xffff;
+          else if (arg == 0x06)
+            woken = true;
+          else
+            {
+              // CRAM banks are written whole, BRAM banks in chunks of
+              // rows in order
+              std::vector<bool> *bits;
+              assert(bank >= 0 && cur_width > 0 && cur_height > 0);
+              if (arg == 0x01)
+                {
+                  assert(offset == 0);
+                  width = cur_width;
+                  height = cur_height;
+                  bits = &banks[bank];
+                  assert(bits->empty());
+                }
+              else
+                {
+                  assert(arg == 0x03);
+                  bram_width = cur_width;
+                  bits = &bram_banks[bank];
+                  assert((int)bits->size() == offset * cur_width);
+                }
+              for (int i = 0; i < cur_width * cur_height; i += 8)
+                {
+                  uint8_t b = next();
+                  for (int j = 7; j >= 0; --j)
+                    bits->push_back((b >> j) & 1);
+                }
+              assert(next() == 0 && next() == 0);
+            }
+          break;
+        case 1:
+          bank = arg;
+          break;
+        case 6:
+          cur_width = arg + 1;
+          break;
+        case 7:
+          cur_height = arg;
+          break;
+        case 8:
+          offset = arg;
+          break;
+        case 5:
+        case 9:
+          break;
+        default:
+          assert(false);
+        }
+    }
+  assert(next() == 0);
+  assert(p == s.size());
+}
+
+// shaped like the 384, without RAM
+static void
+test_cram()
+{
+  ChipDB chipdb;
+  make_chipdb(chipdb, "384", 8, 10);
+  Configuration conf(&chipdb);
+  
+  // one bit in a tile of each kind, in each quadrant
+  conf.set_cbit(CBit(chipdb.tile(1, 1), 0, 0), true);
+  conf.set_cbit(CBit(chipdb.tile(6, 8), 2, 5), true);
+  conf.set_cbit(CBit(chipdb.tile(0, 1), 3, 1), true);
+  conf.set_cbit(CBit(chipdb.tile(7, 8), 3, 1), true);
+  conf.set_cbit(CBit(chipdb.tile(1, 0), 2, 0), true);
+  conf.set_cbit(CBit(chipdb.tile(5, 9), 2, 0), true);
+  conf.set_cbit(CBit(chipdb.tile(2, 2), 1, 1), false);
+  conf.set_extra_cbit(std::make_tuple(1, 100, 50));
+  
+  Design d;
+  d.create_standard_models();
+  std::map<Instance *, int, IdLess> placement;
+  std::ostringstream s;
+  conf.write_bin(s, &chipdb, &d, placement);
+  
+  Bitstream bs(s.str());
+  // half the columns, 18 + 3 * 54, and two more
+  assert(bs.width == 182);
+  // five rows of tiles per half
+  assert(bs.height == 80);
+  
+  // logic tiles: bottom left as is, top right mirrored
+  assert(bs.get(0, 18 + 0, 16 + 0));
+  assert(bs.get(3, 18 + 53 - 5, 16 + 15 - 2));
+  // left and right IO columns are mirrored
+  assert(bs.get(0, 17 - 1, 16 + 3));
+  assert(bs.get(3, 17 - 1, 16 + 15 - 3));
+  // top and bottom IO bits are permuted
+  assert(bs.get(0, 18 + 23, 15 - 3));
+  assert(bs.get(3, 18 + 54 + 53 - 23, 15 - 3));
+  assert(bs.get(1, 100, 50));
+  assert(bs.count() == 7);
+  
+  // the 5k isn't supported
+  chipdb.device = "5k";
+  {
+    FatalThrows ft;
+    bool threw = false;
+    try
+      {
+        std::ostringstream s2;
+        conf.write_bin(s2, &chipdb, &d, placement);
+      }
+    catch (const FatalError &)
+      {
+        threw = true;
+      }
+    assert(threw);
+  }
+}
+
+// shaped like the 1k, with a RAM in each quadrant
+static void
+test_bram()
+{
+  ChipDB chipdb;
+  make_chipdb(chipdb, "1k", 14, 18, 3, 10);
+  Configuration conf(&chipdb);
+  conf.set_cbit(CBit(chipdb.tile(3, 1), 0, 41), true);
+  conf.set_cbit(CBit(chipdb.tile(10, 16), 0, 41), true);
+  
+  Design d;
+  d.create_standard_models();
+  Model *top = new Model(&d, "top");
+  d.set_top(top);
+  Model *ram = d.find_model("SB_RAM40_4K");
+  std::map<Instance *, int, IdLess> placement;
+  
+  // bit 0 of INIT_0 of the bottom left RAM, and bit 255 of INIT_F of
+  // the third RAM down in the top right
+  Instance *r1 = top->add_instance(ram);
+  BitVector init1(256);
+  init1[0] = true;
+  r1->set_param("INIT_0", init1);
+  placement[r1] = ram_cell(chipdb, 3, 2);
+  
+  Instance *r2 = top->add_instance(ram);
+  BitVector init2(256);
+  init2[255] = true;
+  r2->set_param("INIT_F", init2);
+  placement[r2] = ram_cell(chipdb, 10, 14);
+  
+  std::ostringstream s;
+  conf.write_bin(s, &chipdb, &d, placement);
+  
+  Bitstream bs(s.str());
+  // 18 + 2 * 54 + 42 + 3 * 54, and two more
+  assert(bs.width == 332);
+  assert(bs.height == 144);
+  assert(bs.get(0, 18 + 2 * 54 + 41, 16));
+  assert(bs.get(3, 18 + 2 * 54 + 42 - 1 - 41, 16 + 15));
+  
+  // four RAMs of 16 columns per half
+  assert(bs.bram_width == 64);
+  assert(bs.bram_banks[0].size() == 64 * 256);
+  assert(bs.get_bram(0, 15, 0));
+  assert(bs.get_bram(3, 16 * 2 + 0, 255));
+  assert(bs.count() == 4);
+}
+
+int
+main()
+{
+  test_cram();
+  test_bram();
+  
+  std::cout << "test_bitstream: all tests passed.\n";
+  return 0;
+}
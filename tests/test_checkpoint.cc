@@ -0,0 +1,258 @@
+
+#include "checkpoint.hh"
+#include "designstate.hh"
+#include "util.hh"
+
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cassert>
+
+static const char *filename = "test_checkpoint.tmp";
+
+// a 4x4 chip with logic tiles inside a ring of IO tiles, with only
+// what checkpoints and Configuration look at
+static void
+make_chipdb(ChipDB &chipdb)
+{
+  chipdb.device = "test";
+  chipdb.width = 4;
+  chipdb.height = 4;
+  chipdb.n_tiles = 16;
+  chipdb.n_nets = 100;
+  for (int t = 0; t < chipdb.n_tiles; ++t)
+    {
+      int x = t % 4,
+        y = t / 4;
+      bool io = x == 0 || x == 3 || y == 0 || y == 3;
+      if (io && (x == 0 || x == 3) && (y == 0 || y == 3))
+        chipdb.tile_type.push_back(TileType::EMPTY);
+      else
+        chipdb.tile_type.push_back(io ? TileType::IO : TileType::LOGIC);
+      if (!io)
+        for (int q = 0; q < 8; ++q)
+          chipdb.add_cell(CellType::LOGIC, Location(t, q));
+    }
+  chipdb.tile_cbits_block_size[TileType::IO] = std::make_pair(18, 16);
+  chipdb.tile_cbits_block_size[TileType::LOGIC] = std::make_pair(54, 16);
+}
+
+static Design *
+make_design()
+{
+  Design *d = new Design;
+  d->create_standard_models();
+  Model *top = new Model(d, "top");
+  d->set_top(top);
+  top->set_param("p", "x");
+  
+  Model *lut4 = d->find_model("SB_LUT4"),
+    *carry = d->find_model("SB_CARRY");
+  
+  Port *a = top->add_port("a", Direction::IN),
+    *y = top->add_port("y", Direction::OUT, Value::ZERO);
+  Net *na = top->find_or_add_net("a"),
+    *ny = top->find_or_add_net("y"),
+    *c0 = top->find_or_add_net("c0"),
+    *c1 = top->find_or_add_net("c1"),
+    *one = top->find_or_add_net("$true");
+  one->set_is_constant(true);
+  one->set_constant(Value::ONE);
+  a->connect(na);
+  y->connect(ny);
+  
+  BitVector init(16);
+  init[3] = true;
+  for (int i = 0; i < 2; ++i)
+    {
+      Instance *lut = top->add_instance(lut4);
+      lut->set_param("LUT_INIT", init);
+      lut->set_attr("src", Const(fmt("top.v:" << i)));
+      lut->find_port("I0")->connect(na);
+      lut->find_port("I1")->connect(i ? c1 : c0);
+      lut->find_port("I2")->connect(one);
+      lut->find_port("O")->connect(i ? ny : top->add_net());
+      
+      Instance *cy = top->add_instance(carry);
+      cy->find_port("I0")->connect(na);
+      cy->find_port("CI")->connect(i ? c0 : one);
+      cy->find_port("CO")->connect(i ? c1 : c0);
+    }
+  return d;
+}
+
+static std::string
+blif(const Design *d)
+{
+  std::ostringstream s;
+  d->write_blif(s);
+  return s.str();
+}
+
+static std::string
+conf_bits(const Configuration &conf)
+{
+  std::ostringstream s;
+  obstream obs(s);
+  conf.bwrite(obs);
+  return s.str();
+}
+
+static std::vector<Instance *>
+instances(const DesignState &ds)
+{
+  return std::vector<Instance *>(ds.top->instances().begin(),
+                                 ds.top->instances().end());
+}
+
+static void
+test(CheckpointStage stage, const ChipDB *chipdb, const Package &package)
+{
+  Design *d = make_design();
+  DesignState ds(chipdb, package, d);
+  
+  std::vector<Instance *> insts = instances(ds);
+  assert(insts.size() == 4);
+  ds.constraints.net_pin_loc["a"] = Location(1, 0);
+  ds.constraints.net_pin_pull_up["a"] = true;
+  ds.constraints.regions.push_back(Region("cnt*", 1, 1, 2, 2));
+  ds.chains.chains.push_back({insts[1], insts[3]});
+  ds.locked.insert(insts[0]);
+  for (int i = 0; i < 4; ++i)
+    ds.placement[insts[i]] = i + 1;
+  ds.gb_inst_gc[insts[2]] = 5;
+  ds.conf.set_cbit(CBit(5, 3, 7), true);
+  ds.conf.set_cbit(CBit(1, 0, 0), false);
+  ds.conf.set_extra_cbit(std::make_tuple(0, 1, 2));
+  ds.cnet_net.assign(chipdb->n_nets, nullptr);
+  ds.cnet_net[7] = d->top()->find_net("c0");
+  ds.cnet_net[42] = d->top()->find_net("y");
+  
+  write_checkpoint(filename, stage, ds);
+  
+  CheckpointReader reader(filename, chipdb);
+  assert(reader.stage() == stage);
+  Design *d2 = reader.read_design();
+  DesignState ds2(chipdb, package, d2);
+  reader.read_state(ds2);
+  
+  // the BLIF has the instance params and attributes
+  assert(blif(d2) == blif(d));
+  assert(ds2.top->params().size() == 1
+         && ds2.top->get_param("p").as_string() == "x");
+  std::vector<Instance *> insts2 = instances(ds2);
+  assert(insts2.size() == insts.size());
+  for (int i = 0; i < 4; ++i)
+    assert(insts2[i]->instance_of()->name()
+           == insts[i]->instance_of()->name());
+  
+  assert(ds2.constraints.net_pin_loc == ds.constraints.net_pin_loc);
+  assert(ds2.constraints.net_pin_pull_up == ds.constraints.net_pin_pull_up);
+  assert(ds2.constraints.regions.size() == 1);
+  const Region &r = ds2.constraints.regions[0];
+  assert(r.pattern == "cnt*"
+         && r.xmin == 1 && r.ymin == 1
+         && r.xmax == 2 && r.ymax == 2);
+  
+  assert(ds2.chains.chains.size() == 1);
+  assert(ds2.chains.chains[0]
+         == std::vector<Instance *>({insts2[1], insts2[3]}));
+  assert(ds2.locked.size() == 1
+         && contains(ds2.locked, insts2[0]));
+  assert(ds2.placement.size() == 4);
+  for (int i = 0; i < 4; ++i)
+    assert(ds2.placement.at(insts2[i]) == i + 1);
+  assert(ds2.gb_inst_gc.size() == 1
+         && ds2.gb_inst_gc.at(insts2[2]) == 5);
+  
+  if (stage >= CheckpointStage::PLACE)
+    assert(conf_bits(ds2.conf) == conf_bits(ds.conf));
+  else
+    assert(conf_bits(ds2.conf) == conf_bits(Configuration(chipdb)));
+  
+  if (stage >= CheckpointStage::ROUTE)
+    {
+      assert((int)ds2.cnet_net.size() == chipdb->n_nets);
+      for (int i = 0; i < chipdb->n_nets; ++i)
+        {
+          if (ds.cnet_net[i])
+            assert(ds2.cnet_net[i]
+                   && ds2.cnet_net[i]->name() == ds.cnet_net[i]->name());
+          else
+            assert(!ds2.cnet_net[i]);
+        }
+    }
+  else
+    assert(ds2.cnet_net.empty());
+  
+  delete d2;
+  delete d;
+  std::remove(filename);
+}
+
+// reading a checkpoint back onto the design it was written from, as
+// --seeds does, replaces the state and keeps the netlist
+static void
+test_match(const ChipDB *chipdb, const Package &package)
+{
+  Design *d = make_design();
+  DesignState ds(chipdb, package, d);
+  std::vector<Instance *> insts = instances(ds);
+  ds.chains.chains.push_back({insts[1], insts[3]});
+  for (int i = 0; i < 4; ++i)
+    ds.placement[insts[i]] = i + 1;
+  ds.conf.set_cbit(CBit(5, 3, 7), true);
+  ds.cnet_net.assign(chipdb->n_nets, nullptr);
+  ds.cnet_net[7] = d->top()->find_net("c0");
+  write_checkpoint(filename, CheckpointStage::ROUTE, ds);
+  
+  DesignState ds2(chipdb, package, d);
+  ds2.chains.chains.push_back({insts[1], insts[3]});
+  ds2.placement[insts[0]] = 4;
+  {
+    CheckpointReader reader(filename, chipdb);
+    reader.match_design(ds2.top);
+    reader.read_state(ds2);
+  }
+  assert(ds2.chains.chains == ds.chains.chains);
+  assert(ds2.placement == ds.placement);
+  assert(conf_bits(ds2.conf) == conf_bits(ds.conf));
+  assert(ds2.cnet_net == ds.cnet_net);
+  
+  // a different design doesn't match
+  d->top()->add_instance(d->find_model("SB_LUT4"));
+  {
+    FatalThrows ft;
+    CheckpointReader reader(filename, chipdb);
+    bool threw = false;
+    try
+      {
+        reader.match_design(d->top());
+      }
+    catch (const FatalError &)
+      {
+        threw = true;
+      }
+    assert(threw);
+  }
+  
+  delete d;
+  std::remove(filename);
+}
+
+int
+main()
+{
+  ChipDB chipdb;
+  make_chipdb(chipdb);
+  Package package;
+  
+  test(CheckpointStage::PACK, &chipdb, package);
+  test(CheckpointStage::PLACE, &chipdb, package);
+  test(CheckpointStage::ROUTE, &chipdb, package);
+  test_match(&chipdb, package);
+  
+  std::cout << "test_checkpoint: all tests passed.\n";
+  return 0;
+}
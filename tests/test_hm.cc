@@ -0,0 +1,152 @@
+
+#include "hashmap.hh"
+#include "hashset.hh"
+#include "util.hh"
+
+#include <map>
+#include <set>
+#include <string>
+#include <iostream>
+
+// every key in one of a few buckets, for long probe sequences
+class BadHash
+{
+public:
+  size_t operator()(int x) const { return x & 3; }
+};
+
+template<typename M> void
+test_map(int n, random_generator &rg)
+{
+  std::map<int, int> a;
+  M b;
+  
+  assert(b.empty());
+  assert(b.find(0) == b.end());
+  
+  for (int k = 0; k < 4*n; ++k)
+    {
+      int i = random_int(0, n-1, rg),
+        v = random_int(0, 1000, rg);
+      switch (random_int(0, 3, rg))
+        {
+        case 0:
+          {
+            bool inserted = a.insert(std::make_pair(i, v)).second;
+            auto p = b.insert(std::make_pair(i, v));
+            assert(p.second == inserted);
+            assert(p.first->first == i);
+            assert(p.first->second == a.at(i));
+          }
+          break;
+        case 1:
+          a[i] = v;
+          b[i] = v;
+          break;
+        case 2:
+          assert(b.erase(i) == a.erase(i));
+          break;
+        case 3:
+          {
+            auto j = b.find(i);
+            if (j != b.end())
+              {
+                b.erase(j);
+                a.erase(i);
+              }
+          }
+          break;
+        }
+      assert(a.size() == b.size());
+    }
+  
+  for (int i = 0; i < n; ++i)
+    {
+      auto j = b.find(i);
+      if (contains_key(a, i))
+        {
+          assert(j != b.end());
+          assert(j->first == i);
+          assert(j->second == a.at(i));
+          assert(b.at(i) == a.at(i));
+          assert(b.count(i) == 1);
+        }
+      else
+        {
+          assert(j == b.end());
+          assert(b.count(i) == 0);
+        }
+    }
+  
+  M c(b);
+  assert(c == b);
+  if (!a.empty())
+    {
+      int i = a.begin()->first;
+      c[i] = c[i] + 1;
+      assert(c != b);
+    }
+  M d(std::move(c));
+  assert(d.size() == b.size());
+  c = b;
+  assert(c == b);
+  
+  b.clear();
+  assert(b.empty());
+  for (int i = 0; i < n; ++i)
+    assert(b.find(i) == b.end());
+}
+
+template<typename S> void
+test_set(int n, random_generator &rg)
+{
+  std::set<int> a;
+  S b;
+  
+  for (int k = 0; k < 4*n; ++k)
+    {
+      int i = random_int(0, n-1, rg);
+      if (random_int(0, 1, rg))
+        assert(b.insert(i).second == a.insert(i).second);
+      else
+        assert(b.erase(i) == a.erase(i));
+      assert(a.size() == b.size());
+    }
+  for (int i = 0; i < n; ++i)
+    {
+      assert(contains(a, i) == contains(b, i));
+      if (contains(b, i))
+        assert(*b.find(i) == i);
+    }
+  
+  S c(b);
+  assert(c == b);
+  c.insert(n);
+  assert(c != b);
+}
+
+int
+main()
+{
+  random_generator rg;
+  
+  for (int n : {1, 2, 5, 17, 100, 1000, 10000})
+    {
+      test_map<HashMap<int, int>>(n, rg);
+      test_map<HashMap<int, int, BadHash>>(n, rg);
+      test_set<HashSet<int>>(n, rg);
+      test_set<HashSet<int, BadHash>>(n, rg);
+    }
+  
+  HashMap<std::string, std::string> m;
+  m["a"] = "x";
+  m.insert(std::make_pair(std::string("b"), std::string("y")));
+  assert(m.size() == 2);
+  assert(m.at("a") == "x");
+  assert(m.at("b") == "y");
+  m.erase("a");
+  assert(!contains_key(m, std::string("a")));
+  
+  std::cout << "test_hm: all tests passed.\n";
+  return 0;
+}
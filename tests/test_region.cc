@@ -0,0 +1,66 @@
+
+#include "location.hh"
+#include "pcf.hh"
+
+#include <iostream>
+#include <cassert>
+
+static bool
+matches(const char *pattern, const char *name)
+{
+  return Region(pattern, 0, 0, 0, 0).matches(name);
+}
+
+int
+main()
+{
+  // empty pattern
+  assert(matches("", ""));
+  assert(!matches("", "a"));
+  
+  // literals
+  assert(matches("abc", "abc"));
+  assert(!matches("abc", "ab"));
+  assert(!matches("ab", "abc"));
+  assert(!matches("abc", "abd"));
+  
+  // trailing and repeated *
+  assert(matches("*", ""));
+  assert(matches("*", "abc"));
+  assert(matches("**", ""));
+  assert(matches("a*", "a"));
+  assert(matches("a*", "abc"));
+  assert(matches("a**", "abc"));
+  assert(!matches("a*", "ba"));
+  assert(matches("*c", "abc"));
+  assert(!matches("*c", "abcd"));
+  
+  // backtracking
+  assert(matches("a*b*c", "axbxbxc"));
+  assert(matches("*ab", "aab"));
+  assert(matches("*aab", "aaab"));
+  assert(!matches("a*b*c", "axbxbx"));
+  assert(matches("cnt[*]", "cnt[12]"));
+  assert(!matches("cnt[*]", "cnt[12]x"));
+  
+  // ? next to *
+  assert(matches("?", "a"));
+  assert(!matches("?", ""));
+  assert(!matches("?", "ab"));
+  assert(matches("*?", "a"));
+  assert(!matches("*?", ""));
+  assert(matches("?*", "abc"));
+  assert(!matches("?*", ""));
+  assert(matches("a*?c", "abc"));
+  assert(!matches("a*?c", "ac"));
+  assert(matches("a?*c", "abxc"));
+  
+  Region r("*", 2, 3, 4, 5);
+  assert(r.contains(2, 3));
+  assert(r.contains(4, 5));
+  assert(!r.contains(1, 3));
+  assert(!r.contains(2, 6));
+  
+  std::cout << "test_region: all tests passed.\n";
+  return 0;
+}
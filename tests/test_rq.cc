@@ -0,0 +1,84 @@
+#include "radixq.hh"
+#include "util.hh"
+
+#include <set>
+#include <vector>
+#include <iostream>
+#include <cassert>
+
+void
+test(int n, unsigned max_step, random_generator &rg)
+{
+  RadixQ q(n);
+  assert((int)q.capacity() == n);
+  assert(q.empty());
+
+  // key, id
+  std::set<std::pair<unsigned, int>> a;
+  std::vector<unsigned> key(n);
+  unsigned last = 0;
+  for (int k = 0; k < 4*n; ++k)
+    {
+      int i = random_int(0, n-1, rg);
+      int op = random_int(0, 3, rg);
+      if (op == 0
+          && !a.empty())
+        {
+          auto p = q.pop();
+          assert(p.second == a.begin()->first);
+          assert(a.count(std::make_pair(p.second, p.first)));
+          a.erase(std::make_pair(p.second, p.first));
+          last = p.second;
+          assert(!q.contains(p.first));
+        }
+      else if (op == 1)
+        {
+          if (q.contains(i))
+            {
+              a.erase(std::make_pair(key[i], i));
+              q.erase(i);
+            }
+          assert(!q.contains(i));
+        }
+      else if (q.contains(i))
+        {
+          unsigned k2 = last + random_int(0, key[i] - last, rg);
+          a.erase(std::make_pair(key[i], i));
+          key[i] = k2;
+          q.decrease(i, k2);
+          a.insert(std::make_pair(k2, i));
+        }
+      else
+        {
+          key[i] = last + random_int(0, max_step, rg);
+          q.push(i, key[i]);
+          a.insert(std::make_pair(key[i], i));
+        }
+      assert(q.size() == a.size());
+    }
+
+  while (!a.empty())
+    {
+      auto p = q.pop();
+      assert(p.second == a.begin()->first);
+      a.erase(std::make_pair(p.second, p.first));
+    }
+  assert(q.empty());
+
+  q.clear();
+  for (int i = 0; i < n; ++i)
+    assert(!q.contains(i));
+}
+
+int
+main()
+{
+  random_generator rg;
+
+  for (int n = 1; n <= 200; ++n)
+    {
+      test(n, 10, rg);
+      test(n, 1000000, rg);
+    }
+  test(10000, 100, rg);
+}